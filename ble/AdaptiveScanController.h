@@ -0,0 +1,207 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ADAPTIVE_SCAN_CONTROLLER_H__
+#define __ADAPTIVE_SCAN_CONTROLLER_H__
+
+#include <stdint.h>
+
+#include "blecommon.h"
+#include "BLEProtocol.h"
+#include "Gap.h"
+#include "TimeSource.h"
+
+#ifndef YOTTA_CFG_BLE_ADAPTIVE_SCAN_MAX_ADVERTISERS
+/**
+ * Default number of advertisers an AdaptiveScanController remembers to tell
+ * new ones from those already discovered.
+ */
+#define YOTTA_CFG_BLE_ADAPTIVE_SCAN_MAX_ADVERTISERS 32
+#endif
+
+/**
+ * @brief Scan duty cycle adapted to the advertisers around.
+ *
+ * @details A fixed scan window is either too short to discover advertisers
+ * quickly when they show up, or wastes the radio once they are all known.
+ * The controller varies the window of Gap within a fixed scan interval:
+ * every evaluation period, it doubles the duty cycle when new advertisers
+ * were discovered, and halves it after a few periods without any, sooner
+ * when the advertisers in range are many and all known, since their reports
+ * then only cost power.
+ *
+ * The average duty cycle is held to an airtime budget: the periods below
+ * the budget save credit which the discovery bursts spend, and once the
+ * credit is exhausted the duty cycle is capped at the budget. Each active
+ * connection takes a share of the maximum duty cycle, as its events compete
+ * with scanning for the radio.
+ *
+ * The controller doesn't start scanning; the application forwards to
+ * recordReport() the advertisement reports it receives, from Gap or from
+ * ConnectionScheduler, and calls process() periodically.
+ */
+class AdaptiveScanController {
+public:
+    /**
+     * Maximum number of advertisers remembered.
+     */
+    static const unsigned MAX_ADVERTISERS = YOTTA_CFG_BLE_ADAPTIVE_SCAN_MAX_ADVERTISERS;
+    /**
+     * Number of periods without discovery after which the duty cycle is
+     * halved.
+     */
+    static const unsigned QUIET_PERIODS   = 3;
+    /**
+     * Period, in microseconds, after which an advertiser not heard from is
+     * forgotten and counts as new when it reappears.
+     */
+    static const uint32_t FORGET_TIME     = 60000000;
+
+    /**
+     * Coverage statistics since construction.
+     */
+    struct Stats_t {
+        uint32_t elapsed;     /**< Milliseconds evaluated. */
+        uint32_t airtime;     /**< Milliseconds scanned, at the duty cycle in effect. */
+        uint32_t reports;
+        uint32_t discoveries; /**< New advertisers; those forgotten count again. */
+        uint32_t adjustments; /**< Changes of the scan window. */
+        uint8_t  dutyCycle;   /**< In percent, currently in effect. */
+        uint8_t  density;     /**< Advertisers heard in the last period. */
+    };
+
+public:
+    /**
+     * Construct a controller for the scanning of @p gap and register it
+     * with its connection events. The scan interval and window of Gap are
+     * set at the first process().
+     *
+     * @param[in] gap
+     *              Gap whose scan window is adapted.
+     * @param[in] timeSource
+     *              Clock timing the periods; not NULL.
+     */
+    AdaptiveScanController(Gap &gap, TimeSource_t timeSource);
+
+    /**
+     * Unregister from the events; the scan parameters are left as they are.
+     */
+    ~AdaptiveScanController();
+
+    /**
+     * Set the scan interval, in milliseconds, within which the window
+     * varies: from 3 to 10239, 200 by default.
+     *
+     * @return BLE_ERROR_NONE on success or BLE_ERROR_PARAM_OUT_OF_RANGE.
+     */
+    ble_error_t setScanInterval(uint16_t intervalInMS);
+
+    /**
+     * Set the range of the duty cycle, in percent; 5 to 100 by default.
+     *
+     * @return BLE_ERROR_NONE on success or BLE_ERROR_PARAM_OUT_OF_RANGE.
+     */
+    ble_error_t setDutyCycleRange(uint8_t minPercent, uint8_t maxPercent);
+
+    /**
+     * Set the average duty cycle allowed, in percent, and the time, in
+     * milliseconds, over which bursts above it are allowed; 20 percent over
+     * 30 seconds by default.
+     *
+     * @return BLE_ERROR_NONE on success or BLE_ERROR_PARAM_OUT_OF_RANGE.
+     */
+    ble_error_t setAirtimeBudget(uint8_t percent, uint32_t burstInMS);
+
+    /**
+     * Set the share of the maximum duty cycle, in percent, each active
+     * connection takes; 10 by default.
+     */
+    void setConnectionCost(uint8_t percent) {
+        connectionCost = percent;
+    }
+
+    /**
+     * Set the evaluation period, in milliseconds; 2000 by default.
+     */
+    void setEvaluationPeriod(uint32_t milliseconds) {
+        period = milliseconds * 1000;
+    }
+
+    /**
+     * Account for an advertisement report.
+     */
+    void recordReport(const Gap::AdvertisementCallbackParams_t *params);
+
+    /**
+     * Adapt the duty cycle if an evaluation period has elapsed.
+     *
+     * @return BLE_ERROR_NONE on success or the error of Gap setting the scan
+     *         parameters.
+     */
+    ble_error_t process(void);
+
+    /**
+     * Get the coverage statistics.
+     */
+    const Stats_t &getStats(void) const {
+        return stats;
+    }
+
+private:
+    struct Advertiser_t {
+        BLEProtocol::AddressBytes_t address;
+        uint32_t                    lastSeen;
+        uint32_t                    lastPeriod;    /**< Index of the period it was last heard in. */
+    };
+
+    void processConnectionEvent(const Gap::ConnectionCallbackParams_t *params);
+    void processDisconnectionEvent(const Gap::DisconnectionCallbackParams_t *params);
+
+    uint8_t getMaxDutyCycle(void) const;
+    ble_error_t apply(void);
+
+private:
+    Gap          &gap;
+    TimeSource_t  timeSource;
+    uint16_t      interval;           /**< In milliseconds. */
+    uint8_t       minDuty;
+    uint8_t       maxDuty;
+    uint8_t       budget;
+    uint8_t       connectionCost;
+    uint8_t       duty;
+    bool          started;            /**< The first process() ran. */
+    uint16_t      appliedInterval;    /**< In milliseconds; 0 before the first apply(). */
+    uint16_t      appliedWindow;
+    uint32_t      period;             /**< In microseconds. */
+    uint32_t      periodStart;
+    uint32_t      periodIndex;
+    uint32_t      burst;              /**< Credit capacity, in microseconds of airtime. */
+    uint32_t      credit;             /**< In microseconds of airtime. */
+    unsigned      quietPeriods;
+    unsigned      connectionCount;
+    unsigned      periodDiscoveries;
+    unsigned      periodAdvertisers;
+    unsigned      advertiserCount;
+    Stats_t       stats;
+    Advertiser_t  advertisers[MAX_ADVERTISERS];
+
+private:
+    /* Disallow copy and assignment. */
+    AdaptiveScanController(const AdaptiveScanController &);
+    AdaptiveScanController& operator=(const AdaptiveScanController &);
+};
+
+#endif /* ifndef __ADAPTIVE_SCAN_CONTROLLER_H__ */
@@ -0,0 +1,154 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ADDRESS_FILTER_H__
+#define __ADDRESS_FILTER_H__
+
+#include <stdint.h>
+
+#include "blecommon.h"
+#include "BLEProtocol.h"
+#include "AddressHashTable.h"
+
+/**
+ * @brief Host-side allow or deny list of peer addresses, for lists larger
+ * than the whitelist of the controller.
+ *
+ * @details The addresses are kept in an AddressHashTable over slots provided
+ * by the application, so that the memory used is bounded and chosen by the
+ * application. Lookups are exact.
+ *
+ * Attach the filter to Gap with Gap::setAddressFilter() to drop the
+ * advertisement reports of, and disconnect, the peers it refuses. The type of
+ * the address isn't part of the key, since it isn't reported along with
+ * advertisements; peers whose address is resolved by the RPAResolver of Gap
+ * are checked by their identity address.
+ */
+class AddressFilter {
+public:
+    /**
+     * How the addresses held are applied.
+     */
+    enum Mode_t {
+        MODE_DISABLED,   /**< Accept all peers. */
+        MODE_ALLOW_LIST, /**< Only accept the peers held. */
+        MODE_DENY_LIST,  /**< Accept all peers but those held. */
+    };
+
+    /**
+     * Storage of an address; the application allocates the slots.
+     */
+    struct Slot_t {
+        BLEProtocol::AddressBytes_t address;
+        uint8_t                     flags;
+    };
+
+public:
+    /**
+     * Construct an empty filter, in MODE_DISABLED.
+     *
+     * @param[in] slots
+     *              The slots; they need not be initialized.
+     * @param[in] slotCount
+     *              Number of @p slots; a power of two, at least 4. The
+     *              filter holds up to three quarters as many addresses.
+     */
+    AddressFilter(Slot_t *slots, unsigned slotCount);
+
+    /**
+     * Set how the addresses held are applied.
+     */
+    void setMode(Mode_t modeIn) {
+        mode = modeIn;
+    }
+
+    /**
+     * Get how the addresses held are applied.
+     */
+    Mode_t getMode(void) const {
+        return mode;
+    }
+
+    /**
+     * Add an address.
+     *
+     * @return BLE_ERROR_NONE on success or if the address is already held,
+     *         BLE_ERROR_NO_MEM if getCapacity() addresses are held, or
+     *         BLE_ERROR_INVALID_STATE if the slot count is unsuitable.
+     */
+    ble_error_t add(const BLEProtocol::AddressBytes_t address);
+
+    /**
+     * Remove an address.
+     *
+     * @return BLE_ERROR_NONE on success or BLE_ERROR_INVALID_PARAM if the
+     *         address isn't held.
+     */
+    ble_error_t remove(const BLEProtocol::AddressBytes_t address);
+
+    /**
+     * Remove all the addresses.
+     */
+    void clear(void) {
+        table.clear();
+    }
+
+    /**
+     * Check whether an address is held.
+     */
+    bool contains(const BLEProtocol::AddressBytes_t address) const {
+        return table.find(address) >= 0;
+    }
+
+    /**
+     * Check whether a peer is accepted in the current mode.
+     */
+    bool accepts(const BLEProtocol::AddressBytes_t address) const {
+        switch (mode) {
+            case MODE_ALLOW_LIST:
+                return contains(address);
+            case MODE_DENY_LIST:
+                return !contains(address);
+            default:
+                return true;
+        }
+    }
+
+    /**
+     * Get the number of addresses held.
+     */
+    unsigned getSize(void) const {
+        return table.getSize();
+    }
+
+    /**
+     * Get the maximum number of addresses held.
+     */
+    unsigned getCapacity(void) const {
+        return table.getCapacity();
+    }
+
+private:
+    AddressHashTable<Slot_t> table;
+    Mode_t                   mode;
+
+private:
+    /* Disallow copy and assignment. */
+    AddressFilter(const AddressFilter &);
+    AddressFilter& operator=(const AddressFilter &);
+};
+
+#endif /* ifndef __ADDRESS_FILTER_H__ */
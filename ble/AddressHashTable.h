@@ -0,0 +1,210 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ADDRESS_HASH_TABLE_H__
+#define __ADDRESS_HASH_TABLE_H__
+
+#include <stdint.h>
+#include <string.h>
+
+#include "BLEProtocol.h"
+
+/**
+ * @brief Set of peer addresses in slots provided by the application, shared
+ * by AddressFilter and RSSITracker.
+ *
+ * @details The table hashes addresses with open addressing and linear
+ * probing. At most three quarters of the slots are used, which keeps
+ * lookups to a few probes and guarantees a free slot ending each of them.
+ * Removing an entry moves back the following entries of its cluster rather
+ * than leaving a tombstone.
+ *
+ * SlotT is a structure with an @c address member, a
+ * BLEProtocol::AddressBytes_t, and a @c flags member, a uint8_t whose
+ * SLOT_USED bit is managed by the table; the other bits and members belong
+ * to the user of the table.
+ */
+template <typename SlotT>
+class AddressHashTable {
+public:
+    /**
+     * Bit of SlotT::flags set in the slots holding an address.
+     */
+    static const uint8_t SLOT_USED = 0x01;
+
+public:
+    /**
+     * Construct an empty table.
+     *
+     * @param[in] slotsIn
+     *              The slots; they need not be initialized.
+     * @param[in] slotCount
+     *              Number of @p slotsIn; a power of two, at least 4. Any
+     *              other count leaves the table without capacity.
+     */
+    AddressHashTable(SlotT *slotsIn, unsigned slotCount) :
+        slots(slotsIn),
+        mask(slotCount - 1),
+        capacity(slotCount - (slotCount / 4)),
+        size(0) {
+        if ((slotCount < 4) || ((slotCount & mask) != 0)) {
+            mask     = 0;
+            capacity = 0;
+        }
+
+        clear();
+    }
+
+    /**
+     * Remove all the addresses.
+     */
+    void clear(void) {
+        if (capacity != 0) {
+            for (unsigned i = 0; i <= mask; ++i) {
+                slots[i].flags = 0;
+            }
+        }
+        size = 0;
+    }
+
+    /**
+     * Look up an address.
+     *
+     * @return The index of its slot, or -1 if it isn't held.
+     */
+    int find(const BLEProtocol::AddressBytes_t address) const {
+        if (capacity == 0) {
+            return -1;
+        }
+
+        for (unsigned index = getHomeSlot(address); isUsed(index); index = getNextSlot(index)) {
+            if (memcmp(slots[index].address, address, BLEProtocol::ADDR_LEN) == 0) {
+                return (int)index;
+            }
+        }
+
+        return -1;
+    }
+
+    /**
+     * Add an address which isn't held; getSize() must be below
+     * getCapacity().
+     *
+     * @return The index of its slot, whose flags are SLOT_USED.
+     */
+    unsigned insert(const BLEProtocol::AddressBytes_t address) {
+        unsigned index = getHomeSlot(address);
+        while (isUsed(index)) {
+            index = getNextSlot(index);
+        }
+
+        memcpy(slots[index].address, address, BLEProtocol::ADDR_LEN);
+        slots[index].flags = SLOT_USED;
+        ++size;
+
+        return index;
+    }
+
+    /**
+     * Remove the address of a used slot. The entries following it may move
+     * back, into that slot in particular.
+     */
+    void erase(unsigned index) {
+        unsigned hole = index;
+        for (unsigned next = getNextSlot(hole); isUsed(next); next = getNextSlot(next)) {
+            /* Move back the entries which the hole would cut off from their
+             * home slot. */
+            unsigned home = getHomeSlot(slots[next].address);
+            if (((next - home) & mask) >= ((next - hole) & mask)) {
+                slots[hole] = slots[next];
+                hole        = next;
+            }
+        }
+        slots[hole].flags = 0;
+        --size;
+    }
+
+    /**
+     * Get the slot where the probes for an address start.
+     */
+    unsigned getHomeSlot(const BLEProtocol::AddressBytes_t address) const {
+        uint32_t low  = (uint32_t)address[0] | ((uint32_t)address[1] << 8) | ((uint32_t)address[2] << 16) | ((uint32_t)address[3] << 24);
+        uint32_t high = (uint32_t)address[4] | ((uint32_t)address[5] << 8);
+
+        uint32_t value = (low * 0x9E3779B1UL) ^ (high * 0x85EBCA6BUL);
+        value ^= value >> 15;
+        value *= 0x2C1B3C6DUL;
+        value ^= value >> 13;
+
+        return value & mask;
+    }
+
+    /**
+     * Get the slot following another one, wrapping around.
+     */
+    unsigned getNextSlot(unsigned index) const {
+        return (index + 1) & mask;
+    }
+
+    /**
+     * Check whether a slot holds an address.
+     */
+    bool isUsed(unsigned index) const {
+        return (slots[index].flags & SLOT_USED) != 0;
+    }
+
+    SlotT &operator[](unsigned index) {
+        return slots[index];
+    }
+
+    const SlotT &operator[](unsigned index) const {
+        return slots[index];
+    }
+
+    /**
+     * Get the number of slots, or 0 if their count is unsuitable.
+     */
+    unsigned getSlotCount(void) const {
+        return (capacity != 0) ? (mask + 1) : 0;
+    }
+
+    /**
+     * Get the number of addresses held.
+     */
+    unsigned getSize(void) const {
+        return size;
+    }
+
+    /**
+     * Get the maximum number of addresses held.
+     */
+    unsigned getCapacity(void) const {
+        return capacity;
+    }
+
+private:
+    SlotT    *slots;
+    unsigned  mask;     /**< Slot count minus one. */
+    unsigned  capacity;
+    unsigned  size;
+
+private:
+    /* Disallow copy and assignment. */
+    AddressHashTable(const AddressHashTable &);
+    AddressHashTable& operator=(const AddressHashTable &);
+};
+
+#endif /* ifndef __ADDRESS_HASH_TABLE_H__ */
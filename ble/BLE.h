@@ -21,6 +21,9 @@
 #include "Gap.h"
 #include "GattServer.h"
 #include "GattClient.h"
+#include "TimeSource.h"
+#include "BLEStats.h"
+#include "BLETrace.h"
 
 #include "ble/FunctionPointerWithContext.h"
 
@@ -36,6 +39,20 @@ class BLEInstanceBase;
 /**
  * The base class used to abstract away BLE-capable radio transceivers or SOCs,
  * so that the BLE API can work with any radio transparently.
+ *
+ * Threading: BLE API takes no locks. The state of each instance, from the
+ * BLE object down to its transport, its Gap, GattServer, GattClient and
+ * SecurityManager and the services built on them, is only reachable through
+ * that instance; instances share no mutable state. Targets with several
+ * radios (refer to NUM_INSTANCES) may therefore drive each instance from its
+ * own thread or core, provided that:
+ *  - each instance is only used from one thread at a time; its stack posts
+ *    events through BLEInstanceBase::postEvent(), which may be called from
+ *    one interrupt or stack context concurrently with that thread;
+ *  - Instance() is called for a given ID from one thread at a time; calls
+ *    for different IDs don't interfere;
+ *  - objects passed to several instances, such as a TimeSource_t or a
+ *    BLETrace, are themselves safe to share.
  */
 class BLE
 {
@@ -242,7 +259,8 @@ public:
 
     /**
      * Get a reference to the BLE singleton corresponding to a given interface.
-     * There is a static array of BLE singletons.
+     * There is a static array of BLE singletons; they are constructed in
+     * place on first use and never allocated on the heap.
      *
      * @note Calling Instance() is preferred over constructing a BLE object
      * directly, as it returns references to singletons.
@@ -1519,7 +1537,9 @@ public:
      * Return once all events have been consumed.
      * This function is called by user in their while loop (mbed Classic)
      * or automatically by Minar (mbed OS) when BLE event processing is scheduled.
-     * Internally, this function will call BLEInstanceBase::processEvent.
+     * Internally, this function will call BLEInstanceBase::processEvent, then
+     * dispatch the events queued through BLEInstanceBase::postEvent(), within
+     * the limit set by setEventProcessingBudget().
      */
     void processEvents();
 
@@ -1532,6 +1552,95 @@ public:
      */
     void onEventsToProcess(const OnEventsToProcessCallback_t& callback);
 
+    /**
+     * Set the budget of each call to processEvents() for the events posted by
+     * the stack (refer to BLEInstanceBase::postEvent()). Events are
+     * dispatched by priority class and link control events are exempt from
+     * the budget. When events remain, processEvents() signals them again
+     * through the onEventsToProcess callback, which lets other tasks run in
+     * between.
+     *
+     * @param[in] maxEvents
+     *              Maximum number of events per call; 0 means no limit.
+     * @param[in] maxDuration
+     *              Maximum time per call, in microseconds; 0 means no limit.
+     *              It only applies once a time source has been set with
+     *              setTimeSource().
+     */
+    void setEventProcessingBudget(unsigned maxEvents, uint32_t maxDuration = 0) {
+        eventProcessingBudget     = maxEvents;
+        eventProcessingTimeBudget = maxDuration;
+    }
+
+    /**
+     * Get the maximum number of events dispatched by each call to
+     * processEvents(); 0 means no limit.
+     */
+    unsigned getEventProcessingBudget(void) const {
+        return eventProcessingBudget;
+    }
+
+    /**
+     * Get the maximum time, in microseconds, spent dispatching events by each
+     * call to processEvents(); 0 means no limit.
+     */
+    uint32_t getEventProcessingTimeBudget(void) const {
+        return eventProcessingTimeBudget;
+    }
+
+    /**
+     * Set the clock used by BLE API to measure time, for instance
+     * us_ticker_read on mbed targets.
+     *
+     * @param[in] source
+     *              A monotonic microsecond clock; NULL disables the features
+     *              relying on time.
+     */
+    void setTimeSource(TimeSource_t source);
+
+    /**
+     * Get the clock set with setTimeSource(), or NULL.
+     */
+    TimeSource_t getTimeSource(void) const {
+        return timeSource;
+    }
+
+    /**
+     * Take a snapshot of the event statistics of this instance: number of
+     * events handled per type, time spent in their handlers, depth of the
+     * event queues and events dropped. Handling times are only measured once
+     * a clock has been set with setTimeSource().
+     *
+     * @param[out] stats
+     *               Receives the statistics.
+     *
+     * @return BLE_ERROR_NONE on success or BLE_ERROR_NOT_IMPLEMENTED if the
+     *         instrumentation isn't compiled in (refer to
+     *         YOTTA_CFG_BLE_STATS_ENABLED).
+     */
+    ble_error_t getStats(BLEStats &stats) const;
+
+    /**
+     * Reset the event statistics of this instance. The high water marks and
+     * drop counts of the event queues are cumulative and aren't reset.
+     */
+    void resetStats(void);
+
+    /**
+     * Attach a trace to this instance: the events reported by the stack to
+     * Gap, GattServer and GattClient are then recorded into it, timestamped
+     * with its own clock. The trace can later be fed back to a BLE instance
+     * with BLETraceReplayer.
+     *
+     * @param[in] trace
+     *              The trace recording the events, or NULL to stop recording.
+     *
+     * @return BLE_ERROR_NONE on success or BLE_ERROR_NOT_IMPLEMENTED if the
+     *         recording isn't compiled in (refer to
+     *         YOTTA_CFG_BLE_TRACE_ENABLED).
+     */
+    ble_error_t setTrace(BLETrace *trace);
+
 private:
 
     friend class BLEInstanceBase;
@@ -1560,6 +1669,12 @@ private:
     InstanceID_t     instanceID;
     BLEInstanceBase *transport; /* The device-specific backend */
     OnEventsToProcessCallback_t whenEventsToProcess;
+    unsigned         eventProcessingBudget;
+    uint32_t         eventProcessingTimeBudget;
+    TimeSource_t     timeSource;
+#if BLE_STATS_ENABLED
+    BLEStatsRecorder<BLEStats::PROCESS_EVENTS, 1> stats;
+#endif
 };
 
 typedef BLE BLEDevice; /**< @deprecated This type alias is retained for the
@@ -0,0 +1,341 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __BLE_EVENT_QUEUE_H__
+#define __BLE_EVENT_QUEUE_H__
+
+#include <stdint.h>
+#include <string.h>
+
+#include "blecommon.h"
+#include "BLEStats.h"
+#include "LockFreeRingBuffer.h"
+#include "TimeSource.h"
+
+#ifndef YOTTA_CFG_BLE_EVENT_QUEUE_SIZE
+/**
+ * Default number of events which can be queued per BLE instance and priority
+ * class; it has to be a power of two.
+ */
+#define YOTTA_CFG_BLE_EVENT_QUEUE_SIZE 16
+#endif
+
+#ifndef YOTTA_CFG_BLE_EVENT_PAYLOAD_SIZE
+/**
+ * Default size, in bytes, of the payload carried by a queued event.
+ */
+#define YOTTA_CFG_BLE_EVENT_PAYLOAD_SIZE 16
+#endif
+
+#ifndef YOTTA_CFG_BLE_EVENT_PROCESSING_BUDGET
+/**
+ * Default maximum number of queued events dispatched by each call to
+ * BLE::processEvents(); 0 means no limit.
+ */
+#define YOTTA_CFG_BLE_EVENT_PROCESSING_BUDGET 0
+#endif
+
+#ifndef YOTTA_CFG_BLE_EVENT_PROCESSING_TIME_BUDGET
+/**
+ * Default maximum time, in microseconds, spent dispatching queued events in
+ * each call to BLE::processEvents(); 0 means no limit. It only applies once a
+ * time source has been set with BLE::setTimeSource().
+ */
+#define YOTTA_CFG_BLE_EVENT_PROCESSING_TIME_BUDGET 0
+#endif
+
+/**
+ * @brief Queue of events posted by the BLE stack and dispatched by
+ * BLE::processEvents().
+ *
+ * @details Ports which use it provide its storage to their transport object
+ * with BLEInstanceBase::setEventQueue(), then post events from the context of
+ * the stack (usually an interrupt handler) through
+ * BLEInstanceBase::postEvent(); each event carries
+ * a handler, a context and a small payload copied into the queue. The
+ * application thread then runs the handlers from BLE::processEvents(), which
+ * is where the process*() entry points of Gap, GattServer, GattClient and
+ * SecurityManager should be called.
+ *
+ * Events are posted with a priority class; each class has its own ring and
+ * higher classes are always dispatched first. Link control events (connections,
+ * disconnections, security) are never held back by the processing budget, so
+ * that a burst of scan reports cannot delay them.
+ *
+ * The queue is single producer and single consumer: events must be posted
+ * from one context only, and not from the handlers.
+ */
+class BLEEventQueue {
+public:
+    /**
+     * Maximum number of events in the queue.
+     */
+    static const unsigned CAPACITY     = YOTTA_CFG_BLE_EVENT_QUEUE_SIZE;
+    /**
+     * Maximum size of the payload of an event.
+     */
+    static const unsigned PAYLOAD_SIZE = YOTTA_CFG_BLE_EVENT_PAYLOAD_SIZE;
+
+    /**
+     * Type of the event handlers.
+     *
+     * @param[in] context
+     *              The context posted with the event.
+     * @param[in] payload
+     *              The copy of the payload posted with the event; it is
+     *              aligned on 32 bits.
+     * @param[in] length
+     *              Size of the payload.
+     */
+    typedef void (*Handler_t)(void *context, const void *payload, uint8_t length);
+
+    /**
+     * Priority classes of the events, from the most urgent.
+     */
+    enum Priority_t {
+        PRIORITY_LINK_CONTROL  = 0, /**< Connections, disconnections, security and connection parameter updates; exempt from the budget. */
+        PRIORITY_GATT_RESPONSE = 1, /**< Responses to GATT requests, data read and written. */
+        PRIORITY_NOTIFICATION  = 2, /**< Notifications, indications and data sent events. */
+        PRIORITY_SCAN_REPORT   = 3, /**< Advertising reports and other bulk events. */
+        NUM_PRIORITIES         = 4
+    };
+
+public:
+    BLEEventQueue() {
+        for (unsigned i = 0; i < NUM_PRIORITIES; ++i) {
+            droppedCount[i] = 0;
+#if BLE_STATS_ENABLED
+            highWaterMark[i] = 0;
+#endif
+        }
+    }
+
+    /**
+     * Post an event; producer side.
+     *
+     * @param[in] priority
+     *              Priority class of the event.
+     * @param[in] handler
+     *              The function dispatching the event.
+     * @param[in] context
+     *              Context passed to @p handler.
+     * @param[in] payload
+     *              Data passed to @p handler; it is copied.
+     * @param[in] length
+     *              Size of @p payload, at most PAYLOAD_SIZE.
+     *
+     * @return BLE_ERROR_NONE on success, BLE_ERROR_INVALID_PARAM if the
+     *         payload is too large or BLE_ERROR_NO_MEM if the ring of the
+     *         priority class is full.
+     */
+    ble_error_t post(Priority_t priority, Handler_t handler, void *context, const void *payload = NULL, uint8_t length = 0) {
+        if ((priority >= NUM_PRIORITIES) || (handler == NULL) || (length > PAYLOAD_SIZE)) {
+            return BLE_ERROR_INVALID_PARAM;
+        }
+
+        Event_t event;
+        event.handler = handler;
+        event.context = context;
+        event.length  = length;
+        if (length != 0) {
+            memcpy(event.payload, payload, length);
+        }
+
+        if (!events[priority].push(event)) {
+            ++droppedCount[priority];
+            return BLE_ERROR_NO_MEM;
+        }
+
+#if BLE_STATS_ENABLED
+        unsigned depth = events[priority].size();
+        if (depth > highWaterMark[priority]) {
+            highWaterMark[priority] = depth;
+        }
+#endif
+
+        return BLE_ERROR_NONE;
+    }
+
+    /**
+     * Dispatch queued events by priority; consumer side. Link control events
+     * are all dispatched; the other ones are dispatched, most urgent first,
+     * until either budget is exhausted. Of the events posted during the
+     * call, only link control ones are dispatched; the other ones are left
+     * for the next call.
+     *
+     * @param[in] maxEvents
+     *              Maximum number of events dispatched, link control events
+     *              excluded; 0 means no limit.
+     * @param[in] maxDuration
+     *              Maximum time, in microseconds, spent dispatching events
+     *              other than link control ones; 0 means no limit.
+     * @param[in] timeSource
+     *              Clock measuring @p maxDuration; the time budget is ignored
+     *              if it is NULL.
+     *
+     * @return The number of events dispatched.
+     */
+    unsigned process(unsigned maxEvents = 0, uint32_t maxDuration = 0, TimeSource_t timeSource = NULL) {
+        bool     timed = (maxDuration != 0) && (timeSource != NULL);
+        uint32_t start = timed ? timeSource() : 0;
+        unsigned count = 0;
+        unsigned spent = 0;
+
+        /* Bound the work to the events queued so far, so that a flood of
+         * events cannot keep the caller busy forever. */
+        unsigned remaining[NUM_PRIORITIES];
+        for (unsigned i = 0; i < NUM_PRIORITIES; ++i) {
+            remaining[i] = events[i].size();
+        }
+
+        while (true) {
+            count += dispatch(PRIORITY_LINK_CONTROL, events[PRIORITY_LINK_CONTROL].size());
+
+            unsigned priority = PRIORITY_LINK_CONTROL + 1;
+            while ((priority < NUM_PRIORITIES) && (remaining[priority] == 0)) {
+                ++priority;
+            }
+            if (priority == NUM_PRIORITIES) {
+                break;
+            }
+
+            if ((maxEvents != 0) && (spent >= maxEvents)) {
+                break;
+            }
+            if (timed && (getElapsedTime(start, timeSource()) >= maxDuration)) {
+                break;
+            }
+
+            --remaining[priority];
+            if (dispatch((Priority_t)priority, 1) != 0) {
+                ++count;
+                ++spent;
+            }
+        }
+
+        return count;
+    }
+
+    /**
+     * Check whether events are waiting to be dispatched.
+     */
+    bool hasPendingEvents(void) const {
+        for (unsigned i = 0; i < NUM_PRIORITIES; ++i) {
+            if (!events[i].isEmpty()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Get the number of events of a priority class waiting to be dispatched.
+     */
+    unsigned getPendingCount(Priority_t priority) const {
+        return events[priority].size();
+    }
+
+    /**
+     * Get the number of events of a priority class dropped because its ring
+     * was full.
+     */
+    uint32_t getDroppedCount(Priority_t priority) const {
+        return droppedCount[priority];
+    }
+
+    /**
+     * Get the largest number of events of a priority class queued at once;
+     * this is only tracked when BLE_STATS_ENABLED is set, 0 otherwise.
+     */
+    uint32_t getHighWaterMark(Priority_t priority) const {
+#if BLE_STATS_ENABLED
+        return highWaterMark[priority];
+#else
+        (void)priority;
+        return 0;
+#endif
+    }
+
+    /**
+     * Get the number of events dropped because a ring was full.
+     */
+    uint32_t getDroppedCount(void) const {
+        uint32_t total = 0;
+        for (unsigned i = 0; i < NUM_PRIORITIES; ++i) {
+            total += droppedCount[i];
+        }
+        return total;
+    }
+
+    /**
+     * Discard the pending events; consumer side.
+     */
+    void clear(void) {
+        for (unsigned i = 0; i < NUM_PRIORITIES; ++i) {
+            events[i].clear();
+        }
+    }
+
+private:
+    struct Event_t {
+        Handler_t handler;
+        void     *context;
+        uint8_t   length;
+        uint32_t  payload[(PAYLOAD_SIZE + sizeof(uint32_t) - 1) / sizeof(uint32_t)];
+    };
+
+    /**
+     * Dispatch up to @p count events of a priority class.
+     */
+    unsigned dispatch(Priority_t priority, unsigned count) {
+        Event_t event;
+        for (unsigned i = 0; i < count; ++i) {
+            if (!events[priority].pop(event)) {
+                return i;
+            }
+            event.handler(event.context, event.payload, event.length);
+        }
+        return count;
+    }
+
+private:
+    /**
+     * One ring per priority class.
+     */
+    LockFreeRingBuffer<Event_t, CAPACITY> events[NUM_PRIORITIES];
+    /**
+     * Number of events of each class which could not be posted; written by
+     * the producer only.
+     */
+    volatile uint32_t                     droppedCount[NUM_PRIORITIES];
+#if BLE_STATS_ENABLED
+    /**
+     * Largest number of events of each class queued at once; written by the
+     * producer only.
+     */
+    volatile uint32_t                     highWaterMark[NUM_PRIORITIES];
+#endif
+
+    /* BLEStats holds the statistics of one queue per priority class. */
+    typedef char NumQueuesCheck_t[(NUM_PRIORITIES == BLEStats::NUM_QUEUES) ? 1 : -1];
+
+private:
+    /* Disallow copy and assignment. */
+    BLEEventQueue(const BLEEventQueue &);
+    BLEEventQueue& operator=(const BLEEventQueue &);
+};
+
+#endif /* ifndef __BLE_EVENT_QUEUE_H__ */
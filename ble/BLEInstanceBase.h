@@ -20,6 +20,7 @@
 #include "Gap.h"
 #include "ble/SecurityManager.h"
 #include "ble/BLE.h"
+#include "ble/BLEEventQueue.h"
 
 /* Forward declarations. */
 class GattServer;
@@ -36,7 +37,7 @@ class GattClient;
 class BLEInstanceBase
 {
 public:
-    BLEInstanceBase() {}
+    BLEInstanceBase() : eventQueue(NULL) {}
 
     /**
      * Virtual destructor of the interface.
@@ -156,6 +157,64 @@ public:
      */
     void signalEventsToProcess(BLE::InstanceID_t id);
 
+    /**
+     * Queue an event to be dispatched by BLE::processEvents() and signal that
+     * there is work to do. This is meant to be called from the context of the
+     * stack, for instance its interrupt handler; a single context may post
+     * events to a given instance.
+     *
+     * @param[in] id
+     *              The ID of the BLE instance posting the event.
+     * @param[in] priority
+     *              Priority class of the event; refer to BLEEventQueue::Priority_t.
+     * @param[in] handler
+     *              The function dispatching the event, typically to one of the
+     *              process*() entry points of the BLE API.
+     * @param[in] context
+     *              Context passed to @p handler.
+     * @param[in] payload
+     *              Data passed to @p handler; it is copied into the queue.
+     * @param[in] length
+     *              Size of @p payload, at most BLEEventQueue::PAYLOAD_SIZE.
+     *
+     * @return BLE_ERROR_NONE on success, BLE_ERROR_NO_MEM if the queue of the
+     *         priority class is full, BLE_ERROR_INVALID_PARAM if the payload
+     *         is too large or BLE_ERROR_NOT_IMPLEMENTED if the port has not
+     *         provided a queue (refer to setEventQueue()).
+     */
+    ble_error_t postEvent(BLE::InstanceID_t         id,
+                          BLEEventQueue::Priority_t priority,
+                          BLEEventQueue::Handler_t  handler,
+                          void                     *context,
+                          const void               *payload = NULL,
+                          uint8_t                   length  = 0);
+
+    /**
+     * Accessor to the queue of events posted by the stack. This function is
+     * used by BLE::processEvents().
+     *
+     * @return The queue provided with setEventQueue(), or NULL.
+     */
+    BLEEventQueue* getEventQueue() {
+        return eventQueue;
+    }
+
+protected:
+    /**
+     * Provide the storage of the queue used by postEvent(), typically a
+     * member of the port's transport object. Ports which don't post events
+     * don't need to call it and spare the RAM of the queue.
+     *
+     * @param[in] queue
+     *              The queue; it must outlive the transport object.
+     */
+    void setEventQueue(BLEEventQueue *queue) {
+        eventQueue = queue;
+    }
+
+private:
+    BLEEventQueue *eventQueue;
+
 private:
     // this class is not a value type.
     // prohibit copy construction and copy assignement
@@ -173,4 +232,26 @@ private:
  */
 extern BLEInstanceBase *createBLEInstance(void);
 
+/**
+ * Initializer creating the transport object of a BLE instance in static
+ * storage rather than on the heap. It may be used as the initializer of any
+ * instance in the configuration of the target, provided that the header
+ * named by the configuration (YOTTA_CFG_BLE_INSTANCES_HEADER) declares the
+ * transport class; refer to BLE.cpp. Each transport type gets its own
+ * object, so targets with several radios should give each radio its own type
+ * (or its own template instantiation).
+ *
+ * @tparam TransportT
+ *           The class implementing BLEInstanceBase; it must be default
+ *           constructible.
+ *
+ * @return The transport object, constructed on first call.
+ */
+template <typename TransportT>
+BLEInstanceBase *createStaticBLEInstance(void)
+{
+    static TransportT transport;
+    return &transport;
+}
+
 #endif // ifndef __BLE_DEVICE_INSTANCE_BASE__
@@ -0,0 +1,206 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __BLE_STATS_H__
+#define __BLE_STATS_H__
+
+#include <stdint.h>
+#include <string.h>
+
+#include "TimeSource.h"
+
+/**
+ * Event instrumentation is compiled in when YOTTA_CFG_BLE_STATS_ENABLED is
+ * set; otherwise the recording macros expand to nothing and BLE::getStats()
+ * returns BLE_ERROR_NOT_IMPLEMENTED.
+ */
+#if defined(YOTTA_CFG_BLE_STATS_ENABLED) && YOTTA_CFG_BLE_STATS_ENABLED
+#define BLE_STATS_ENABLED 1
+#else
+#define BLE_STATS_ENABLED 0
+#endif
+
+/**
+ * @brief Snapshot of the event statistics of a BLE instance, filled by
+ * BLE::getStats().
+ *
+ * @details For each event type the number of events handled and the time
+ * spent in the handlers registered by the application are recorded; the
+ * duration is measured with the clock set by BLE::setTimeSource() and is only
+ * available once one has been set. Durations are also sorted in a histogram
+ * whose buckets grow by powers of two: bucket 0 counts events handled in
+ * less than 2us, bucket i those handled in [2^i, 2^(i+1)) us, and the last
+ * bucket all the longer ones.
+ */
+struct BLEStats {
+    /**
+     * Types of events instrumented.
+     */
+    enum EventType_t {
+        /* Gap */
+        GAP_CONNECTION,
+        GAP_DISCONNECTION,
+        GAP_ADVERTISEMENT_REPORT,
+        GAP_TIMEOUT,
+        GAP_CONNECTION_PARAMS_UPDATE,
+        /* GattServer */
+        GATT_SERVER_DATA_WRITTEN,
+        GATT_SERVER_DATA_READ,
+        GATT_SERVER_UPDATES_EVENT,  /**< Updates enabled, updates disabled and confirmation received. */
+        GATT_SERVER_DATA_SENT,
+        /* GattClient */
+        GATT_CLIENT_READ_RESPONSE,
+        GATT_CLIENT_WRITE_RESPONSE,
+        GATT_CLIENT_HVX,
+        GATT_CLIENT_DATA_SENT,
+        /* BLE */
+        PROCESS_EVENTS,             /**< Calls to BLE::processEvents(). */
+
+        NUM_EVENT_TYPES
+    };
+
+    /**
+     * Number of buckets of the duration histograms.
+     */
+    static const unsigned HISTOGRAM_SIZE = 16;
+    /**
+     * Number of event queues, one per priority class of BLEEventQueue.
+     */
+    static const unsigned NUM_QUEUES     = 4;
+
+    /**
+     * Statistics of an event type.
+     */
+    struct EventStats_t {
+        uint32_t count;                     /**< Number of events handled. */
+        uint32_t maxTime;                   /**< Longest handling time, in microseconds. */
+        uint64_t totalTime;                 /**< Cumulated handling time, in microseconds. */
+        uint32_t histogram[HISTOGRAM_SIZE]; /**< Distribution of the handling times. */
+    };
+
+    /**
+     * Statistics of the event queue of a priority class.
+     */
+    struct QueueStats_t {
+        uint32_t pending;                   /**< Events waiting to be dispatched. */
+        uint32_t highWaterMark;             /**< Largest number of events queued. */
+        uint32_t dropped;                   /**< Events dropped because the queue was full. */
+    };
+
+    EventStats_t events[NUM_EVENT_TYPES];
+    QueueStats_t queues[NUM_QUEUES];
+
+    /**
+     * Get the histogram bucket of a duration.
+     *
+     * @param[in] duration
+     *              Duration in microseconds.
+     */
+    static unsigned getHistogramBucket(uint32_t duration) {
+        unsigned bucket = 0;
+        while ((duration >>= 1) != 0) {
+            ++bucket;
+        }
+        return (bucket < HISTOGRAM_SIZE) ? bucket : (HISTOGRAM_SIZE - 1);
+    }
+};
+
+/**
+ * @brief Recorder of the statistics of a range of event types; each BLE API
+ * component instrumented holds one for its own events.
+ *
+ * @tparam FIRST
+ *           The first event type recorded.
+ * @tparam COUNT
+ *           Number of event types recorded.
+ */
+template <unsigned FIRST, unsigned COUNT>
+class BLEStatsRecorder {
+public:
+    BLEStatsRecorder() : timeSource(NULL) {
+        clear();
+    }
+
+    /**
+     * Set the clock measuring handling times; NULL only counts events.
+     */
+    void setTimeSource(TimeSource_t source) {
+        timeSource = source;
+    }
+
+    /**
+     * Read the clock; 0 if there is none.
+     */
+    uint32_t now(void) const {
+        return (timeSource != NULL) ? timeSource() : 0;
+    }
+
+    /**
+     * Record an event handled since @p startTime, as returned by now().
+     */
+    void record(BLEStats::EventType_t type, uint32_t startTime) {
+        BLEStats::EventStats_t &stats = events[type - FIRST];
+
+        ++stats.count;
+        if (timeSource != NULL) {
+            uint32_t duration = getElapsedTime(startTime, timeSource());
+            if (duration > stats.maxTime) {
+                stats.maxTime = duration;
+            }
+            stats.totalTime += duration;
+            ++stats.histogram[BLEStats::getHistogramBucket(duration)];
+        }
+    }
+
+    /**
+     * Copy the statistics recorded into a snapshot.
+     */
+    void copyTo(BLEStats &snapshot) const {
+        memcpy(&snapshot.events[FIRST], events, sizeof(events));
+    }
+
+    /**
+     * Reset the statistics recorded.
+     */
+    void clear(void) {
+        memset(events, 0, sizeof(events));
+    }
+
+private:
+    /* The recorded range must fit in the snapshot. */
+    typedef char RangeCheck_t[((FIRST + COUNT) <= BLEStats::NUM_EVENT_TYPES) ? 1 : -1];
+
+private:
+    TimeSource_t           timeSource;
+    BLEStats::EventStats_t events[COUNT];
+};
+
+#if BLE_STATS_ENABLED
+/**
+ * Start measuring the handling of an event; to be used once at the top of an
+ * event entry point.
+ */
+#define BLE_STATS_START(recorder)        const uint32_t bleStatsStartTime = (recorder).now()
+/**
+ * Record the handling of an event started by BLE_STATS_START().
+ */
+#define BLE_STATS_RECORD(recorder, type) (recorder).record((type), bleStatsStartTime)
+#else
+#define BLE_STATS_START(recorder)
+#define BLE_STATS_RECORD(recorder, type)
+#endif
+
+#endif /* ifndef __BLE_STATS_H__ */
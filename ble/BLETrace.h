@@ -0,0 +1,217 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __BLE_TRACE_H__
+#define __BLE_TRACE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "TimeSource.h"
+
+/**
+ * The event entry points of Gap, GattServer and GattClient record their
+ * arguments into the trace attached with BLE::setTrace() when
+ * YOTTA_CFG_BLE_TRACE_ENABLED is set; otherwise the recording macro expands
+ * to nothing.
+ */
+#if defined(YOTTA_CFG_BLE_TRACE_ENABLED) && YOTTA_CFG_BLE_TRACE_ENABLED
+#define BLE_TRACE_ENABLED 1
+#else
+#define BLE_TRACE_ENABLED 0
+#endif
+
+/* Forward declarations. */
+struct GattWriteCallbackParams;
+struct GattReadCallbackParams;
+struct GattHVXCallbackParams;
+
+/**
+ * @brief Compact binary recorder of the events reported by the BLE stack.
+ *
+ * @details Records are stored into a ring buffer provided by the application;
+ * when it is full, the oldest records are overwritten. Each record is made of
+ * a 6-byte header (record type, payload length and a little endian 32-bit
+ * timestamp in microseconds) followed by the little endian encoding of the
+ * arguments of the entry point. Attribute and advertising data are truncated
+ * when the payload would exceed MAX_PAYLOAD_SIZE.
+ *
+ * A trace copied out with copy() can be fed back to a BLE instance, real or
+ * simulated, with BLETraceReplayer.
+ */
+class BLETrace {
+public:
+    /**
+     * Types of records; one per event entry point.
+     */
+    enum RecordType_t {
+        GAP_CONNECTION                    = 1,  /**< Gap::processConnectionEvent(). */
+        GAP_DISCONNECTION                 = 2,  /**< Gap::processDisconnectionEvent(). */
+        GAP_ADVERTISEMENT_REPORT          = 3,  /**< Gap::processAdvertisementReport(). */
+        GAP_TIMEOUT                       = 4,  /**< Gap::processTimeoutEvent(). */
+        GATT_SERVER_DATA_WRITTEN          = 5,  /**< GattServer::handleDataWrittenEvent(). */
+        GATT_SERVER_DATA_READ             = 6,  /**< GattServer::handleDataReadEvent(). */
+        GATT_SERVER_EVENT                 = 7,  /**< GattServer::handleEvent(), with or without connection. */
+        GATT_SERVER_DATA_SENT             = 8,  /**< GattServer::handleDataSentEvent(). */
+        GATT_SERVER_DISCONNECTION         = 9,  /**< GattServer::handleDisconnectionEvent(). */
+        GATT_CLIENT_READ_RESPONSE         = 10, /**< GattClient::processReadResponse(). */
+        GATT_CLIENT_WRITE_RESPONSE        = 11, /**< GattClient::processWriteResponse(). */
+        GATT_CLIENT_HVX                   = 12, /**< GattClient::processHVXEvent(). */
+        GATT_CLIENT_DATA_SENT             = 13, /**< GattClient::processDataSentEvent(). */
+        GAP_CONNECTION_PARAMS_UPDATE      = 14, /**< Gap::processConnectionParamsUpdateEvent(). */
+        GATT_SERVER_SUBSCRIPTION_RESTORED = 15  /**< GattServer::handleSubscriptionRestored(). */
+    };
+
+    /**
+     * Size of the header of a record.
+     */
+    static const uint8_t HEADER_SIZE      = 6;
+    /**
+     * Maximum size of the payload of a record.
+     */
+    static const uint8_t MAX_PAYLOAD_SIZE = 255;
+
+    /**
+     * Handle recorded for events which don't carry a connection handle.
+     */
+    static const uint16_t NO_CONNECTION   = 0xFFFF;
+
+public:
+    /**
+     * Construct a trace recorder.
+     *
+     * @param[in] buffer
+     *              Storage of the records; it must outlive the recorder.
+     * @param[in] size
+     *              Size of @p buffer in bytes.
+     * @param[in] timeSource
+     *              Clock timestamping the records; they are all stamped 0 if
+     *              it is NULL.
+     */
+    BLETrace(uint8_t *buffer, size_t size, TimeSource_t timeSource = NULL);
+
+    /**
+     * Record a connection event. @p connectionParams points to the
+     * Gap::ConnectionParams_t of the connection, or is NULL.
+     */
+    void recordConnectionEvent(uint16_t       handle,
+                               uint8_t        role,
+                               uint8_t        peerAddrType,
+                               const uint8_t *peerAddr,
+                               uint8_t        ownAddrType,
+                               const uint8_t *ownAddr,
+                               const void    *connectionParams);
+    void recordDisconnectionEvent(uint16_t handle, uint8_t reason);
+    void recordAdvertisementReport(const uint8_t *peerAddr,
+                                   int8_t         rssi,
+                                   bool           isScanResponse,
+                                   uint8_t        type,
+                                   uint8_t        advertisingDataLen,
+                                   const uint8_t *advertisingData);
+    void recordTimeoutEvent(uint8_t source);
+    /**
+     * Record a connection parameters update. @p connectionParams points to
+     * the Gap::ConnectionParams_t in effect, or is NULL.
+     */
+    void recordConnectionParamsUpdateEvent(uint16_t handle, bool accepted, const void *connectionParams);
+    void recordDataWrittenEvent(const GattWriteCallbackParams *params);
+    void recordDataReadEvent(const GattReadCallbackParams *params);
+    void recordServerEvent(uint8_t type, uint16_t connectionHandle, uint16_t attributeHandle);
+    void recordServerDataSentEvent(unsigned count);
+    void recordServerDisconnectionEvent(uint16_t connectionHandle);
+    void recordServerSubscriptionRestored(uint16_t connectionHandle, uint16_t valueHandle);
+    void recordReadResponse(const GattReadCallbackParams *params);
+    void recordWriteResponse(const GattWriteCallbackParams *params);
+    void recordHVXEvent(const GattHVXCallbackParams *params);
+    void recordClientDataSentEvent(uint16_t connectionHandle, unsigned count);
+
+    /**
+     * Copy the records, oldest first, into a linear buffer suitable for
+     * BLETraceReplayer. Only whole records are copied.
+     *
+     * @param[out] destination
+     *               The buffer receiving the records.
+     * @param[in]  size
+     *               Size of @p destination.
+     *
+     * @return The number of bytes copied.
+     */
+    size_t copy(uint8_t *destination, size_t size) const;
+
+    /**
+     * Get the number of bytes of records held.
+     */
+    size_t getUsedSize(void) const {
+        return used;
+    }
+
+    /**
+     * Get the number of records overwritten, or not recorded because they
+     * didn't fit in the buffer.
+     */
+    uint32_t getLostCount(void) const {
+        return lostCount;
+    }
+
+    /**
+     * Discard all records.
+     */
+    void clear(void);
+
+private:
+    /**
+     * Payload under construction.
+     */
+    struct Payload_t {
+        uint8_t length;
+        uint8_t bytes[MAX_PAYLOAD_SIZE];
+
+        void put8(uint8_t value);
+        void put16(uint16_t value);
+        void putBytes(const uint8_t *value, uint8_t count);
+        uint8_t getRoom(void) const;
+    };
+
+    void commit(RecordType_t type, const Payload_t &payload);
+    void write(const uint8_t *bytes, size_t count);
+    void dropOldest(void);
+
+private:
+    uint8_t     *buffer;
+    size_t       size;
+    TimeSource_t timeSource;
+    size_t       head;      /**< Where the next record is written. */
+    size_t       tail;      /**< Start of the oldest record. */
+    size_t       used;      /**< Bytes of records held. */
+    uint32_t     lostCount;
+
+private:
+    /* Disallow copy and assignment. */
+    BLETrace(const BLETrace &);
+    BLETrace& operator=(const BLETrace &);
+};
+
+#if BLE_TRACE_ENABLED
+/**
+ * Record an event into a trace, if one is attached; @p record is a call to
+ * one of the record*() member functions of BLETrace.
+ */
+#define BLE_TRACE_RECORD(tracer, record) do { if ((tracer) != NULL) { (tracer)->record; } } while (0)
+#else
+#define BLE_TRACE_RECORD(tracer, record)
+#endif
+
+#endif /* ifndef __BLE_TRACE_H__ */
@@ -0,0 +1,76 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __BLE_TRACE_REPLAYER_H__
+#define __BLE_TRACE_REPLAYER_H__
+
+#include "BLETrace.h"
+#include "BLEInstanceBase.h"
+
+/**
+ * @brief Feed the events of a trace recorded by BLETrace back to a BLE
+ * instance.
+ *
+ * @details Each record is decoded and passed to the matching entry point of
+ * Gap, GattServer or GattClient, exactly as the stack would; the handlers
+ * registered by the application run as they did when the trace was captured.
+ * Records are replayed back to back, regardless of their timestamps, which
+ * makes it possible to reproduce captured traffic deterministically on a host
+ * with a simulated BLEInstanceBase.
+ */
+class BLETraceReplayer {
+public:
+    /**
+     * Construct a replayer.
+     *
+     * @param[in] instance
+     *              The BLE instance receiving the events.
+     */
+    BLETraceReplayer(BLEInstanceBase &instance) : instance(instance) {
+    }
+
+    /**
+     * Replay a trace, as produced by BLETrace::copy().
+     *
+     * @param[in] trace
+     *              The records.
+     * @param[in] length
+     *              Size of @p trace in bytes.
+     *
+     * @return The number of records replayed. Replay stops at the first
+     *         truncated record; malformed records and records of unknown
+     *         types are skipped and not counted.
+     */
+    size_t replay(const uint8_t *trace, size_t length);
+
+private:
+    /**
+     * Replay a single record.
+     *
+     * @return false if the record is malformed or of an unknown type.
+     */
+    bool replayRecord(uint8_t type, const uint8_t *payload, uint8_t length);
+
+private:
+    BLEInstanceBase &instance;
+
+private:
+    /* Disallow copy and assignment. */
+    BLETraceReplayer(const BLETraceReplayer &);
+    BLETraceReplayer& operator=(const BLETraceReplayer &);
+};
+
+#endif /* ifndef __BLE_TRACE_REPLAYER_H__ */
@@ -0,0 +1,110 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __BOND_STORAGE_H__
+#define __BOND_STORAGE_H__
+
+#include <stddef.h>
+
+#include "blecommon.h"
+
+/**
+ * @brief Non-volatile storage of a BondTable, modelled on flash memory.
+ *
+ * @details The storage is divided into sectors of equal size. Erasing a
+ * sector sets all its octets to 0xFF; programming can then only clear bits,
+ * and each octet is programmed at most once between two erasures. The bond
+ * table writes sequentially and erases sectors in turn, so that the wear is
+ * spread across all of them.
+ *
+ * Targets typically implement this over a few pages of internal flash.
+ */
+class BondStorage {
+public:
+    virtual ~BondStorage() {
+        /* empty */
+    }
+
+    /**
+     * Get the size of a sector, in octets.
+     */
+    virtual size_t getSectorSize(void) const = 0;
+
+    /**
+     * Get the number of sectors; at least two are needed.
+     */
+    virtual unsigned getSectorCount(void) const = 0;
+
+    /**
+     * Get the programming granularity, in octets: the offsets and lengths
+     * passed to program() are multiples of it. Internal flash typically
+     * programs whole words or double words.
+     */
+    virtual size_t getProgramSize(void) const {
+        return 1;
+    }
+
+    /**
+     * Read from a sector.
+     *
+     * @param[in]  sector
+     *               Index of the sector.
+     * @param[in]  offset
+     *               Offset in the sector.
+     * @param[out] buffer
+     *               Receives the data.
+     * @param[in]  length
+     *               Number of octets to read.
+     *
+     * @return BLE_ERROR_NONE on success.
+     */
+    virtual ble_error_t read(unsigned sector, size_t offset, void *buffer, size_t length) = 0;
+
+    /**
+     * Program erased octets of a sector.
+     *
+     * @param[in] sector
+     *              Index of the sector.
+     * @param[in] offset
+     *              Offset in the sector.
+     * @param[in] data
+     *              The data to program.
+     * @param[in] length
+     *              Number of octets to program.
+     *
+     * @return BLE_ERROR_NONE on success.
+     */
+    virtual ble_error_t program(unsigned sector, size_t offset, const void *data, size_t length) = 0;
+
+    /**
+     * Erase a sector.
+     *
+     * @return BLE_ERROR_NONE on success.
+     */
+    virtual ble_error_t erase(unsigned sector) = 0;
+
+protected:
+    BondStorage() {
+        /* empty */
+    }
+
+private:
+    /* Disallow copy and assignment. */
+    BondStorage(const BondStorage &);
+    BondStorage& operator=(const BondStorage &);
+};
+
+#endif /* ifndef __BOND_STORAGE_H__ */
@@ -0,0 +1,263 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __BOND_TABLE_H__
+#define __BOND_TABLE_H__
+
+#include <stdint.h>
+
+#include "blecommon.h"
+#include "BLEProtocol.h"
+#include "BondStorage.h"
+#include "FunctionPointerWithContext.h"
+#include "CallChainOfFunctionPointersWithContext.h"
+
+#ifndef YOTTA_CFG_BLE_BOND_TABLE_MAX_BONDS
+/**
+ * Default number of peers a BondTable can hold.
+ */
+#define YOTTA_CFG_BLE_BOND_TABLE_MAX_BONDS 8
+#endif
+
+/**
+ * @brief Database of the keys of bonded peers, indexed by identity address
+ * and optionally persisted in a BondStorage.
+ *
+ * @details The records are held in RAM, where they are looked up through a
+ * hash of the identity address. The storage is written as a log: each change
+ * appends an entry to the active sector, and when the sector is full the
+ * live records are written compactly to the next sector, which becomes the
+ * active one. Sectors are thus erased in turn, and each one once every
+ * getSectorCount() compactions. A sector only becomes active once its
+ * header, written last, is valid: an interrupted compaction leaves the
+ * previous sector in use, and an interrupted append only loses that entry.
+ *
+ * At boot, load() reads the headers of the sectors and then only the active
+ * sector. Ports record the keys distributed during bonding with store() and
+ * look them up with find() when a bonded peer reconnects. The callbacks
+ * registered with onChange() are invoked whenever the records change.
+ */
+class BondTable {
+public:
+    /**
+     * Maximum number of bonded peers.
+     */
+    static const unsigned MAX_BONDS = YOTTA_CFG_BLE_BOND_TABLE_MAX_BONDS;
+
+    /**
+     * Size of the keys.
+     */
+    static const unsigned KEY_SIZE = 16;
+
+    /**
+     * Values of BondRecord_t::flags.
+     */
+    enum {
+        HAS_LTK            = 0x01, /**< ltk, ediv and rand are valid. */
+        HAS_IRK            = 0x02, /**< irk is valid. */
+        HAS_CSRK           = 0x04, /**< csrk is valid. */
+        AUTHENTICATED      = 0x08, /**< The keys were distributed with MITM protection. */
+        SECURE_CONNECTIONS = 0x10, /**< The keys result from LE secure connections pairing. */
+    };
+
+    /**
+     * Keys and identity of a bonded peer. Keys, as addresses, are least
+     * significant octet first.
+     */
+    struct BondRecord_t {
+        BLEProtocol::AddressType_t  identityAddressType; /**< PUBLIC or RANDOM_STATIC. */
+        BLEProtocol::AddressBytes_t identityAddress;
+        uint8_t                     flags;               /**< Combination of HAS_LTK, HAS_IRK, HAS_CSRK, AUTHENTICATED and SECURE_CONNECTIONS. */
+        uint8_t                     keySize;             /**< Size of the encryption key, from 7 to 16 octets. */
+        uint16_t                    ediv;
+        uint8_t                     rand[8];
+        uint8_t                     ltk[KEY_SIZE];
+        uint8_t                     irk[KEY_SIZE];
+        uint8_t                     csrk[KEY_SIZE];
+    };
+
+    /**
+     * Callback invoked after the records of the table changed. Refer to
+     * BondTable::onChange().
+     */
+    typedef FunctionPointerWithContext<const BondTable *> ChangeCallback_t;
+    /**
+     * Callchain of change callbacks. Refer to BondTable::onChange().
+     */
+    typedef CallChainOfFunctionPointersWithContext<const BondTable *> ChangeCallbackChain_t;
+
+public:
+    /**
+     * Construct an empty table.
+     *
+     * @param[in] storage
+     *              Where the table is persisted, or NULL to keep it in RAM
+     *              only. It needs at least two sectors, each able to hold
+     *              MAX_BONDS + 1 records of RECORD_SIZE octets after
+     *              HEADER_SIZE octets, both rounded up to the program size
+     *              of the storage, which can't exceed MAX_PROGRAM_SIZE.
+     */
+    BondTable(BondStorage *storage = NULL);
+
+    /**
+     * Replace the content of the table with the records persisted in the
+     * storage.
+     *
+     * @return BLE_ERROR_NONE on success, BLE_ERROR_INVALID_PARAM if the
+     *         geometry of the storage is unsuitable, or the error of the
+     *         storage.
+     */
+    ble_error_t load(void);
+
+    /**
+     * Add the record of a peer, or replace the record with the same identity
+     * address. The table is updated even if the record couldn't be
+     * persisted, in which case it is with the next successful write.
+     *
+     * @return BLE_ERROR_NONE on success, BLE_ERROR_INVALID_PARAM if the
+     *         address isn't an identity address, BLE_ERROR_NO_MEM if
+     *         MAX_BONDS peers are already held, or the error of the storage.
+     */
+    ble_error_t store(const BondRecord_t &record);
+
+    /**
+     * Remove the record of a peer.
+     *
+     * @return BLE_ERROR_NONE on success, BLE_ERROR_INVALID_PARAM if there is
+     *         no such record, or the error of the storage.
+     */
+    ble_error_t remove(BLEProtocol::AddressType_t type, const BLEProtocol::AddressBytes_t address);
+
+    /**
+     * Remove all the records.
+     *
+     * @return BLE_ERROR_NONE on success or the error of the storage.
+     */
+    ble_error_t clear(void);
+
+    /**
+     * Look up the record of a peer.
+     *
+     * @return The record, or NULL if the peer isn't bonded. The record is
+     *         valid until the table is next modified.
+     */
+    const BondRecord_t *find(BLEProtocol::AddressType_t type, const BLEProtocol::AddressBytes_t address) const;
+
+    /**
+     * Get the number of records.
+     */
+    unsigned getCount(void) const {
+        return count;
+    }
+
+    /**
+     * Get a record by index, for iteration.
+     *
+     * @param[in] index
+     *              Index of the record, less than getCount().
+     *
+     * @return The record, or NULL if @p index is out of range. The order of
+     *         the records changes when the table is modified.
+     */
+    const BondRecord_t *getRecord(unsigned index) const {
+        return (index < count) ? &records[index] : NULL;
+    }
+
+    /**
+     * Get the number of sector compactions, which bounds the erasures.
+     */
+    uint32_t getCompactionCount(void) const {
+        return compactions;
+    }
+
+    /**
+     * Append to the chain of callbacks invoked after records are added,
+     * replaced or removed, by load(), store(), remove() or clear(), whether
+     * or not the change could be persisted.
+     *
+     * @note It is possible to unregister callbacks using onChange().detach(callback)
+     */
+    void onChange(ChangeCallback_t callback) {
+        changeCallChain.add(callback);
+    }
+
+    /**
+     * Access the callchain of change callbacks, to register or unregister
+     * callbacks.
+     */
+    ChangeCallbackChain_t& onChange() {
+        return changeCallChain;
+    }
+
+public:
+    /**
+     * Size of a persisted record: a tag, the fields of BondRecord_t and a
+     * CRC.
+     */
+    static const size_t RECORD_SIZE = 1 + (1 + BLEProtocol::ADDR_LEN + 1 + 1 + 2 + 8 + (3 * KEY_SIZE)) + 2;
+
+    /**
+     * Size of the header of a sector.
+     */
+    static const size_t HEADER_SIZE = 12;
+
+    /**
+     * Largest program size of a storage.
+     */
+    static const size_t MAX_PROGRAM_SIZE = 16;
+
+private:
+    static const uint8_t NO_SLOT = 0xFF;
+    static const unsigned NUM_BUCKETS = 2 * MAX_BONDS;
+
+    int findIndex(BLEProtocol::AddressType_t type, const BLEProtocol::AddressBytes_t address) const;
+    void link(uint8_t index);
+    void unlink(uint8_t index);
+    void removeIndex(uint8_t index);
+    void resetIndex(void);
+
+    ble_error_t readStorage(void);
+    ble_error_t append(uint8_t tag, const BondRecord_t &record);
+    ble_error_t compact(void);
+    ble_error_t readHeader(unsigned sector, uint32_t &sequence);
+    ble_error_t replay(void);
+
+    /* Slot indexes must not collide with NO_SLOT. */
+    typedef char MaxBondsCheck_t[(MAX_BONDS < NO_SLOT) ? 1 : -1];
+
+private:
+    BondStorage  *storage;
+    int           activeSector;     /**< Sector receiving the appends, or -1 if none is valid. */
+    uint32_t      sequence;         /**< Sequence number of activeSector, incremented by each compaction. */
+    size_t        tail;             /**< Offset of the next append in activeSector. */
+    size_t        recordSlotSize;   /**< RECORD_SIZE rounded up to the program size of the storage. */
+    size_t        headerSlotSize;   /**< HEADER_SIZE rounded up to the program size of the storage. */
+    bool          needsCompaction;  /**< Set when the tail may be partially programmed. */
+    uint32_t      compactions;
+    unsigned      count;
+    BondRecord_t  records[MAX_BONDS];
+    uint8_t       next[MAX_BONDS];  /**< Next record in the same bucket, or NO_SLOT. */
+    uint8_t       buckets[NUM_BUCKETS];
+
+    ChangeCallbackChain_t changeCallChain;
+
+private:
+    /* Disallow copy and assignment. */
+    BondTable(const BondTable &);
+    BondTable& operator=(const BondTable &);
+};
+
+#endif /* ifndef __BOND_TABLE_H__ */
@@ -0,0 +1,270 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __CONNECTION_PARAMS_MANAGER_H__
+#define __CONNECTION_PARAMS_MANAGER_H__
+
+#include <stdint.h>
+
+#include "Gap.h"
+#include "GattServer.h"
+#include "GattClient.h"
+#include "TimeSource.h"
+
+#ifndef YOTTA_CFG_BLE_CONNECTION_PARAMS_MANAGER_MAX_LINKS
+/**
+ * Default number of links whose parameters a ConnectionParamsManager manages.
+ */
+#define YOTTA_CFG_BLE_CONNECTION_PARAMS_MANAGER_MAX_LINKS 4
+#endif
+
+#ifndef YOTTA_CFG_BLE_CONNECTION_PARAMS_MANAGER_MAX_RETRIES
+/**
+ * Default number of times a ConnectionParamsManager retries a refused update
+ * before giving up on the profile for the link.
+ */
+#define YOTTA_CFG_BLE_CONNECTION_PARAMS_MANAGER_MAX_RETRIES 3
+#endif
+
+/**
+ * @brief Connection parameters chosen from the traffic of each link.
+ *
+ * @details Rather than have the application tune the connection interval,
+ * the manager switches each link between three profiles: low power when the
+ * link is idle, low latency while it carries occasional traffic, and bulk
+ * transfer while it carries a stream of packets or a backlog of
+ * notifications. The traffic is observed through the events of GattServer
+ * and GattClient; the application reports what they don't show, the
+ * notifications it has queued and the transactions it has outstanding.
+ *
+ * process() is called periodically, every few hundred milliseconds; it moves
+ * a link to a busier profile as soon as the traffic calls for it, and back to
+ * low power once the link has been idle for the idle timeout, requesting the
+ * change through Gap::updateConnectionParams(). A refused request, by the
+ * stack or by the peer, is retried with an exponential backoff; after
+ * MAX_RETRIES the profile is given up for the lifetime of the link, and a
+ * link refused bulk transfer falls back to low latency.
+ *
+ * The outcome of a request is taken from Gap::onConnectionParamsUpdate(); on
+ * ports which don't report it, a request without an answer is assumed
+ * applied after REQUEST_TIMEOUT. Updates started by the peer are respected
+ * until the traffic calls for another profile.
+ */
+class ConnectionParamsManager {
+public:
+    /**
+     * Maximum number of links managed.
+     */
+    static const unsigned MAX_LINKS       = YOTTA_CFG_BLE_CONNECTION_PARAMS_MANAGER_MAX_LINKS;
+    /**
+     * Number of retries of a refused update.
+     */
+    static const unsigned MAX_RETRIES     = YOTTA_CFG_BLE_CONNECTION_PARAMS_MANAGER_MAX_RETRIES;
+    /**
+     * Delay, in microseconds, before the first retry; it doubles with each
+     * retry.
+     */
+    static const uint32_t RETRY_DELAY     = 1000000;
+    /**
+     * Time, in microseconds, after which a request without an answer is
+     * assumed applied.
+     */
+    static const uint32_t REQUEST_TIMEOUT = 5000000;
+    /**
+     * Duration, in microseconds, of the windows over which packets are
+     * counted.
+     */
+    static const uint32_t TRAFFIC_WINDOW  = 1000000;
+
+    /**
+     * Sets of connection parameters.
+     */
+    enum Profile_t {
+        PROFILE_LOW_POWER,     /**< Long interval and slave latency, for idle links. */
+        PROFILE_LOW_LATENCY,   /**< Short interval, for occasional traffic. */
+        PROFILE_BULK_TRANSFER, /**< Shortest interval, for streams of packets. */
+        NUM_PROFILES,
+        PROFILE_NONE = NUM_PROFILES /**< The parameters of the link match no profile. */
+    };
+
+public:
+    /**
+     * Construct a manager and register it with the events of @p gap,
+     * @p server and @p client.
+     *
+     * @param[in] gap
+     *              Gap of the links managed.
+     * @param[in] server
+     *              GattServer whose traffic is observed.
+     * @param[in] client
+     *              GattClient whose traffic is observed.
+     * @param[in] timeSource
+     *              Clock timing idleness, backoffs and requests; not NULL.
+     */
+    ConnectionParamsManager(Gap &gap, GattServer &server, GattClient &client, TimeSource_t timeSource);
+
+    /**
+     * Unregister from the events; the parameters of the links are left as
+     * they are.
+     */
+    ~ConnectionParamsManager();
+
+    /**
+     * Set the parameters of a profile; they apply to the following requests.
+     *
+     * @return BLE_ERROR_NONE on success, BLE_ERROR_INVALID_PARAM for an
+     *         unknown profile, or BLE_ERROR_PARAM_OUT_OF_RANGE if the
+     *         parameters are outside the limits of the specification or the
+     *         supervision timeout is too short for the interval and latency.
+     */
+    ble_error_t setProfileParams(Profile_t profile, const Gap::ConnectionParams_t &params);
+
+    /**
+     * Get the parameters of a profile.
+     */
+    const Gap::ConnectionParams_t &getProfileParams(Profile_t profile) const {
+        return profiles[(profile < NUM_PROFILES) ? profile : PROFILE_LOW_POWER];
+    }
+
+    /**
+     * Set the time without traffic after which a link goes low power;
+     * 5 seconds by default.
+     */
+    void setIdleTimeout(uint32_t milliseconds) {
+        idleTimeout = milliseconds * 1000;
+    }
+
+    /**
+     * Set the traffic which calls for bulk transfer: at least
+     * @p packetsPerWindow packets in a TRAFFIC_WINDOW, or at least
+     * @p backlog notifications queued; 10 and 4 by default.
+     */
+    void setBulkThresholds(unsigned packetsPerWindow, unsigned backlog) {
+        bulkPackets = packetsPerWindow;
+        bulkBacklog = backlog;
+    }
+
+    /**
+     * Report the number of notifications the application has queued for a
+     * link and not yet handed to GattServer.
+     */
+    void setPendingNotifications(Gap::Handle_t connHandle, unsigned count);
+
+    /**
+     * Report the number of GATT transactions the application has outstanding
+     * on a link.
+     */
+    void setPendingTransactions(Gap::Handle_t connHandle, unsigned count);
+
+    /**
+     * Report traffic on a link which the events of GattServer and GattClient
+     * don't show.
+     */
+    void recordActivity(Gap::Handle_t connHandle, unsigned packets);
+
+    /**
+     * Evaluate the traffic of the links and request the profiles it calls
+     * for, and the retries which are due.
+     */
+    void process(void);
+
+    /**
+     * Get the profile in effect on a link; PROFILE_NONE if the link isn't
+     * managed or its parameters match no profile.
+     */
+    Profile_t getProfile(Gap::Handle_t connHandle) const;
+
+    /**
+     * Check whether a profile was given up for a link after MAX_RETRIES.
+     */
+    bool isRejected(Gap::Handle_t connHandle, Profile_t profile) const;
+
+    /**
+     * Get the number of updates applied since construction.
+     */
+    uint32_t getUpdateCount(void) const {
+        return updateCount;
+    }
+
+    /**
+     * Get the number of profiles given up after MAX_RETRIES since
+     * construction.
+     */
+    uint32_t getRejectionCount(void) const {
+        return rejectionCount;
+    }
+
+private:
+    struct Link_t {
+        Gap::Handle_t handle;
+        bool          used;
+        bool          pending;              /**< An update is requested and unanswered. */
+        bool          backingOff;           /**< A refused update waits for its retry. */
+        uint8_t       current;              /**< Profile_t in effect. */
+        uint8_t       wanted;               /**< Profile_t the traffic called for at the last evaluation. */
+        uint8_t       requested;            /**< Profile_t of the last request. */
+        uint8_t       retries;
+        uint8_t       rejected;             /**< Bit mask of the Profile_t given up. */
+        uint16_t      pendingNotifications;
+        uint16_t      pendingTransactions;
+        uint32_t      requestTime;          /**< Time of the last request. */
+        uint32_t      lastActivity;
+        uint32_t      windowStart;
+        unsigned      windowPackets;        /**< Packets since windowStart. */
+        unsigned      previousWindowPackets;
+    };
+
+    void processConnectionEvent(const Gap::ConnectionCallbackParams_t *params);
+    void processDisconnectionEvent(const Gap::DisconnectionCallbackParams_t *params);
+    void processConnectionParamsUpdateEvent(const Gap::ConnectionParamsUpdateCallbackParams_t *params);
+    void processServerDataWritten(const GattWriteCallbackParams *params);
+    void processServerDataSent(unsigned count);
+    void processClientDataRead(const GattReadCallbackParams *params);
+    void processClientDataWritten(const GattWriteCallbackParams *params);
+    void processClientHVX(const GattHVXCallbackParams *params);
+    void processClientDataSent(const GattDataSentCallbackParams *params);
+
+    Profile_t classify(const Link_t &link, uint32_t now) const;
+    Profile_t fallback(const Link_t &link, Profile_t profile) const;
+    Profile_t match(const Gap::ConnectionParams_t *params) const;
+    void request(Link_t &link, Profile_t profile, uint32_t now);
+    void refuse(Link_t &link, uint32_t now);
+    Link_t *findLink(Gap::Handle_t connHandle);
+    const Link_t *findLink(Gap::Handle_t connHandle) const;
+
+private:
+    Gap                     &gap;
+    GattServer              &server;
+    GattClient              &client;
+    TimeSource_t             timeSource;
+    Gap::ConnectionParams_t  profiles[NUM_PROFILES];
+    uint32_t                 idleTimeout; /**< In microseconds. */
+    unsigned                 bulkPackets;
+    unsigned                 bulkBacklog;
+    uint32_t                 updateCount;
+    uint32_t                 rejectionCount;
+    Link_t                   links[MAX_LINKS];
+
+    /* Link_t::rejected holds one bit per profile. */
+    typedef char ProfileCountCheck_t[(NUM_PROFILES <= 8) ? 1 : -1];
+
+private:
+    /* Disallow copy and assignment. */
+    ConnectionParamsManager(const ConnectionParamsManager &);
+    ConnectionParamsManager& operator=(const ConnectionParamsManager &);
+};
+
+#endif /* ifndef __CONNECTION_PARAMS_MANAGER_H__ */
@@ -0,0 +1,309 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __CONNECTION_SCHEDULER_H__
+#define __CONNECTION_SCHEDULER_H__
+
+#include <stdint.h>
+
+#include "blecommon.h"
+#include "BLEProtocol.h"
+#include "Gap.h"
+#include "GapScanningParams.h"
+#include "TimeSource.h"
+
+#ifndef YOTTA_CFG_BLE_CONNECTION_SCHEDULER_MAX_REQUESTS
+/**
+ * Default number of connection requests a ConnectionScheduler can hold.
+ */
+#define YOTTA_CFG_BLE_CONNECTION_SCHEDULER_MAX_REQUESTS 16
+#endif
+
+#ifndef YOTTA_CFG_BLE_CONNECTION_SCHEDULER_MAX_ATTEMPTS
+/**
+ * Default number of attempts a ConnectionScheduler makes for a request
+ * before giving up.
+ */
+#define YOTTA_CFG_BLE_CONNECTION_SCHEDULER_MAX_ATTEMPTS 4
+#endif
+
+/**
+ * @brief Queue of connection requests for a central connecting to many
+ * peripherals.
+ *
+ * @details Gap::connect() starts a single connection procedure and the
+ * controller can only run a few at once. The scheduler queues the requests
+ * instead, each with a priority and a deadline, and starts them as the
+ * controller frees up: the highest priority first, then the earliest
+ * deadline. No more than setMaxParallelAttempts() procedures run at once,
+ * and none is started while setMaxConnections() links are up.
+ *
+ * A procedure which fails, because Gap::connect() refuses it or the peer
+ * wasn't found before the timeout of the attempt, is retried with an
+ * exponential backoff, up to MAX_ATTEMPTS; requests still queued when their
+ * deadline passes are given up. The outcome of each request is reported
+ * through onCompletion(), and getStats() accumulates the time from request to
+ * connection.
+ *
+ * Scanning started with ConnectionScheduler::startScan() is interleaved with
+ * the procedures: it is stopped while they run, as most controllers can't
+ * scan and initiate at once, and runs for at least the scan slot between
+ * them, so that new peers keep being discovered while the queue drains.
+ *
+ * process() is called periodically, every few tens of milliseconds; it also
+ * gives up on procedures whose timeout the port doesn't report.
+ */
+class ConnectionScheduler {
+public:
+    /**
+     * Maximum number of requests held.
+     */
+    static const unsigned MAX_REQUESTS  = YOTTA_CFG_BLE_CONNECTION_SCHEDULER_MAX_REQUESTS;
+    /**
+     * Number of attempts made for a request.
+     */
+    static const unsigned MAX_ATTEMPTS  = YOTTA_CFG_BLE_CONNECTION_SCHEDULER_MAX_ATTEMPTS;
+    /**
+     * Delay, in microseconds, before the first retry; it doubles with each
+     * retry, up to 16 times.
+     */
+    static const uint32_t BACKOFF_DELAY = 500000;
+
+    /**
+     * Outcome of a request.
+     */
+    enum Outcome_t {
+        OUTCOME_CONNECTED, /**< The peer is connected. */
+        OUTCOME_EXPIRED,   /**< The deadline passed. */
+        OUTCOME_FAILED,    /**< MAX_ATTEMPTS attempts failed. */
+        OUTCOME_REFUSED,   /**< The AddressFilter of Gap refuses the peer. */
+    };
+
+    /**
+     * Outcome of a request, reported through onCompletion().
+     */
+    struct CompletionCallbackParams_t {
+        BLEProtocol::Address_t peer;
+        Outcome_t              outcome;
+        Gap::Handle_t          handle;   /**< Handle of the connection if OUTCOME_CONNECTED. */
+        ble_error_t            error;    /**< Error of the last Gap::connect(), or BLE_ERROR_NONE if the attempt timed out. */
+        unsigned               attempts;
+        uint32_t               latency;  /**< Milliseconds since the request. */
+    };
+    typedef FunctionPointerWithContext<const CompletionCallbackParams_t *> CompletionCallback_t;
+
+    /**
+     * Statistics of the requests since construction.
+     */
+    struct Stats_t {
+        uint32_t requests;
+        uint32_t connections;
+        uint32_t expirations;
+        uint32_t failures;        /**< Requests given up after MAX_ATTEMPTS or refused. */
+        uint32_t attempts;
+        uint32_t failedAttempts;
+        uint32_t minLatency;      /**< In milliseconds, from request to connection. */
+        uint32_t maxLatency;
+        uint32_t totalLatency;    /**< Sum over the connections; divide by connections for the mean. */
+    };
+
+public:
+    /**
+     * Construct a scheduler and register it with the events of @p gap.
+     *
+     * @param[in] gap
+     *              Gap initiating the connections.
+     * @param[in] timeSource
+     *              Clock timing deadlines, backoffs and attempts; not NULL.
+     */
+    ConnectionScheduler(Gap &gap, TimeSource_t timeSource);
+
+    /**
+     * Unregister from the events and stop the scanning started by the
+     * scheduler; the requests held are dropped silently.
+     */
+    ~ConnectionScheduler();
+
+    /**
+     * Queue a connection request. A request for a peer already queued keeps
+     * its deadline and takes the higher of the two priorities.
+     *
+     * @param[in] peer
+     *              Address of the peer.
+     * @param[in] priority
+     *              Priority of the request; higher values are served first.
+     * @param[in] timeout
+     *              Deadline of the request, in milliseconds from now.
+     *
+     * @return BLE_ERROR_NONE on success or BLE_ERROR_NO_MEM if MAX_REQUESTS
+     *         requests are held.
+     */
+    ble_error_t connect(const BLEProtocol::Address_t &peer, uint8_t priority, uint32_t timeout);
+
+    /**
+     * Drop a queued request silently.
+     *
+     * @return BLE_ERROR_NONE on success, BLE_ERROR_INVALID_PARAM if no
+     *         request is held for the peer, or BLE_ERROR_INVALID_STATE if
+     *         its procedure is running, as Gap can't cancel it.
+     */
+    ble_error_t cancel(const BLEProtocol::Address_t &peer);
+
+    /**
+     * Scan, between the procedures, with the parameters of Gap in effect.
+     *
+     * @param[in] callback
+     *              Receiver of the advertisement reports.
+     *
+     * @return BLE_ERROR_NONE on success or the error of Gap::startScan().
+     */
+    ble_error_t startScan(const Gap::AdvertisementReportCallback_t &callback);
+
+    /**
+     * Stop the scanning started by startScan().
+     */
+    ble_error_t stopScan(void);
+
+    /**
+     * Set the number of procedures run at once; 1 by default, as most
+     * controllers initiate a single connection at a time.
+     */
+    void setMaxParallelAttempts(unsigned count) {
+        maxParallelAttempts = (count != 0) ? count : 1;
+    }
+
+    /**
+     * Set the number of links the controller supports; no procedure is
+     * started while as many are up. Connections made before the scheduler
+     * was constructed aren't counted.
+     */
+    void setMaxConnections(unsigned count) {
+        maxConnections = count;
+    }
+
+    /**
+     * Set the minimum time, in milliseconds, scanning runs between two
+     * procedures; 500 by default.
+     */
+    void setScanSlot(uint32_t milliseconds) {
+        scanSlot = milliseconds * 1000;
+    }
+
+    /**
+     * Set the scanning of a procedure; by default, a 30 ms window every
+     * 30 ms for up to 2 seconds.
+     *
+     * @return BLE_ERROR_NONE on success or BLE_ERROR_PARAM_OUT_OF_RANGE
+     *         for an interval or window out of range, a window longer than
+     *         the interval, or a timeout of 0, as the attempts must end, or
+     *         above 4293 seconds, as the time source can't measure it.
+     */
+    ble_error_t setAttemptParams(uint16_t intervalInMS, uint16_t windowInMS, uint16_t timeoutInSeconds);
+
+    /**
+     * Set the parameters of the connections, or NULL for those of the stack.
+     */
+    void setConnectionParams(const Gap::ConnectionParams_t *params);
+
+    /**
+     * Expire the requests past their deadline and start the procedures and
+     * the retries which are due.
+     */
+    void process(void);
+
+    /**
+     * Get the number of requests held, running or waiting.
+     */
+    unsigned getQueueSize(void) const {
+        return requestCount;
+    }
+
+    /**
+     * Get the statistics of the requests.
+     */
+    const Stats_t &getStats(void) const {
+        return stats;
+    }
+
+    /**
+     * Set the callback reporting the outcome of the requests.
+     */
+    void onCompletion(const CompletionCallback_t &callback) {
+        completionCallback = callback;
+    }
+    template <typename T>
+    void onCompletion(T *objPtr, void (T::*memberPtr)(const CompletionCallbackParams_t *)) {
+        completionCallback.attach(objPtr, memberPtr);
+    }
+
+private:
+    enum {
+        REQUEST_FREE,
+        REQUEST_QUEUED,
+        REQUEST_INITIATING,
+    };
+
+    struct Request_t {
+        BLEProtocol::Address_t peer;
+        uint8_t                state;
+        uint8_t                priority;
+        uint8_t                attempts;
+        ble_error_t            error;       /**< Of the last attempt. */
+        uint32_t               requestTime;
+        uint32_t               timeout;     /**< In microseconds from requestTime. */
+        uint32_t               attemptTime; /**< Start of the running attempt, or end of the failed one. */
+        uint32_t               backoff;     /**< In microseconds from attemptTime. */
+    };
+
+    void processConnectionEvent(const Gap::ConnectionCallbackParams_t *params);
+    void processDisconnectionEvent(const Gap::DisconnectionCallbackParams_t *params);
+    void processTimeoutEvent(Gap::TimeoutSource_t source);
+    void processAdvertisementReport(const Gap::AdvertisementCallbackParams_t *params);
+
+    Request_t *selectRequest(uint32_t now);
+    bool startAttempt(Request_t &request, uint32_t now);
+    void failAttempt(Request_t &request, ble_error_t error, uint32_t now);
+    void complete(Request_t &request, Outcome_t outcome, Gap::Handle_t handle, uint32_t now);
+    void resumeScan(uint32_t now);
+    Request_t *find(const BLEProtocol::AddressBytes_t address);
+
+private:
+    Gap                                &gap;
+    TimeSource_t                        timeSource;
+    GapScanningParams                   attemptParams;
+    Gap::ConnectionParams_t             connectionParams;
+    bool                                hasConnectionParams;
+    unsigned                            maxParallelAttempts;
+    unsigned                            maxConnections;
+    uint32_t                            scanSlot;       /**< In microseconds. */
+    bool                                scanRequested;  /**< startScan() was called. */
+    bool                                scanning;       /**< Scanning runs on behalf of the scheduler. */
+    uint32_t                            scanStart;
+    Gap::AdvertisementReportCallback_t  scanCallback;
+    CompletionCallback_t                completionCallback;
+    unsigned                            connectionCount;
+    unsigned                            attemptCount;   /**< Procedures running. */
+    unsigned                            requestCount;
+    Stats_t                             stats;
+    Request_t                           requests[MAX_REQUESTS];
+
+private:
+    /* Disallow copy and assignment. */
+    ConnectionScheduler(const ConnectionScheduler &);
+    ConnectionScheduler& operator=(const ConnectionScheduler &);
+};
+
+#endif /* ifndef __CONNECTION_SCHEDULER_H__ */
@@ -0,0 +1,233 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __CRYPTO_BACKEND_H__
+#define __CRYPTO_BACKEND_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "blecommon.h"
+
+/**
+ * @brief Provider of the AES-128 block cipher, and of the cryptographic
+ * functions of the Security Manager built on it.
+ *
+ * @details Targets implement encrypt(), typically with their AES engine;
+ * SoftwareCryptoBackend and TableCryptoBackend are portable implementations
+ * for targets without one and for host builds.
+ *
+ * encrypt(), cmac() and the CCM functions use the byte order of FIPS-197,
+ * RFC 4493 and RFC 3610: most significant octet first. The Security Manager
+ * functions ah(), c1() and s1() take and produce their values least
+ * significant octet first, as they are exchanged over the air and stored by
+ * BLE API (keys, random numbers, addresses).
+ */
+class CryptoBackend {
+public:
+    /**
+     * Size of an AES-128 key and block.
+     */
+    static const size_t BLOCK_SIZE = 16;
+
+    /**
+     * Size of the nonce of the CCM functions.
+     */
+    static const size_t CCM_NONCE_SIZE = 13;
+
+public:
+    virtual ~CryptoBackend() {
+        /* empty */
+    }
+
+    /**
+     * Encrypt a block with AES-128; the function e() of the Core
+     * specification.
+     *
+     * @param[in]  key
+     *               The key.
+     * @param[in]  plaintext
+     *               The block to encrypt.
+     * @param[out] ciphertext
+     *               Receives the encrypted block; it may alias @p plaintext.
+     *
+     * @return BLE_ERROR_NONE on success.
+     */
+    virtual ble_error_t encrypt(const uint8_t key[BLOCK_SIZE],
+                                const uint8_t plaintext[BLOCK_SIZE],
+                                uint8_t       ciphertext[BLOCK_SIZE]) = 0;
+
+    /**
+     * Random address hash function ah(k, r) = e(k, padding || r) mod 2^24.
+     *
+     * @param[in]  irk
+     *               The identity resolving key.
+     * @param[in]  r
+     *               prand, the three most significant octets of the
+     *               address.
+     * @param[out] hash
+     *               Receives the hash, the three least significant octets
+     *               of the address.
+     */
+    ble_error_t ah(const uint8_t irk[BLOCK_SIZE], const uint8_t r[3], uint8_t hash[3]);
+
+    /**
+     * Confirm value generation function c1 of LE legacy pairing.
+     *
+     * @param[in]  k
+     *               The temporary key.
+     * @param[in]  r
+     *               The random number.
+     * @param[in]  preq
+     *               The Pairing Request command, opcode included.
+     * @param[in]  pres
+     *               The Pairing Response command, opcode included.
+     * @param[in]  iat
+     *               Type of the initiator's address: 0 if public, 1 if
+     *               random.
+     * @param[in]  ia
+     *               The initiator's address.
+     * @param[in]  rat
+     *               Type of the responder's address.
+     * @param[in]  ra
+     *               The responder's address.
+     * @param[out] confirm
+     *               Receives the confirm value.
+     */
+    ble_error_t c1(const uint8_t k[BLOCK_SIZE],
+                   const uint8_t r[BLOCK_SIZE],
+                   const uint8_t preq[7],
+                   const uint8_t pres[7],
+                   uint8_t       iat,
+                   const uint8_t ia[6],
+                   uint8_t       rat,
+                   const uint8_t ra[6],
+                   uint8_t       confirm[BLOCK_SIZE]);
+
+    /**
+     * Key generation function s1 of LE legacy pairing, producing the short
+     * term key from the random numbers of both devices.
+     *
+     * @param[in]  k
+     *               The temporary key.
+     * @param[in]  r1
+     *               The random number of the responder.
+     * @param[in]  r2
+     *               The random number of the initiator.
+     * @param[out] stk
+     *               Receives the short term key.
+     */
+    ble_error_t s1(const uint8_t k[BLOCK_SIZE],
+                   const uint8_t r1[BLOCK_SIZE],
+                   const uint8_t r2[BLOCK_SIZE],
+                   uint8_t       stk[BLOCK_SIZE]);
+
+    /**
+     * AES-CMAC (RFC 4493), used by LE secure connections and signed writes.
+     *
+     * @param[in]  key
+     *               The key.
+     * @param[in]  message
+     *               The message to authenticate; may be NULL if @p length
+     *               is 0.
+     * @param[in]  length
+     *               Size of @p message.
+     * @param[out] mac
+     *               Receives the message authentication code.
+     */
+    ble_error_t cmac(const uint8_t  key[BLOCK_SIZE],
+                     const uint8_t *message,
+                     size_t         length,
+                     uint8_t        mac[BLOCK_SIZE]);
+
+    /**
+     * Encrypt and authenticate with AES-CCM (RFC 3610) using a 13-octet
+     * nonce, as the link layer does.
+     *
+     * @param[in]     key
+     *                  The key.
+     * @param[in]     nonce
+     *                  The nonce; it must never be reused with the same key.
+     * @param[in]     aad
+     *                  Data authenticated but not encrypted; may be NULL if
+     *                  @p aadLength is 0.
+     * @param[in]     aadLength
+     *                  Size of @p aad; less than 0xFF00.
+     * @param[in,out] data
+     *                  The plaintext, encrypted in place.
+     * @param[in]     length
+     *                  Size of @p data; at most 0xFFFF.
+     * @param[out]    mic
+     *                  Receives the message integrity check.
+     * @param[in]     micLength
+     *                  Size of the MIC: 4, 6, 8, 10, 12, 14 or 16.
+     *
+     * @return BLE_ERROR_NONE on success or BLE_ERROR_INVALID_PARAM if a size
+     *         is out of range.
+     */
+    ble_error_t ccmEncrypt(const uint8_t  key[BLOCK_SIZE],
+                           const uint8_t  nonce[CCM_NONCE_SIZE],
+                           const uint8_t *aad,
+                           size_t         aadLength,
+                           uint8_t       *data,
+                           size_t         length,
+                           uint8_t       *mic,
+                           size_t         micLength);
+
+    /**
+     * Decrypt and verify data protected with ccmEncrypt().
+     *
+     * @return BLE_ERROR_NONE if the MIC is valid, in which case @p data holds
+     *         the plaintext; BLE_ERROR_OPERATION_NOT_PERMITTED if the MIC is
+     *         invalid, in which case @p data is cleared; or
+     *         BLE_ERROR_INVALID_PARAM if a size is out of range.
+     */
+    ble_error_t ccmDecrypt(const uint8_t  key[BLOCK_SIZE],
+                           const uint8_t  nonce[CCM_NONCE_SIZE],
+                           const uint8_t *aad,
+                           size_t         aadLength,
+                           uint8_t       *data,
+                           size_t         length,
+                           const uint8_t *mic,
+                           size_t         micLength);
+
+protected:
+    CryptoBackend() {
+        /* empty */
+    }
+
+private:
+    ble_error_t ccmMac(const uint8_t  key[BLOCK_SIZE],
+                       const uint8_t  nonce[CCM_NONCE_SIZE],
+                       const uint8_t *aad,
+                       size_t         aadLength,
+                       const uint8_t *data,
+                       size_t         length,
+                       size_t         micLength,
+                       uint8_t        tag[BLOCK_SIZE]);
+    ble_error_t ccmCtr(const uint8_t  key[BLOCK_SIZE],
+                       const uint8_t  nonce[CCM_NONCE_SIZE],
+                       uint8_t       *data,
+                       size_t         length,
+                       uint8_t        tag[BLOCK_SIZE]);
+
+private:
+    /* Disallow copy and assignment. */
+    CryptoBackend(const CryptoBackend &);
+    CryptoBackend& operator=(const CryptoBackend &);
+};
+
+#endif /* ifndef __CRYPTO_BACKEND_H__ */
@@ -0,0 +1,411 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __DISCOVERED_ATTRIBUTE_DATABASE_H__
+#define __DISCOVERED_ATTRIBUTE_DATABASE_H__
+
+#include "UUID.h"
+#include "UUIDSet.h"
+#include "Gap.h"
+#include "GattAttribute.h"
+#include "ServiceDiscovery.h"
+#include "DiscoveredService.h"
+#include "DiscoveredCharacteristic.h"
+#include "CharacteristicDescriptorDiscovery.h"
+
+class GattClient;
+
+/**
+ * @brief Copy of the attributes discovered on a peer GATT server.
+ *
+ * @details A database is bound to one connection at a time. It launches the
+ * service discovery (and optionally the descriptor discovery) itself and
+ * records every service, characteristic and descriptor reported, so that
+ * applications don't have to keep their own lists of discovered attributes.
+ * Callbacks given to the database are forwarded the discovery events as they
+ * are recorded.
+ *
+ * Attributes are stored in discovery order in an arena provided at
+ * construction; the database never allocates memory. Two indexes are
+ * maintained on top of the arena:
+ *   - a table sorted by attribute handle, searched by binary search;
+ *   - a hash table keyed by UUID.
+ *
+ * Attributes which don't fit in the arena are dropped and hasOverflowed()
+ * reports it. StaticDiscoveredAttributeDatabase provides a database with
+ * embedded storage.
+ */
+class DiscoveredAttributeDatabase {
+public:
+    /**
+     * Largest capacity of a database, so that the UUID hash table, twice as
+     * large, can be indexed with 16 bits.
+     */
+    static const uint16_t MAX_CAPACITY = 0x7FFF;
+
+    /**
+     * Kinds of attribute held by the database.
+     */
+    enum AttributeType_t {
+        SERVICE        = 0, /**< A primary service. */
+        CHARACTERISTIC = 1, /**< A characteristic. */
+        DESCRIPTOR     = 2  /**< A characteristic descriptor. */
+    };
+
+    /**
+     * Record of a discovered attribute.
+     */
+    struct Attribute_t {
+        /**
+         * UUID of the service, characteristic or descriptor.
+         */
+        UUID                                   uuid;
+        /**
+         * Service start handle, characteristic declaration handle or
+         * descriptor handle. This is the key of the handle index.
+         */
+        GattAttribute::Handle_t                handle;
+        /**
+         * Service end handle or characteristic last handle; equal to handle
+         * for descriptors.
+         */
+        GattAttribute::Handle_t                endHandle;
+        /**
+         * Characteristic value handle; equal to handle for services and
+         * descriptors.
+         */
+        GattAttribute::Handle_t                valueHandle;
+        /**
+         * Characteristic properties; meaningless for other attributes.
+         */
+        DiscoveredCharacteristic::Properties_t properties;
+        /**
+         * The kind of attribute. Refer to AttributeType_t.
+         */
+        uint8_t                                type;
+    };
+
+    /**
+     * Construct a database on top of caller provided storage.
+     *
+     * @param[in] attributeStorage
+     *              Arena receiving the attribute records; @p capacity entries.
+     * @param[in] handleIndexStorage
+     *              Storage of the handle index; @p capacity entries.
+     * @param[in] uuidIndexStorage
+     *              Storage of the UUID hash table; 2 * @p capacity entries.
+     * @param[in] capacity
+     *              Maximum number of attributes held by the database;
+     *              larger values are clamped to MAX_CAPACITY.
+     */
+    DiscoveredAttributeDatabase(Attribute_t *attributeStorage,
+                                uint16_t    *handleIndexStorage,
+                                uint16_t    *uuidIndexStorage,
+                                uint16_t     capacity);
+
+public:
+    /**
+     * Clear the database and launch a service discovery filling it. The
+     * characteristics of every matching service are discovered and recorded.
+     * Refer to GattClient::launchServiceDiscovery() for the description of
+     * the parameters.
+     *
+     * @param[in] client
+     *              The GattClient used to run the discovery.
+     * @param[in] connectionHandle
+     *              Handle of the connection with the peer.
+     * @param[in] sc
+     *              Optional application callback forwarded each service
+     *              recorded.
+     * @param[in] cc
+     *              Optional application callback forwarded each
+     *              characteristic recorded.
+     * @param[in] tc
+     *              Optional application callback invoked when the discovery
+     *              terminates.
+     *
+     * @note The database tracks the termination of the discovery with
+     *       GattClient::onServiceDiscoveryTerminationOn(). On ports which
+     *       don't implement it, it registers with
+     *       GattClient::onServiceDiscoveryTermination() instead, replacing
+     *       the callback set there, and relies on
+     *       GattClient::isServiceDiscoveryActive(); pass @p tc rather than
+     *       setting that callback.
+     *
+     * @return BLE_ERROR_NONE if the discovery is launched; BLE_STACK_BUSY if
+     *         a discovery driven by this database is already in progress; else
+     *         the error returned by the GattClient.
+     */
+    ble_error_t launchServiceDiscovery(GattClient                                 &client,
+                                       Gap::Handle_t                               connectionHandle,
+                                       ServiceDiscovery::ServiceCallback_t         sc                           = NULL,
+                                       ServiceDiscovery::CharacteristicCallback_t  cc                           = NULL,
+                                       ServiceDiscovery::TerminationCallback_t     tc                           = NULL,
+                                       const UUID                                 &matchingServiceUUID          = UUID::ShortUUIDBytes_t(BLE_UUID_UNKNOWN),
+                                       const UUID                                 &matchingCharacteristicUUIDIn = UUID::ShortUUIDBytes_t(BLE_UUID_UNKNOWN));
+
+    /**
+     * Same as above but for a targeted discovery; refer to
+     * GattClient::launchServiceDiscovery() for the use of UUID sets.
+     */
+    ble_error_t launchServiceDiscovery(GattClient                                 &client,
+                                       Gap::Handle_t                               connectionHandle,
+                                       ServiceDiscovery::ServiceCallback_t         sc,
+                                       ServiceDiscovery::CharacteristicCallback_t  cc,
+                                       ServiceDiscovery::TerminationCallback_t     tc,
+                                       const UUIDSet                              &matchingServiceUUIDs,
+                                       const UUIDSet                              &matchingCharacteristicUUIDs);
+
+    /**
+     * Discover and record the descriptors of a characteristic. The
+     * characteristic must belong to the connection of the database.
+     *
+     * @param[in] characteristic
+     *              The characteristic whose descriptors are discovered.
+     * @param[in] discoveryCallback
+     *              Optional application callback forwarded each descriptor
+     *              recorded.
+     * @param[in] terminationCallback
+     *              Optional application callback invoked at the end of the
+     *              procedure.
+     *
+     * @return BLE_ERROR_NONE if the discovery is launched; BLE_STACK_BUSY if
+     *         a descriptor discovery driven by this database is in progress;
+     *         BLE_ERROR_INVALID_PARAM if the characteristic belongs to another
+     *         connection; else the error returned by the GattClient.
+     */
+    ble_error_t discoverDescriptors(const DiscoveredCharacteristic                                &characteristic,
+                                    const CharacteristicDescriptorDiscovery::DiscoveryCallback_t   &discoveryCallback   = CharacteristicDescriptorDiscovery::DiscoveryCallback_t(),
+                                    const CharacteristicDescriptorDiscovery::TerminationCallback_t &terminationCallback = CharacteristicDescriptorDiscovery::TerminationCallback_t());
+
+    /**
+     * Record a service. This is called by the database while discovery runs
+     * and can be used to populate it from another source (e.g. a cache).
+     *
+     * @return BLE_ERROR_NONE on success or BLE_ERROR_NO_MEM if the database
+     *         is full.
+     */
+    ble_error_t addService(const UUID &uuid, GattAttribute::Handle_t startHandle, GattAttribute::Handle_t endHandle);
+
+    /**
+     * Record a characteristic. See addService().
+     */
+    ble_error_t addCharacteristic(const UUID                                   &uuid,
+                                  GattAttribute::Handle_t                       declHandle,
+                                  GattAttribute::Handle_t                       valueHandle,
+                                  GattAttribute::Handle_t                       lastHandle,
+                                  const DiscoveredCharacteristic::Properties_t &properties);
+
+    /**
+     * Record a descriptor. See addService().
+     */
+    ble_error_t addDescriptor(const UUID &uuid, GattAttribute::Handle_t handle);
+
+    /**
+     * Remove all attributes and unbind the database from its connection.
+     */
+    void clear(void);
+
+public:
+    /**
+     * Find the attribute with a given handle (service start handle,
+     * characteristic declaration handle or descriptor handle).
+     *
+     * @return The attribute or NULL if there is none.
+     */
+    const Attribute_t *findByHandle(GattAttribute::Handle_t handle) const;
+
+    /**
+     * Find the attribute of a given type whose handle range contains a
+     * handle; e.g. the service or the characteristic owning a descriptor.
+     *
+     * @return The attribute or NULL if there is none.
+     */
+    const Attribute_t *findEnclosing(GattAttribute::Handle_t handle, AttributeType_t type) const;
+
+    /**
+     * Find an attribute by UUID and type. Several attributes can share a UUID
+     * (e.g. Client Characteristic Configuration descriptors); iterate over
+     * them by passing the previous result in @p previous.
+     *
+     * @param[in] uuid
+     *              The UUID to look for.
+     * @param[in] type
+     *              The type of the attribute looked for.
+     * @param[in] previous
+     *              The last attribute returned by this function for the same
+     *              UUID and type, or NULL to get the first match.
+     *
+     * @return The next matching attribute or NULL if there is none.
+     */
+    const Attribute_t *findByUUID(const UUID &uuid, AttributeType_t type, const Attribute_t *previous = NULL) const;
+
+    /**
+     * Find a characteristic of a given service by UUID.
+     *
+     * @return The characteristic or NULL if there is none.
+     */
+    const Attribute_t *findCharacteristic(const UUID &serviceUUID, const UUID &characteristicUUID) const;
+
+    /**
+     * Access attributes in discovery order.
+     *
+     * @param[in] index
+     *              Index of the attribute, less than getAttributeCount().
+     */
+    const Attribute_t &getAttribute(uint16_t index) const {
+        return attributes[index];
+    }
+
+    /**
+     * Get the number of attributes recorded.
+     */
+    uint16_t getAttributeCount(void) const {
+        return count;
+    }
+
+    /**
+     * Get the maximum number of attributes the database can hold.
+     */
+    uint16_t getCapacity(void) const {
+        return capacity;
+    }
+
+    /**
+     * Check whether attributes have been dropped because the database was full.
+     */
+    bool hasOverflowed(void) const {
+        return overflowed;
+    }
+
+    /**
+     * Check whether a service discovery driven by the database is running.
+     * This is only tracked if the port supports per connection termination
+     * callbacks.
+     */
+    bool isServiceDiscoveryActive(void) const {
+        return serviceDiscoveryActive;
+    }
+
+    /**
+     * Get the handle of the connection the database was populated from.
+     */
+    Gap::Handle_t getConnectionHandle(void) const {
+        return connHandle;
+    }
+
+private:
+    ble_error_t add(uint8_t type, const UUID &uuid, GattAttribute::Handle_t handle,
+                    GattAttribute::Handle_t endHandle, GattAttribute::Handle_t valueHandle,
+                    const DiscoveredCharacteristic::Properties_t *properties);
+    ble_error_t prepareServiceDiscovery(GattClient &client, Gap::Handle_t connectionHandle,
+                                        ServiceDiscovery::ServiceCallback_t sc,
+                                        ServiceDiscovery::CharacteristicCallback_t cc,
+                                        ServiceDiscovery::TerminationCallback_t tc);
+    void completeServiceDiscoveryLaunch(ble_error_t status);
+    uint16_t lowerBound(GattAttribute::Handle_t handle) const;
+    uint16_t hashSlot(const UUID &uuid) const;
+    uint16_t nextSlot(uint16_t slot) const;
+    uint32_t getTableSize(void) const {
+        return 2 * (uint32_t)capacity;
+    }
+
+    void onServiceDiscovered(const DiscoveredService *service);
+    void onCharacteristicDiscovered(const DiscoveredCharacteristic *characteristic);
+    void onServiceDiscoveryTermination(Gap::Handle_t connectionHandle);
+    void onDescriptorDiscovered(const CharacteristicDescriptorDiscovery::DiscoveryCallbackParams_t *params);
+    void onDescriptorDiscoveryTermination(const CharacteristicDescriptorDiscovery::TerminationCallbackParams_t *params);
+
+private:
+    /**
+     * Attribute records, in discovery order.
+     */
+    Attribute_t                                             *attributes;
+    /**
+     * Indexes of the records sorted by handle.
+     */
+    uint16_t                                                *handleIndex;
+    /**
+     * Open addressing hash table of (record index + 1) keyed by UUID; 0 marks
+     * an empty slot.
+     */
+    uint16_t                                                *uuidIndex;
+    /**
+     * Maximum number of records.
+     */
+    uint16_t                                                 capacity;
+    /**
+     * Number of records.
+     */
+    uint16_t                                                 count;
+    /**
+     * Set when a record has been dropped for lack of space.
+     */
+    bool                                                     overflowed;
+    /**
+     * Connection the database is bound to.
+     */
+    Gap::Handle_t                                            connHandle;
+    /**
+     * Client used to run discoveries.
+     */
+    GattClient                                              *gattc;
+    /**
+     * Set while a service discovery driven by the database runs.
+     */
+    bool                                                     serviceDiscoveryActive;
+    /**
+     * Set while a descriptor discovery driven by the database runs.
+     */
+    bool                                                     descriptorDiscoveryActive;
+    /**
+     * Application callbacks forwarded the discovery events.
+     */
+    ServiceDiscovery::ServiceCallback_t                      serviceCallback;
+    ServiceDiscovery::CharacteristicCallback_t               characteristicCallback;
+    ServiceDiscovery::TerminationCallback_t                  terminationCallback;
+    CharacteristicDescriptorDiscovery::DiscoveryCallback_t   descriptorCallback;
+    CharacteristicDescriptorDiscovery::TerminationCallback_t descriptorTerminationCallback;
+
+private:
+    /* Disallow copy and assignment. */
+    DiscoveredAttributeDatabase(const DiscoveredAttributeDatabase &);
+    DiscoveredAttributeDatabase& operator=(const DiscoveredAttributeDatabase &);
+};
+
+/**
+ * @brief DiscoveredAttributeDatabase embedding the storage for up to
+ * MAX_ATTRIBUTES attributes.
+ *
+ * @details Each attribute costs sizeof(Attribute_t) plus 6 bytes of index.
+ */
+template <uint16_t MAX_ATTRIBUTES>
+class StaticDiscoveredAttributeDatabase : public DiscoveredAttributeDatabase {
+public:
+    StaticDiscoveredAttributeDatabase() :
+        DiscoveredAttributeDatabase(attributeStorage, handleIndexStorage, uuidIndexStorage, MAX_ATTRIBUTES) {
+        /* Empty */
+    }
+
+private:
+    Attribute_t attributeStorage[MAX_ATTRIBUTES];
+    uint16_t    handleIndexStorage[MAX_ATTRIBUTES];
+    uint16_t    uuidIndexStorage[2 * MAX_ATTRIBUTES];
+
+    typedef char MaxAttributesCheck_t[(MAX_ATTRIBUTES <= MAX_CAPACITY) ? 1 : -1];
+};
+
+#endif /* ifndef __DISCOVERED_ATTRIBUTE_DATABASE_H__ */
@@ -212,6 +212,28 @@ public:
      */
     ble_error_t writeWoResponse(uint16_t length, const uint8_t *value) const;
 
+    /**
+     * Write a buffer of any size with write commands; the buffer is split into
+     * packets of the connection ATT_MTU and queued as transmit buffers become
+     * available. Refer to GattClient::writeBurst().
+     *
+     * @param[in]  length
+     *           The amount of data being written.
+     * @param[in]  value
+     *           The bytes being written. They must remain valid until
+     *           @p onComplete is invoked.
+     * @param[in]  onComplete
+     *           Callback invoked once the whole buffer has been transmitted
+     *           or the burst failed.
+     *
+     * @retval BLE_ERROR_NONE Successfully started the burst, or
+     *         BLE_ERROR_INVALID_STATE if the characteristic is not bound to a client, or
+     *         BLE_STACK_BUSY if a burst is already in progress on the connection, or
+     *         BLE_ERROR_NO_MEM if too many bursts are in progress, or
+     *         BLE_ERROR_OPERATION_NOT_PERMITTED due to the characteristic's properties.
+     */
+    ble_error_t writeBurst(size_t length, const uint8_t *value, const GattClient::BurstWriteCallback_t &onComplete) const;
+
     /**
      * Initiate a GATT Characteristic Descriptor Discovery procedure for descriptors within this characteristic.
      *
@@ -0,0 +1,83 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __FILE_BOND_STORAGE_H__
+#define __FILE_BOND_STORAGE_H__
+
+#include <stdio.h>
+
+#include "BondStorage.h"
+
+/**
+ * @brief BondStorage kept in a file, for host builds and simulations.
+ *
+ * @details The file emulates flash memory: it is created with all its octets
+ * erased, and programming only clears bits, so that a bond table which would
+ * misbehave on flash misbehaves here as well.
+ */
+class FileBondStorage : public BondStorage {
+public:
+    /**
+     * Construct a storage; nothing is accessed before open().
+     *
+     * @param[in] path
+     *              Path of the file; the string must outlive the storage.
+     * @param[in] sectorSize
+     *              Size of a sector, in octets.
+     * @param[in] sectorCount
+     *              Number of sectors.
+     */
+    FileBondStorage(const char *path, size_t sectorSize, unsigned sectorCount);
+
+    virtual ~FileBondStorage();
+
+    /**
+     * Open the file, creating it erased if it doesn't exist or doesn't have
+     * the expected size.
+     *
+     * @return BLE_ERROR_NONE on success or BLE_ERROR_UNSPECIFIED if the file
+     *         can't be opened or created.
+     */
+    ble_error_t open(void);
+
+    /**
+     * Close the file.
+     */
+    void close(void);
+
+    virtual size_t getSectorSize(void) const {
+        return sectorSize;
+    }
+
+    virtual unsigned getSectorCount(void) const {
+        return sectorCount;
+    }
+
+    virtual ble_error_t read(unsigned sector, size_t offset, void *buffer, size_t length);
+    virtual ble_error_t program(unsigned sector, size_t offset, const void *data, size_t length);
+    virtual ble_error_t erase(unsigned sector);
+
+private:
+    bool seek(unsigned sector, size_t offset, size_t length);
+
+private:
+    const char *path;
+    size_t      sectorSize;
+    unsigned    sectorCount;
+    FILE       *file;
+};
+
+#endif /* ifndef __FILE_BOND_STORAGE_H__ */
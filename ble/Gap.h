@@ -25,6 +25,19 @@
 #include "CallChainOfFunctionPointersWithContext.h"
 #include "FunctionPointerWithContext.h"
 #include "deprecate.h"
+#include "BLEStats.h"
+#include "BLETrace.h"
+#include "RPAResolver.h"
+#include "AddressFilter.h"
+#include "RSSITracker.h"
+
+#ifndef YOTTA_CFG_BLE_GAP_MAX_REFUSED_CONNECTIONS
+/**
+ * Default number of connections refused by the AddressFilter of Gap which
+ * can await their disconnection at the same time.
+ */
+#define YOTTA_CFG_BLE_GAP_MAX_REFUSED_CONNECTIONS 4
+#endif
 
 /* Forward declarations for classes that will only be used for pointers or references in the following. */
 class GapAdvertisingParams;
@@ -70,6 +83,11 @@ public:
      * Length (in octets) of the BLE MAC address.
      */
     static const unsigned ADDR_LEN = BLEProtocol::ADDR_LEN;
+    /**
+     * Maximum number of connections refused by the AddressFilter which can
+     * await their disconnection; refer to setAddressFilter().
+     */
+    static const unsigned MAX_REFUSED_CONNECTIONS = YOTTA_CFG_BLE_GAP_MAX_REFUSED_CONNECTIONS;
     /**
      * 48-bit address, LSB format.
      *
@@ -203,6 +221,9 @@ public:
         GapAdvertisingParams::AdvertisingType_t  type;               /**< The type of advertisement. */
         uint8_t                                  advertisingDataLen; /**< Length of the advertisement data. */
         const uint8_t                           *advertisingData;    /**< Pointer to the advertisement packet's data. */
+        bool                                     peerAddrResolved;   /**< Whether peerAddr is a resolvable private address resolved by the RPAResolver set with Gap::setRPAResolver(). */
+        BLEProtocol::AddressType_t               peerIdentityAddrType; /**< The type of the peer's identity address; only valid if peerAddrResolved is true. */
+        BLEProtocol::AddressBytes_t              peerIdentityAddr;   /**< The peer's identity address; only valid if peerAddrResolved is true. */
     };
 
     /**
@@ -223,6 +244,9 @@ public:
         BLEProtocol::AddressType_t  ownAddrType;      /**< This device's BLE address type */
         BLEProtocol::AddressBytes_t ownAddr;          /**< This devices's BLE address */
         const ConnectionParams_t   *connectionParams; /**< The currently configured connection parameters */
+        bool                        peerAddrResolved; /**< Whether peerAddr is a resolvable private address resolved by the RPAResolver set with Gap::setRPAResolver(). */
+        BLEProtocol::AddressType_t  peerIdentityAddrType; /**< The type of the peer's identity address; only valid if peerAddrResolved is true. */
+        BLEProtocol::AddressBytes_t peerIdentityAddr; /**< The peer's identity address; only valid if peerAddrResolved is true. */
 
         /**
          * Constructor for ConnectionCallbackParams_t.
@@ -255,7 +279,10 @@ public:
             peerAddr(),
             ownAddrType(ownAddrTypeIn),
             ownAddr(),
-            connectionParams(connectionParamsIn) {
+            connectionParams(connectionParamsIn),
+            peerAddrResolved(false),
+            peerIdentityAddrType(BLEProtocol::AddressType::PUBLIC),
+            peerIdentityAddr() {
             memcpy(peerAddr, peerAddrIn, ADDR_LEN);
             memcpy(ownAddr, ownAddrIn, ADDR_LEN);
         }
@@ -284,6 +311,34 @@ public:
         {}
     };
 
+    /**
+     * Structure that encapsulates information about the outcome of a
+     * connection parameters update. Refer to Gap::onConnectionParamsUpdate().
+     */
+    struct ConnectionParamsUpdateCallbackParams_t {
+        Handle_t                  handle;           /**< The ID of the connection whose parameters were negotiated. */
+        bool                      accepted;         /**< Whether the update was applied; false if the peer rejected it. */
+        const ConnectionParams_t *connectionParams; /**< The parameters in effect after the procedure, or NULL if unknown. */
+
+        /**
+         * Constructor for ConnectionParamsUpdateCallbackParams_t.
+         *
+         * @param[in] handleIn
+         *              Value for ConnectionParamsUpdateCallbackParams_t::handle.
+         * @param[in] acceptedIn
+         *              Value for ConnectionParamsUpdateCallbackParams_t::accepted.
+         * @param[in] connectionParamsIn
+         *              Value for ConnectionParamsUpdateCallbackParams_t::connectionParams.
+         */
+        ConnectionParamsUpdateCallbackParams_t(Handle_t                  handleIn,
+                                               bool                      acceptedIn,
+                                               const ConnectionParams_t *connectionParamsIn) :
+            handle(handleIn),
+            accepted(acceptedIn),
+            connectionParams(connectionParamsIn)
+        {}
+    };
+
     static const uint16_t UNIT_1_25_MS  = 1250; /**< Number of microseconds in 1.25 milliseconds. */
     /**
      * Helper function to convert from units of milliseconds to GAP duration
@@ -328,6 +383,17 @@ public:
      */
     typedef CallChainOfFunctionPointersWithContext<const DisconnectionCallbackParams_t*> DisconnectionEventCallbackChain_t;
 
+    /**
+     * Type for the registered callbacks added to the connection parameters
+     * update event callchain. Refer to Gap::onConnectionParamsUpdate().
+     */
+    typedef FunctionPointerWithContext<const ConnectionParamsUpdateCallbackParams_t*> ConnectionParamsUpdateEventCallback_t;
+    /**
+     * Type for the connection parameters update event callchain. Refer to
+     * Gap::onConnectionParamsUpdate().
+     */
+    typedef CallChainOfFunctionPointersWithContext<const ConnectionParamsUpdateCallbackParams_t*> ConnectionParamsUpdateEventCallbackChain_t;
+
     /**
      * Type for the handlers of radio notification callback events. Refer to
      * Gap::onRadioNotification().
@@ -757,6 +823,45 @@ public:
         return BLE_ERROR_NOT_IMPLEMENTED;
     }
 
+    /**
+     * Add an address to the internal whitelist, leaving the other entries
+     * untouched.
+     *
+     * @param[in] address
+     *              The address to add.
+     *
+     * @return BLE_ERROR_NONE if the address was added or already present,
+     *         BLE_ERROR_INVALID_PARAM if it can't be whitelisted (see
+     *         setWhitelist()) or BLE_ERROR_NO_MEM if the whitelist is full.
+     *
+     * @note WhitelistManager uses this function, and falls back to
+     *       setWhitelist() if it isn't implemented.
+     *
+     * @experimental
+     */
+    virtual ble_error_t addToWhitelist(const BLEProtocol::Address_t &address)
+    {
+        (void) address;
+        return BLE_ERROR_NOT_IMPLEMENTED; /* Requesting action from porters: override this API if the whitelist can be updated incrementally. */
+    }
+
+    /**
+     * Remove an address from the internal whitelist, leaving the other
+     * entries untouched.
+     *
+     * @param[in] address
+     *              The address to remove.
+     *
+     * @return BLE_ERROR_NONE if the address was removed or absent.
+     *
+     * @experimental
+     */
+    virtual ble_error_t removeFromWhitelist(const BLEProtocol::Address_t &address)
+    {
+        (void) address;
+        return BLE_ERROR_NOT_IMPLEMENTED; /* Requesting action from porters: override this API if the whitelist can be updated incrementally. */
+    }
+
     /**
      * Set the advertising policy filter mode to be used in the next call
      * to startAdvertising().
@@ -1579,6 +1684,22 @@ public:
         return disconnectionCallChain;
     }
 
+    /**
+     * @brief Provide access to the callchain of connection parameters update
+     * event callbacks. They are invoked when a procedure started with
+     * updateConnectionParams(), or by the peer, completes.
+     *
+     * @return A reference to the connection parameters update event callback
+     *         chain.
+     *
+     * @note It is possible to register callbacks using onConnectionParamsUpdate().add(callback).
+     *
+     * @note It is possible to unregister callbacks using onConnectionParamsUpdate().detach(callback).
+     */
+    ConnectionParamsUpdateEventCallbackChain_t& onConnectionParamsUpdate() {
+        return connectionParamsUpdateCallChain;
+    }
+
     /**
      * Set the application callback for radio-notification events.
      *
@@ -1670,6 +1791,98 @@ public:
         return shutdownCallChain;
     }
 
+public:
+    /**
+     * Set the resolver used to resolve the resolvable private addresses of
+     * peers. The identity addresses it finds are reported in
+     * AdvertisementCallbackParams_t and ConnectionCallbackParams_t.
+     *
+     * @param[in] resolver
+     *              The resolver, or NULL to stop resolving addresses.
+     */
+    void setRPAResolver(RPAResolver *resolver) {
+        rpaResolver = resolver;
+    }
+
+    /**
+     * Get the resolver set with setRPAResolver(), or NULL.
+     */
+    RPAResolver *getRPAResolver(void) const {
+        return rpaResolver;
+    }
+
+    /**
+     * Set the filter applied by the host to the peers: the advertisement
+     * reports of the peers it refuses aren't reported, and the connections
+     * with them are terminated without their connection nor their
+     * disconnection being reported. Peers resolved by the RPAResolver are
+     * checked by their identity address.
+     *
+     * @note If more than MAX_REFUSED_CONNECTIONS refused connections await
+     *       their disconnection, the others are reported before they are
+     *       terminated.
+     *
+     * @param[in] filter
+     *              The filter, or NULL to accept all peers.
+     */
+    void setAddressFilter(AddressFilter *filter) {
+        addressFilter = filter;
+    }
+
+    /**
+     * Get the filter set with setAddressFilter(), or NULL.
+     */
+    AddressFilter *getAddressFilter(void) const {
+        return addressFilter;
+    }
+
+    /**
+     * Check whether a connection with a peer would be accepted by the
+     * AddressFilter, if any.
+     *
+     * @param[in] peerAddrType
+     *              Type of the peer's address; resolvable private addresses
+     *              are checked by their identity address if the RPAResolver
+     *              resolves them.
+     * @param[in] peerAddr
+     *              The peer's address.
+     *
+     * @return true if no filter is set or the filter accepts the peer.
+     */
+    bool acceptsPeer(BLEProtocol::AddressType_t peerAddrType, const BLEProtocol::AddressBytes_t peerAddr) {
+        if (addressFilter == NULL) {
+            return true;
+        }
+
+        BLEProtocol::AddressType_t  identityAddrType;
+        BLEProtocol::AddressBytes_t identityAddr;
+        if ((rpaResolver != NULL) && (peerAddrType == BLEProtocol::AddressType::RANDOM_PRIVATE_RESOLVABLE) &&
+            rpaResolver->resolve(peerAddr, identityAddrType, identityAddr)) {
+            return addressFilter->accepts(identityAddr);
+        }
+
+        return addressFilter->accepts(peerAddr);
+    }
+
+    /**
+     * Set the tracker fed with the advertisement reports, after the
+     * AddressFilter; peers resolved by the RPAResolver are tracked by their
+     * identity address.
+     *
+     * @param[in] tracker
+     *              The tracker, or NULL to track no peer.
+     */
+    void setRSSITracker(RSSITracker *tracker) {
+        rssiTracker = tracker;
+    }
+
+    /**
+     * Get the tracker set with setRSSITracker(), or NULL.
+     */
+    RSSITracker *getRSSITracker(void) const {
+        return rssiTracker;
+    }
+
 public:
     /**
      * Notify all registered onShutdown callbacks that the Gap instance is
@@ -1707,9 +1920,17 @@ public:
         timeoutCallbackChain.clear();
         connectionCallChain.clear();
         disconnectionCallChain.clear();
+        connectionParamsUpdateCallChain.clear();
         radioNotificationCallback = NULL;
         onAdvertisementReport     = NULL;
 
+        refusedConnectionCount = 0;
+
+        /* Drop the application's hooks */
+        rpaResolver   = NULL;
+        addressFilter = NULL;
+        rssiTracker   = NULL;
+
         return BLE_ERROR_NONE;
     }
 
@@ -1729,9 +1950,17 @@ protected:
         radioNotificationCallback(),
         onAdvertisementReport(),
         connectionCallChain(),
-        disconnectionCallChain() {
+        disconnectionCallChain(),
+        connectionParamsUpdateCallChain(),
+        rpaResolver(NULL),
+        addressFilter(NULL),
+        rssiTracker(NULL),
+        refusedConnectionCount(0) {
         _advPayload.clear();
         _scanResponse.clear();
+#if BLE_TRACE_ENABLED
+        trace = NULL;
+#endif
     }
 
     /* Entry points for the underlying stack to report events back to the user. */
@@ -1763,13 +1992,31 @@ public:
                                 BLEProtocol::AddressType_t         ownAddrType,
                                 const BLEProtocol::AddressBytes_t  ownAddr,
                                 const ConnectionParams_t          *connectionParams) {
+        BLE_STATS_START(stats);
+        BLE_TRACE_RECORD(trace, recordConnectionEvent(handle, role, peerAddrType, peerAddr, ownAddrType, ownAddr, connectionParams));
+
         /* Update Gap state */
         state.advertising = 0;
         state.connected   = 1;
         ++connectionCount;
 
         ConnectionCallbackParams_t callbackParams(handle, role, peerAddrType, peerAddr, ownAddrType, ownAddr, connectionParams);
-        connectionCallChain.call(&callbackParams);
+        if ((rpaResolver != NULL) && (peerAddrType == BLEProtocol::AddressType::RANDOM_PRIVATE_RESOLVABLE)) {
+            callbackParams.peerAddrResolved = rpaResolver->resolve(peerAddr, callbackParams.peerIdentityAddrType, callbackParams.peerIdentityAddr);
+        }
+        bool refused = (addressFilter != NULL) &&
+                       !addressFilter->accepts(callbackParams.peerAddrResolved ? callbackParams.peerIdentityAddr : peerAddr);
+        if (refused && (refusedConnectionCount < MAX_REFUSED_CONNECTIONS)) {
+            /* Its disconnection won't be reported either. */
+            refusedConnections[refusedConnectionCount++] = handle;
+        } else {
+            connectionCallChain.call(&callbackParams);
+        }
+        if (refused) {
+            disconnect(handle, LOCAL_HOST_TERMINATED_CONNECTION);
+        }
+
+        BLE_STATS_RECORD(stats, BLEStats::GAP_CONNECTION);
     }
 
     /**
@@ -1783,14 +2030,30 @@ public:
      *              The reason for disconnection.
      */
     void processDisconnectionEvent(Handle_t handle, DisconnectionReason_t reason) {
+        BLE_STATS_START(stats);
+        BLE_TRACE_RECORD(trace, recordDisconnectionEvent(handle, reason));
+
         /* Update Gap state */
         --connectionCount;
         if (!connectionCount) {
             state.connected = 0;
         }
 
-        DisconnectionCallbackParams_t callbackParams(handle, reason);
-        disconnectionCallChain.call(&callbackParams);
+        bool refused = false;
+        for (unsigned i = 0; i < refusedConnectionCount; ++i) {
+            if (refusedConnections[i] == handle) {
+                refusedConnections[i] = refusedConnections[--refusedConnectionCount];
+                refused = true;
+                break;
+            }
+        }
+
+        if (!refused) {
+            DisconnectionCallbackParams_t callbackParams(handle, reason);
+            disconnectionCallChain.call(&callbackParams);
+        }
+
+        BLE_STATS_RECORD(stats, BLEStats::GAP_DISCONNECTION);
     }
 
     /**
@@ -1817,6 +2080,9 @@ public:
                                     GapAdvertisingParams::AdvertisingType_t  type,
                                     uint8_t                                  advertisingDataLen,
                                     const uint8_t                           *advertisingData) {
+        BLE_STATS_START(stats);
+        BLE_TRACE_RECORD(trace, recordAdvertisementReport(peerAddr, rssi, isScanResponse, type, advertisingDataLen, advertisingData));
+
         AdvertisementCallbackParams_t params;
         memcpy(params.peerAddr, peerAddr, ADDR_LEN);
         params.rssi               = rssi;
@@ -1824,7 +2090,21 @@ public:
         params.type               = type;
         params.advertisingDataLen = advertisingDataLen;
         params.advertisingData    = advertisingData;
-        onAdvertisementReport.call(&params);
+        params.peerAddrResolved   = false;
+        /* The type of the advertiser's address isn't reported; resolve the
+         * addresses which have the format of an RPA. */
+        if (rpaResolver != NULL) {
+            params.peerAddrResolved = rpaResolver->resolve(peerAddr, params.peerIdentityAddrType, params.peerIdentityAddr);
+        }
+        const uint8_t *address = params.peerAddrResolved ? params.peerIdentityAddr : peerAddr;
+        if ((addressFilter == NULL) || addressFilter->accepts(address)) {
+            if (rssiTracker != NULL) {
+                rssiTracker->processReport(address, rssi, advertisingDataLen, advertisingData);
+            }
+            onAdvertisementReport.call(&params);
+        }
+
+        BLE_STATS_RECORD(stats, BLEStats::GAP_ADVERTISEMENT_REPORT);
     }
 
     /**
@@ -1836,6 +2116,9 @@ public:
      *              The source of the timout event.
      */
     void processTimeoutEvent(TimeoutSource_t source) {
+        BLE_STATS_START(stats);
+        BLE_TRACE_RECORD(trace, recordTimeoutEvent(source));
+
         if (source == TIMEOUT_SRC_ADVERTISING) {
             /* Update gap state if the source is an advertising timeout */
             state.advertising = 0;
@@ -1843,6 +2126,32 @@ public:
         if (timeoutCallbackChain) {
             timeoutCallbackChain(source);
         }
+
+        BLE_STATS_RECORD(stats, BLEStats::GAP_TIMEOUT);
+    }
+
+    /**
+     * Helper function that notifies all registered handlers of the outcome
+     * of a connection parameters update. This function is meant to be called
+     * from the BLE stack specific implementation when the procedure
+     * completes, whether it was started locally or by the peer.
+     *
+     * @param[in] handle
+     *              The ID of the connection whose parameters were negotiated.
+     * @param[in] accepted
+     *              Whether the update was applied.
+     * @param[in] connectionParams
+     *              The parameters in effect after the procedure, or NULL if
+     *              unknown.
+     */
+    void processConnectionParamsUpdateEvent(Handle_t handle, bool accepted, const ConnectionParams_t *connectionParams) {
+        BLE_STATS_START(stats);
+        BLE_TRACE_RECORD(trace, recordConnectionParamsUpdateEvent(handle, accepted, connectionParams));
+
+        ConnectionParamsUpdateCallbackParams_t callbackParams(handle, accepted, connectionParams);
+        connectionParamsUpdateCallChain.call(&callbackParams);
+
+        BLE_STATS_RECORD(stats, BLEStats::GAP_CONNECTION_PARAMS_UPDATE);
     }
 
 protected:
@@ -1902,6 +2211,11 @@ protected:
      * events.
      */
     DisconnectionEventCallbackChain_t disconnectionCallChain;
+    /**
+     * Callchain containing all registered callback handlers for connection
+     * parameters update events.
+     */
+    ConnectionParamsUpdateEventCallbackChain_t connectionParamsUpdateCallChain;
 
 private:
     /**
@@ -1909,6 +2223,41 @@ private:
      * events.
      */
     GapShutdownCallbackChain_t shutdownCallChain;
+    /**
+     * Resolver of the peers' resolvable private addresses, or NULL.
+     */
+    RPAResolver               *rpaResolver;
+    /**
+     * Filter applied by the host to the peers, or NULL.
+     */
+    AddressFilter             *addressFilter;
+    /**
+     * Tracker fed with the accepted advertisement reports, or NULL.
+     */
+    RSSITracker               *rssiTracker;
+    /**
+     * Connections refused by the AddressFilter which await their
+     * disconnection.
+     */
+    Handle_t                   refusedConnections[MAX_REFUSED_CONNECTIONS];
+    unsigned                   refusedConnectionCount;
+
+private:
+    friend class BLE;
+
+#if BLE_STATS_ENABLED
+    /**
+     * Statistics of the events handled by Gap; refer to BLE::getStats().
+     */
+    BLEStatsRecorder<BLEStats::GAP_CONNECTION, BLEStats::GAP_CONNECTION_PARAMS_UPDATE - BLEStats::GAP_CONNECTION + 1> stats;
+#endif
+#if BLE_TRACE_ENABLED
+    /**
+     * Trace recording the events handled by Gap, or NULL; refer to
+     * BLE::setTrace().
+     */
+    BLETrace *trace;
+#endif
 
 private:
     /* Disallow copy and assignment. */
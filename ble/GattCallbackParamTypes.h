@@ -112,4 +112,24 @@ struct GattHVXCallbackParams {
   const uint8_t           *data;       /**< Attribute data, variable length. */
 };
 
+/**
+ * For encapsulating the transmission of packets queued by the GATT client
+ * without expecting a response from the remote server (write commands).
+ */
+struct GattDataSentCallbackParams {
+    Gap::Handle_t            connHandle; /**< The handle of the connection on which packets have been sent. */
+    unsigned                 count;      /**< Number of packets transmitted since the last event. */
+};
+
+/**
+ * For encapsulating the completion of a burst of write commands started with
+ * GattClient::writeBurst().
+ */
+struct GattBurstWriteCallbackParams {
+    Gap::Handle_t            connHandle; /**< The handle of the connection the burst was written to. */
+    GattAttribute::Handle_t  handle;     /**< Attribute Handle to which the burst applies. */
+    ble_error_t              status;     /**< BLE_ERROR_NONE if the whole burst has been transmitted; else the error which stopped it. */
+    size_t                   len;        /**< Number of bytes handed over to the stack. */
+};
+
 #endif /*__GATT_CALLBACK_PARAM_TYPES_H__*/
@@ -643,11 +643,11 @@ public:
      *       attribute value that equals sizeof(T). For a variable length
      *       alternative use GattCharacteristic directly.
      */
-    ReadOnlyGattCharacteristic<T>(const UUID    &uuid,
-                                  T             *valuePtr,
-                                  uint8_t        additionalProperties = BLE_GATT_CHAR_PROPERTIES_NONE,
-                                  GattAttribute *descriptors[]        = NULL,
-                                  unsigned       numDescriptors       = 0) :
+    ReadOnlyGattCharacteristic(const UUID    &uuid,
+                               T             *valuePtr,
+                               uint8_t        additionalProperties = BLE_GATT_CHAR_PROPERTIES_NONE,
+                               GattAttribute *descriptors[]        = NULL,
+                               unsigned       numDescriptors       = 0) :
         GattCharacteristic(uuid, reinterpret_cast<uint8_t *>(valuePtr), sizeof(T), sizeof(T),
                            BLE_GATT_CHAR_PROPERTIES_READ | additionalProperties, descriptors, numDescriptors, false) {
         /* empty */
@@ -681,11 +681,11 @@ public:
      *       attribute value with maximum size equal to sizeof(T). For a fixed length
      *       alternative use GattCharacteristic directly.
      */
-    WriteOnlyGattCharacteristic<T>(const UUID     &uuid,
-                                   T              *valuePtr,
-                                   uint8_t        additionalProperties = BLE_GATT_CHAR_PROPERTIES_NONE,
-                                   GattAttribute *descriptors[]        = NULL,
-                                   unsigned       numDescriptors       = 0) :
+    WriteOnlyGattCharacteristic(const UUID    &uuid,
+                                T             *valuePtr,
+                                uint8_t        additionalProperties = BLE_GATT_CHAR_PROPERTIES_NONE,
+                                GattAttribute *descriptors[]        = NULL,
+                                unsigned       numDescriptors       = 0) :
         GattCharacteristic(uuid, reinterpret_cast<uint8_t *>(valuePtr), sizeof(T), sizeof(T),
                            BLE_GATT_CHAR_PROPERTIES_WRITE | additionalProperties, descriptors, numDescriptors) {
         /* empty */
@@ -720,11 +720,11 @@ public:
      *       attribute value with maximum size equal to sizeof(T). For a fixed length
      *       alternative use GattCharacteristic directly.
      */
-    ReadWriteGattCharacteristic<T>(const UUID    &uuid,
-                                   T             *valuePtr,
-                                   uint8_t        additionalProperties = BLE_GATT_CHAR_PROPERTIES_NONE,
-                                   GattAttribute *descriptors[]        = NULL,
-                                   unsigned       numDescriptors       = 0) :
+    ReadWriteGattCharacteristic(const UUID    &uuid,
+                                T             *valuePtr,
+                                uint8_t        additionalProperties = BLE_GATT_CHAR_PROPERTIES_NONE,
+                                GattAttribute *descriptors[]        = NULL,
+                                unsigned       numDescriptors       = 0) :
         GattCharacteristic(uuid, reinterpret_cast<uint8_t *>(valuePtr), sizeof(T), sizeof(T),
                            BLE_GATT_CHAR_PROPERTIES_READ | BLE_GATT_CHAR_PROPERTIES_WRITE | additionalProperties, descriptors, numDescriptors) {
         /* empty */
@@ -760,11 +760,11 @@ public:
      *       attribute value with maximum size equal to sizeof(T) * NUM_ELEMENTS.
      *       For a fixed length alternative use GattCharacteristic directly.
      */
-    WriteOnlyArrayGattCharacteristic<T, NUM_ELEMENTS>(const          UUID &uuid,
-                                                      T              valuePtr[NUM_ELEMENTS],
-                                                      uint8_t        additionalProperties = BLE_GATT_CHAR_PROPERTIES_NONE,
-                                                      GattAttribute *descriptors[]        = NULL,
-                                                      unsigned       numDescriptors       = 0) :
+    WriteOnlyArrayGattCharacteristic(const UUID    &uuid,
+                                     T              valuePtr[NUM_ELEMENTS],
+                                     uint8_t        additionalProperties = BLE_GATT_CHAR_PROPERTIES_NONE,
+                                     GattAttribute *descriptors[]        = NULL,
+                                     unsigned       numDescriptors       = 0) :
         GattCharacteristic(uuid, reinterpret_cast<uint8_t *>(valuePtr), sizeof(T) * NUM_ELEMENTS, sizeof(T) * NUM_ELEMENTS,
                            BLE_GATT_CHAR_PROPERTIES_WRITE | additionalProperties, descriptors, numDescriptors) {
         /* empty */
@@ -800,11 +800,11 @@ public:
      *       attribute value that equals sizeof(T) * NUM_ELEMENTS.
      *       For a variable length alternative use GattCharacteristic directly.
      */
-    ReadOnlyArrayGattCharacteristic<T, NUM_ELEMENTS>(const UUID    &uuid,
-                                                     T              valuePtr[NUM_ELEMENTS],
-                                                     uint8_t        additionalProperties = BLE_GATT_CHAR_PROPERTIES_NONE,
-                                                     GattAttribute *descriptors[]        = NULL,
-                                                     unsigned       numDescriptors       = 0) :
+    ReadOnlyArrayGattCharacteristic(const UUID    &uuid,
+                                    T              valuePtr[NUM_ELEMENTS],
+                                    uint8_t        additionalProperties = BLE_GATT_CHAR_PROPERTIES_NONE,
+                                    GattAttribute *descriptors[]        = NULL,
+                                    unsigned       numDescriptors       = 0) :
         GattCharacteristic(uuid, reinterpret_cast<uint8_t *>(valuePtr), sizeof(T) * NUM_ELEMENTS, sizeof(T) * NUM_ELEMENTS,
                            BLE_GATT_CHAR_PROPERTIES_READ | additionalProperties, descriptors, numDescriptors, false) {
         /* empty */
@@ -841,11 +841,11 @@ public:
      *       attribute value with maximum size equal to sizeof(T) * NUM_ELEMENTS.
      *       For a fixed length alternative use GattCharacteristic directly.
      */
-    ReadWriteArrayGattCharacteristic<T, NUM_ELEMENTS>(const UUID    &uuid,
-                                                      T              valuePtr[NUM_ELEMENTS],
-                                                      uint8_t        additionalProperties = BLE_GATT_CHAR_PROPERTIES_NONE,
-                                                      GattAttribute *descriptors[]        = NULL,
-                                                      unsigned       numDescriptors       = 0) :
+    ReadWriteArrayGattCharacteristic(const UUID    &uuid,
+                                     T              valuePtr[NUM_ELEMENTS],
+                                     uint8_t        additionalProperties = BLE_GATT_CHAR_PROPERTIES_NONE,
+                                     GattAttribute *descriptors[]        = NULL,
+                                     unsigned       numDescriptors       = 0) :
         GattCharacteristic(uuid, reinterpret_cast<uint8_t *>(valuePtr), sizeof(T) * NUM_ELEMENTS, sizeof(T) * NUM_ELEMENTS,
                            BLE_GATT_CHAR_PROPERTIES_READ | BLE_GATT_CHAR_PROPERTIES_WRITE | additionalProperties, descriptors, numDescriptors) {
         /* empty */
@@ -20,12 +20,26 @@
 #include "Gap.h"
 #include "GattAttribute.h"
 #include "ServiceDiscovery.h"
+#include "ServiceDiscoveryPool.h"
 #include "CharacteristicDescriptorDiscovery.h"
 
 #include "GattCallbackParamTypes.h"
+#include "BLEStats.h"
+#include "BLETrace.h"
 
 #include "CallChainOfFunctionPointersWithContext.h"
 
+/* Forward declarations. */
+class GattClientFuture;
+
+#ifndef YOTTA_CFG_BLE_GATT_CLIENT_MAX_BURST_WRITES
+/**
+ * Default number of burst writes (see GattClient::writeBurst()) which can run
+ * concurrently, each one on a different connection.
+ */
+#define YOTTA_CFG_BLE_GATT_CLIENT_MAX_BURST_WRITES 2
+#endif
+
 class GattClient {
 public:
     /**
@@ -66,6 +80,22 @@ public:
      */
     typedef CallChainOfFunctionPointersWithContext<const GattHVXCallbackParams*> HVXCallbackChain_t;
 
+    /**
+     * Type for the registered callbacks added to the data sent callchain.
+     * Refer to GattClient::onDataSent().
+     */
+    typedef FunctionPointerWithContext<const GattDataSentCallbackParams*> DataSentCallback_t;
+    /**
+     * Type for the data sent event callchain. Refer to GattClient::onDataSent().
+     */
+    typedef CallChainOfFunctionPointersWithContext<const GattDataSentCallbackParams*> DataSentCallbackChain_t;
+
+    /**
+     * Type for the callback invoked at the end of a burst write. Refer to
+     * GattClient::writeBurst().
+     */
+    typedef FunctionPointerWithContext<const GattBurstWriteCallbackParams*> BurstWriteCallback_t;
+
     /**
      * Type for the registered callbacks added to the shutdown callchain.
      * Refer to GattClient::onShutdown().
@@ -131,6 +161,9 @@ public:
      *           service. This allows for an inexpensive method to discover only
      *           services.
      *
+     * @note     Discoveries launched on different connections run independently
+     *           of each other, up to getMaxConcurrentServiceDiscoveries().
+     *
      * @return
      *           BLE_ERROR_NONE if service discovery is launched successfully; else an appropriate error.
      */
@@ -149,6 +182,51 @@ public:
         return BLE_ERROR_NOT_IMPLEMENTED; /* Requesting action from porters: override this API if this capability is supported. */
     }
 
+    /**
+     * Launch a targeted service discovery: callbacks are invoked for services
+     * and characteristics whose UUID belongs to the sets given, and the
+     * procedure terminates as soon as all targets have been found. This
+     * avoids either a full discovery or several sequential launches when a
+     * few specific characteristics are needed.
+     *
+     * @param[in]  connectionHandle
+     *              Handle for the connection with the peer.
+     * @param[in]  sc
+     *              The application callback for a matching service.
+     * @param[in]  cc
+     *              The application callback for a matching characteristic.
+     *              Providing NULL skips characteristic discovery.
+     * @param[in]  matchingServiceUUIDs
+     *              Services the application is interested in. An empty set
+     *              matches all services.
+     * @param[in]  matchingCharacteristicUUIDs
+     *              Characteristics the application is interested in. An empty
+     *              set matches all characteristics of the matching services.
+     *
+     * @note     The default implementation falls back to the single UUID
+     *           launchServiceDiscovery() when each set holds at most one UUID.
+     *
+     * @return
+     *           BLE_ERROR_NONE if service discovery is launched successfully; else an appropriate error.
+     */
+    virtual ble_error_t launchServiceDiscovery(Gap::Handle_t                               connectionHandle,
+                                               ServiceDiscovery::ServiceCallback_t         sc,
+                                               ServiceDiscovery::CharacteristicCallback_t  cc,
+                                               const UUIDSet                              &matchingServiceUUIDs,
+                                               const UUIDSet                              &matchingCharacteristicUUIDs) {
+        if ((matchingServiceUUIDs.size() > 1) || (matchingCharacteristicUUIDs.size() > 1)) {
+            return BLE_ERROR_NOT_IMPLEMENTED; /* Requesting action from porters: override this API if this capability is supported. */
+        }
+
+        return launchServiceDiscovery(
+            connectionHandle,
+            sc,
+            cc,
+            matchingServiceUUIDs.isEmpty() ? UUID(UUID::ShortUUIDBytes_t(BLE_UUID_UNKNOWN)) : matchingServiceUUIDs[0],
+            matchingCharacteristicUUIDs.isEmpty() ? UUID(UUID::ShortUUIDBytes_t(BLE_UUID_UNKNOWN)) : matchingCharacteristicUUIDs[0]
+        );
+    }
+
     /**
      * Launch service discovery for services. Once launched, service discovery will remain
      * active with service-callbacks being issued back into the application for matching
@@ -241,6 +319,59 @@ public:
         /* Requesting action from porters: override this API if this capability is supported. */
     }
 
+    /**
+     * Check if service-discovery is currently active on a given connection.
+     *
+     * @param[in] connectionHandle
+     *              Handle of the connection to check.
+     *
+     * @return true if service-discovery is active on this connection, false
+     *         otherwise.
+     *
+     * @note The default implementation reports the state of the single
+     *       discovery procedure supported by legacy ports, whatever the
+     *       connection it runs on.
+     *
+     * @note The per-connection functions are named apart from their legacy
+     *       counterparts so that ports overriding only the latter don't
+     *       hide them.
+     */
+    virtual bool isServiceDiscoveryActiveOn(Gap::Handle_t connectionHandle) const {
+        (void)connectionHandle;
+        return isServiceDiscoveryActive(); /* Requesting action from porters: override this API if concurrent discoveries are supported. */
+    }
+
+    /**
+     * Terminate the service discovery running on a given connection. Discoveries
+     * running on other connections are not affected. This should result in an
+     * invocation of the TerminationCallback(s) if service-discovery is active
+     * on this connection.
+     *
+     * @param[in] connectionHandle
+     *              Handle of the connection on which discovery should stop.
+     *
+     * @return BLE_ERROR_NONE if the discovery has been terminated or none was
+     *         running on this connection; else an appropriate error.
+     */
+    virtual ble_error_t terminateServiceDiscoveryOn(Gap::Handle_t connectionHandle) {
+        (void)connectionHandle;
+        return BLE_ERROR_NOT_IMPLEMENTED; /* Requesting action from porters: override this API if this capability is supported. */
+    }
+
+    /**
+     * Get the maximum number of service discoveries which can run
+     * concurrently, each one on a different connection. Once this limit is
+     * reached, launchServiceDiscovery() fails with BLE_ERROR_NO_MEM.
+     *
+     * @return The maximum number of concurrent service discoveries.
+     *
+     * @note Ports can use ServiceDiscoveryPool to implement concurrent
+     *       discoveries.
+     */
+    virtual uint8_t getMaxConcurrentServiceDiscoveries(void) const {
+        return 1; /* Requesting action from porters: override this API if concurrent discoveries are supported. */
+    }
+
     /**
      * Initiate a GATT Client read procedure by attribute-handle.
      *
@@ -297,6 +428,92 @@ public:
         return BLE_ERROR_NOT_IMPLEMENTED; /* Requesting action from porters: override this API if this capability is supported. */
     }
 
+    /**
+     * Get the ATT_MTU negotiated on a connection. It bounds the size of the
+     * packets sent by writeBurst().
+     *
+     * @param[in] connHandle
+     *              Handle for the connection with the peer.
+     *
+     * @return The ATT_MTU of the connection.
+     */
+    virtual uint16_t getAttMtu(Gap::Handle_t connHandle) const {
+        (void)connHandle;
+        return BLE_GATT_MTU_SIZE_DEFAULT; /* Requesting action from porters: override this API if MTU exchange is supported. */
+    }
+
+    /**
+     * Get the number of write commands which can currently be queued in the
+     * stack for a connection before its buffers are full.
+     *
+     * @param[in]  connHandle
+     *              Handle for the connection with the peer.
+     * @param[out] credits
+     *              The number of packets which can be queued.
+     *
+     * @return BLE_ERROR_NONE on success. Ports which cannot report it return
+     *         BLE_ERROR_NOT_IMPLEMENTED; writeBurst() then queues packets until
+     *         the stack refuses one.
+     */
+    virtual ble_error_t getWriteWithoutResponseCredits(Gap::Handle_t connHandle, uint16_t &credits) const {
+        /* Avoid compiler warnings about unused variables. */
+        (void)connHandle;
+        (void)credits;
+
+        return BLE_ERROR_NOT_IMPLEMENTED; /* Requesting action from porters: override this API if this capability is supported. */
+    }
+
+    /**
+     * Write a buffer of any size to a remote attribute using write commands.
+     *
+     * The buffer is split into packets of (ATT_MTU - 3) bytes which are queued
+     * in the stack as long as transmit credits are available. Transmission
+     * resumes automatically when the stack reports that packets have been sent
+     * (refer to processDataSentEvent()), and @p onComplete is invoked once,
+     * when every packet has been transmitted or an error stopped the burst.
+     *
+     * @param[in] connHandle
+     *              Handle for the connection with the peer.
+     * @param[in] attributeHandle
+     *              Handle for the target attribute on the remote GATT server.
+     * @param[in] length
+     *              Length of the buffer.
+     * @param[in] value
+     *              The buffer to write. It is not copied and must remain valid
+     *              until completion.
+     * @param[in] onComplete
+     *              Callback invoked at the end of the burst.
+     *
+     * @note Only one burst can be in progress per connection, and at most
+     *       MAX_BURST_WRITES on all connections.
+     *
+     * @note A burst is stopped when its connection terminates (refer to
+     *       processDisconnectionEvent()); its completion callback is then
+     *       invoked with the status BLE_ERROR_INVALID_STATE.
+     *
+     * @return BLE_ERROR_NONE if the burst has started; BLE_STACK_BUSY if a
+     *         burst is already running on this connection; BLE_ERROR_NO_MEM if
+     *         too many bursts are running; else the error reported by write()
+     *         for the first packet, including BLE_ERROR_NO_MEM or
+     *         BLE_STACK_BUSY if the stack has no buffer for it.
+     */
+    ble_error_t writeBurst(Gap::Handle_t               connHandle,
+                           GattAttribute::Handle_t     attributeHandle,
+                           size_t                      length,
+                           const uint8_t              *value,
+                           const BurstWriteCallback_t &onComplete);
+
+    /**
+     * Check whether a burst write is running on a connection.
+     */
+    bool isBurstWriteActive(Gap::Handle_t connHandle) const;
+
+    /**
+     * Stop the burst write running on a connection. Its completion callback is
+     * invoked with the status BLE_ERROR_INVALID_STATE.
+     */
+    void cancelBurstWrite(Gap::Handle_t connHandle);
+
     /* Event callback handlers. */
 public:
     /**
@@ -356,6 +573,53 @@ public:
         return onDataWriteCallbackChain;
     }
 
+    /**
+     * Set up a callback for when write commands queued by the GATT client
+     * have been transmitted.
+     *
+     * @param[in] callback
+     *              Event handler being registered.
+     *
+     * @note It is possible to chain together multiple onDataSent callbacks
+     * (potentially from different modules of an application).
+     *
+     * @note It is possible to unregister a callback using
+     * onDataSent().detach(callbackToRemove).
+     */
+    void onDataSent(const DataSentCallback_t &callback) {
+        dataSentCallChain.add(callback);
+    }
+
+    /**
+     * Same as GattClient::onDataSent(), but allows the possibility to add an
+     * object reference and member function as handler for data sent event
+     * callbacks.
+     *
+     * @param[in] objPtr
+     *              Pointer to the object of a class defining the member callback
+     *              function (@p memberPtr).
+     * @param[in] memberPtr
+     *              The member callback (within the context of an object) to be
+     *              invoked.
+     */
+    template <typename T>
+    void onDataSent(T *objPtr, void (T::*memberPtr)(const GattDataSentCallbackParams *)) {
+        dataSentCallChain.add(objPtr, memberPtr);
+    }
+
+    /**
+     * @brief Provide access to the callchain of data sent event callbacks.
+     *
+     * @return A reference to the data sent event callbacks chain.
+     *
+     * @note It is possible to register callbacks using onDataSent().add(callback).
+     *
+     * @note It is possible to unregister callbacks using onDataSent().detach(callback).
+     */
+    DataSentCallbackChain_t& onDataSent() {
+        return dataSentCallChain;
+    }
+
     /**
      * Set up a callback for write response events.
      *
@@ -382,6 +646,27 @@ public:
         /* Requesting action from porters: override this API if this capability is supported. */
     }
 
+    /**
+     * Set up a callback for when the service discovery currently running on a
+     * given connection terminates. It is invoked before the callback registered
+     * with onServiceDiscoveryTermination(callback) and discarded afterwards.
+     *
+     * @param[in] connectionHandle
+     *              Handle of the connection running the discovery.
+     * @param[in] callback
+     *              Event handler being registered.
+     *
+     * @return BLE_ERROR_NONE on success, BLE_ERROR_INVALID_STATE if no
+     *         discovery is running on this connection.
+     */
+    virtual ble_error_t onServiceDiscoveryTerminationOn(Gap::Handle_t connectionHandle, ServiceDiscovery::TerminationCallback_t callback) {
+        /* Avoid compiler warnings about unused variables. */
+        (void)connectionHandle;
+        (void)callback;
+
+        return BLE_ERROR_NOT_IMPLEMENTED; /* Requesting action from porters: override this API if this capability is supported. */
+    }
+
     /**
      * @brief Launch discovery of descriptors for a given characteristic.
      *
@@ -543,13 +828,25 @@ public:
         onDataReadCallbackChain.clear();
         onDataWriteCallbackChain.clear();
         onHVXCallbackChain.clear();
+        dataSentCallChain.clear();
+
+        for (unsigned i = 0; i < MAX_BURST_WRITES; ++i) {
+            burstWrites[i].active = false;
+        }
+
+        cancelFutures();
 
         return BLE_ERROR_NONE;
     }
 
 protected:
-    GattClient() {
-        /* Empty */
+    GattClient() : pendingFutures(NULL) {
+        for (unsigned i = 0; i < MAX_BURST_WRITES; ++i) {
+            burstWrites[i].active = false;
+        }
+#if BLE_TRACE_ENABLED
+        trace = NULL;
+#endif
     }
 
     /* Entry points for the underlying stack to report events back to the user. */
@@ -564,7 +861,13 @@ public:
      *              handlers.
      */
     void processReadResponse(const GattReadCallbackParams *params) {
+        BLE_STATS_START(stats);
+        BLE_TRACE_RECORD(trace, recordReadResponse(params));
+        if (pendingFutures != NULL) {
+            completeReadFuture(params);
+        }
         onDataReadCallbackChain(params);
+        BLE_STATS_RECORD(stats, BLEStats::GATT_CLIENT_READ_RESPONSE);
     }
 
     /**
@@ -577,7 +880,13 @@ public:
      *              handlers.
      */
     void processWriteResponse(const GattWriteCallbackParams *params) {
+        BLE_STATS_START(stats);
+        BLE_TRACE_RECORD(trace, recordWriteResponse(params));
+        if (pendingFutures != NULL) {
+            completeWriteFuture(params);
+        }
         onDataWriteCallbackChain(params);
+        BLE_STATS_RECORD(stats, BLEStats::GATT_CLIENT_WRITE_RESPONSE);
     }
 
     /**
@@ -590,11 +899,86 @@ public:
      *              handlers.
      */
     void processHVXEvent(const GattHVXCallbackParams *params) {
+        BLE_STATS_START(stats);
+        BLE_TRACE_RECORD(trace, recordHVXEvent(params));
+        if (pendingFutures != NULL) {
+            completeUpdateFutures(params);
+        }
         if (onHVXCallbackChain) {
             onHVXCallbackChain(params);
         }
+        BLE_STATS_RECORD(stats, BLEStats::GATT_CLIENT_HVX);
     }
 
+    /**
+     * Helper function that notifies all registered handlers of an occurrence
+     * of a data sent event and resumes the burst write of the connection, if
+     * any. This function is meant to be called from the BLE stack specific
+     * implementation when write commands have been transmitted.
+     *
+     * @param[in] connHandle
+     *              The handle of the connection on which packets have been
+     *              sent.
+     * @param[in] count
+     *              Number of packets transmitted.
+     */
+    void processDataSentEvent(Gap::Handle_t connHandle, unsigned count);
+
+    /**
+     * Helper function that stops the burst write of a terminated connection,
+     * if any, and cancels the GattClientFutures pending on it. This function
+     * is meant to be called from the BLE stack specific implementation when
+     * a connection terminates, before its handle can be reused.
+     *
+     * @param[in] connHandle
+     *              The connection which terminated.
+     */
+    void processDisconnectionEvent(Gap::Handle_t connHandle) {
+        cancelBurstWrite(connHandle);
+        if (pendingFutures != NULL) {
+            cancelFutures(connHandle);
+        }
+    }
+
+public:
+    /**
+     * Maximum number of burst writes running concurrently.
+     */
+    static const unsigned MAX_BURST_WRITES = YOTTA_CFG_BLE_GATT_CLIENT_MAX_BURST_WRITES;
+
+private:
+    /**
+     * State of a burst write.
+     */
+    struct BurstWrite_t {
+        bool                     active;
+        Gap::Handle_t            connHandle;
+        GattAttribute::Handle_t  attributeHandle;
+        const uint8_t           *value;
+        size_t                   length;
+        size_t                   offset;    /**< Number of bytes handed over to the stack. */
+        unsigned                 inFlight;  /**< Packets queued but not reported sent yet. */
+        BurstWriteCallback_t     onComplete;
+    };
+
+    friend class GattClientFuture;
+
+    /*
+     * Management of the GattClientFutures waiting for a response; refer to
+     * GattClientFuture.
+     */
+    void attachFuture(GattClientFuture *future);
+    void detachFuture(GattClientFuture *future);
+    void completeReadFuture(const GattReadCallbackParams *params);
+    void completeWriteFuture(const GattWriteCallbackParams *params);
+    void completeUpdateFutures(const GattHVXCallbackParams *params);
+    void cancelFutures(void);
+    void cancelFutures(Gap::Handle_t connHandle);
+
+    BurstWrite_t *findBurstWrite(Gap::Handle_t connHandle);
+    ble_error_t pumpBurstWrite(BurstWrite_t &burst);
+    void completeBurstWrite(BurstWrite_t &burst, ble_error_t status);
+
 protected:
     /**
      * Callchain containing all registered callback handlers for data read
@@ -616,6 +1000,38 @@ protected:
      * events.
      */
     GattClientShutdownCallbackChain_t shutdownCallChain;
+    /**
+     * Callchain containing all registered callback handlers for data sent
+     * events.
+     */
+    DataSentCallbackChain_t           dataSentCallChain;
+
+private:
+    /**
+     * Burst writes in progress.
+     */
+    BurstWrite_t                      burstWrites[MAX_BURST_WRITES];
+    /**
+     * Futures waiting for a response, oldest first.
+     */
+    GattClientFuture                 *pendingFutures;
+
+private:
+    friend class BLE;
+
+#if BLE_STATS_ENABLED
+    /**
+     * Statistics of the events handled by GattClient; refer to BLE::getStats().
+     */
+    BLEStatsRecorder<BLEStats::GATT_CLIENT_READ_RESPONSE, BLEStats::GATT_CLIENT_DATA_SENT - BLEStats::GATT_CLIENT_READ_RESPONSE + 1> stats;
+#endif
+#if BLE_TRACE_ENABLED
+    /**
+     * Trace recording the events handled by GattClient, or NULL; refer to
+     * BLE::setTrace().
+     */
+    BLETrace *trace;
+#endif
 
 private:
     /* Disallow copy and assignment. */
@@ -0,0 +1,309 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __GATT_CLIENT_FUTURE_H__
+#define __GATT_CLIENT_FUTURE_H__
+
+#include "GattClient.h"
+#include "FunctionPointerWithContext.h"
+
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#endif
+
+#ifndef YOTTA_CFG_BLE_GATT_CLIENT_FUTURE_BUFFER_SIZE
+/**
+ * Default size of the buffer of a GattClientFuture receiving the value read
+ * or notified; longer values are truncated. The default matches the largest
+ * value carried by a single PDU with the default ATT MTU.
+ */
+#define YOTTA_CFG_BLE_GATT_CLIENT_FUTURE_BUFFER_SIZE 22
+#endif
+
+/**
+ * @brief Result of a single GATT client operation, to be polled, waited on
+ * with a callback or, with C++20 compilers, awaited by a coroutine.
+ *
+ * @details A future starts one operation at a time (a read, a write request,
+ * a subscription or the wait for the next update of an attribute) and holds
+ * everything the operation needs: it is the preallocated slot of the
+ * operation and no memory is allocated. While the operation is pending, the
+ * future is linked into the GattClient, which completes it directly from the
+ * matching response; the callchains of the GattClient are neither used nor
+ * modified, and the handlers registered there still see the response.
+ *
+ * Operations can be chained from the completion callback:
+ *
+ * @code
+ * GattClientFuture future;
+ *
+ * void onWritten(const GattClientFuture *f) {
+ *     future.subscribe(client, connHandle, cccdHandle);
+ * }
+ *
+ * void onRead(const GattClientFuture *f) {
+ *     if (f->isCompleted() && (f->getData()[0] == 0)) {
+ *         future.onComplete(onWritten);
+ *         future.write(client, connHandle, controlHandle, sizeof(command), command);
+ *     }
+ * }
+ *
+ * future.onComplete(onRead);
+ * future.read(client, connHandle, valueHandle);
+ * @endcode
+ *
+ * or, when coroutines are available, awaited in sequence:
+ *
+ * @code
+ * future.read(client, connHandle, valueHandle);
+ * co_await future;
+ * future.write(client, connHandle, controlHandle, sizeof(command), command);
+ * co_await future;
+ * @endcode
+ */
+class GattClientFuture {
+public:
+    /**
+     * Type of the callback invoked when the operation completes or is
+     * cancelled.
+     */
+    typedef FunctionPointerWithContext<const GattClientFuture *> CompletionCallback_t;
+
+    /**
+     * State of a future.
+     */
+    enum State_t {
+        STATE_IDLE,      /**< No operation has been started. */
+        STATE_PENDING,   /**< The operation is waiting for its response. */
+        STATE_COMPLETED, /**< The response has been received. */
+        STATE_CANCELLED  /**< The operation has been cancelled, its connection has terminated or the GattClient has been reset. */
+    };
+
+    /**
+     * Size of the buffer receiving the value read or notified.
+     */
+    static const uint16_t BUFFER_SIZE = YOTTA_CFG_BLE_GATT_CLIENT_FUTURE_BUFFER_SIZE;
+
+public:
+    GattClientFuture();
+
+    /**
+     * Cancel the pending operation, if any.
+     */
+    ~GattClientFuture();
+
+    /**
+     * Read the value of an attribute; refer to GattClient::read().
+     *
+     * @return BLE_ERROR_NONE if the read has been started,
+     *         BLE_ERROR_INVALID_STATE if an operation is already pending, or
+     *         the error returned by GattClient::read().
+     */
+    ble_error_t read(GattClient              &client,
+                     Gap::Handle_t            connHandle,
+                     GattAttribute::Handle_t  attributeHandle,
+                     uint16_t                 offset = 0);
+
+    /**
+     * Write the value of an attribute with a write request; the operation
+     * completes when the server acknowledges it. @p value must remain valid
+     * until then if the underlying stack doesn't copy it.
+     *
+     * @return BLE_ERROR_NONE if the write has been started,
+     *         BLE_ERROR_INVALID_STATE if an operation is already pending, or
+     *         the error returned by GattClient::write().
+     */
+    ble_error_t write(GattClient              &client,
+                      Gap::Handle_t            connHandle,
+                      GattAttribute::Handle_t  attributeHandle,
+                      uint16_t                 length,
+                      const uint8_t           *value);
+
+    /**
+     * Enable the notifications or indications of a characteristic by writing
+     * its Client Characteristic Configuration descriptor.
+     *
+     * @param[in] cccdHandle
+     *              Handle of the CCCD of the characteristic.
+     * @param[in] type
+     *              BLE_HVX_NOTIFICATION or BLE_HVX_INDICATION.
+     *
+     * @return As write().
+     */
+    ble_error_t subscribe(GattClient              &client,
+                          Gap::Handle_t            connHandle,
+                          GattAttribute::Handle_t  cccdHandle,
+                          HVXType_t                type = BLE_HVX_NOTIFICATION);
+
+    /**
+     * Disable the notifications and indications of a characteristic.
+     *
+     * @return As write().
+     */
+    ble_error_t unsubscribe(GattClient              &client,
+                            Gap::Handle_t            connHandle,
+                            GattAttribute::Handle_t  cccdHandle);
+
+    /**
+     * Wait for the next notification or indication of an attribute. The
+     * future completes with the value sent by the server.
+     *
+     * @return BLE_ERROR_NONE, or BLE_ERROR_INVALID_STATE if an operation is
+     *         already pending.
+     */
+    ble_error_t waitForUpdate(GattClient              &client,
+                              Gap::Handle_t            connHandle,
+                              GattAttribute::Handle_t  valueHandle);
+
+    /**
+     * Cancel the pending operation. Its response, if it ever arrives, only
+     * reaches the handlers registered with the GattClient. The completion
+     * callback is invoked, and an awaiting coroutine resumed, with the
+     * future in the STATE_CANCELLED state.
+     */
+    void cancel(void);
+
+    /**
+     * Set the callback invoked when an operation completes or is cancelled;
+     * it applies to the following operations until changed.
+     */
+    void onComplete(const CompletionCallback_t &callback) {
+        completionCallback = callback;
+    }
+
+    /**
+     * Same as onComplete(), with a member function.
+     */
+    template <typename T>
+    void onComplete(T *objPtr, void (T::*memberPtr)(const GattClientFuture *)) {
+        completionCallback.attach(objPtr, memberPtr);
+    }
+
+    State_t getState(void) const {
+        return state;
+    }
+
+    bool isPending(void) const {
+        return state == STATE_PENDING;
+    }
+
+    bool isCompleted(void) const {
+        return state == STATE_COMPLETED;
+    }
+
+    Gap::Handle_t getConnectionHandle(void) const {
+        return connHandle;
+    }
+
+    GattAttribute::Handle_t getAttributeHandle(void) const {
+        return attributeHandle;
+    }
+
+    /**
+     * Get the value read or notified; it remains valid until the next
+     * operation is started.
+     */
+    const uint8_t *getData(void) const {
+        return buffer;
+    }
+
+    /**
+     * Get the length of the value held by getData().
+     */
+    uint16_t getLength(void) const {
+        return length;
+    }
+
+    /**
+     * Check whether the value received was longer than BUFFER_SIZE.
+     */
+    bool isTruncated(void) const {
+        return truncated;
+    }
+
+#if defined(__cpp_impl_coroutine)
+    /*
+     * Awaitable interface: a coroutine executing "co_await future" is
+     * suspended until the pending operation completes or is cancelled.
+     */
+    bool await_ready(void) const {
+        return state != STATE_PENDING;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+        continuation = handle;
+    }
+
+    const GattClientFuture &await_resume(void) const {
+        return *this;
+    }
+#endif
+
+private:
+    friend class GattClient;
+
+    /**
+     * Kinds of operations, matched against the responses of the server.
+     */
+    enum Operation_t {
+        OPERATION_NONE,
+        OPERATION_READ,
+        OPERATION_WRITE,
+        OPERATION_UPDATE
+    };
+
+    ble_error_t start(GattClient              &client,
+                      Operation_t              operation,
+                      Gap::Handle_t            connHandle,
+                      GattAttribute::Handle_t  attributeHandle);
+    ble_error_t writeCCCD(GattClient              &client,
+                          Gap::Handle_t            connHandle,
+                          GattAttribute::Handle_t  cccdHandle,
+                          uint16_t                 cccdValue);
+    bool matches(Operation_t operation, Gap::Handle_t connHandle, GattAttribute::Handle_t attributeHandle) const;
+
+    /**
+     * Store the outcome of the operation; called once the future has been
+     * unlinked from its GattClient.
+     */
+    void store(State_t state, const uint8_t *data, uint16_t length);
+    /**
+     * Invoke the completion callback and resume the awaiting coroutine.
+     */
+    void notify(void);
+
+private:
+    GattClient              *client;       /**< The client the pending operation is linked into. */
+    GattClientFuture        *next;         /**< Next pending future of the client. */
+    Operation_t              operation;
+    State_t                  state;
+    Gap::Handle_t            connHandle;
+    GattAttribute::Handle_t  attributeHandle;
+    uint16_t                 length;
+    bool                     truncated;
+    uint8_t                  buffer[BUFFER_SIZE];
+    CompletionCallback_t     completionCallback;
+#if defined(__cpp_impl_coroutine)
+    std::coroutine_handle<>  continuation;
+#endif
+
+private:
+    /* Disallow copy and assignment. */
+    GattClientFuture(const GattClientFuture &);
+    GattClientFuture& operator=(const GattClientFuture &);
+};
+
+#endif /* ifndef __GATT_CLIENT_FUTURE_H__ */
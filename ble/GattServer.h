@@ -22,6 +22,9 @@
 #include "GattAttribute.h"
 #include "GattServerEvents.h"
 #include "GattCallbackParamTypes.h"
+#include "GattSubscriptionTable.h"
+#include "BLEStats.h"
+#include "BLETrace.h"
 #include "CallChainOfFunctionPointersWithContext.h"
 
 class GattServer {
@@ -73,6 +76,26 @@ public:
      */
     typedef FunctionPointerWithContext<GattAttribute::Handle_t> EventCallback_t;
 
+    /**
+     * Outcome of a notification sent to one connection by
+     * notifyConnections() or notifySubscribers().
+     */
+    enum NotificationStatus_t {
+        NOTIFICATION_QUEUED         = 0, /**< The stack accepted the notification; it goes out at the next connection event. */
+        NOTIFICATION_DROPPED        = 1, /**< No transmit buffer was available; the notification has not been sent. */
+        NOTIFICATION_NOT_SUBSCRIBED = 2, /**< The peer has not enabled updates; nothing has been sent. */
+        NOTIFICATION_FAILED         = 3  /**< The stack rejected the notification; refer to NotificationResult_t::error. */
+    };
+
+    /**
+     * Per-connection result of a notification fan-out.
+     */
+    struct NotificationResult_t {
+        Gap::Handle_t        connectionHandle; /**< The connection targeted. */
+        NotificationStatus_t status;           /**< What happened to the notification. */
+        ble_error_t          error;            /**< Error reported by the stack, BLE_ERROR_NONE if queued. */
+    };
+
 protected:
     /**
      * Construct a GattServer instance.
@@ -86,7 +109,9 @@ protected:
         updatesEnabledCallback(NULL),
         updatesDisabledCallback(NULL),
         confirmationReceivedCallback(NULL) {
-        /* empty */
+#if BLE_TRACE_ENABLED
+        trace = NULL;
+#endif
     }
 
     /*
@@ -267,6 +292,56 @@ public:
         return BLE_ERROR_NOT_IMPLEMENTED; /* Requesting action from porters: override this API if this capability is supported. */
     }
 
+    /**
+     * Send the current value of a characteristic to a single connection as a
+     * notification or an indication, according to the CCCD of the peer. The
+     * value is the one held in the attribute table: unlike
+     * write(Gap::Handle_t, GattAttribute::Handle_t, const uint8_t *, uint16_t, bool)
+     * no value is copied.
+     *
+     * @param[in] connectionHandle
+     *              The connection to update.
+     * @param[in] valueHandle
+     *              Value handle of the characteristic.
+     *
+     * @return BLE_ERROR_NONE if the update has been queued;
+     *         BLE_ERROR_NO_MEM if no transmit buffer is available.
+     */
+    virtual ble_error_t sendUpdate(Gap::Handle_t connectionHandle, GattAttribute::Handle_t valueHandle) {
+        /* Avoid compiler warnings about unused variables. */
+        (void)connectionHandle;
+        (void)valueHandle;
+
+        return BLE_ERROR_NOT_IMPLEMENTED; /* Requesting action from porters: override this API if this capability is supported. */
+    }
+
+    /**
+     * Update the length of a characteristic value held in user-owned memory,
+     * that is the buffer passed to the GattCharacteristic constructor, after
+     * the application has modified it in place; then notify or indicate it
+     * unless @p localOnly is set. Stacks which reference user-owned memory in
+     * their attribute table avoid copying the value.
+     *
+     * @param[in] attributeHandle
+     *              Handle for the value attribute of the characteristic.
+     * @param[in] size
+     *              Size of the new value (in bytes).
+     * @param[in] localOnly
+     *              If set to true, no notification or indication is generated.
+     *
+     * @return BLE_ERROR_NONE if the value has been updated;
+     *         BLE_ERROR_NOT_IMPLEMENTED if the stack keeps its own copy of
+     *         attribute values, in which case write() must be used instead.
+     */
+    virtual ble_error_t updateInPlace(GattAttribute::Handle_t attributeHandle, uint16_t size, bool localOnly = false) {
+        /* Avoid compiler warnings about unused variables. */
+        (void)attributeHandle;
+        (void)size;
+        (void)localOnly;
+
+        return BLE_ERROR_NOT_IMPLEMENTED; /* Requesting action from porters: override this API if this capability is supported. */
+    }
+
     /**
      * A virtual function to allow underlying stacks to indicate if they support
      * onDataRead(). It should be overridden to return true as applicable.
@@ -277,6 +352,169 @@ public:
         return false; /* Requesting action from porters: override this API if this capability is supported. */
     }
 
+    /**
+     * A virtual function to allow underlying stacks to indicate if they report
+     * CCCD writes with the connection they originate from (refer to
+     * handleEvent(GattServerEvents::gattEvent_e, Gap::Handle_t, GattAttribute::Handle_t)),
+     * the CCCDs they restore for bonded peers (refer to
+     * handleSubscriptionRestored()) and connection terminations (refer to
+     * handleDisconnectionEvent()). When they do, the GattServer caches the
+     * subscriptions of each connection.
+     *
+     * @return true if the subscription cache is maintained, false otherwise.
+     */
+    virtual bool isSubscriptionCacheAvailable() const {
+        return false; /* Requesting action from porters: override this API if this capability is supported. */
+    }
+
+    /* Subscription cache. */
+public:
+    /**
+     * Check whether a connection has enabled notifications or indications
+     * for a characteristic. This is answered from the subscription cache,
+     * without querying the stack.
+     *
+     * @param[in] connectionHandle
+     *              The connection to check.
+     * @param[in] valueHandle
+     *              Value handle of the characteristic.
+     *
+     * @return true if the connection has subscribed. If the cache isn't
+     *         available (refer to isSubscriptionCacheAvailable()) or can't
+     *         tell, true is returned.
+     */
+    bool isSubscribed(Gap::Handle_t connectionHandle, GattAttribute::Handle_t valueHandle) const {
+        if (!isSubscriptionCacheAvailable()) {
+            return true;
+        }
+
+        return subscriptions.isSubscribed(connectionHandle, valueHandle);
+    }
+
+    /**
+     * Check whether any connection has enabled notifications or indications
+     * for a characteristic.
+     *
+     * @param[in] valueHandle
+     *              Value handle of the characteristic.
+     *
+     * @return true if at least one connection has subscribed. If the cache
+     *         isn't available or can't tell, true is returned.
+     */
+    bool hasSubscribers(GattAttribute::Handle_t valueHandle) const {
+        if (!isSubscriptionCacheAvailable()) {
+            return true;
+        }
+
+        return subscriptions.hasSubscribers(valueHandle);
+    }
+
+    /**
+     * Get the connections which have enabled notifications or indications
+     * for a characteristic.
+     *
+     * @param[in]  valueHandle
+     *               Value handle of the characteristic.
+     * @param[out] connectionHandles
+     *               Array receiving the connection handles.
+     * @param[in]  maxConnections
+     *               Size of @p connectionHandles.
+     *
+     * @return The number of handles written to @p connectionHandles; 0 if the
+     *         cache isn't available.
+     */
+    uint8_t getSubscribers(GattAttribute::Handle_t valueHandle, Gap::Handle_t *connectionHandles, uint8_t maxConnections) const {
+        if (!isSubscriptionCacheAvailable()) {
+            return 0;
+        }
+
+        return subscriptions.getSubscribers(valueHandle, connectionHandles, maxConnections);
+    }
+
+    /**
+     * Update the value of a characteristic and notify it only if a peer has
+     * subscribed to it. When no peer has subscribed, the value is only
+     * updated locally so that it remains available to read requests, and no
+     * notification or indication is attempted.
+     *
+     * @param[in] valueHandle
+     *              Value handle of the characteristic.
+     * @param[in] value
+     *              The new value.
+     * @param[in] size
+     *              Size of the new value (in bytes).
+     *
+     * @return The result of the underlying write().
+     */
+    ble_error_t notifySubscribers(GattAttribute::Handle_t valueHandle, const uint8_t *value, uint16_t size) {
+        return write(valueHandle, value, size, !hasSubscribers(valueHandle));
+    }
+
+    /**
+     * Update the value of a characteristic once then send it to a set of
+     * connections.
+     *
+     * @param[in]  valueHandle
+     *               Value handle of the characteristic.
+     * @param[in]  value
+     *               The new value.
+     * @param[in]  size
+     *               Size of the new value (in bytes).
+     * @param[in]  connectionHandles
+     *               The connections to update.
+     * @param[in]  count
+     *               Number of connections in @p connectionHandles.
+     * @param[out] results
+     *               Optional array of @p count entries receiving the outcome
+     *               for each connection.
+     *
+     * @return BLE_ERROR_NONE if the value has been updated, whatever the
+     *         outcome for each connection; else the error which prevented the
+     *         update.
+     *
+     * @note Connections which are known not to have enabled updates are
+     *       skipped (NOTIFICATION_NOT_SUBSCRIBED).
+     */
+    ble_error_t notifyConnections(GattAttribute::Handle_t  valueHandle,
+                                  const uint8_t           *value,
+                                  uint16_t                 size,
+                                  const Gap::Handle_t     *connectionHandles,
+                                  uint8_t                  count,
+                                  NotificationResult_t    *results = NULL);
+
+    /**
+     * Update the value of a characteristic once then send it to every
+     * connection which has enabled updates, according to the subscription
+     * cache.
+     *
+     * @param[in]  valueHandle
+     *               Value handle of the characteristic.
+     * @param[in]  value
+     *               The new value.
+     * @param[in]  size
+     *               Size of the new value (in bytes).
+     * @param[out] results
+     *               Optional array receiving the outcome for each connection.
+     * @param[in]  maxResults
+     *               Size of @p results.
+     * @param[out] resultCount
+     *               Optional; receives the number of connections updated.
+     *
+     * @return BLE_ERROR_NONE if the value has been updated; else the error
+     *         which prevented the update.
+     *
+     * @note Without a subscription cache (refer to isSubscriptionCacheAvailable()),
+     *       or when some subscriptions to the characteristic could not be
+     *       cached, this falls back to write(GattAttribute::Handle_t, const uint8_t *, uint16_t, bool)
+     *       and no per-connection result is reported.
+     */
+    ble_error_t notifySubscribers(GattAttribute::Handle_t  valueHandle,
+                                  const uint8_t           *value,
+                                  uint16_t                 size,
+                                  NotificationResult_t    *results,
+                                  uint8_t                  maxResults,
+                                  uint8_t                 *resultCount = NULL);
+
     /*
      * APIs with non-virtual implementations.
      */
@@ -543,7 +781,10 @@ protected:
      *              handlers.
      */
     void handleDataWrittenEvent(const GattWriteCallbackParams *params) {
+        BLE_STATS_START(stats);
+        BLE_TRACE_RECORD(trace, recordDataWrittenEvent(params));
         dataWrittenCallChain.call(params);
+        BLE_STATS_RECORD(stats, BLEStats::GATT_SERVER_DATA_WRITTEN);
     }
 
     /**
@@ -556,7 +797,10 @@ protected:
      *              handlers.
      */
     void handleDataReadEvent(const GattReadCallbackParams *params) {
+        BLE_STATS_START(stats);
+        BLE_TRACE_RECORD(trace, recordDataReadEvent(params));
         dataReadCallChain.call(params);
+        BLE_STATS_RECORD(stats, BLEStats::GATT_SERVER_DATA_READ);
     }
 
     /**
@@ -571,6 +815,91 @@ protected:
      *              The handle of the attribute that was modified.
      */
     void handleEvent(GattServerEvents::gattEvent_e type, GattAttribute::Handle_t attributeHandle) {
+        BLE_TRACE_RECORD(trace, recordServerEvent(type, BLETrace::NO_CONNECTION, attributeHandle));
+        dispatchEvent(type, attributeHandle);
+    }
+
+    /**
+     * Helper function that records the CCCD state of a connection in the
+     * subscription cache and then notifies the registered handlers of the
+     * event, as handleEvent(GattServerEvents::gattEvent_e, GattAttribute::Handle_t)
+     * does. Stacks calling it should return true from
+     * isSubscriptionCacheAvailable().
+     *
+     * @param[in] type
+     *              The type of event that occurred.
+     * @param[in] connectionHandle
+     *              The connection on which the event occurred.
+     * @param[in] attributeHandle
+     *              The handle of the attribute the event relates to.
+     */
+    void handleEvent(GattServerEvents::gattEvent_e type, Gap::Handle_t connectionHandle, GattAttribute::Handle_t attributeHandle) {
+        BLE_TRACE_RECORD(trace, recordServerEvent(type, connectionHandle, attributeHandle));
+
+        if (type == GattServerEvents::GATT_EVENT_UPDATES_ENABLED) {
+            subscriptions.setSubscribed(connectionHandle, attributeHandle, true);
+        } else if (type == GattServerEvents::GATT_EVENT_UPDATES_DISABLED) {
+            subscriptions.setSubscribed(connectionHandle, attributeHandle, false);
+        }
+
+        dispatchEvent(type, attributeHandle);
+    }
+
+    /**
+     * Helper function that drops the subscriptions of a terminated
+     * connection from the subscription cache. This function is meant to be
+     * called from the BLE stack specific implementation when a connection
+     * terminates.
+     *
+     * @param[in] connectionHandle
+     *              The connection which terminated.
+     */
+    void handleDisconnectionEvent(Gap::Handle_t connectionHandle) {
+        BLE_TRACE_RECORD(trace, recordServerDisconnectionEvent(connectionHandle));
+        subscriptions.removeConnection(connectionHandle);
+    }
+
+    /**
+     * Helper function that records in the subscription cache a subscription
+     * restored without a CCCD write, as stacks do for bonded peers when they
+     * reconnect. No event is dispatched to the application. This function is
+     * meant to be called from the BLE stack specific implementation, for
+     * each characteristic whose restored CCCD enables notifications or
+     * indications, before the connection is reported.
+     *
+     * @param[in] connectionHandle
+     *              The connection of the bonded peer.
+     * @param[in] valueHandle
+     *              Value handle of the characteristic.
+     */
+    void handleSubscriptionRestored(Gap::Handle_t connectionHandle, GattAttribute::Handle_t valueHandle) {
+        BLE_TRACE_RECORD(trace, recordServerSubscriptionRestored(connectionHandle, valueHandle));
+        subscriptions.setSubscribed(connectionHandle, valueHandle, true);
+    }
+
+    /**
+     * Helper function that notifies all registered handlers of an occurrence
+     * of a data sent event. This function is meant to be called from the
+     * BLE stack specific implementation when a data sent event occurs.
+     *
+     * @param[in] count
+     *              Number of packets sent.
+     */
+    void handleDataSentEvent(unsigned count) {
+        BLE_STATS_START(stats);
+        BLE_TRACE_RECORD(trace, recordServerDataSentEvent(count));
+        dataSentCallChain.call(count);
+        BLE_STATS_RECORD(stats, BLEStats::GATT_SERVER_DATA_SENT);
+    }
+
+private:
+    /**
+     * Notify the registered handler of an updates enabled, updates disabled
+     * or confirmation received event.
+     */
+    void dispatchEvent(GattServerEvents::gattEvent_e type, GattAttribute::Handle_t attributeHandle) {
+        BLE_STATS_START(stats);
+
         switch (type) {
             case GattServerEvents::GATT_EVENT_UPDATES_ENABLED:
                 if (updatesEnabledCallback) {
@@ -590,18 +919,8 @@ protected:
             default:
                 break;
         }
-    }
 
-    /**
-     * Helper function that notifies all registered handlers of an occurrence
-     * of a data sent event. This function is meant to be called from the
-     * BLE stack specific implementation when a data sent event occurs.
-     *
-     * @param[in] count
-     *              Number of packets sent.
-     */
-    void handleDataSentEvent(unsigned count) {
-        dataSentCallChain.call(count);
+        BLE_STATS_RECORD(stats, BLEStats::GATT_SERVER_UPDATES_EVENT);
     }
 
 public:
@@ -633,6 +952,8 @@ public:
         updatesDisabledCallback      = NULL;
         confirmationReceivedCallback = NULL;
 
+        subscriptions.clear();
+
         return BLE_ERROR_NONE;
     }
 
@@ -679,6 +1000,35 @@ private:
      * The registered callback handler for confirmation received events.
      */
     EventCallback_t                   confirmationReceivedCallback;
+    /**
+     * Cache of the CCCD state of each connection.
+     */
+    GattSubscriptionTable             subscriptions;
+
+private:
+    NotificationStatus_t notifyConnection(Gap::Handle_t           connectionHandle,
+                                          GattAttribute::Handle_t valueHandle,
+                                          const uint8_t          *value,
+                                          uint16_t                size,
+                                          ble_error_t            &error);
+
+private:
+    friend class BLE;
+    friend class BLETraceReplayer;
+
+#if BLE_STATS_ENABLED
+    /**
+     * Statistics of the events handled by GattServer; refer to BLE::getStats().
+     */
+    BLEStatsRecorder<BLEStats::GATT_SERVER_DATA_WRITTEN, BLEStats::GATT_SERVER_DATA_SENT - BLEStats::GATT_SERVER_DATA_WRITTEN + 1> stats;
+#endif
+#if BLE_TRACE_ENABLED
+    /**
+     * Trace recording the events handled by GattServer, or NULL; refer to
+     * BLE::setTrace().
+     */
+    BLETrace *trace;
+#endif
 
 private:
     /* Disallow copy and assignment. */
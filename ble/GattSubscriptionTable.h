@@ -0,0 +1,282 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __GATT_SUBSCRIPTION_TABLE_H__
+#define __GATT_SUBSCRIPTION_TABLE_H__
+
+#include "Gap.h"
+#include "GattAttribute.h"
+
+#ifndef YOTTA_CFG_BLE_GATT_SERVER_SUBSCRIPTION_MAX_CONNECTIONS
+/**
+ * Default number of connections whose subscriptions are cached by the
+ * GattServer.
+ */
+#define YOTTA_CFG_BLE_GATT_SERVER_SUBSCRIPTION_MAX_CONNECTIONS 4
+#endif
+
+#ifndef YOTTA_CFG_BLE_GATT_SERVER_SUBSCRIPTION_MAX_CHARACTERISTICS
+/**
+ * Default number of characteristics (at most 32) whose subscriptions are
+ * cached by the GattServer.
+ */
+#define YOTTA_CFG_BLE_GATT_SERVER_SUBSCRIPTION_MAX_CHARACTERISTICS 16
+#endif
+
+/**
+ * @brief Cache of the Client Characteristic Configuration Descriptor (CCCD)
+ * state of each connection.
+ *
+ * @details For each connection, a bitmap records the characteristics for
+ * which the peer has enabled notifications or indications; characteristics
+ * are assigned a bit the first time a peer subscribes to them.
+ *
+ * When the table runs out of connection or characteristic slots, the
+ * subscriptions which cannot be recorded are reported conservatively: a
+ * characteristic which isn't tracked is considered to have subscribers.
+ */
+class GattSubscriptionTable {
+public:
+    /**
+     * Maximum number of connections tracked.
+     */
+    static const uint8_t MAX_CONNECTIONS     = YOTTA_CFG_BLE_GATT_SERVER_SUBSCRIPTION_MAX_CONNECTIONS;
+    /**
+     * Maximum number of characteristics tracked.
+     */
+    static const uint8_t MAX_CHARACTERISTICS = YOTTA_CFG_BLE_GATT_SERVER_SUBSCRIPTION_MAX_CHARACTERISTICS;
+
+    GattSubscriptionTable() {
+        clear();
+    }
+
+    /**
+     * Record the CCCD state of a characteristic for a connection.
+     *
+     * @param[in] connectionHandle
+     *              The connection which wrote the CCCD.
+     * @param[in] valueHandle
+     *              Value handle of the characteristic.
+     * @param[in] enabled
+     *              true if notifications or indications have been enabled.
+     *
+     * @return BLE_ERROR_NONE on success or BLE_ERROR_NO_MEM if the
+     *         subscription could not be recorded.
+     */
+    ble_error_t setSubscribed(Gap::Handle_t connectionHandle, GattAttribute::Handle_t valueHandle, bool enabled) {
+        int characteristic = indexOfCharacteristic(valueHandle);
+        int connection     = indexOfConnection(connectionHandle);
+
+        if (!enabled) {
+            if ((characteristic >= 0) && (connection >= 0)) {
+                connections[connection].subscriptions &= ~(1UL << characteristic);
+            }
+            return BLE_ERROR_NONE;
+        }
+
+        if (characteristic < 0) {
+            if (characteristicCount == MAX_CHARACTERISTICS) {
+                untrackedCharacteristics = true;
+                return BLE_ERROR_NO_MEM;
+            }
+            characteristic = characteristicCount;
+            characteristics[characteristicCount++] = valueHandle;
+        }
+
+        if (connection < 0) {
+            connection = indexOfConnection(Gap::Handle_t(0), false);
+            if (connection < 0) {
+                untrackedConnections |= (1UL << characteristic);
+                return BLE_ERROR_NO_MEM;
+            }
+            connections[connection].inUse         = true;
+            connections[connection].handle        = connectionHandle;
+            connections[connection].subscriptions = 0;
+        }
+
+        connections[connection].subscriptions |= (1UL << characteristic);
+        return BLE_ERROR_NONE;
+    }
+
+    /**
+     * Check whether a connection has subscribed to a characteristic.
+     */
+    bool isSubscribed(Gap::Handle_t connectionHandle, GattAttribute::Handle_t valueHandle) const {
+        int characteristic = indexOfCharacteristic(valueHandle);
+        if (characteristic < 0) {
+            return untrackedCharacteristics;
+        }
+
+        int connection = indexOfConnection(connectionHandle);
+        if (connection < 0) {
+            return (untrackedConnections & (1UL << characteristic)) != 0;
+        }
+
+        return (connections[connection].subscriptions & (1UL << characteristic)) != 0;
+    }
+
+    /**
+     * Check whether any connection has subscribed to a characteristic.
+     */
+    bool hasSubscribers(GattAttribute::Handle_t valueHandle) const {
+        int characteristic = indexOfCharacteristic(valueHandle);
+        if (characteristic < 0) {
+            return untrackedCharacteristics;
+        }
+
+        uint32_t mask = untrackedConnections;
+        for (uint8_t i = 0; i < MAX_CONNECTIONS; ++i) {
+            if (connections[i].inUse) {
+                mask |= connections[i].subscriptions;
+            }
+        }
+
+        return (mask & (1UL << characteristic)) != 0;
+    }
+
+    /**
+     * Get the connections which have subscribed to a characteristic.
+     *
+     * @param[in]  valueHandle
+     *               Value handle of the characteristic.
+     * @param[out] connectionHandles
+     *               Array receiving the handles of the subscribed connections.
+     * @param[in]  maxConnections
+     *               Size of @p connectionHandles.
+     *
+     * @return The number of connections written in @p connectionHandles.
+     *
+     * @note Only recorded subscriptions are returned. hasUntrackedSubscribers()
+     *       tells whether some to this characteristic could not be recorded.
+     */
+    uint8_t getSubscribers(GattAttribute::Handle_t valueHandle, Gap::Handle_t *connectionHandles, uint8_t maxConnections) const {
+        int     characteristic = indexOfCharacteristic(valueHandle);
+        uint8_t count          = 0;
+
+        if (characteristic < 0) {
+            return 0;
+        }
+
+        for (uint8_t i = 0; (i < MAX_CONNECTIONS) && (count < maxConnections); ++i) {
+            if (connections[i].inUse && (connections[i].subscriptions & (1UL << characteristic))) {
+                connectionHandles[count++] = connections[i].handle;
+            }
+        }
+
+        return count;
+    }
+
+    /**
+     * Check whether some subscriptions to a characteristic could not be
+     * recorded, in which case getSubscribers() doesn't return all of them.
+     */
+    bool hasUntrackedSubscribers(GattAttribute::Handle_t valueHandle) const {
+        int characteristic = indexOfCharacteristic(valueHandle);
+        if (characteristic < 0) {
+            return untrackedCharacteristics;
+        }
+
+        return (untrackedConnections & (1UL << characteristic)) != 0;
+    }
+
+    /**
+     * Check whether every subscription reported to the table has been
+     * recorded.
+     */
+    bool isComplete(void) const {
+        return !untrackedCharacteristics && (untrackedConnections == 0);
+    }
+
+    /**
+     * Forget the subscriptions of a connection; to be called when it
+     * terminates.
+     */
+    void removeConnection(Gap::Handle_t connectionHandle) {
+        int connection = indexOfConnection(connectionHandle);
+        if (connection >= 0) {
+            connections[connection].inUse = false;
+        }
+    }
+
+    /**
+     * Forget all subscriptions.
+     */
+    void clear(void) {
+        characteristicCount      = 0;
+        untrackedCharacteristics = false;
+        untrackedConnections     = 0;
+        for (uint8_t i = 0; i < MAX_CONNECTIONS; ++i) {
+            connections[i].inUse = false;
+        }
+    }
+
+private:
+    int indexOfCharacteristic(GattAttribute::Handle_t valueHandle) const {
+        for (uint8_t i = 0; i < characteristicCount; ++i) {
+            if (characteristics[i] == valueHandle) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    int indexOfConnection(Gap::Handle_t connectionHandle, bool inUse = true) const {
+        for (uint8_t i = 0; i < MAX_CONNECTIONS; ++i) {
+            if (connections[i].inUse != inUse) {
+                continue;
+            }
+            if (!inUse || (connections[i].handle == connectionHandle)) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    /* Subscriptions are stored in 32-bit masks. */
+    typedef char MaxCharacteristicsCheck_t[(MAX_CHARACTERISTICS <= 32) ? 1 : -1];
+
+private:
+    struct Connection_t {
+        bool          inUse;
+        Gap::Handle_t handle;
+        uint32_t      subscriptions; /**< Bit i is set if subscribed to characteristics[i]. */
+    };
+
+    /**
+     * Value handles of the tracked characteristics.
+     */
+    GattAttribute::Handle_t characteristics[MAX_CHARACTERISTICS];
+    /**
+     * Number of tracked characteristics.
+     */
+    uint8_t                 characteristicCount;
+    /**
+     * Subscription state of the tracked connections.
+     */
+    Connection_t            connections[MAX_CONNECTIONS];
+    /**
+     * Set when a subscription to a characteristic could not be recorded for
+     * lack of characteristic slots.
+     */
+    bool                    untrackedCharacteristics;
+    /**
+     * Bit i is set when a subscription to characteristics[i] could not be
+     * recorded for lack of connection slots.
+     */
+    uint32_t                untrackedConnections;
+};
+
+#endif /* ifndef __GATT_SUBSCRIPTION_TABLE_H__ */
@@ -0,0 +1,237 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __GATT_UPDATE_COALESCER_H__
+#define __GATT_UPDATE_COALESCER_H__
+
+#include "Gap.h"
+#include "GattServer.h"
+
+#ifndef YOTTA_CFG_BLE_GATT_COALESCER_MAX_CHARACTERISTICS
+/**
+ * Default number of characteristics whose updates can be coalesced.
+ */
+#define YOTTA_CFG_BLE_GATT_COALESCER_MAX_CHARACTERISTICS 8
+#endif
+
+#ifndef YOTTA_CFG_BLE_GATT_COALESCER_MAX_VALUE_SIZE
+/**
+ * Default size of the largest value which can be coalesced; updates of larger
+ * values are written through.
+ */
+#define YOTTA_CFG_BLE_GATT_COALESCER_MAX_VALUE_SIZE 8
+#endif
+
+/**
+ * @brief Coalesce the updates of frequently sampled characteristic values.
+ *
+ * @details Sensors are often sampled faster than the connection interval, and
+ * consecutive samples are often equal. Values passed to update() are held by
+ * the coalescer, which only keeps the latest one per characteristic; they are
+ * written to the GattServer by flush(), ideally once per connection event. An
+ * update equal to the value last written, or within the deadband configured
+ * for the characteristic, is suppressed.
+ *
+ * flush() is called on each radio notification once the coalescer has been
+ * attached to Gap through attach(); if radio notifications aren't supported,
+ * or are used for something else, the application has to call flush()
+ * periodically, for instance from an event posted at the connection interval.
+ *
+ * The coalescer isn't interrupt safe: update() and flush() must be called from
+ * the same thread context, and the radio notifications must therefore be
+ * delivered through BLE::processEvents() rather than from interrupt context.
+ *
+ * Characteristics are registered on their first update, or through
+ * setDeadband(). When no slot is left, or the value is too large, updates are
+ * written through to the GattServer.
+ */
+class GattUpdateCoalescer {
+public:
+    /**
+     * Maximum number of characteristics coalesced.
+     */
+    static const uint8_t MAX_CHARACTERISTICS = YOTTA_CFG_BLE_GATT_COALESCER_MAX_CHARACTERISTICS;
+    /**
+     * Size of the largest value which can be coalesced.
+     */
+    static const uint8_t MAX_VALUE_SIZE      = YOTTA_CFG_BLE_GATT_COALESCER_MAX_VALUE_SIZE;
+
+    /**
+     * Encoding of a characteristic value, used to apply a deadband. Values
+     * are little endian, as mandated for GATT.
+     */
+    enum ValueFormat_t {
+        FORMAT_NONE,   /**< Opaque value: only identical updates are suppressed. */
+        FORMAT_UINT8,
+        FORMAT_SINT8,
+        FORMAT_UINT16,
+        FORMAT_SINT16,
+        FORMAT_UINT32,
+        FORMAT_SINT32
+    };
+
+public:
+    /**
+     * Construct a coalescer writing to a GattServer.
+     *
+     * @param[in] server
+     *              The GattServer holding the characteristics.
+     */
+    GattUpdateCoalescer(GattServer &server) : gattServer(server) {
+        clear();
+    }
+
+    /**
+     * Attach the coalescer to the radio notifications of Gap, so that
+     * pending updates are flushed ahead of each radio activity.
+     *
+     * @param[in] gap
+     *              The Gap instance of the BLE device.
+     *
+     * @return BLE_ERROR_NONE on success, or the error returned by
+     *         Gap::initRadioNotification() if radio notifications aren't
+     *         available.
+     *
+     * @note This replaces the radio notification callback registered in Gap.
+     *
+     * @note The port must deliver the radio notifications through
+     *       BLE::processEvents(), in the thread context updates are made in.
+     */
+    ble_error_t attach(Gap &gap);
+
+    /**
+     * Set the deadband of a characteristic: updates whose difference with the
+     * value last written is strictly lower than @p threshold are suppressed.
+     *
+     * @param[in] valueHandle
+     *              Value handle of the characteristic.
+     * @param[in] format
+     *              Encoding of the value. FORMAT_NONE removes the deadband.
+     * @param[in] threshold
+     *              Smallest difference, in units of the encoded value, which
+     *              is reported to the peers.
+     *
+     * @return BLE_ERROR_NONE on success or BLE_ERROR_NO_MEM if no slot is
+     *         available for the characteristic.
+     */
+    ble_error_t setDeadband(GattAttribute::Handle_t valueHandle, ValueFormat_t format, uint32_t threshold);
+
+    /**
+     * Update the value of a characteristic. The value is copied and written
+     * on the next flush(), unless it is suppressed or superseded by a later
+     * update.
+     *
+     * @param[in] valueHandle
+     *              Value handle of the characteristic.
+     * @param[in] value
+     *              The new value.
+     * @param[in] size
+     *              Size of the new value, in bytes.
+     *
+     * @return BLE_ERROR_NONE if the update has been queued or suppressed; the
+     *         result of the GattServer write if it has been written through.
+     */
+    ble_error_t update(GattAttribute::Handle_t valueHandle, const uint8_t *value, uint16_t size);
+
+    /**
+     * Write the pending updates to the GattServer.
+     *
+     * @return BLE_ERROR_NONE on success, or the first error returned by the
+     *         GattServer. Updates which could not be written for lack of
+     *         buffers are retried on the next flush.
+     */
+    ble_error_t flush(void);
+
+    /**
+     * Write the pending update of a single characteristic.
+     *
+     * @param[in] valueHandle
+     *              Value handle of the characteristic.
+     *
+     * @return BLE_ERROR_NONE if nothing was pending or the write succeeded,
+     *         the error returned by the GattServer otherwise.
+     */
+    ble_error_t flush(GattAttribute::Handle_t valueHandle);
+
+    /**
+     * Check whether updates are waiting for a flush.
+     */
+    bool hasPendingUpdates(void) const;
+
+    /**
+     * Stop coalescing the updates of a characteristic; a pending update is
+     * discarded.
+     */
+    void remove(GattAttribute::Handle_t valueHandle);
+
+    /**
+     * Forget all characteristics and pending updates; to be called when the
+     * GattServer is reset.
+     */
+    void clear(void);
+
+    /**
+     * Radio notification handler; pending updates are flushed when the radio
+     * is about to become active.
+     *
+     * @param[in] radioActive
+     *              true when the radio is about to become active.
+     */
+    void processRadioNotification(bool radioActive) {
+        if (radioActive) {
+            flush();
+        }
+    }
+
+private:
+    struct Slot_t {
+        bool                    inUse;
+        bool                    hasWritten;    /**< Set once a value has been written. */
+        bool                    pending;       /**< Set when latestValue awaits a flush. */
+        GattAttribute::Handle_t valueHandle;
+        ValueFormat_t           format;
+        uint32_t                threshold;
+        uint8_t                 writtenLength;
+        uint8_t                 latestLength;
+        uint8_t                 writtenValue[MAX_VALUE_SIZE];
+        uint8_t                 latestValue[MAX_VALUE_SIZE];
+    };
+
+    Slot_t *find(GattAttribute::Handle_t valueHandle);
+    Slot_t *acquire(GattAttribute::Handle_t valueHandle);
+    bool isSuppressed(const Slot_t &slot, const uint8_t *value, uint16_t size) const;
+    ble_error_t flushSlot(Slot_t &slot);
+
+    static int64_t decode(ValueFormat_t format, const uint8_t *value);
+    static uint8_t getFormatSize(ValueFormat_t format);
+
+private:
+    /**
+     * The GattServer the updates are written to.
+     */
+    GattServer &gattServer;
+    /**
+     * Coalescing state of each characteristic.
+     */
+    Slot_t      slots[MAX_CHARACTERISTICS];
+
+private:
+    /* Disallow copy and assignment. */
+    GattUpdateCoalescer(const GattUpdateCoalescer &);
+    GattUpdateCoalescer& operator=(const GattUpdateCoalescer &);
+};
+
+#endif /* ifndef __GATT_UPDATE_COALESCER_H__ */
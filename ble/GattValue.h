@@ -0,0 +1,245 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __GATT_VALUE_H__
+#define __GATT_VALUE_H__
+
+#include <stdint.h>
+#include <string.h>
+
+#include "GattCharacteristic.h"
+#include "GattServer.h"
+
+/**
+ * @brief Serialization of a characteristic value of type T.
+ *
+ * @details The generic codec copies the object representation of T. Integer
+ * types are specialized below to be serialized in little endian, as mandated
+ * for GATT, whatever the endianness of the target. Applications may
+ * specialize GattValueCodec for their own types; a codec provides a SIZE
+ * constant and static encode() and decode() functions.
+ */
+template <typename T>
+struct GattValueCodec {
+    /**
+     * Size of the serialized value, in bytes.
+     */
+    static const uint16_t SIZE = sizeof(T);
+
+    static void encode(const T &value, uint8_t *buffer) {
+        memcpy(buffer, &value, sizeof(T));
+    }
+
+    static void decode(const uint8_t *buffer, T &value) {
+        memcpy(&value, buffer, sizeof(T));
+    }
+};
+
+/**
+ * Little endian codec of the integer type T, whose unsigned counterpart is
+ * UT.
+ */
+template <typename T, typename UT>
+struct GattIntegerValueCodec {
+    static const uint16_t SIZE = sizeof(T);
+
+    static void encode(const T &value, uint8_t *buffer) {
+        UT bits = (UT)value;
+        for (uint16_t i = 0; i < SIZE; ++i) {
+            buffer[i] = (uint8_t)(bits >> (8 * i));
+        }
+    }
+
+    static void decode(const uint8_t *buffer, T &value) {
+        UT bits = 0;
+        for (uint16_t i = 0; i < SIZE; ++i) {
+            bits |= (UT)((UT)buffer[i] << (8 * i));
+        }
+        value = (T)bits;
+    }
+};
+
+template <> struct GattValueCodec<uint16_t> : GattIntegerValueCodec<uint16_t, uint16_t> {};
+template <> struct GattValueCodec<int16_t>  : GattIntegerValueCodec<int16_t,  uint16_t> {};
+template <> struct GattValueCodec<uint32_t> : GattIntegerValueCodec<uint32_t, uint32_t> {};
+template <> struct GattValueCodec<int32_t>  : GattIntegerValueCodec<int32_t,  uint32_t> {};
+template <> struct GattValueCodec<uint64_t> : GattIntegerValueCodec<uint64_t, uint64_t> {};
+template <> struct GattValueCodec<int64_t>  : GattIntegerValueCodec<int64_t,  uint64_t> {};
+
+/**
+ * @brief Typed handle on the value of a characteristic.
+ *
+ * @details A GattValue holds the serialized value of a characteristic; its
+ * size is known at compile time. When its buffer is used as the value memory
+ * of the characteristic, stacks which support user-owned attribute memory
+ * (refer to GattServer::updateInPlace()) notify updates without copying the
+ * value; other stacks fall back to GattServer::write().
+ *
+ * Typical use, the GattValue being declared before the characteristic:
+ *
+ * @code
+ * GattValue<uint16_t> level;
+ * GattCharacteristic  levelCharacteristic(uuid, level.getBuffer(), level.SIZE, level.SIZE,
+ *                                         GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ |
+ *                                         GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY);
+ *
+ * // Once the service has been added:
+ * level.bind(ble.gattServer(), levelCharacteristic);
+ * level.set(42);
+ * @endcode
+ */
+template <typename T, typename Codec = GattValueCodec<T> >
+class GattValue {
+public:
+    /**
+     * Size of the serialized value, in bytes.
+     */
+    static const uint16_t SIZE = Codec::SIZE;
+
+public:
+    /**
+     * Construct a value handle; it has to be bound to its characteristic
+     * before updates can be sent.
+     *
+     * @param[in] initialValue
+     *              The initial value.
+     */
+    GattValue(const T &initialValue = T()) : gattServer(NULL), characteristic(NULL), inPlace(false) {
+        Codec::encode(initialValue, buffer);
+    }
+
+    /**
+     * Bind the handle to its characteristic, once the service holding it
+     * has been added to the GattServer.
+     *
+     * @param[in] server
+     *              The GattServer holding the characteristic.
+     * @param[in] valueCharacteristic
+     *              The characteristic.
+     */
+    void bind(GattServer &server, GattCharacteristic &valueCharacteristic) {
+        gattServer     = &server;
+        characteristic = &valueCharacteristic;
+        inPlace        = (valueCharacteristic.getValueAttribute().getValuePtr() == buffer);
+    }
+
+    /**
+     * Get the buffer holding the serialized value, to be used as the value
+     * memory of the characteristic.
+     */
+    uint8_t *getBuffer(void) {
+        return buffer;
+    }
+
+    /**
+     * Get the current value.
+     */
+    T get(void) const {
+        T value;
+        Codec::decode(buffer, value);
+        return value;
+    }
+
+    /**
+     * Update the value and notify or indicate it to the peers which have
+     * subscribed to it.
+     *
+     * @param[in] value
+     *              The new value.
+     *
+     * @return BLE_ERROR_NONE on success, BLE_ERROR_INVALID_STATE if the handle
+     *         isn't bound, or the error reported by the GattServer.
+     */
+    ble_error_t set(const T &value) {
+        Codec::encode(value, buffer);
+        return commit(false);
+    }
+
+    /**
+     * Update the value on the local GattServer only; no notification or
+     * indication is sent.
+     *
+     * @param[in] value
+     *              The new value.
+     *
+     * @return BLE_ERROR_NONE on success, BLE_ERROR_INVALID_STATE if the handle
+     *         isn't bound, or the error reported by the GattServer.
+     */
+    ble_error_t setLocal(const T &value) {
+        Codec::encode(value, buffer);
+        return commit(true);
+    }
+
+    /**
+     * Reload the value from the GattServer, after it has been written by a
+     * peer.
+     *
+     * @return BLE_ERROR_NONE on success, BLE_ERROR_INVALID_STATE if the handle
+     *         isn't bound, or the error reported by the GattServer.
+     */
+    ble_error_t fetch(void) {
+        if (characteristic == NULL) {
+            return BLE_ERROR_INVALID_STATE;
+        }
+
+        uint16_t length = SIZE;
+        return gattServer->read(characteristic->getValueHandle(), buffer, &length);
+    }
+
+private:
+    ble_error_t commit(bool localOnly) {
+        if (characteristic == NULL) {
+            return BLE_ERROR_INVALID_STATE;
+        }
+
+        GattAttribute::Handle_t handle = characteristic->getValueHandle();
+        if (!localOnly) {
+            localOnly = !gattServer->hasSubscribers(handle);
+        }
+
+        if (inPlace) {
+            ble_error_t err = gattServer->updateInPlace(handle, SIZE, localOnly);
+            if (err != BLE_ERROR_NOT_IMPLEMENTED) {
+                return err;
+            }
+            /* The stack keeps its own copy of the value; stop trying. */
+            inPlace = false;
+        }
+
+        return gattServer->write(handle, buffer, SIZE, localOnly);
+    }
+
+private:
+    /**
+     * Serialized value.
+     */
+    uint8_t             buffer[SIZE];
+    /**
+     * The GattServer holding the characteristic; NULL until bound.
+     */
+    GattServer         *gattServer;
+    /**
+     * The characteristic whose value is handled; NULL until bound.
+     */
+    GattCharacteristic *characteristic;
+    /**
+     * Set when the characteristic references buffer as its value memory and
+     * the stack may update it in place.
+     */
+    bool                inPlace;
+};
+
+#endif /* ifndef __GATT_VALUE_H__ */
@@ -0,0 +1,146 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __LOCK_FREE_RING_BUFFER_H__
+#define __LOCK_FREE_RING_BUFFER_H__
+
+#include <stdint.h>
+
+/**
+ * BLE_MEMORY_BARRIER() orders the accesses to the ring storage with respect
+ * to the updates of its indexes. It may be defined by the target when the
+ * toolchain isn't recognized below.
+ */
+#ifndef BLE_MEMORY_BARRIER
+#if defined(__CC_ARM)
+#define BLE_MEMORY_BARRIER() __dmb(0xF)
+#elif defined(__ICCARM__)
+#include <intrinsics.h>
+#define BLE_MEMORY_BARRIER() __DMB()
+#elif defined(__GNUC__)
+#define BLE_MEMORY_BARRIER() __sync_synchronize()
+#else
+#error "BLE_MEMORY_BARRIER() must be defined for this toolchain"
+#endif
+#endif
+
+/**
+ * @brief Bounded single-producer/single-consumer queue which needs no lock.
+ *
+ * @details One context, typically the interrupt handler of the BLE stack,
+ * pushes items while another one, typically the thread calling
+ * BLE::processEvents(), pops them. Each index is written by a single side:
+ * the producer owns head and the consumer owns tail. Both are free running
+ * counters; CAPACITY has to be a power of two so that they wrap consistently.
+ *
+ * @note Using the same side from two contexts at once (two producers, for
+ *       instance) is not supported.
+ */
+template <typename T, unsigned CAPACITY>
+class LockFreeRingBuffer {
+public:
+    LockFreeRingBuffer() : head(0), tail(0) {
+    }
+
+    /**
+     * Push an item; producer side.
+     *
+     * @param[in] item
+     *              The item to copy into the ring.
+     *
+     * @return true if the item has been pushed, false if the ring is full.
+     */
+    bool push(const T &item) {
+        uint32_t position = head;
+        if ((uint32_t)(position - tail) == CAPACITY) {
+            return false;
+        }
+
+        storage[position & MASK] = item;
+        BLE_MEMORY_BARRIER(); /* Publish the item before the index. */
+        head = position + 1;
+        return true;
+    }
+
+    /**
+     * Pop the oldest item; consumer side.
+     *
+     * @param[out] item
+     *              Receives the item.
+     *
+     * @return true if an item has been popped, false if the ring is empty.
+     */
+    bool pop(T &item) {
+        uint32_t position = tail;
+        if (position == head) {
+            return false;
+        }
+
+        BLE_MEMORY_BARRIER(); /* Read the item after its index. */
+        item = storage[position & MASK];
+        BLE_MEMORY_BARRIER(); /* Release the slot after the copy. */
+        tail = position + 1;
+        return true;
+    }
+
+    /**
+     * Get the number of items in the ring. The result is exact from the
+     * consumer side and an upper bound from the producer side.
+     */
+    unsigned size(void) const {
+        return (uint32_t)(head - tail);
+    }
+
+    bool isEmpty(void) const {
+        return head == tail;
+    }
+
+    bool isFull(void) const {
+        return size() == CAPACITY;
+    }
+
+    /**
+     * Get the maximum number of items in the ring.
+     */
+    static unsigned getCapacity(void) {
+        return CAPACITY;
+    }
+
+    /**
+     * Discard all items; consumer side.
+     */
+    void clear(void) {
+        tail = head;
+    }
+
+private:
+    static const uint32_t MASK = CAPACITY - 1;
+
+    /* The indexes wrap consistently only if CAPACITY is a power of two. */
+    typedef char CapacityCheck_t[((CAPACITY != 0) && ((CAPACITY & (CAPACITY - 1)) == 0)) ? 1 : -1];
+
+private:
+    T                 storage[CAPACITY];
+    volatile uint32_t head; /**< Count of items pushed; written by the producer only. */
+    volatile uint32_t tail; /**< Count of items popped; written by the consumer only. */
+
+private:
+    /* Disallow copy and assignment. */
+    LockFreeRingBuffer(const LockFreeRingBuffer &);
+    LockFreeRingBuffer& operator=(const LockFreeRingBuffer &);
+};
+
+#endif /* ifndef __LOCK_FREE_RING_BUFFER_H__ */
@@ -0,0 +1,243 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __RPA_RESOLVER_H__
+#define __RPA_RESOLVER_H__
+
+#include <stdint.h>
+
+#include "blecommon.h"
+#include "BLEProtocol.h"
+#include "TimeSource.h"
+#include "CryptoBackend.h"
+
+#ifndef YOTTA_CFG_BLE_RPA_RESOLVER_MAX_IDENTITIES
+/**
+ * Default number of peer identities (IRK and identity address) an
+ * RPAResolver can hold.
+ */
+#define YOTTA_CFG_BLE_RPA_RESOLVER_MAX_IDENTITIES 8
+#endif
+
+#ifndef YOTTA_CFG_BLE_RPA_RESOLVER_CACHE_SIZE
+/**
+ * Default number of resolvable private addresses whose resolution, positive
+ * or negative, an RPAResolver remembers.
+ */
+#define YOTTA_CFG_BLE_RPA_RESOLVER_CACHE_SIZE 16
+#endif
+
+#ifndef YOTTA_CFG_BLE_RPA_ROTATION_PERIOD
+/**
+ * Default period, in seconds, after which peers are expected to have
+ * rotated their resolvable private address; the Core specification
+ * recommends 15 minutes.
+ */
+#define YOTTA_CFG_BLE_RPA_ROTATION_PERIOD 900
+#endif
+
+/**
+ * @brief Resolver of resolvable private addresses (RPA) against the identity
+ * resolving keys (IRK) of known peers, with a cache of recent resolutions.
+ *
+ * @details Resolving an address costs one AES-128 encryption per known
+ * identity, which is prohibitive when done for every advertisement report.
+ * The resolver therefore remembers, for the last CACHE_SIZE addresses seen,
+ * the identity they resolved to or the fact that none matched. An entry
+ * expires once its address hasn't been seen for the rotation period, since
+ * its owner has then moved to a new address; when the cache is full, the
+ * least recently used entry is replaced. Negative entries are dropped when an
+ * identity is added, and the entries of an identity when it is removed.
+ *
+ * Entries only expire once a clock has been given; addresses are otherwise
+ * only evicted when the cache is full. The clock is expected to be read more
+ * often than it wraps, which holds as long as reports are received.
+ *
+ * Attach the resolver to Gap with Gap::setRPAResolver() to get the identity
+ * of peers in AdvertisementCallbackParams_t and ConnectionCallbackParams_t.
+ */
+class RPAResolver {
+public:
+    /**
+     * Size of an identity resolving key.
+     */
+    static const unsigned IRK_SIZE = 16;
+
+    /**
+     * Identity resolving key, in the byte order in which it is distributed
+     * over the air (least significant octet first, as addresses).
+     */
+    typedef uint8_t IRK_t[IRK_SIZE];
+
+    /**
+     * Maximum number of identities.
+     */
+    static const unsigned MAX_IDENTITIES = YOTTA_CFG_BLE_RPA_RESOLVER_MAX_IDENTITIES;
+    /**
+     * Number of addresses cached.
+     */
+    static const unsigned CACHE_SIZE     = YOTTA_CFG_BLE_RPA_RESOLVER_CACHE_SIZE;
+
+public:
+    /**
+     * Construct a resolver.
+     *
+     * @param[in] crypto
+     *              The AES-128 implementation; typically the one set with
+     *              SecurityManager::setCryptoBackend().
+     * @param[in] timeSource
+     *              Clock expiring cache entries; entries don't expire if it
+     *              is NULL.
+     * @param[in] rotationPeriod
+     *              Time, in seconds, after which an address which hasn't
+     *              been seen expires; at most 4294.
+     */
+    RPAResolver(CryptoBackend &crypto,
+                TimeSource_t   timeSource     = NULL,
+                uint32_t       rotationPeriod = YOTTA_CFG_BLE_RPA_ROTATION_PERIOD);
+
+    /**
+     * Add the identity of a peer, or update its IRK.
+     *
+     * @param[in] irk
+     *              The IRK distributed by the peer.
+     * @param[in] type
+     *              Type of the identity address: PUBLIC or RANDOM_STATIC.
+     * @param[in] address
+     *              The identity address distributed by the peer.
+     *
+     * @return BLE_ERROR_NONE on success, BLE_ERROR_INVALID_PARAM if @p type
+     *         isn't an identity address type or BLE_ERROR_NO_MEM if
+     *         MAX_IDENTITIES are already held.
+     */
+    ble_error_t addIdentity(const IRK_t irk, BLEProtocol::AddressType_t type, const BLEProtocol::AddressBytes_t address);
+
+    /**
+     * Remove the identity of a peer; its cached resolutions are dropped.
+     *
+     * @return BLE_ERROR_NONE on success or BLE_ERROR_INVALID_PARAM if the
+     *         identity isn't known.
+     */
+    ble_error_t removeIdentity(BLEProtocol::AddressType_t type, const BLEProtocol::AddressBytes_t address);
+
+    /**
+     * Remove all identities and flush the cache.
+     */
+    void clear(void);
+
+    /**
+     * Drop all the cached resolutions.
+     */
+    void flushCache(void);
+
+    /**
+     * Resolve an address against the identities held.
+     *
+     * @param[in]  address
+     *               The address to resolve.
+     * @param[out] identityType
+     *               Receives the type of the identity address, if resolved.
+     * @param[out] identityAddress
+     *               Receives the identity address, if resolved.
+     *
+     * @return true if @p address is a resolvable private address generated
+     *         with the IRK of one of the identities, false otherwise.
+     */
+    bool resolve(const BLEProtocol::AddressBytes_t  address,
+                 BLEProtocol::AddressType_t        &identityType,
+                 BLEProtocol::AddressBytes_t        identityAddress);
+
+    /**
+     * Get the number of identities held.
+     */
+    unsigned getIdentityCount(void) const {
+        return identityCount;
+    }
+
+    /**
+     * Get the number of resolutions answered from the cache.
+     */
+    uint32_t getCacheHitCount(void) const {
+        return cacheHits;
+    }
+
+    /**
+     * Get the number of resolutions which required AES computations.
+     */
+    uint32_t getCacheMissCount(void) const {
+        return cacheMisses;
+    }
+
+    /**
+     * Check whether an address has the format of a resolvable private
+     * address: its two most significant bits are 0b01.
+     */
+    static bool isResolvable(const BLEProtocol::AddressBytes_t address) {
+        return (address[BLEProtocol::ADDR_LEN - 1] & 0xC0) == 0x40;
+    }
+
+    /**
+     * Check whether a resolvable private address has been generated from an
+     * IRK, i.e. whether its hash equals ah(IRK, prand).
+     */
+    static bool matches(CryptoBackend &crypto, const IRK_t irk, const BLEProtocol::AddressBytes_t address);
+
+private:
+    /**
+     * Special values of CacheEntry_t::identity.
+     */
+    static const uint8_t ENTRY_UNUSED = 0xFF;
+    static const uint8_t NO_IDENTITY  = 0xFE;
+
+    struct Identity_t {
+        IRK_t                       irk;
+        BLEProtocol::AddressType_t  type;
+        BLEProtocol::AddressBytes_t address;
+    };
+
+    struct CacheEntry_t {
+        BLEProtocol::AddressBytes_t address;
+        uint8_t                     identity; /**< Index in identities, NO_IDENTITY or ENTRY_UNUSED. */
+        uint32_t                    lastSeen; /**< Time of the last resolution, for expiry. */
+        uint32_t                    lastUse;  /**< Value of useCounter at the last resolution, for replacement. */
+    };
+
+    int findIdentity(BLEProtocol::AddressType_t type, const BLEProtocol::AddressBytes_t address) const;
+    bool isExpired(const CacheEntry_t &entry, uint32_t now) const;
+    CacheEntry_t &allocateEntry(uint32_t now);
+    void dropEntries(uint8_t identity);
+
+    /* Identity indexes must not collide with the special values. */
+    typedef char MaxIdentitiesCheck_t[(MAX_IDENTITIES < NO_IDENTITY) ? 1 : -1];
+
+private:
+    CryptoBackend  &crypto;
+    TimeSource_t    timeSource;
+    uint32_t        expiry;      /**< Rotation period, in microseconds. */
+    uint32_t        useCounter;
+    uint32_t        cacheHits;
+    uint32_t        cacheMisses;
+    unsigned        identityCount;
+    Identity_t      identities[MAX_IDENTITIES];
+    CacheEntry_t    cache[CACHE_SIZE];
+
+private:
+    /* Disallow copy and assignment. */
+    RPAResolver(const RPAResolver &);
+    RPAResolver& operator=(const RPAResolver &);
+};
+
+#endif /* ifndef __RPA_RESOLVER_H__ */
@@ -0,0 +1,241 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __RSSI_TRACKER_H__
+#define __RSSI_TRACKER_H__
+
+#include <stdint.h>
+
+#include "blecommon.h"
+#include "BLEProtocol.h"
+#include "AddressHashTable.h"
+#include "TimeSource.h"
+#include "FunctionPointerWithContext.h"
+
+/**
+ * @brief Smoothed signal strength and proximity of the advertisers in range.
+ *
+ * @details The RSSI of advertisement reports varies by several dB from one
+ * packet to the next. The tracker keeps, for each advertiser, an
+ * exponentially weighted moving average of its RSSI and the time it was last
+ * heard, in an AddressHashTable over slots provided by the application, so
+ * that the memory used is bounded and chosen by the application. When the
+ * table is full, the advertiser
+ * heard from least recently among a few neighbouring entries makes room.
+ *
+ * The distance of an advertiser is estimated with the log-distance path loss
+ * model from the RSSI expected at 1 meter: the TX power it advertises (AD
+ * type TX_POWER_LEVEL) less 41 dB, the free space loss at 1 meter on 2.4 GHz,
+ * or a default value. The region callback reports advertisers entering the
+ * region within the enter distance, and leaving it beyond the leave
+ * distance, which is larger to absorb the remaining noise; advertisers not
+ * heard from for the absence timeout leave the region and are forgotten by
+ * process().
+ *
+ * Attach the tracker to Gap with Gap::setRSSITracker() to feed it the
+ * advertisement reports accepted by the AddressFilter of Gap, if any.
+ * Advertisers whose address is resolved by the RPAResolver of Gap are
+ * tracked by their identity address.
+ */
+class RSSITracker {
+public:
+    /**
+     * Storage of an advertiser; the application allocates the slots.
+     */
+    struct Slot_t {
+        BLEProtocol::AddressBytes_t address;
+        int8_t                      referencePower; /**< RSSI expected at 1 meter, in dBm. */
+        uint8_t                     flags;
+        int16_t                     rssi;           /**< Smoothed RSSI, in 1/16 dBm. */
+        uint32_t                    lastSeen;
+    };
+
+    /**
+     * Advertiser entering or leaving the region, reported through
+     * onRegionEvent().
+     */
+    struct RegionEventCallbackParams_t {
+        BLEProtocol::AddressBytes_t address;
+        bool                        entered;  /**< False if it left the region. */
+        bool                        absent;   /**< It left the region because it wasn't heard from. */
+        int8_t                      rssi;     /**< Smoothed RSSI, in dBm. */
+        float                       distance; /**< Estimated distance, in meters. */
+    };
+    typedef FunctionPointerWithContext<const RegionEventCallbackParams_t *> RegionEventCallback_t;
+
+public:
+    /**
+     * Construct an empty tracker.
+     *
+     * @param[in] slots
+     *              The slots; they need not be initialized.
+     * @param[in] slotCount
+     *              Number of @p slots; a power of two, at least 4. The
+     *              tracker holds up to three quarters as many advertisers.
+     * @param[in] timeSource
+     *              Clock timing the absence of the advertisers; not NULL.
+     */
+    RSSITracker(Slot_t *slots, unsigned slotCount, TimeSource_t timeSource);
+
+    /**
+     * Set the weight of each report in the average, 1 / 2^@p shift; 1/8 by
+     * default. Lower weights smooth more and react more slowly.
+     *
+     * @return BLE_ERROR_NONE on success or BLE_ERROR_PARAM_OUT_OF_RANGE if
+     *         @p shift is larger than 7.
+     */
+    ble_error_t setSmoothing(uint8_t shift);
+
+    /**
+     * Set the RSSI expected at 1 meter from the advertisers which don't
+     * advertise their TX power; -59 dBm by default.
+     */
+    void setDefaultReferencePower(int8_t dBm) {
+        defaultReferencePower = dBm;
+    }
+
+    /**
+     * Set the region, by its enter and leave distances in meters, and the
+     * path loss exponent of the environment: 2 in free space, up to 4
+     * indoors; 2 and 3 meters with an exponent of 2 by default.
+     *
+     * @return BLE_ERROR_NONE on success or BLE_ERROR_PARAM_OUT_OF_RANGE if
+     *         the distances aren't positive and increasing, or the exponent
+     *         is outside [1, 6].
+     */
+    ble_error_t setRegion(float enterDistance, float leaveDistance, float pathLossExponent = 2.0f);
+
+    /**
+     * Set the time, in milliseconds, after which an advertiser not heard
+     * from leaves the region and is forgotten; 10 seconds by default. Longer
+     * timeouts than the time source can measure, about 71 minutes, are
+     * clamped to it.
+     */
+    void setAbsenceTimeout(uint32_t milliseconds) {
+        absenceTimeout = (milliseconds < 0xFFFFFFFF / 1000) ? (milliseconds * 1000) : 0xFFFFFFFF;
+    }
+
+    /**
+     * Account for an advertisement report.
+     *
+     * @param[in] address
+     *              Address of the advertiser.
+     * @param[in] rssi
+     *              RSSI of the report; 127, unavailable, is ignored.
+     * @param[in] advertisingDataLen
+     *              Length of @p advertisingData.
+     * @param[in] advertisingData
+     *              Payload of the report, searched for the TX power.
+     */
+    void processReport(const BLEProtocol::AddressBytes_t address,
+                       int8_t                            rssi,
+                       uint8_t                           advertisingDataLen,
+                       const uint8_t                    *advertisingData);
+
+    /**
+     * Forget the advertisers not heard from for the absence timeout, among
+     * up to @p slotCount slots following those checked by the previous call;
+     * call it often enough to visit all the slots within the timeout.
+     */
+    void process(unsigned slotCount = 64);
+
+    /**
+     * Get the smoothed RSSI of an advertiser.
+     *
+     * @return true if the advertiser is tracked, false otherwise.
+     */
+    bool getRSSI(const BLEProtocol::AddressBytes_t address, int8_t &rssi) const;
+
+    /**
+     * Get the estimated distance of an advertiser, in meters; negative if
+     * the advertiser isn't tracked.
+     */
+    float getDistance(const BLEProtocol::AddressBytes_t address) const;
+
+    /**
+     * Check whether an advertiser is in the region.
+     */
+    bool isInside(const BLEProtocol::AddressBytes_t address) const;
+
+    /**
+     * Get the number of advertisers tracked.
+     */
+    unsigned getSize(void) const {
+        return table.getSize();
+    }
+
+    /**
+     * Get the maximum number of advertisers tracked.
+     */
+    unsigned getCapacity(void) const {
+        return table.getCapacity();
+    }
+
+    /**
+     * Get the number of advertisers forgotten to make room since
+     * construction.
+     */
+    uint32_t getEvictionCount(void) const {
+        return evictions;
+    }
+
+    /**
+     * Set the callback reporting the advertisers entering or leaving the
+     * region.
+     */
+    void onRegionEvent(const RegionEventCallback_t &callback) {
+        regionCallback = callback;
+    }
+    template <typename T>
+    void onRegionEvent(T *objPtr, void (T::*memberPtr)(const RegionEventCallbackParams_t *)) {
+        regionCallback.attach(objPtr, memberPtr);
+    }
+
+private:
+    /**
+     * Value of Slot_t::flags, besides AddressHashTable::SLOT_USED.
+     */
+    enum {
+        SLOT_INSIDE = 0x02,
+    };
+
+    void evict(unsigned home, uint32_t now);
+    void leave(Slot_t &slot, bool absent);
+    void notify(const Slot_t &slot, bool entered, bool absent);
+    float estimateDistance(const Slot_t &slot) const;
+
+    static int8_t findTxPower(uint8_t advertisingDataLen, const uint8_t *advertisingData, bool &found);
+
+private:
+    AddressHashTable<Slot_t> table;
+    unsigned                 cursor;                /**< Next slot checked by process(). */
+    TimeSource_t             timeSource;
+    uint8_t                  smoothing;
+    int8_t                   defaultReferencePower;
+    int16_t                  enterLoss;             /**< Path loss at the enter distance, in 1/16 dB. */
+    int16_t                  leaveLoss;
+    float                    pathLossExponent;
+    uint32_t                 absenceTimeout;        /**< In microseconds. */
+    uint32_t                 evictions;
+    RegionEventCallback_t    regionCallback;
+
+private:
+    /* Disallow copy and assignment. */
+    RSSITracker(const RSSITracker &);
+    RSSITracker& operator=(const RSSITracker &);
+};
+
+#endif /* ifndef __RSSI_TRACKER_H__ */
@@ -0,0 +1,255 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SECURE_GATT_QUEUE_H__
+#define __SECURE_GATT_QUEUE_H__
+
+#include <stdint.h>
+
+#include "Gap.h"
+#include "GattClient.h"
+#include "SecurityManager.h"
+#include "TimeSource.h"
+
+#ifndef YOTTA_CFG_BLE_SECURE_GATT_QUEUE_MAX_LINKS
+/**
+ * Default number of links whose security state a SecureGattQueue tracks.
+ */
+#define YOTTA_CFG_BLE_SECURE_GATT_QUEUE_MAX_LINKS 4
+#endif
+
+#ifndef YOTTA_CFG_BLE_SECURE_GATT_QUEUE_MAX_OPERATIONS
+/**
+ * Default number of operations a SecureGattQueue can hold, for all links.
+ */
+#define YOTTA_CFG_BLE_SECURE_GATT_QUEUE_MAX_OPERATIONS 8
+#endif
+
+#ifndef YOTTA_CFG_BLE_SECURE_GATT_QUEUE_MAX_VALUE_SIZE
+/**
+ * Default size of the largest value a SecureGattQueue can hold for a write.
+ */
+#define YOTTA_CFG_BLE_SECURE_GATT_QUEUE_MAX_VALUE_SIZE 20
+#endif
+
+#ifndef YOTTA_CFG_BLE_SECURE_GATT_QUEUE_RESPONSE_TIMEOUT
+/**
+ * Default time, in microseconds, a SecureGattQueue waits for the response to
+ * a replayed request before issuing the next one.
+ */
+#define YOTTA_CFG_BLE_SECURE_GATT_QUEUE_RESPONSE_TIMEOUT 2000000
+#endif
+
+/**
+ * @brief GATT client operations held until their link is secured.
+ *
+ * @details Reading or writing an attribute which requires encryption over a
+ * link which isn't encrypted yet costs a round trip: the server answers with
+ * an insufficient authentication error, and the application has to set up
+ * security and try again. The queue tracks the security state of each link
+ * instead, and holds the operations which need a security mode the link
+ * hasn't reached: it requests the mode from the SecurityManager on their
+ * behalf, and issues them in order once the link is secured. Several
+ * operations can be queued while pairing is in progress; the application
+ * doesn't wait for it.
+ *
+ * Replayed requests are issued one at a time, each after the response to the
+ * previous one, as the Attribute Protocol allows a single outstanding request
+ * per link. The responses are reported by GattClient as usual; the operations
+ * which can't be issued, because security couldn't be set up at the mode
+ * they require, the link was lost or GattClient refused them, are reported
+ * through onFailure().
+ *
+ * GattClient doesn't report error responses, so a request the server
+ * rejects would hold the following ones forever. With a time source,
+ * process() is called periodically, every few hundred milliseconds; it
+ * reports the requests left without response for RESPONSE_TIMEOUT through
+ * onFailure() and issues the next ones.
+ */
+class SecureGattQueue {
+public:
+    /**
+     * Maximum number of links tracked.
+     */
+    static const unsigned MAX_LINKS      = YOTTA_CFG_BLE_SECURE_GATT_QUEUE_MAX_LINKS;
+    /**
+     * Maximum number of operations held.
+     */
+    static const unsigned MAX_OPERATIONS = YOTTA_CFG_BLE_SECURE_GATT_QUEUE_MAX_OPERATIONS;
+    /**
+     * Size of the largest value written.
+     */
+    static const unsigned MAX_VALUE_SIZE = YOTTA_CFG_BLE_SECURE_GATT_QUEUE_MAX_VALUE_SIZE;
+    /**
+     * Time, in microseconds, after which a replayed request is considered
+     * rejected.
+     */
+    static const uint32_t RESPONSE_TIMEOUT = YOTTA_CFG_BLE_SECURE_GATT_QUEUE_RESPONSE_TIMEOUT;
+
+    /**
+     * Security state of a link.
+     */
+    enum LinkState_t {
+        LINK_NOT_ENCRYPTED, /**< Security hasn't been set up, or failed. */
+        LINK_ENCRYPTING,    /**< A security procedure is in progress. */
+        LINK_ENCRYPTED,     /**< The link is encrypted. */
+    };
+
+    /**
+     * Operation which couldn't be issued.
+     */
+    struct FailureCallbackParams_t {
+        Gap::Handle_t                               connHandle;
+        GattAttribute::Handle_t                     attributeHandle;
+        bool                                        isWrite;
+        ble_error_t                                 error;  /**< BLE_ERROR_INVALID_STATE if the link was lost or couldn't be secured, BLE_ERROR_UNSPECIFIED if a replayed request got no response, the error of GattClient otherwise. */
+        SecurityManager::SecurityCompletionStatus_t status; /**< Outcome of the security procedure. */
+    };
+    typedef FunctionPointerWithContext<const FailureCallbackParams_t *> FailureCallback_t;
+
+public:
+    /**
+     * Construct a queue and register it with the events of @p gap,
+     * @p client and @p securityManager.
+     *
+     * @param[in] timeSource
+     *              Clock timing the responses to the replayed requests, or
+     *              NULL to wait for them until the link is lost.
+     */
+    SecureGattQueue(Gap &gap, GattClient &client, SecurityManager &securityManager, TimeSource_t timeSource = NULL);
+
+    /**
+     * Unregister from the events; the operations held are dropped silently.
+     */
+    ~SecureGattQueue();
+
+    /**
+     * Read an attribute over a link secured with at least @p requiredMode;
+     * see GattClient::read().
+     *
+     * @return BLE_ERROR_NONE if the read was issued or queued,
+     *         BLE_ERROR_NO_MEM if the queue is full, or the error of
+     *         GattClient or of SecurityManager::setLinkSecurity().
+     */
+    ble_error_t read(Gap::Handle_t                   connHandle,
+                     GattAttribute::Handle_t         attributeHandle,
+                     uint16_t                        offset,
+                     SecurityManager::SecurityMode_t requiredMode = SecurityManager::SECURITY_MODE_ENCRYPTION_NO_MITM);
+
+    /**
+     * Write an attribute over a link secured with at least @p requiredMode;
+     * see GattClient::write(). The value is copied if the write is queued.
+     *
+     * @return BLE_ERROR_NONE if the write was issued or queued,
+     *         BLE_ERROR_INVALID_PARAM if the value is larger than
+     *         MAX_VALUE_SIZE, BLE_ERROR_NO_MEM if the queue is full, or the
+     *         error of GattClient or of SecurityManager::setLinkSecurity().
+     */
+    ble_error_t write(GattClient::WriteOp_t           cmd,
+                      Gap::Handle_t                   connHandle,
+                      GattAttribute::Handle_t         attributeHandle,
+                      size_t                          length,
+                      const uint8_t                  *value,
+                      SecurityManager::SecurityMode_t requiredMode = SecurityManager::SECURITY_MODE_ENCRYPTION_NO_MITM);
+
+    /**
+     * Give up on the replayed requests left without response for
+     * RESPONSE_TIMEOUT, and issue the operations held behind them.
+     */
+    void process(void);
+
+    /**
+     * Get the security state of a link, as tracked by the queue.
+     */
+    LinkState_t getLinkState(Gap::Handle_t connHandle) const;
+
+    /**
+     * Get the number of operations held for a link.
+     */
+    unsigned getPendingCount(Gap::Handle_t connHandle) const;
+
+    /**
+     * Set the callback reporting the operations which couldn't be issued.
+     */
+    void onFailure(const FailureCallback_t &callback) {
+        failureCallback = callback;
+    }
+    template <typename T>
+    void onFailure(T *objPtr, void (T::*memberPtr)(const FailureCallbackParams_t *)) {
+        failureCallback.attach(objPtr, memberPtr);
+    }
+
+private:
+    struct Link_t {
+        Gap::Handle_t                   handle;
+        bool                            used;
+        bool                            awaitingResponse;  /**< A replayed request is outstanding. */
+        GattAttribute::Handle_t         outstandingHandle; /**< Attribute of the outstanding request. */
+        bool                            outstandingIsWrite;
+        uint32_t                        requestTime;       /**< When the outstanding request was issued. */
+        LinkState_t                     state;
+        SecurityManager::SecurityMode_t mode;              /**< Mode reached, or requested while LINK_ENCRYPTING. */
+    };
+
+    struct Operation_t {
+        Gap::Handle_t                   connHandle;
+        GattAttribute::Handle_t         attributeHandle;
+        bool                            isWrite;
+        GattClient::WriteOp_t           cmd;
+        uint16_t                        offset;
+        uint8_t                         length;
+        SecurityManager::SecurityMode_t requiredMode;
+        uint8_t                         value[MAX_VALUE_SIZE];
+    };
+
+    void processLinkSecurityEvent(const SecurityManager::LinkSecurityEventParams_t *params);
+    void processDisconnectionEvent(const Gap::DisconnectionCallbackParams_t *params);
+    void processReadResponse(const GattReadCallbackParams *params);
+    void processWriteResponse(const GattWriteCallbackParams *params);
+
+    bool isReady(const Link_t &link, SecurityManager::SecurityMode_t requiredMode) const;
+    ble_error_t submit(Link_t &link, const Operation_t &operation);
+    void replay(Link_t &link);
+    void failAll(Gap::Handle_t connHandle, ble_error_t error, SecurityManager::SecurityCompletionStatus_t status);
+    void failInsufficient(Link_t &link, SecurityManager::SecurityCompletionStatus_t status);
+    void fail(const Operation_t &operation, ble_error_t error, SecurityManager::SecurityCompletionStatus_t status);
+    void erase(unsigned index);
+    Link_t *findLink(Gap::Handle_t connHandle);
+    const Link_t *findLink(Gap::Handle_t connHandle) const;
+    Link_t *acquireLink(Gap::Handle_t connHandle);
+
+    static bool satisfies(SecurityManager::SecurityMode_t mode, SecurityManager::SecurityMode_t requiredMode);
+
+private:
+    Gap               &gap;
+    GattClient        &client;
+    SecurityManager   &securityManager;
+    TimeSource_t       timeSource;
+    FailureCallback_t  failureCallback;
+    Link_t             links[MAX_LINKS];
+    unsigned           operationCount;
+    Operation_t        operations[MAX_OPERATIONS]; /**< In submission order. */
+
+    /* Operation_t::length holds the value size. */
+    typedef char MaxValueSizeCheck_t[(MAX_VALUE_SIZE <= 0xFF) ? 1 : -1];
+
+private:
+    /* Disallow copy and assignment. */
+    SecureGattQueue(const SecureGattQueue &);
+    SecureGattQueue& operator=(const SecureGattQueue &);
+};
+
+#endif /* ifndef __SECURE_GATT_QUEUE_H__ */
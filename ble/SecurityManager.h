@@ -21,6 +21,8 @@
 
 #include "Gap.h"
 #include "CallChainOfFunctionPointersWithContext.h"
+#include "CryptoBackend.h"
+#include "BondTable.h"
 
 class SecurityManager {
 public:
@@ -83,6 +85,19 @@ public:
     typedef void (*LinkSecuredCallback_t)(Gap::Handle_t handle, SecurityMode_t securityMode);
     typedef void (*PasskeyDisplayCallback_t)(Gap::Handle_t handle, const Passkey_t passkey);
 
+    /**
+     * Outcome of a security procedure on a link, reported to the callbacks
+     * registered with onLinkSecurityEvent().
+     */
+    struct LinkSecurityEventParams_t {
+        Gap::Handle_t              handle;       /**< The link. */
+        bool                       secured;      /**< Whether the link is now encrypted. */
+        SecurityMode_t             securityMode; /**< Security mode of the link, if secured. */
+        SecurityCompletionStatus_t status;       /**< Status of the security procedure. */
+    };
+    typedef FunctionPointerWithContext<const LinkSecurityEventParams_t *> LinkSecurityEventCallback_t;
+    typedef CallChainOfFunctionPointersWithContext<const LinkSecurityEventParams_t *> LinkSecurityEventCallbackChain_t;
+
     typedef FunctionPointerWithContext<const SecurityManager *> SecurityManagerShutdownCallback_t;
     typedef CallChainOfFunctionPointersWithContext<const SecurityManager *> SecurityManagerShutdownCallbackChain_t;
 
@@ -160,6 +175,10 @@ public:
      *                                    application registration.
      */
     virtual ble_error_t purgeAllBondingState(void) {
+        if (bondTable != NULL) {
+            return bondTable->clear();
+        }
+
         return BLE_ERROR_NOT_IMPLEMENTED; /* Requesting action from porters: override this API if security is supported. */
     }
 
@@ -179,12 +198,58 @@ public:
      * @experimental
      */
     virtual ble_error_t getAddressesFromBondTable(Gap::Whitelist_t &addresses) const {
-        /* Avoid compiler warnings about unused variables */
-        (void) addresses;
+        if (bondTable != NULL) {
+            addresses.size = 0;
+            for (unsigned i = 0; (i < bondTable->getCount()) && (addresses.size < addresses.capacity); ++i) {
+                const BondTable::BondRecord_t *record = bondTable->getRecord(i);
+                addresses.addresses[addresses.size++] = BLEProtocol::Address_t(record->identityAddressType, record->identityAddress);
+            }
+            return BLE_ERROR_NONE;
+        }
 
         return BLE_ERROR_NOT_IMPLEMENTED; /* Requesting action from porters: override this API if security is supported. */
     }
 
+    /**
+     * Set the table in which the keys of bonded peers are kept. Ports which
+     * use it store the keys distributed during bonding in it and look them
+     * up on reconnection; purgeAllBondingState() and
+     * getAddressesFromBondTable() then operate on it unless overridden.
+     *
+     * @param[in] table
+     *              The table, already loaded, or NULL.
+     */
+    void setBondTable(BondTable *table) {
+        bondTable = table;
+    }
+
+    /**
+     * Get the table set with setBondTable(), or NULL.
+     */
+    BondTable *getBondTable(void) const {
+        return bondTable;
+    }
+
+    /**
+     * Set the implementation of AES-128 and of the functions built on it
+     * (ah, c1, s1, CMAC, CCM) used by the stack and by the application.
+     * Targets with an AES engine typically install a backend using it at
+     * init(); others may install a SoftwareCryptoBackend.
+     *
+     * @param[in] backend
+     *              The backend, or NULL if none is available.
+     */
+    void setCryptoBackend(CryptoBackend *backend) {
+        cryptoBackend = backend;
+    }
+
+    /**
+     * Get the backend set with setCryptoBackend(), or NULL.
+     */
+    CryptoBackend *getCryptoBackend(void) const {
+        return cryptoBackend;
+    }
+
     /* Event callback handlers. */
 public:
     /**
@@ -219,6 +284,20 @@ public:
         return shutdownCallChain;
     }
 
+    /**
+     * Provide access to the callchain of link security events: one is
+     * reported when a link becomes encrypted and when a security procedure
+     * fails. Unlike the callbacks set with onLinkSecured() and
+     * onSecuritySetupCompleted(), several modules can register.
+     *
+     * @note It is possible to register callbacks using onLinkSecurityEvent().add(callback).
+     *
+     * @note It is possible to unregister callbacks using onLinkSecurityEvent().detach(callback).
+     */
+    LinkSecurityEventCallbackChain_t& onLinkSecurityEvent() {
+        return linkSecurityEventCallChain;
+    }
+
     /**
      * To indicate that a security procedure for the link has started.
      */
@@ -259,12 +338,20 @@ public:
         if (securitySetupCompletedCallback) {
             securitySetupCompletedCallback(handle, status);
         }
+
+        if (status != SEC_STATUS_SUCCESS) {
+            LinkSecurityEventParams_t params = { handle, false, SECURITY_MODE_ENCRYPTION_OPEN_LINK, status };
+            linkSecurityEventCallChain.call(&params);
+        }
     }
 
     void processLinkSecuredEvent(Gap::Handle_t handle, SecurityMode_t securityMode) {
         if (linkSecuredCallback) {
             linkSecuredCallback(handle, securityMode);
         }
+
+        LinkSecurityEventParams_t params = { handle, true, securityMode, SEC_STATUS_SUCCESS };
+        linkSecurityEventCallChain.call(&params);
     }
 
     void processSecurityContextStoredEvent(Gap::Handle_t handle) {
@@ -285,7 +372,9 @@ protected:
         securitySetupCompletedCallback(),
         linkSecuredCallback(),
         securityContextStoredCallback(),
-        passkeyDisplayCallback() {
+        passkeyDisplayCallback(),
+        cryptoBackend(NULL),
+        bondTable(NULL) {
         /* empty */
     }
 
@@ -307,6 +396,7 @@ public:
         /* Notify that the instance is about to shutdown */
         shutdownCallChain.call(this);
         shutdownCallChain.clear();
+        linkSecurityEventCallChain.clear();
 
         securitySetupInitiatedCallback = NULL;
         securitySetupCompletedCallback = NULL;
@@ -314,6 +404,10 @@ public:
         securityContextStoredCallback  = NULL;
         passkeyDisplayCallback         = NULL;
 
+        /* Drop the application's hooks */
+        cryptoBackend = NULL;
+        bondTable     = NULL;
+
         return BLE_ERROR_NONE;
     }
 
@@ -323,9 +417,12 @@ protected:
     LinkSecuredCallback_t            linkSecuredCallback;
     HandleSpecificEvent_t            securityContextStoredCallback;
     PasskeyDisplayCallback_t         passkeyDisplayCallback;
+    CryptoBackend                   *cryptoBackend;
+    BondTable                       *bondTable;
 
 private:
     SecurityManagerShutdownCallbackChain_t shutdownCallChain;
+    LinkSecurityEventCallbackChain_t       linkSecurityEventCallChain;
 };
 
 #endif /*__SECURITY_MANAGER_H__*/
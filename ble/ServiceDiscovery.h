@@ -18,6 +18,7 @@
 #define __SERVICE_DISOVERY_H__
 
 #include "UUID.h"
+#include "UUIDSet.h"
 #include "Gap.h"
 #include "GattAttribute.h"
 
@@ -116,17 +117,90 @@ public:
                                const UUID               &matchingServiceUUID = UUID::ShortUUIDBytes_t(BLE_UUID_UNKNOWN),
                                const UUID               &matchingCharacteristicUUIDIn = UUID::ShortUUIDBytes_t(BLE_UUID_UNKNOWN)) = 0;
 
+    /**
+     * Launch a targeted service discovery. Instead of a single service and a
+     * single characteristic UUID, the filters are sets of UUIDs: callbacks are
+     * issued for every service (respectively characteristic) whose UUID belongs
+     * to the corresponding set, and discovery terminates as soon as all the
+     * targets have been found rather than walking the whole attribute table.
+     *
+     * @param  connectionHandle
+     *           Handle for the connection with the peer.
+     * @param  sc
+     *           The application callback for a matching service.
+     * @param  cc
+     *           The application callback for a matching characteristic.
+     * @param  matchingServiceUUIDs
+     *           Services the application is interested in. An empty set
+     *           matches all services.
+     * @param  matchingCharacteristicUUIDs
+     *           Characteristics the application is interested in. An empty set
+     *           matches all characteristics of the matching services.
+     *
+     * @note     Implementations are expected to rely on isServiceMatching(),
+     *           isCharacteristicMatching() and areAllTargetsFound() to apply
+     *           the filters.
+     *
+     * @return
+     *           BLE_ERROR_NONE if service discovery is launched successfully; else an appropriate error.
+     */
+    virtual ble_error_t launch(Gap::Handle_t             connectionHandle,
+                               ServiceCallback_t         sc,
+                               CharacteristicCallback_t  cc,
+                               const UUIDSet            &matchingServiceUUIDs,
+                               const UUIDSet            &matchingCharacteristicUUIDs) {
+        /* Avoid compiler warnings about unused variables. */
+        (void)connectionHandle;
+        (void)sc;
+        (void)cc;
+        (void)matchingServiceUUIDs;
+        (void)matchingCharacteristicUUIDs;
+
+        return BLE_ERROR_NOT_IMPLEMENTED; /* Requesting action from porters: override this API if this capability is supported. */
+    }
+
     /**
      * Check whether service-discovery is currently active.
      */
     virtual bool        isActive(void) const = 0;
 
+    /**
+     * Check whether service-discovery is currently active on a given
+     * connection.
+     *
+     * @param[in] connectionHandle
+     *              Handle of the connection to check.
+     */
+    virtual bool        isActiveOn(Gap::Handle_t connectionHandle) const {
+        return isActive() && (connHandle == connectionHandle);
+    }
+
     /**
      * Terminate an ongoing service discovery. This should result in an
      * invocation of the TerminationCallback if service discovery is active.
      */
     virtual void        terminate(void) = 0;
 
+    /**
+     * Terminate the service discovery if it is running on a given connection;
+     * otherwise this is a no-op.
+     *
+     * @param[in] connectionHandle
+     *              Handle of the connection on which discovery should stop.
+     */
+    virtual void        terminateOn(Gap::Handle_t connectionHandle) {
+        if (isActiveOn(connectionHandle)) {
+            terminate();
+        }
+    }
+
+    /**
+     * Get the handle of the connection the last discovery was launched on.
+     */
+    Gap::Handle_t       getConnectionHandle(void) const {
+        return connHandle;
+    }
+
     /**
      * Set up a callback to be invoked when service discovery is terminated.
      */
@@ -149,10 +223,76 @@ public:
         serviceCallback            = NULL;
         matchingCharacteristicUUID = UUID::ShortUUIDBytes_t(BLE_UUID_UNKNOWN);
         characteristicCallback     = NULL;
+        matchingServiceUUIDs.clear();
+        matchingCharacteristicUUIDs.clear();
 
         return BLE_ERROR_NONE;
     }
 
+protected:
+    /**
+     * Check a discovered service against the service filter: the set of
+     * targets if one was provided at launch, else matchingServiceUUID.
+     * The service is flagged as found if it is one of the targets.
+     *
+     * @param[in] uuid
+     *              UUID of the discovered service.
+     *
+     * @return true if the service matches the filter.
+     */
+    bool isServiceMatching(const UUID &uuid) {
+        if (!matchingServiceUUIDs.isEmpty()) {
+            if (!matchingServiceUUIDs.contains(uuid)) {
+                return false;
+            }
+            matchingServiceUUIDs.markFound(uuid);
+            return true;
+        }
+
+        return (matchingServiceUUID == UUID::ShortUUIDBytes_t(BLE_UUID_UNKNOWN)) || (matchingServiceUUID == uuid);
+    }
+
+    /**
+     * Check a discovered characteristic against the characteristic filter:
+     * the set of targets if one was provided at launch, else
+     * matchingCharacteristicUUID. The characteristic is flagged as found if it
+     * is one of the targets.
+     *
+     * @param[in] uuid
+     *              UUID of the discovered characteristic.
+     *
+     * @return true if the characteristic matches the filter.
+     */
+    bool isCharacteristicMatching(const UUID &uuid) {
+        if (!matchingCharacteristicUUIDs.isEmpty()) {
+            if (!matchingCharacteristicUUIDs.contains(uuid)) {
+                return false;
+            }
+            matchingCharacteristicUUIDs.markFound(uuid);
+            return true;
+        }
+
+        return (matchingCharacteristicUUID == UUID::ShortUUIDBytes_t(BLE_UUID_UNKNOWN)) || (matchingCharacteristicUUID == uuid);
+    }
+
+    /**
+     * Check whether a targeted discovery can stop early: every characteristic
+     * target has been found or, when only services are targeted and
+     * characteristic discovery is skipped, every service target has been
+     * found.
+     *
+     * @return true if the procedure can terminate.
+     */
+    bool areAllTargetsFound(void) const {
+        if (!matchingCharacteristicUUIDs.isEmpty()) {
+            return matchingCharacteristicUUIDs.allFound();
+        }
+        if (!characteristicCallback) {
+            return matchingServiceUUIDs.allFound();
+        }
+        return false;
+    }
+
 protected:
     /**
      * Connection handle as provided by the SoftDevice.
@@ -178,6 +318,16 @@ protected:
      * found during service-discovery.
      */
     CharacteristicCallback_t characteristicCallback;
+    /**
+     * Set of services targeted by the discovery; empty unless a targeted
+     * discovery is running.
+     */
+    UUIDSet                  matchingServiceUUIDs;
+    /**
+     * Set of characteristics targeted by the discovery; empty unless a
+     * targeted discovery is running.
+     */
+    UUIDSet                  matchingCharacteristicUUIDs;
 };
 
 #endif /* ifndef __SERVICE_DISOVERY_H__ */
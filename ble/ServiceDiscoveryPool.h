@@ -0,0 +1,320 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SERVICE_DISCOVERY_POOL_H__
+#define __SERVICE_DISCOVERY_POOL_H__
+
+#include "ServiceDiscovery.h"
+
+#ifndef YOTTA_CFG_BLE_GATT_CLIENT_MAX_CONCURRENT_DISCOVERIES
+/**
+ * Default number of service discovery procedures which can run concurrently,
+ * each one on a different connection.
+ */
+#define YOTTA_CFG_BLE_GATT_CLIENT_MAX_CONCURRENT_DISCOVERIES 3
+#endif
+
+/**
+ * @brief Set of service discovery state machines, one per connection.
+ *
+ * @details A ServiceDiscovery object models a single discovery procedure; this
+ * class lets a GattClient port run several of them in parallel on different
+ * connections. The port registers its ServiceDiscovery instances once (at
+ * construction time) with add(), then forwards the GattClient service
+ * discovery APIs to the pool:
+ *
+ *   - GattClient::launchServiceDiscovery() -> ServiceDiscoveryPool::launch()
+ *   - GattClient::isServiceDiscoveryActive() and isServiceDiscoveryActiveOn()
+ *     -> ServiceDiscoveryPool::isActive()
+ *   - GattClient::terminateServiceDiscovery() and terminateServiceDiscoveryOn()
+ *     -> ServiceDiscoveryPool::terminate()
+ *   - GattClient::onServiceDiscoveryTermination() and
+ *     onServiceDiscoveryTerminationOn() -> ServiceDiscoveryPool::onTermination()
+ *
+ * The pool takes ownership of the termination callback of each registered
+ * procedure: it dispatches terminations first to the callback registered for
+ * that connection (if any) then to the callback common to all connections.
+ *
+ * @note The number of procedures which can be registered is bounded by
+ * YOTTA_CFG_BLE_GATT_CLIENT_MAX_CONCURRENT_DISCOVERIES. No memory is
+ * allocated by the pool.
+ */
+class ServiceDiscoveryPool {
+public:
+    /**
+     * Maximum number of discovery procedures the pool can hold.
+     */
+    static const uint8_t MAX_PROCEDURES = YOTTA_CFG_BLE_GATT_CLIENT_MAX_CONCURRENT_DISCOVERIES;
+
+    /**
+     * Construct an empty pool.
+     */
+    ServiceDiscoveryPool() : procedureCount(0), terminationCallback() {
+        for (uint8_t i = 0; i < MAX_PROCEDURES; ++i) {
+            procedures[i] = NULL;
+            connectionTerminationCallbacks[i] = NULL;
+        }
+    }
+
+    /**
+     * Register a discovery procedure with the pool.
+     *
+     * @param[in] procedure
+     *              The ServiceDiscovery state machine to register. It must
+     *              outlive the pool.
+     *
+     * @return BLE_ERROR_NONE on success, BLE_ERROR_NO_MEM if the pool is full
+     *         and BLE_ERROR_INVALID_PARAM if @p procedure is NULL.
+     */
+    ble_error_t add(ServiceDiscovery *procedure) {
+        if (procedure == NULL) {
+            return BLE_ERROR_INVALID_PARAM;
+        }
+        if (procedureCount == MAX_PROCEDURES) {
+            return BLE_ERROR_NO_MEM;
+        }
+
+        procedure->onTermination(makeFunctionPointer(this, &ServiceDiscoveryPool::processTermination));
+        procedures[procedureCount++] = procedure;
+
+        return BLE_ERROR_NONE;
+    }
+
+    /**
+     * Launch service discovery on a connection using the first idle
+     * procedure of the pool. See ServiceDiscovery::launch() for a
+     * description of the parameters.
+     *
+     * @return BLE_ERROR_NONE if service discovery is launched successfully;
+     *         BLE_STACK_BUSY if a discovery is already running on this
+     *         connection; BLE_ERROR_NO_MEM if the maximum number of concurrent
+     *         discoveries is reached; else the error returned by the procedure.
+     */
+    ble_error_t launch(Gap::Handle_t                               connectionHandle,
+                       ServiceDiscovery::ServiceCallback_t         sc                           = NULL,
+                       ServiceDiscovery::CharacteristicCallback_t  cc                           = NULL,
+                       const UUID                                 &matchingServiceUUID          = UUID::ShortUUIDBytes_t(BLE_UUID_UNKNOWN),
+                       const UUID                                 &matchingCharacteristicUUIDIn = UUID::ShortUUIDBytes_t(BLE_UUID_UNKNOWN)) {
+        ServiceDiscovery *procedure = NULL;
+        ble_error_t       err       = acquire(connectionHandle, procedure);
+        if (err != BLE_ERROR_NONE) {
+            return err;
+        }
+
+        return procedure->launch(connectionHandle, sc, cc, matchingServiceUUID, matchingCharacteristicUUIDIn);
+    }
+
+    /**
+     * Launch a targeted service discovery on a connection using the first
+     * idle procedure of the pool. See ServiceDiscovery::launch() for a
+     * description of the parameters and launch() above for the errors
+     * returned.
+     */
+    ble_error_t launch(Gap::Handle_t                               connectionHandle,
+                       ServiceDiscovery::ServiceCallback_t         sc,
+                       ServiceDiscovery::CharacteristicCallback_t  cc,
+                       const UUIDSet                              &matchingServiceUUIDs,
+                       const UUIDSet                              &matchingCharacteristicUUIDs) {
+        ServiceDiscovery *procedure = NULL;
+        ble_error_t       err       = acquire(connectionHandle, procedure);
+        if (err != BLE_ERROR_NONE) {
+            return err;
+        }
+
+        return procedure->launch(connectionHandle, sc, cc, matchingServiceUUIDs, matchingCharacteristicUUIDs);
+    }
+
+    /**
+     * Get the procedure running on a given connection.
+     *
+     * @param[in] connectionHandle
+     *              Handle of the connection.
+     *
+     * @return The active procedure for this connection or NULL if there is none.
+     */
+    ServiceDiscovery *find(Gap::Handle_t connectionHandle) const {
+        int index = indexOf(connectionHandle);
+        return (index < 0) ? NULL : procedures[index];
+    }
+
+    /**
+     * Check whether service discovery is active on any connection.
+     */
+    bool isActive(void) const {
+        return getActiveCount() != 0;
+    }
+
+    /**
+     * Check whether service discovery is active on a given connection.
+     */
+    bool isActive(Gap::Handle_t connectionHandle) const {
+        return find(connectionHandle) != NULL;
+    }
+
+    /**
+     * Terminate all ongoing service discoveries.
+     */
+    void terminate(void) {
+        for (uint8_t i = 0; i < procedureCount; ++i) {
+            if (procedures[i]->isActive()) {
+                procedures[i]->terminate();
+            }
+        }
+    }
+
+    /**
+     * Terminate the service discovery running on a given connection, if any.
+     * Discoveries running on other connections are not affected.
+     */
+    void terminate(Gap::Handle_t connectionHandle) {
+        ServiceDiscovery *procedure = find(connectionHandle);
+        if (procedure != NULL) {
+            procedure->terminate();
+        }
+    }
+
+    /**
+     * Set up a callback invoked whenever a service discovery terminates,
+     * whatever the connection it was running on.
+     */
+    void onTermination(ServiceDiscovery::TerminationCallback_t callback) {
+        terminationCallback = callback;
+    }
+
+    /**
+     * Set up a callback invoked when the service discovery currently running
+     * on a given connection terminates. The callback is discarded once it has
+     * been invoked.
+     *
+     * @return BLE_ERROR_NONE on success or BLE_ERROR_INVALID_STATE if no
+     *         discovery is running on this connection.
+     */
+    ble_error_t onTermination(Gap::Handle_t connectionHandle, ServiceDiscovery::TerminationCallback_t callback) {
+        int index = indexOf(connectionHandle);
+        if (index < 0) {
+            return BLE_ERROR_INVALID_STATE;
+        }
+
+        connectionTerminationCallbacks[index] = callback;
+        return BLE_ERROR_NONE;
+    }
+
+    /**
+     * Get the number of discoveries currently running.
+     */
+    uint8_t getActiveCount(void) const {
+        uint8_t count = 0;
+        for (uint8_t i = 0; i < procedureCount; ++i) {
+            if (procedures[i]->isActive()) {
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    /**
+     * Get the maximum number of discoveries which can run concurrently; this
+     * is the number of procedures registered.
+     */
+    uint8_t getCapacity(void) const {
+        return procedureCount;
+    }
+
+    /**
+     * Reset every registered procedure and drop the termination callbacks.
+     * Registered procedures remain part of the pool.
+     *
+     * @return BLE_ERROR_NONE on success.
+     */
+    ble_error_t reset(void) {
+        for (uint8_t i = 0; i < procedureCount; ++i) {
+            procedures[i]->reset();
+            procedures[i]->onTermination(makeFunctionPointer(this, &ServiceDiscoveryPool::processTermination));
+            connectionTerminationCallbacks[i] = NULL;
+        }
+        terminationCallback = NULL;
+
+        return BLE_ERROR_NONE;
+    }
+
+private:
+    ble_error_t acquire(Gap::Handle_t connectionHandle, ServiceDiscovery *&procedure) {
+        if (find(connectionHandle) != NULL) {
+            return BLE_STACK_BUSY;
+        }
+
+        for (uint8_t i = 0; i < procedureCount; ++i) {
+            if (!procedures[i]->isActive()) {
+                connectionTerminationCallbacks[i] = NULL;
+                procedure = procedures[i];
+                return BLE_ERROR_NONE;
+            }
+        }
+
+        return BLE_ERROR_NO_MEM;
+    }
+
+    int indexOf(Gap::Handle_t connectionHandle) const {
+        for (uint8_t i = 0; i < procedureCount; ++i) {
+            if (procedures[i]->isActive() && (procedures[i]->getConnectionHandle() == connectionHandle)) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    void processTermination(Gap::Handle_t connectionHandle) {
+        /* A connection runs at most one procedure at a time. */
+        for (uint8_t i = 0; i < procedureCount; ++i) {
+            if (connectionTerminationCallbacks[i] && (procedures[i]->getConnectionHandle() == connectionHandle)) {
+                ServiceDiscovery::TerminationCallback_t callback = connectionTerminationCallbacks[i];
+                connectionTerminationCallbacks[i] = NULL;
+                callback(connectionHandle);
+                break;
+            }
+        }
+
+        if (terminationCallback) {
+            terminationCallback(connectionHandle);
+        }
+    }
+
+private:
+    /**
+     * The registered procedures.
+     */
+    ServiceDiscovery                        *procedures[MAX_PROCEDURES];
+    /**
+     * Number of registered procedures.
+     */
+    uint8_t                                  procedureCount;
+    /**
+     * Termination callbacks registered for the discovery running on a
+     * specific connection; indexed like procedures.
+     */
+    ServiceDiscovery::TerminationCallback_t  connectionTerminationCallbacks[MAX_PROCEDURES];
+    /**
+     * Termination callback common to all connections.
+     */
+    ServiceDiscovery::TerminationCallback_t  terminationCallback;
+
+private:
+    /* Disallow copy and assignment. */
+    ServiceDiscoveryPool(const ServiceDiscoveryPool &);
+    ServiceDiscoveryPool& operator=(const ServiceDiscoveryPool &);
+};
+
+#endif /* ifndef __SERVICE_DISCOVERY_POOL_H__ */
@@ -0,0 +1,73 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SOFTWARE_CRYPTO_BACKEND_H__
+#define __SOFTWARE_CRYPTO_BACKEND_H__
+
+#include "CryptoBackend.h"
+
+/**
+ * @brief Portable AES-128 without lookup tables.
+ *
+ * @details The S-box is computed arithmetically, as the inversion in GF(2^8)
+ * followed by the affine transform, with no data-dependent branch or memory
+ * access: the execution time doesn't depend on the key or the data, which
+ * makes it suitable for devices exposed to timing or cache attacks. It needs
+ * no memory beyond its stack frame, at the cost of speed.
+ */
+class SoftwareCryptoBackend : public CryptoBackend {
+public:
+    SoftwareCryptoBackend() {
+        /* empty */
+    }
+
+    virtual ble_error_t encrypt(const uint8_t key[BLOCK_SIZE],
+                                const uint8_t plaintext[BLOCK_SIZE],
+                                uint8_t       ciphertext[BLOCK_SIZE]);
+};
+
+/**
+ * @brief Portable AES-128 using lookup tables.
+ *
+ * @details Each round is computed with a 1KB table combining SubBytes and
+ * MixColumns, and the key schedule of the last key used is kept, which makes
+ * repeated operations with the same key (CMAC, CCM) cheaper. This is several
+ * times faster than SoftwareCryptoBackend and meant for hosts and simulations;
+ * the table accesses depend on the data and leak it through the cache
+ * timings, so it shouldn't be used where such attacks are a concern.
+ */
+class TableCryptoBackend : public CryptoBackend {
+public:
+    TableCryptoBackend();
+
+    virtual ble_error_t encrypt(const uint8_t key[BLOCK_SIZE],
+                                const uint8_t plaintext[BLOCK_SIZE],
+                                uint8_t       ciphertext[BLOCK_SIZE]);
+
+private:
+    static const unsigned NUM_ROUNDS = 10;
+
+    void expandKey(const uint8_t key[BLOCK_SIZE]);
+
+private:
+    uint8_t  sbox[256];
+    uint32_t table[256];                        /**< SubBytes and MixColumns of a column, before rotation. */
+    uint8_t  cachedKey[BLOCK_SIZE];
+    bool     keyCached;
+    uint32_t roundKeys[4 * (NUM_ROUNDS + 1)];   /**< Expanded cachedKey. */
+};
+
+#endif /* ifndef __SOFTWARE_CRYPTO_BACKEND_H__ */
@@ -0,0 +1,45 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __BLE_TIME_SOURCE_H__
+#define __BLE_TIME_SOURCE_H__
+
+#include <stdint.h>
+
+/**
+ * Clock used by the time-dependent components of BLE API. It returns a
+ * monotonic time in microseconds, such as us_ticker_read() on mbed targets,
+ * which wraps around at 2^32.
+ */
+typedef uint32_t (*TimeSource_t)(void);
+
+/**
+ * Get the time elapsed between two readings of a TimeSource_t; the result is
+ * correct across a wrap around of the clock, as long as less than 2^32
+ * microseconds have elapsed.
+ *
+ * @param[in] since
+ *              The earlier reading.
+ * @param[in] now
+ *              The later reading.
+ *
+ * @return The elapsed time in microseconds.
+ */
+static inline uint32_t getElapsedTime(uint32_t since, uint32_t now) {
+    return (uint32_t)(now - since);
+}
+
+#endif /* ifndef __BLE_TIME_SOURCE_H__ */
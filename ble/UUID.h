@@ -313,6 +313,23 @@ public:
         return !(*this == other);
     }
 
+    /**
+     * Compute a 32-bit hash of the UUID, suitable for hash table lookups.
+     * UUIDs which compare equal have the same hash.
+     *
+     * @return The FNV-1a hash of the UUID value.
+     */
+    uint32_t hash(void) const {
+        const uint8_t *bytes = getBaseUUID();
+        uint32_t       h     = 2166136261UL ^ type;
+
+        for (uint8_t i = 0; i < getLen(); ++i) {
+            h = (h ^ bytes[i]) * 16777619UL;
+        }
+
+        return h;
+    }
+
 private:
     /**
      * The UUID type. Refer to UUID_Type_t.
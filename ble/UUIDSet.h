@@ -0,0 +1,207 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __UUID_SET_H__
+#define __UUID_SET_H__
+
+#include <stdint.h>
+#include <string.h>
+
+#include "UUID.h"
+#include "blecommon.h"
+
+#ifndef YOTTA_CFG_BLE_UUID_SET_MAX_SIZE
+/**
+ * Default maximum number of UUIDs held by a UUIDSet (at most 32).
+ */
+#define YOTTA_CFG_BLE_UUID_SET_MAX_SIZE 8
+#endif
+
+/**
+ * @brief Small fixed-capacity set of UUIDs with hashed membership lookup.
+ *
+ * @details It is used to express the targets of a service discovery: each
+ * UUID of the set can be flagged as found, which makes it possible to stop a
+ * procedure as soon as every target has been seen.
+ *
+ * Lookups hash the UUID into an open addressing table twice as large as the
+ * set capacity; no memory is allocated.
+ */
+class UUIDSet {
+public:
+    /**
+     * Maximum number of UUIDs in the set.
+     */
+    static const uint8_t MAX_SIZE = YOTTA_CFG_BLE_UUID_SET_MAX_SIZE;
+
+    /**
+     * Construct an empty set.
+     */
+    UUIDSet() : count(0), foundMask(0) {
+        memset(table, 0, sizeof(table));
+    }
+
+    /**
+     * Add a UUID to the set. Adding a UUID already present is a no-op.
+     *
+     * @param[in] uuid
+     *              The UUID to add.
+     *
+     * @return BLE_ERROR_NONE on success or BLE_ERROR_NO_MEM if the set is full.
+     */
+    ble_error_t add(const UUID &uuid) {
+        if (find(uuid) >= 0) {
+            return BLE_ERROR_NONE;
+        }
+        if (count == MAX_SIZE) {
+            return BLE_ERROR_NO_MEM;
+        }
+
+        entries[count] = uuid;
+        table[probe(uuid)] = ++count;
+
+        return BLE_ERROR_NONE;
+    }
+
+    /**
+     * Get the position of a UUID in the set.
+     *
+     * @return The index of @p uuid (usable with operator[]) or -1 if it is
+     *         not in the set.
+     */
+    int find(const UUID &uuid) const {
+        uint8_t slot = table[probe(uuid)];
+        return (slot == 0) ? -1 : (slot - 1);
+    }
+
+    /**
+     * Check whether a UUID is part of the set.
+     */
+    bool contains(const UUID &uuid) const {
+        return find(uuid) >= 0;
+    }
+
+    /**
+     * Flag a UUID of the set as found.
+     *
+     * @return true if @p uuid is in the set and was not flagged yet, false
+     *         otherwise.
+     */
+    bool markFound(const UUID &uuid) {
+        int index = find(uuid);
+        if ((index < 0) || isFound(index)) {
+            return false;
+        }
+
+        foundMask |= (1UL << index);
+        return true;
+    }
+
+    /**
+     * Check whether the UUID at a given index has been flagged as found.
+     */
+    bool isFound(uint8_t index) const {
+        return (foundMask & (1UL << index)) != 0;
+    }
+
+    /**
+     * Check whether every UUID of the set has been flagged as found. This is
+     * false for an empty set.
+     */
+    bool allFound(void) const {
+        return (count != 0) && (foundMask == ((count == 32) ? 0xFFFFFFFFUL : ((1UL << count) - 1)));
+    }
+
+    /**
+     * Clear the found flags, keeping the set content.
+     */
+    void clearFound(void) {
+        foundMask = 0;
+    }
+
+    /**
+     * Remove all UUIDs from the set.
+     */
+    void clear(void) {
+        count     = 0;
+        foundMask = 0;
+        memset(table, 0, sizeof(table));
+    }
+
+    /**
+     * Get the number of UUIDs in the set.
+     */
+    uint8_t size(void) const {
+        return count;
+    }
+
+    /**
+     * Check whether the set is empty.
+     */
+    bool isEmpty(void) const {
+        return count == 0;
+    }
+
+    /**
+     * Access the UUID at a given index, in insertion order.
+     */
+    const UUID &operator[](uint8_t index) const {
+        return entries[index];
+    }
+
+private:
+    /**
+     * Size of the hash table; twice the capacity keeps probe sequences short.
+     */
+    static const uint8_t TABLE_SIZE = 2 * MAX_SIZE;
+
+    /* The found flags are stored in a 32-bit mask. */
+    typedef char MaxSizeCheck_t[(MAX_SIZE <= 32) ? 1 : -1];
+
+    /**
+     * Find the table slot holding @p uuid, or the empty slot where it would
+     * be inserted.
+     */
+    uint8_t probe(const UUID &uuid) const {
+        uint8_t index = uuid.hash() % TABLE_SIZE;
+
+        while ((table[index] != 0) && (entries[table[index] - 1] != uuid)) {
+            index = (index + 1) % TABLE_SIZE;
+        }
+
+        return index;
+    }
+
+private:
+    /**
+     * UUIDs of the set, in insertion order.
+     */
+    UUID     entries[MAX_SIZE];
+    /**
+     * Hash table of (index in entries + 1); 0 marks an empty slot.
+     */
+    uint8_t  table[TABLE_SIZE];
+    /**
+     * Number of UUIDs in the set.
+     */
+    uint8_t  count;
+    /**
+     * Bit i is set if entries[i] has been found.
+     */
+    uint32_t foundMask;
+};
+
+#endif /* ifndef __UUID_SET_H__ */
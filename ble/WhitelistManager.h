@@ -0,0 +1,205 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WHITELIST_MANAGER_H__
+#define __WHITELIST_MANAGER_H__
+
+#include <stdint.h>
+
+#include "blecommon.h"
+#include "BLEProtocol.h"
+#include "Gap.h"
+#include "BondTable.h"
+
+#ifndef YOTTA_CFG_BLE_WHITELIST_MANAGER_CAPACITY
+/**
+ * Default number of addresses a WhitelistManager can hold, whether they fit
+ * in the whitelist of the controller or not.
+ */
+#define YOTTA_CFG_BLE_WHITELIST_MANAGER_CAPACITY 16
+#endif
+
+/**
+ * @brief Whitelist kept in sync with the controller incrementally.
+ *
+ * @details The manager holds a sorted list of addresses, added by the
+ * application or taken from the identities of a BondTable. Once attached to
+ * the bond table with attach(), the bonded identities follow the bonds added
+ * and removed; they are only taken when syncFromBondTable() is called
+ * otherwise. commit() brings
+ * the whitelist of the controller in line with it, through
+ * Gap::addToWhitelist() and Gap::removeFromWhitelist() for the entries which
+ * changed since the previous commit, or through Gap::setWhitelist() when the
+ * port doesn't support incremental updates.
+ *
+ * When the list holds more addresses than Gap::getMaxWhitelistSize(), the
+ * bonded peers get the slots of the controller first, and the remaining
+ * entries overflow: getOverflowCount() is then not 0, and the application is
+ * expected to scan or advertise ignoring the whitelist and filter in
+ * software with contains(), a binary search.
+ */
+class WhitelistManager {
+public:
+    /**
+     * Maximum number of addresses held.
+     */
+    static const unsigned CAPACITY = YOTTA_CFG_BLE_WHITELIST_MANAGER_CAPACITY;
+
+public:
+    /**
+     * Construct an empty whitelist for the controller behind @p gap. The
+     * whitelist of the controller is assumed empty until the first commit().
+     */
+    WhitelistManager(Gap &gap);
+
+    /**
+     * Stop following the bond table, if attached.
+     */
+    ~WhitelistManager();
+
+    /**
+     * Add an address.
+     *
+     * @return BLE_ERROR_NONE on success or if the address is already held,
+     *         BLE_ERROR_INVALID_PARAM for a non-resolvable private address,
+     *         or BLE_ERROR_NO_MEM if CAPACITY addresses are held.
+     */
+    ble_error_t add(const BLEProtocol::Address_t &address);
+
+    /**
+     * Remove an address added with add(); the identities of bonded peers
+     * remain until their bond is removed.
+     *
+     * @return BLE_ERROR_NONE on success or BLE_ERROR_INVALID_PARAM if the
+     *         address wasn't added with add().
+     */
+    ble_error_t remove(const BLEProtocol::Address_t &address);
+
+    /**
+     * Remove all the addresses, added or bonded.
+     */
+    void clear(void);
+
+    /**
+     * Replace the bonded identities held with those of a bond table.
+     *
+     * @return BLE_ERROR_NONE on success or BLE_ERROR_NO_MEM if some
+     *         identities didn't fit.
+     */
+    ble_error_t syncFromBondTable(const BondTable &table);
+
+    /**
+     * Take the identities of a bond table, then follow its changes: the
+     * identities of the peers bonded or unbonded later are added or removed
+     * as they are. The changes reach the controller on the next commit().
+     *
+     * @return BLE_ERROR_NONE on success or BLE_ERROR_NO_MEM if some
+     *         identities didn't fit; those of later bonds which don't fit
+     *         are left out the same way.
+     *
+     * @note This replaces the bond table previously attached.
+     */
+    ble_error_t attach(BondTable &table);
+
+    /**
+     * Stop following the bond table; its identities remain held.
+     */
+    void detach(void);
+
+    /**
+     * Push the changes made since the previous commit to the controller.
+     *
+     * @return BLE_ERROR_NONE on success or the error of Gap; the entries
+     *         pushed before the error remain in sync.
+     */
+    ble_error_t commit(void);
+
+    /**
+     * Check whether an address is held, in the controller or overflowing.
+     */
+    bool contains(BLEProtocol::AddressType_t type, const BLEProtocol::AddressBytes_t address) const;
+
+    /**
+     * Check whether an address is in the whitelist of the controller, as of
+     * the last commit().
+     */
+    bool isInController(BLEProtocol::AddressType_t type, const BLEProtocol::AddressBytes_t address) const;
+
+    /**
+     * Get the number of addresses held.
+     */
+    unsigned getSize(void) const {
+        return size;
+    }
+
+    /**
+     * Get the number of addresses held which aren't in the whitelist of the
+     * controller, as of the last commit(), and need filtering in software.
+     */
+    unsigned getOverflowCount(void) const {
+        return overflowCount;
+    }
+
+    /**
+     * Get the number of addresses pushed to or removed from the controller
+     * since construction.
+     */
+    uint32_t getControllerUpdateCount(void) const {
+        return controllerUpdates;
+    }
+
+private:
+    /**
+     * Values of Entry_t::sources; an entry without source remains until
+     * commit() removes it from the controller.
+     */
+    enum {
+        SOURCE_USER = 0x01,
+        SOURCE_BOND = 0x02,
+    };
+
+    struct Entry_t {
+        BLEProtocol::Address_t address;
+        uint8_t                sources;
+        bool                   inController;
+    };
+
+    unsigned lowerBound(BLEProtocol::AddressType_t type, const BLEProtocol::AddressBytes_t address) const;
+    const Entry_t *find(BLEProtocol::AddressType_t type, const BLEProtocol::AddressBytes_t address) const;
+    ble_error_t insert(const BLEProtocol::Address_t &address, uint8_t source);
+    void erase(unsigned index);
+    void purge(void);
+    void updateOverflowCount(void);
+    void selectControllerEntries(bool wanted[CAPACITY]) const;
+    void onBondTableChange(const BondTable *table);
+    ble_error_t commitIncrementally(void);
+    ble_error_t commitWholesale(void);
+
+private:
+    Gap       &gap;
+    BondTable *bondTable;          /**< The bond table followed, or NULL. */
+    unsigned   size;
+    unsigned   overflowCount;
+    uint32_t   controllerUpdates;
+    Entry_t    entries[CAPACITY];  /**< Sorted by address type, then address. */
+
+private:
+    /* Disallow copy and assignment. */
+    WhitelistManager(const WhitelistManager &);
+    WhitelistManager& operator=(const WhitelistManager &);
+};
+
+#endif /* ifndef __WHITELIST_MANAGER_H__ */
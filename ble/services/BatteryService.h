@@ -18,6 +18,7 @@
 #define __BLE_BATTERY_SERVICE_H__
 
 #include "ble/BLE.h"
+#include "ble/GattUpdateCoalescer.h"
 
 /**
 * @class BatteryService
@@ -32,9 +33,13 @@ public:
      *               BLE object for the underlying controller.
      * @param[in] level
      *               8bit batterly level. Usually used to represent percentage of batterly charge remaining.
+     * @param[in] _coalescer
+     *               Optional coalescer through which battery level updates
+     *               are written; unchanged levels are then not notified.
      */
-    BatteryService(BLE &_ble, uint8_t level = 100) :
+    BatteryService(BLE &_ble, uint8_t level = 100, GattUpdateCoalescer *_coalescer = NULL) :
         ble(_ble),
+        coalescer(_coalescer),
         batteryLevel(level),
         batteryLevelCharacteristic(GattCharacteristic::UUID_BATTERY_LEVEL_CHAR, &batteryLevel, GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY) {
 
@@ -53,7 +58,11 @@ public:
      */
     void updateBatteryLevel(uint8_t newLevel) {
         batteryLevel = newLevel;
-        ble.gattServer().write(batteryLevelCharacteristic.getValueHandle(), &batteryLevel, 1);
+        if (coalescer) {
+            coalescer->update(batteryLevelCharacteristic.getValueHandle(), &batteryLevel, 1);
+        } else {
+            ble.gattServer().write(batteryLevelCharacteristic.getValueHandle(), &batteryLevel, 1);
+        }
     }
 
 protected:
@@ -63,6 +72,11 @@ protected:
      */
     BLE &ble;
 
+    /**
+     * Optional coalescer of the battery level updates.
+     */
+    GattUpdateCoalescer *coalescer;
+
     /**
      * The current battery level represented as an integer from 0% to 100%.
      */
@@ -85,8 +85,9 @@ public:
                                              (softwareRevision != NULL) ? strlen(softwareRevision) : 0, /* Max length */
                                              GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ)
     {
-        static bool serviceAdded = false; /* We only add the information service once. */
-        if (serviceAdded) {
+        static bool serviceAdded[BLE::NUM_INSTANCES]; /* We only add the information service once per BLE instance. */
+        BLE::InstanceID_t instanceID = ble.getInstanceID();
+        if ((instanceID >= BLE::NUM_INSTANCES) || serviceAdded[instanceID]) {
             return;
         }
 
@@ -100,7 +101,7 @@ public:
                                                      sizeof(charTable) / sizeof(GattCharacteristic *));
 
         ble.addService(deviceInformationService);
-        serviceAdded = true;
+        serviceAdded[instanceID] = true;
     }
 
 protected:
@@ -18,6 +18,7 @@
 #define __BLE_ENVIRONMENTAL_SERVICE_H__
 
 #include "ble/BLE.h"
+#include "ble/GattUpdateCoalescer.h"
 
 /**
 * @class EnvironmentalService
@@ -39,15 +40,20 @@ public:
      * @param   temperature_en Enable this characteristic.
      * @param   humidity_en Enable this characteristic.
      * @param   pressure_en Enable this characteristic.
+     * @param   _coalescer Optional coalescer through which measurement
+     *          updates are written, so that they are sent at most once per
+     *          connection event and only when they change.
      */
-    EnvironmentalService(BLE& _ble) :
+    EnvironmentalService(BLE& _ble, GattUpdateCoalescer *_coalescer = NULL) :
         ble(_ble),
+        coalescer(_coalescer),
         temperatureCharacteristic(GattCharacteristic::UUID_TEMPERATURE_CHAR, &temperature),
         humidityCharacteristic(GattCharacteristic::UUID_HUMIDITY_CHAR, &humidity),
         pressureCharacteristic(GattCharacteristic::UUID_PRESSURE_CHAR, &pressure)
     {
-        static bool serviceAdded = false; /* We should only ever need to add the information service once. */
-        if (serviceAdded) {
+        static bool serviceAdded[BLE::NUM_INSTANCES]; /* We should only ever need to add the environmental service once per BLE instance. */
+        BLE::InstanceID_t instanceID = ble.getInstanceID();
+        if ((instanceID >= BLE::NUM_INSTANCES) || serviceAdded[instanceID]) {
             return;
         }
 
@@ -58,7 +64,7 @@ public:
         GattService environmentalService(GattService::UUID_ENVIRONMENTAL_SERVICE, charTable, sizeof(charTable) / sizeof(GattCharacteristic *));
 
         ble.gattServer().addService(environmentalService);
-        serviceAdded = true;
+        serviceAdded[instanceID] = true;
     }
 
     /**
@@ -68,7 +74,7 @@ public:
     void updateHumidity(HumidityType_t newHumidityVal)
     {
         humidity = (HumidityType_t) (newHumidityVal * 100);
-        ble.gattServer().write(humidityCharacteristic.getValueHandle(), (uint8_t *) &humidity, sizeof(HumidityType_t));
+        updateValue(humidityCharacteristic.getValueHandle(), (uint8_t *) &humidity, sizeof(HumidityType_t));
     }
 
     /**
@@ -78,7 +84,7 @@ public:
     void updatePressure(PressureType_t newPressureVal)
     {
         pressure = (PressureType_t) (newPressureVal * 10);
-        ble.gattServer().write(pressureCharacteristic.getValueHandle(), (uint8_t *) &pressure, sizeof(PressureType_t));
+        updateValue(pressureCharacteristic.getValueHandle(), (uint8_t *) &pressure, sizeof(PressureType_t));
     }
 
     /**
@@ -88,11 +94,22 @@ public:
     void updateTemperature(float newTemperatureVal)
     {
         temperature = (TemperatureType_t) (newTemperatureVal * 100);
-        ble.gattServer().write(temperatureCharacteristic.getValueHandle(), (uint8_t *) &temperature, sizeof(TemperatureType_t));
+        updateValue(temperatureCharacteristic.getValueHandle(), (uint8_t *) &temperature, sizeof(TemperatureType_t));
+    }
+
+private:
+    void updateValue(GattAttribute::Handle_t valueHandle, const uint8_t *value, uint16_t size)
+    {
+        if (coalescer) {
+            coalescer->update(valueHandle, value, size);
+        } else {
+            ble.gattServer().write(valueHandle, value, size);
+        }
     }
 
 private:
     BLE& ble;
+    GattUpdateCoalescer *coalescer;
 
     TemperatureType_t temperature;
     HumidityType_t    humidity;
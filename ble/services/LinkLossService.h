@@ -44,8 +44,9 @@ public:
         alertLevel(levelIn),
         callback(callbackIn),
         alertLevelChar(GattCharacteristic::UUID_ALERT_LEVEL_CHAR, reinterpret_cast<uint8_t *>(&alertLevel)) {
-        static bool serviceAdded = false; /* We should only ever add one LinkLoss service. */
-        if (serviceAdded) {
+        static bool serviceAdded[BLE::NUM_INSTANCES]; /* We should only ever add one LinkLoss service per BLE instance. */
+        BLE::InstanceID_t instanceID = ble.getInstanceID();
+        if ((instanceID >= BLE::NUM_INSTANCES) || serviceAdded[instanceID]) {
             return;
         }
 
@@ -53,7 +54,7 @@ public:
         GattService         linkLossService(GattService::UUID_LINK_LOSS_SERVICE, charTable, sizeof(charTable) / sizeof(GattCharacteristic *));
 
         ble.gattServer().addService(linkLossService);
-        serviceAdded = true;
+        serviceAdded[instanceID] = true;
 
         ble.gap().onDisconnection(this, &LinkLossService::onDisconnectionFilter);
         ble.gattServer().onDataWritten(this, &LinkLossService::onDataWritten);
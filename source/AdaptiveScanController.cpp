@@ -0,0 +1,251 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "ble/AdaptiveScanController.h"
+
+/**
+ * Shortest scan window, in milliseconds; 2.5 ms rounded up.
+ */
+static const uint16_t MIN_WINDOW = 3;
+
+AdaptiveScanController::AdaptiveScanController(Gap &gapIn, TimeSource_t timeSourceIn) :
+    gap(gapIn),
+    timeSource(timeSourceIn),
+    interval(200),
+    minDuty(5),
+    maxDuty(100),
+    budget(20),
+    connectionCost(10),
+    duty(20),
+    started(false),
+    appliedInterval(0),
+    appliedWindow(0),
+    period(2000000),
+    periodStart(0),
+    periodIndex(1),
+    burst(6000000),
+    credit(6000000),
+    quietPeriods(0),
+    connectionCount(0),
+    periodDiscoveries(0),
+    periodAdvertisers(0),
+    advertiserCount(0)
+{
+    memset(&stats, 0, sizeof(stats));
+    stats.dutyCycle = duty;
+
+    gap.onConnection().add(this, &AdaptiveScanController::processConnectionEvent);
+    gap.onDisconnection().add(this, &AdaptiveScanController::processDisconnectionEvent);
+}
+
+AdaptiveScanController::~AdaptiveScanController()
+{
+    gap.onConnection().detach(Gap::ConnectionEventCallback_t(this, &AdaptiveScanController::processConnectionEvent));
+    gap.onDisconnection().detach(Gap::DisconnectionEventCallback_t(this, &AdaptiveScanController::processDisconnectionEvent));
+}
+
+ble_error_t
+AdaptiveScanController::setScanInterval(uint16_t intervalInMS)
+{
+    /* The limit of GapScanningParams::setInterval(), applied each period. */
+    if ((intervalInMS < MIN_WINDOW) ||
+        (GapScanningParams::MSEC_TO_SCAN_DURATION_UNITS(intervalInMS) >= GapScanningParams::SCAN_INTERVAL_MAX)) {
+        return BLE_ERROR_PARAM_OUT_OF_RANGE;
+    }
+
+    interval = intervalInMS;
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t
+AdaptiveScanController::setDutyCycleRange(uint8_t minPercent, uint8_t maxPercent)
+{
+    if ((minPercent == 0) || (minPercent > maxPercent) || (maxPercent > 100)) {
+        return BLE_ERROR_PARAM_OUT_OF_RANGE;
+    }
+
+    minDuty = minPercent;
+    maxDuty = maxPercent;
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t
+AdaptiveScanController::setAirtimeBudget(uint8_t percent, uint32_t burstInMS)
+{
+    if ((percent == 0) || (percent > 100) || (burstInMS > 0xFFFFFFFF / 1000)) {
+        return BLE_ERROR_PARAM_OUT_OF_RANGE;
+    }
+
+    budget = percent;
+    burst  = burstInMS * 10 * percent;
+    if (credit > burst) {
+        credit = burst;
+    }
+    return BLE_ERROR_NONE;
+}
+
+void
+AdaptiveScanController::recordReport(const Gap::AdvertisementCallbackParams_t *params)
+{
+    uint32_t      now        = timeSource();
+    Advertiser_t *advertiser = NULL;
+    Advertiser_t *oldest     = NULL;
+
+    ++stats.reports;
+
+    for (unsigned i = 0; i < advertiserCount; ++i) {
+        if (memcmp(advertisers[i].address, params->peerAddr, BLEProtocol::ADDR_LEN) == 0) {
+            advertiser = &advertisers[i];
+            break;
+        }
+        if ((oldest == NULL) || (getElapsedTime(advertisers[i].lastSeen, now) > getElapsedTime(oldest->lastSeen, now))) {
+            oldest = &advertisers[i];
+        }
+    }
+
+    if ((advertiser == NULL) || (getElapsedTime(advertiser->lastSeen, now) >= FORGET_TIME)) {
+        ++periodDiscoveries;
+        ++stats.discoveries;
+    }
+    if (advertiser == NULL) {
+        /* Make room by forgetting the advertiser heard from least recently. */
+        advertiser = (advertiserCount < MAX_ADVERTISERS) ? &advertisers[advertiserCount++] : oldest;
+        memcpy(advertiser->address, params->peerAddr, BLEProtocol::ADDR_LEN);
+        advertiser->lastPeriod = 0;
+    }
+
+    advertiser->lastSeen = now;
+    if (advertiser->lastPeriod != periodIndex) {
+        advertiser->lastPeriod = periodIndex;
+        ++periodAdvertisers;
+    }
+}
+
+ble_error_t
+AdaptiveScanController::process(void)
+{
+    uint32_t now = timeSource();
+
+    if (!started) {
+        started     = true;
+        periodStart = now;
+        return apply();
+    }
+
+    uint32_t elapsed = getElapsedTime(periodStart, now);
+    if (elapsed < period) {
+        return BLE_ERROR_NONE;
+    }
+
+    /* Settle the airtime of the period against the budget. */
+    uint32_t spent     = (elapsed / 100) * duty;
+    uint32_t allowance = (elapsed / 100) * budget;
+    if (allowance >= spent) {
+        credit = ((burst - credit) > (allowance - spent)) ? (credit + (allowance - spent)) : burst;
+    } else {
+        credit = (credit > (spent - allowance)) ? (credit - (spent - allowance)) : 0;
+    }
+    stats.elapsed += elapsed / 1000;
+    stats.airtime += spent / 1000;
+    stats.density  = (periodAdvertisers < 0xFF) ? periodAdvertisers : 0xFF;
+
+    unsigned next = duty;
+    if (periodDiscoveries != 0) {
+        quietPeriods = 0;
+        next         = duty * 2;
+    } else if ((++quietPeriods >= QUIET_PERIODS) || (periodAdvertisers >= MAX_ADVERTISERS / 2)) {
+        /* Nothing new to find; a crowd of known advertisers only costs
+         * reports. */
+        quietPeriods = 0;
+        next         = duty / 2;
+    }
+
+    unsigned ceiling = getMaxDutyCycle();
+    if ((credit == 0) && (ceiling > budget)) {
+        ceiling = budget;
+    }
+    if (next > ceiling) {
+        next = ceiling;
+    }
+    if (next < minDuty) {
+        next = minDuty;
+    }
+    duty = next;
+
+    periodStart       = now;
+    ++periodIndex;
+    periodDiscoveries = 0;
+    periodAdvertisers = 0;
+
+    return apply();
+}
+
+void
+AdaptiveScanController::processConnectionEvent(const Gap::ConnectionCallbackParams_t *params)
+{
+    (void)params;
+
+    ++connectionCount;
+}
+
+void
+AdaptiveScanController::processDisconnectionEvent(const Gap::DisconnectionCallbackParams_t *params)
+{
+    (void)params;
+
+    if (connectionCount != 0) {
+        --connectionCount;
+    }
+}
+
+uint8_t
+AdaptiveScanController::getMaxDutyCycle(void) const
+{
+    unsigned cost = connectionCount * connectionCost;
+    return (cost < maxDuty) ? (maxDuty - cost) : 0;
+}
+
+ble_error_t
+AdaptiveScanController::apply(void)
+{
+    stats.dutyCycle = duty;
+
+    uint16_t window = (uint16_t)(((uint32_t)interval * duty) / 100);
+    if (window < MIN_WINDOW) {
+        window = MIN_WINDOW;
+    }
+    if ((interval == appliedInterval) && (window == appliedWindow)) {
+        return BLE_ERROR_NONE;
+    }
+
+    /* Only the window propagates to a running scan, with the interval. */
+    ble_error_t error = gap.setScanInterval(interval);
+    if (error == BLE_ERROR_NONE) {
+        error = gap.setScanWindow(window);
+    }
+    if (error != BLE_ERROR_NONE) {
+        return error;
+    }
+
+    if (appliedWindow != 0) {
+        ++stats.adjustments;
+    }
+    appliedInterval = interval;
+    appliedWindow   = window;
+    return BLE_ERROR_NONE;
+}
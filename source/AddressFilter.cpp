@@ -0,0 +1,53 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ble/AddressFilter.h"
+
+AddressFilter::AddressFilter(Slot_t *slotsIn, unsigned slotCount) :
+    table(slotsIn, slotCount),
+    mode(MODE_DISABLED)
+{
+    /* empty */
+}
+
+ble_error_t
+AddressFilter::add(const BLEProtocol::AddressBytes_t address)
+{
+    if (table.getCapacity() == 0) {
+        return BLE_ERROR_INVALID_STATE;
+    }
+    if (table.find(address) >= 0) {
+        return BLE_ERROR_NONE;
+    }
+    if (table.getSize() == table.getCapacity()) {
+        return BLE_ERROR_NO_MEM;
+    }
+
+    table.insert(address);
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t
+AddressFilter::remove(const BLEProtocol::AddressBytes_t address)
+{
+    int found = table.find(address);
+    if (found < 0) {
+        return BLE_ERROR_INVALID_PARAM;
+    }
+
+    table.erase((unsigned)found);
+    return BLE_ERROR_NONE;
+}
@@ -14,9 +14,17 @@
  * limitations under the License.
  */
 
+#include <new>
+
 #include "ble/BLE.h"
 #include "ble/BLEInstanceBase.h"
 
+/* Declarations of the initializers of the BLE instances; refer to
+ * instanceConstructors below. */
+#ifdef YOTTA_CFG_BLE_INSTANCES_HEADER
+#include YOTTA_CFG_BLE_INSTANCES_HEADER
+#endif
+
 #if defined(TARGET_OTA_ENABLED)
 #include "ble/services/DFUService.h"
 #endif
@@ -39,9 +47,12 @@ BLE::initImplementation(FunctionPointerWithContext<InitializationCompleteCallbac
     }
 
     /* Platforms enabled for DFU should introduce the DFU Service into
-     * applications automatically. */
+     * applications automatically. The bootloader only updates the firmware
+     * through the default instance. */
 #if defined(TARGET_OTA_ENABLED)
-    static DFUService dfu(*this); // defined static so that the object remains alive
+    if (instanceID == DEFAULT_INSTANCE) {
+        static DFUService dfu(*this); // defined static so that the object remains alive
+    }
 #endif // TARGET_OTA_ENABLED
 
     return BLE_ERROR_NONE;
@@ -66,7 +77,20 @@ BLE::initImplementation(FunctionPointerWithContext<InitializationCompleteCallbac
  *  }
  *
  * The following macros result in translating the above config into a static
- * array: instanceConstructors.
+ * array: instanceConstructors. Up to 8 instances are supported.
+ *
+ * Initializers other than createBLEInstance must be declared in a header of
+ * the target library, named by the "header" entry and included above. Targets
+ * with several radios can avoid allocating their transports on the heap by
+ * declaring their transport classes in that header and using
+ * createStaticBLEInstance<T> (refer to BLEInstanceBase.h) as initializers:
+ *
+ *    "ble_instances": {
+ *      "count": 2,
+ *      "header": "<ble-radio/RadioTransports.h>",
+ *      "0" : { "initializer" : "createStaticBLEInstance<RadioATransport>" },
+ *      "1" : { "initializer" : "createStaticBLEInstance<RadioBTransport>" }
+ *    }
  */
 #ifdef YOTTA_CFG_BLE_INSTANCES_COUNT
 #define CONCATENATE(A, B) A ## B
@@ -77,6 +101,9 @@ BLE::initImplementation(FunctionPointerWithContext<InitializationCompleteCallbac
 #define INITIALIZER_LIST_FOR_INSTANCE_CONSTRUCTORS_3 INITIALIZER_LIST_FOR_INSTANCE_CONSTRUCTORS_2, YOTTA_CFG_BLE_INSTANCES_2_INITIALIZER
 #define INITIALIZER_LIST_FOR_INSTANCE_CONSTRUCTORS_4 INITIALIZER_LIST_FOR_INSTANCE_CONSTRUCTORS_3, YOTTA_CFG_BLE_INSTANCES_3_INITIALIZER
 #define INITIALIZER_LIST_FOR_INSTANCE_CONSTRUCTORS_5 INITIALIZER_LIST_FOR_INSTANCE_CONSTRUCTORS_4, YOTTA_CFG_BLE_INSTANCES_4_INITIALIZER
+#define INITIALIZER_LIST_FOR_INSTANCE_CONSTRUCTORS_6 INITIALIZER_LIST_FOR_INSTANCE_CONSTRUCTORS_5, YOTTA_CFG_BLE_INSTANCES_5_INITIALIZER
+#define INITIALIZER_LIST_FOR_INSTANCE_CONSTRUCTORS_7 INITIALIZER_LIST_FOR_INSTANCE_CONSTRUCTORS_6, YOTTA_CFG_BLE_INSTANCES_6_INITIALIZER
+#define INITIALIZER_LIST_FOR_INSTANCE_CONSTRUCTORS_8 INITIALIZER_LIST_FOR_INSTANCE_CONSTRUCTORS_7, YOTTA_CFG_BLE_INSTANCES_7_INITIALIZER
 /* ... add more of the above if ever needed */
 
 #define INITIALIZER_LIST_FOR_INSTANCE_CONSTRUCTORS(N) EXPAND(CONCATENATE(INITIALIZER_LIST_FOR_INSTANCE_CONSTRUCTORS_, N))
@@ -112,13 +139,25 @@ static const InstanceConstructor_t instanceConstructors[BLE::NUM_INSTANCES] = {
 #endif
 };
 
+/**
+ * Storage of the BLE singletons. They are constructed in place on first use,
+ * so that BLE::Instance() needs no heap and the transports are still created
+ * lazily, in the order in which the application requests the instances.
+ */
+union SingletonStorage_t {
+    uint8_t  bytes[sizeof(BLE)];
+    uint64_t alignment64;      /* The unused members align the storage. */
+    void    *alignmentPointer;
+};
+
 BLE &
 BLE::Instance(InstanceID_t id)
 {
+    static SingletonStorage_t storage[NUM_INSTANCES];
     static BLE *singletons[NUM_INSTANCES];
     if (id < NUM_INSTANCES) {
         if (singletons[id] == NULL) {
-            singletons[id] = new BLE(id); /* This object will never be freed. */
+            singletons[id] = new (storage[id].bytes) BLE(id); /* This object will never be destroyed. */
         }
 
         return *singletons[id];
@@ -139,12 +178,15 @@ void defaultSchedulingCallback(BLE::OnEventsToProcessCallbackContext* params) {
 
 
 BLE::BLE(InstanceID_t instanceIDIn) : instanceID(instanceIDIn), transport(),
-    whenEventsToProcess(defaultSchedulingCallback)
+    whenEventsToProcess(defaultSchedulingCallback),
+    eventProcessingBudget(YOTTA_CFG_BLE_EVENT_PROCESSING_BUDGET),
+    eventProcessingTimeBudget(YOTTA_CFG_BLE_EVENT_PROCESSING_TIME_BUDGET),
+    timeSource(NULL)
 {
     static BLEInstanceBase *transportInstances[NUM_INSTANCES];
 
     if (instanceID < NUM_INSTANCES) {
-        if (!transportInstances[instanceID]) {
+        if (!transportInstances[instanceID] && instanceConstructors[instanceID]) {
             transportInstances[instanceID] = instanceConstructors[instanceID](); /* Call the stack's initializer for the transport object. */
         }
         transport = transportInstances[instanceID];
@@ -168,7 +210,13 @@ ble_error_t BLE::shutdown(void)
         error("bad handle to underlying transport");
     }
 
-    return transport->shutdown();
+    ble_error_t err = transport->shutdown();
+    if ((err == BLE_ERROR_NONE) && (transport->getEventQueue() != NULL)) {
+        /* Queued events refer to the state which has just been purged. */
+        transport->getEventQueue()->clear();
+    }
+
+    return err;
 }
 
 const char *BLE::getVersion(void)
@@ -267,7 +315,95 @@ void BLE::processEvents()
         error("bad handle to underlying transport");
     }
 
+    BLE_STATS_START(stats);
+
     transport->processEvents();
+
+    /* Dispatch the events posted by the stack, most urgent first; leftovers
+     * are signaled again so that other tasks get a chance to run in between. */
+    BLEEventQueue *eventQueue = transport->getEventQueue();
+    if (eventQueue != NULL) {
+        eventQueue->process(eventProcessingBudget, eventProcessingTimeBudget, timeSource);
+        if (eventQueue->hasPendingEvents()) {
+            signalEventsToProcess();
+        }
+    }
+
+    BLE_STATS_RECORD(stats, BLEStats::PROCESS_EVENTS);
+}
+
+void BLE::setTimeSource(TimeSource_t source)
+{
+    timeSource = source;
+
+#if BLE_STATS_ENABLED
+    stats.setTimeSource(source);
+    if (transport) {
+        transport->getGap().stats.setTimeSource(source);
+        transport->getGattServer().stats.setTimeSource(source);
+        transport->getGattClient().stats.setTimeSource(source);
+    }
+#endif
+}
+
+ble_error_t BLE::getStats(BLEStats &snapshot) const
+{
+#if BLE_STATS_ENABLED
+    if (!transport) {
+        error("bad handle to underlying transport");
+    }
+
+    memset(&snapshot, 0, sizeof(snapshot));
+    stats.copyTo(snapshot);
+    transport->getGap().stats.copyTo(snapshot);
+    transport->getGattServer().stats.copyTo(snapshot);
+    transport->getGattClient().stats.copyTo(snapshot);
+
+    const BLEEventQueue *eventQueue = transport->getEventQueue();
+    for (unsigned i = 0; (eventQueue != NULL) && (i < BLEStats::NUM_QUEUES); ++i) {
+        BLEEventQueue::Priority_t priority = (BLEEventQueue::Priority_t)i;
+        snapshot.queues[i].pending       = eventQueue->getPendingCount(priority);
+        snapshot.queues[i].highWaterMark = eventQueue->getHighWaterMark(priority);
+        snapshot.queues[i].dropped       = eventQueue->getDroppedCount(priority);
+    }
+
+    return BLE_ERROR_NONE;
+#else
+    (void)snapshot;
+    return BLE_ERROR_NOT_IMPLEMENTED;
+#endif
+}
+
+void BLE::resetStats(void)
+{
+#if BLE_STATS_ENABLED
+    if (!transport) {
+        error("bad handle to underlying transport");
+    }
+
+    stats.clear();
+    transport->getGap().stats.clear();
+    transport->getGattServer().stats.clear();
+    transport->getGattClient().stats.clear();
+#endif
+}
+
+ble_error_t BLE::setTrace(BLETrace *trace)
+{
+#if BLE_TRACE_ENABLED
+    if (!transport) {
+        error("bad handle to underlying transport");
+    }
+
+    transport->getGap().trace        = trace;
+    transport->getGattServer().trace = trace;
+    transport->getGattClient().trace = trace;
+
+    return BLE_ERROR_NONE;
+#else
+    (void)trace;
+    return BLE_ERROR_NOT_IMPLEMENTED;
+#endif
 }
 
 void BLE::onEventsToProcess(const BLE::OnEventsToProcessCallback_t& callback)
@@ -26,3 +26,22 @@ void BLEInstanceBase::signalEventsToProcess(BLE::InstanceID_t id)
 {
     BLE::Instance(id).signalEventsToProcess();
 }
+
+ble_error_t BLEInstanceBase::postEvent(BLE::InstanceID_t         id,
+                                       BLEEventQueue::Priority_t priority,
+                                       BLEEventQueue::Handler_t  handler,
+                                       void                     *context,
+                                       const void               *payload,
+                                       uint8_t                   length)
+{
+    if (eventQueue == NULL) {
+        return BLE_ERROR_NOT_IMPLEMENTED;
+    }
+
+    ble_error_t err = eventQueue->post(priority, handler, context, payload, length);
+    if (err == BLE_ERROR_NONE) {
+        signalEventsToProcess(id);
+    }
+
+    return err;
+}
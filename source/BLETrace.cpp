@@ -0,0 +1,351 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "ble/BLETrace.h"
+#include "ble/Gap.h"
+#include "ble/GattAttribute.h"
+#include "ble/GattCallbackParamTypes.h"
+
+BLETrace::BLETrace(uint8_t *bufferIn, size_t sizeIn, TimeSource_t timeSourceIn) :
+    buffer(bufferIn),
+    size(sizeIn),
+    timeSource(timeSourceIn),
+    head(0),
+    tail(0),
+    used(0),
+    lostCount(0)
+{
+    /* empty */
+}
+
+void
+BLETrace::recordConnectionEvent(uint16_t       handle,
+                                uint8_t        role,
+                                uint8_t        peerAddrType,
+                                const uint8_t *peerAddr,
+                                uint8_t        ownAddrType,
+                                const uint8_t *ownAddr,
+                                const void    *connectionParams)
+{
+    Payload_t payload;
+    payload.length = 0;
+    payload.put16(handle);
+    payload.put8(role);
+    payload.put8(peerAddrType);
+    payload.putBytes(peerAddr, BLEProtocol::ADDR_LEN);
+    payload.put8(ownAddrType);
+    payload.putBytes(ownAddr, BLEProtocol::ADDR_LEN);
+    if (connectionParams != NULL) {
+        const Gap::ConnectionParams_t *params = static_cast<const Gap::ConnectionParams_t *>(connectionParams);
+        payload.put16(params->minConnectionInterval);
+        payload.put16(params->maxConnectionInterval);
+        payload.put16(params->slaveLatency);
+        payload.put16(params->connectionSupervisionTimeout);
+    }
+
+    commit(GAP_CONNECTION, payload);
+}
+
+void
+BLETrace::recordDisconnectionEvent(uint16_t handle, uint8_t reason)
+{
+    Payload_t payload;
+    payload.length = 0;
+    payload.put16(handle);
+    payload.put8(reason);
+
+    commit(GAP_DISCONNECTION, payload);
+}
+
+void
+BLETrace::recordAdvertisementReport(const uint8_t *peerAddr,
+                                    int8_t         rssi,
+                                    bool           isScanResponse,
+                                    uint8_t        type,
+                                    uint8_t        advertisingDataLen,
+                                    const uint8_t *advertisingData)
+{
+    Payload_t payload;
+    payload.length = 0;
+    payload.putBytes(peerAddr, BLEProtocol::ADDR_LEN);
+    payload.put8((uint8_t)rssi);
+    payload.put8(isScanResponse);
+    payload.put8(type);
+    payload.putBytes(advertisingData, advertisingDataLen);
+
+    commit(GAP_ADVERTISEMENT_REPORT, payload);
+}
+
+void
+BLETrace::recordTimeoutEvent(uint8_t source)
+{
+    Payload_t payload;
+    payload.length = 0;
+    payload.put8(source);
+
+    commit(GAP_TIMEOUT, payload);
+}
+
+void
+BLETrace::recordConnectionParamsUpdateEvent(uint16_t handle, bool accepted, const void *connectionParams)
+{
+    Payload_t payload;
+    payload.length = 0;
+    payload.put16(handle);
+    payload.put8(accepted);
+    if (connectionParams != NULL) {
+        const Gap::ConnectionParams_t *params = static_cast<const Gap::ConnectionParams_t *>(connectionParams);
+        payload.put16(params->minConnectionInterval);
+        payload.put16(params->maxConnectionInterval);
+        payload.put16(params->slaveLatency);
+        payload.put16(params->connectionSupervisionTimeout);
+    }
+
+    commit(GAP_CONNECTION_PARAMS_UPDATE, payload);
+}
+
+void
+BLETrace::recordDataWrittenEvent(const GattWriteCallbackParams *params)
+{
+    Payload_t payload;
+    payload.length = 0;
+    payload.put16(params->connHandle);
+    payload.put16(params->handle);
+    payload.put8(params->writeOp);
+    payload.put16(params->offset);
+    payload.putBytes(params->data, (params->len < MAX_PAYLOAD_SIZE) ? params->len : MAX_PAYLOAD_SIZE);
+
+    commit(GATT_SERVER_DATA_WRITTEN, payload);
+}
+
+void
+BLETrace::recordDataReadEvent(const GattReadCallbackParams *params)
+{
+    Payload_t payload;
+    payload.length = 0;
+    payload.put16(params->connHandle);
+    payload.put16(params->handle);
+    payload.put16(params->offset);
+    payload.putBytes(params->data, (params->len < MAX_PAYLOAD_SIZE) ? params->len : MAX_PAYLOAD_SIZE);
+
+    commit(GATT_SERVER_DATA_READ, payload);
+}
+
+void
+BLETrace::recordServerEvent(uint8_t type, uint16_t connectionHandle, uint16_t attributeHandle)
+{
+    Payload_t payload;
+    payload.length = 0;
+    payload.put8(type);
+    payload.put16(connectionHandle);
+    payload.put16(attributeHandle);
+
+    commit(GATT_SERVER_EVENT, payload);
+}
+
+void
+BLETrace::recordServerDataSentEvent(unsigned count)
+{
+    Payload_t payload;
+    payload.length = 0;
+    payload.put16((count < 0xFFFF) ? count : 0xFFFF);
+
+    commit(GATT_SERVER_DATA_SENT, payload);
+}
+
+void
+BLETrace::recordServerDisconnectionEvent(uint16_t connectionHandle)
+{
+    Payload_t payload;
+    payload.length = 0;
+    payload.put16(connectionHandle);
+
+    commit(GATT_SERVER_DISCONNECTION, payload);
+}
+
+void
+BLETrace::recordServerSubscriptionRestored(uint16_t connectionHandle, uint16_t valueHandle)
+{
+    Payload_t payload;
+    payload.length = 0;
+    payload.put16(connectionHandle);
+    payload.put16(valueHandle);
+
+    commit(GATT_SERVER_SUBSCRIPTION_RESTORED, payload);
+}
+
+void
+BLETrace::recordReadResponse(const GattReadCallbackParams *params)
+{
+    Payload_t payload;
+    payload.length = 0;
+    payload.put16(params->connHandle);
+    payload.put16(params->handle);
+    payload.put16(params->offset);
+    payload.putBytes(params->data, (params->len < MAX_PAYLOAD_SIZE) ? params->len : MAX_PAYLOAD_SIZE);
+
+    commit(GATT_CLIENT_READ_RESPONSE, payload);
+}
+
+void
+BLETrace::recordWriteResponse(const GattWriteCallbackParams *params)
+{
+    Payload_t payload;
+    payload.length = 0;
+    payload.put16(params->connHandle);
+    payload.put16(params->handle);
+    payload.put8(params->writeOp);
+    payload.put16(params->offset);
+    payload.put16(params->len);
+
+    commit(GATT_CLIENT_WRITE_RESPONSE, payload);
+}
+
+void
+BLETrace::recordHVXEvent(const GattHVXCallbackParams *params)
+{
+    Payload_t payload;
+    payload.length = 0;
+    payload.put16(params->connHandle);
+    payload.put16(params->handle);
+    payload.put8(params->type);
+    payload.putBytes(params->data, (params->len < MAX_PAYLOAD_SIZE) ? params->len : MAX_PAYLOAD_SIZE);
+
+    commit(GATT_CLIENT_HVX, payload);
+}
+
+void
+BLETrace::recordClientDataSentEvent(uint16_t connectionHandle, unsigned count)
+{
+    Payload_t payload;
+    payload.length = 0;
+    payload.put16(connectionHandle);
+    payload.put16((count < 0xFFFF) ? count : 0xFFFF);
+
+    commit(GATT_CLIENT_DATA_SENT, payload);
+}
+
+size_t
+BLETrace::copy(uint8_t *destination, size_t destinationSize) const
+{
+    size_t copied   = 0;
+    size_t position = tail;
+
+    while (copied < used) {
+        size_t recordSize = HEADER_SIZE + buffer[(position + 1) % size];
+        if (copied + recordSize > destinationSize) {
+            break;
+        }
+
+        for (size_t i = 0; i < recordSize; ++i) {
+            destination[copied++] = buffer[position];
+            position = (position + 1) % size;
+        }
+    }
+
+    return copied;
+}
+
+void
+BLETrace::clear(void)
+{
+    head = 0;
+    tail = 0;
+    used = 0;
+}
+
+void
+BLETrace::Payload_t::put8(uint8_t value)
+{
+    if (length < MAX_PAYLOAD_SIZE) {
+        bytes[length++] = value;
+    }
+}
+
+void
+BLETrace::Payload_t::put16(uint16_t value)
+{
+    put8(value & 0xFF);
+    put8(value >> 8);
+}
+
+void
+BLETrace::Payload_t::putBytes(const uint8_t *value, uint8_t count)
+{
+    /* Data beyond the room left is truncated. */
+    if (count > getRoom()) {
+        count = getRoom();
+    }
+    if (count != 0) {
+        memcpy(&bytes[length], value, count);
+        length += count;
+    }
+}
+
+uint8_t
+BLETrace::Payload_t::getRoom(void) const
+{
+    return MAX_PAYLOAD_SIZE - length;
+}
+
+void
+BLETrace::commit(RecordType_t type, const Payload_t &payload)
+{
+    size_t recordSize = HEADER_SIZE + payload.length;
+    if (recordSize > size) {
+        ++lostCount;
+        return;
+    }
+
+    while (size - used < recordSize) {
+        dropOldest();
+    }
+
+    uint32_t timestamp = (timeSource != NULL) ? timeSource() : 0;
+    uint8_t  header[HEADER_SIZE] = {
+        (uint8_t)type,
+        payload.length,
+        (uint8_t)(timestamp),
+        (uint8_t)(timestamp >> 8),
+        (uint8_t)(timestamp >> 16),
+        (uint8_t)(timestamp >> 24)
+    };
+
+    write(header, HEADER_SIZE);
+    write(payload.bytes, payload.length);
+}
+
+void
+BLETrace::write(const uint8_t *bytes, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        buffer[head] = bytes[i];
+        head = (head + 1) % size;
+    }
+    used += count;
+}
+
+void
+BLETrace::dropOldest(void)
+{
+    size_t recordSize = HEADER_SIZE + buffer[(tail + 1) % size];
+
+    tail  = (tail + recordSize) % size;
+    used -= recordSize;
+    ++lostCount;
+}
@@ -0,0 +1,235 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ble/BLETraceReplayer.h"
+#include "ble/GattServer.h"
+#include "ble/GattClient.h"
+
+static uint16_t get16(const uint8_t *bytes)
+{
+    return (uint16_t)(bytes[0] | (bytes[1] << 8));
+}
+
+size_t
+BLETraceReplayer::replay(const uint8_t *trace, size_t length)
+{
+    size_t offset = 0;
+    size_t count  = 0;
+
+    while (offset + BLETrace::HEADER_SIZE <= length) {
+        uint8_t type          = trace[offset];
+        uint8_t payloadLength = trace[offset + 1];
+        if (offset + BLETrace::HEADER_SIZE + payloadLength > length) {
+            break;
+        }
+
+        if (replayRecord(type, &trace[offset + BLETrace::HEADER_SIZE], payloadLength)) {
+            ++count;
+        }
+        offset += BLETrace::HEADER_SIZE + payloadLength;
+    }
+
+    return count;
+}
+
+bool
+BLETraceReplayer::replayRecord(uint8_t type, const uint8_t *payload, uint8_t length)
+{
+    Gap        &gap        = instance.getGap();
+    GattServer &gattServer = instance.getGattServer();
+    GattClient &gattClient = instance.getGattClient();
+
+    switch (type) {
+        case BLETrace::GAP_CONNECTION: {
+            static const uint8_t ADDRESSES_SIZE = 2 + 1 + 1 + BLEProtocol::ADDR_LEN + 1 + BLEProtocol::ADDR_LEN;
+            if (length < ADDRESSES_SIZE) {
+                return false;
+            }
+
+            Gap::ConnectionParams_t  params;
+            Gap::ConnectionParams_t *paramsP = NULL;
+            if (length >= ADDRESSES_SIZE + 8) {
+                params.minConnectionInterval        = get16(&payload[ADDRESSES_SIZE]);
+                params.maxConnectionInterval        = get16(&payload[ADDRESSES_SIZE + 2]);
+                params.slaveLatency                 = get16(&payload[ADDRESSES_SIZE + 4]);
+                params.connectionSupervisionTimeout = get16(&payload[ADDRESSES_SIZE + 6]);
+                paramsP = &params;
+            }
+
+            gap.processConnectionEvent(get16(&payload[0]),
+                                       (Gap::Role_t)payload[2],
+                                       (BLEProtocol::AddressType_t)payload[3],
+                                       &payload[4],
+                                       (BLEProtocol::AddressType_t)payload[4 + BLEProtocol::ADDR_LEN],
+                                       &payload[5 + BLEProtocol::ADDR_LEN],
+                                       paramsP);
+            return true;
+        }
+
+        case BLETrace::GAP_DISCONNECTION:
+            if (length < 3) {
+                return false;
+            }
+            gap.processDisconnectionEvent(get16(&payload[0]), (Gap::DisconnectionReason_t)payload[2]);
+            return true;
+
+        case BLETrace::GAP_ADVERTISEMENT_REPORT:
+            if (length < BLEProtocol::ADDR_LEN + 3) {
+                return false;
+            }
+            gap.processAdvertisementReport(&payload[0],
+                                           (int8_t)payload[BLEProtocol::ADDR_LEN],
+                                           payload[BLEProtocol::ADDR_LEN + 1] != 0,
+                                           (GapAdvertisingParams::AdvertisingType_t)payload[BLEProtocol::ADDR_LEN + 2],
+                                           length - (BLEProtocol::ADDR_LEN + 3),
+                                           &payload[BLEProtocol::ADDR_LEN + 3]);
+            return true;
+
+        case BLETrace::GAP_TIMEOUT:
+            if (length < 1) {
+                return false;
+            }
+            gap.processTimeoutEvent((Gap::TimeoutSource_t)payload[0]);
+            return true;
+
+        case BLETrace::GAP_CONNECTION_PARAMS_UPDATE: {
+            if (length < 3) {
+                return false;
+            }
+
+            Gap::ConnectionParams_t  params;
+            Gap::ConnectionParams_t *paramsP = NULL;
+            if (length >= 3 + 8) {
+                params.minConnectionInterval        = get16(&payload[3]);
+                params.maxConnectionInterval        = get16(&payload[5]);
+                params.slaveLatency                 = get16(&payload[7]);
+                params.connectionSupervisionTimeout = get16(&payload[9]);
+                paramsP = &params;
+            }
+
+            gap.processConnectionParamsUpdateEvent(get16(&payload[0]), payload[2] != 0, paramsP);
+            return true;
+        }
+
+        case BLETrace::GATT_SERVER_DATA_WRITTEN: {
+            if (length < 7) {
+                return false;
+            }
+            GattWriteCallbackParams params;
+            params.connHandle = get16(&payload[0]);
+            params.handle     = get16(&payload[2]);
+            params.writeOp    = (GattWriteCallbackParams::WriteOp_t)payload[4];
+            params.offset     = get16(&payload[5]);
+            params.len        = length - 7;
+            params.data       = &payload[7];
+            gattServer.handleDataWrittenEvent(&params);
+            return true;
+        }
+
+        case BLETrace::GATT_SERVER_DATA_READ:
+        case BLETrace::GATT_CLIENT_READ_RESPONSE: {
+            if (length < 6) {
+                return false;
+            }
+            GattReadCallbackParams params;
+            params.connHandle = get16(&payload[0]);
+            params.handle     = get16(&payload[2]);
+            params.offset     = get16(&payload[4]);
+            params.len        = length - 6;
+            params.data       = &payload[6];
+            if (type == BLETrace::GATT_SERVER_DATA_READ) {
+                gattServer.handleDataReadEvent(&params);
+            } else {
+                gattClient.processReadResponse(&params);
+            }
+            return true;
+        }
+
+        case BLETrace::GATT_SERVER_EVENT: {
+            if (length < 5) {
+                return false;
+            }
+            GattServerEvents::gattEvent_e event            = (GattServerEvents::gattEvent_e)payload[0];
+            Gap::Handle_t                 connectionHandle = get16(&payload[1]);
+            if (connectionHandle == BLETrace::NO_CONNECTION) {
+                gattServer.handleEvent(event, get16(&payload[3]));
+            } else {
+                gattServer.handleEvent(event, connectionHandle, get16(&payload[3]));
+            }
+            return true;
+        }
+
+        case BLETrace::GATT_SERVER_DATA_SENT:
+            if (length < 2) {
+                return false;
+            }
+            gattServer.handleDataSentEvent(get16(&payload[0]));
+            return true;
+
+        case BLETrace::GATT_SERVER_DISCONNECTION:
+            if (length < 2) {
+                return false;
+            }
+            gattServer.handleDisconnectionEvent(get16(&payload[0]));
+            return true;
+
+        case BLETrace::GATT_SERVER_SUBSCRIPTION_RESTORED:
+            if (length < 4) {
+                return false;
+            }
+            gattServer.handleSubscriptionRestored(get16(&payload[0]), get16(&payload[2]));
+            return true;
+
+        case BLETrace::GATT_CLIENT_WRITE_RESPONSE: {
+            if (length < 9) {
+                return false;
+            }
+            GattWriteCallbackParams params;
+            params.connHandle = get16(&payload[0]);
+            params.handle     = get16(&payload[2]);
+            params.writeOp    = (GattWriteCallbackParams::WriteOp_t)payload[4];
+            params.offset     = get16(&payload[5]);
+            params.len        = get16(&payload[7]);
+            params.data       = NULL;
+            gattClient.processWriteResponse(&params);
+            return true;
+        }
+
+        case BLETrace::GATT_CLIENT_HVX: {
+            if (length < 5) {
+                return false;
+            }
+            GattHVXCallbackParams params;
+            params.connHandle = get16(&payload[0]);
+            params.handle     = get16(&payload[2]);
+            params.type       = (HVXType_t)payload[4];
+            params.len        = length - 5;
+            params.data       = &payload[5];
+            gattClient.processHVXEvent(&params);
+            return true;
+        }
+
+        case BLETrace::GATT_CLIENT_DATA_SENT:
+            if (length < 4) {
+                return false;
+            }
+            gattClient.processDataSentEvent(get16(&payload[0]), get16(&payload[2]));
+            return true;
+
+        default:
+            return false;
+    }
+}
@@ -0,0 +1,482 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "ble/BondTable.h"
+
+/*
+ * Layout of a sector: a header followed by records.
+ *
+ * The header holds SECTOR_MAGIC, the sequence number of the sector (both
+ * little endian, 4 octets), FORMAT_VERSION and the CRC of the previous
+ * fields (2 octets each).
+ *
+ * A record holds its tag, the fields of BondRecord_t in their declaration
+ * order (multi-octet integers little endian) and the CRC of the previous
+ * octets. Erased space, all 0xFF, ends the records.
+ *
+ * The header and the records are padded with 0xFF to a multiple of the
+ * program size of the storage, so that each is programmed in whole units.
+ */
+static const uint32_t SECTOR_MAGIC   = 0x444E4F42; /* "BOND" */
+static const uint16_t FORMAT_VERSION = 1;
+
+static const uint8_t  TAG_ERASED     = 0xFF;
+static const uint8_t  TAG_STORE      = 0x5A;
+static const uint8_t  TAG_REMOVE     = 0x3C;
+
+/**
+ * CRC-16/CCITT (polynomial 0x1021, initial value 0xFFFF).
+ */
+static uint16_t
+crc16(const uint8_t *data, size_t length)
+{
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < length; ++i) {
+        crc ^= (uint16_t)(data[i] << 8);
+        for (unsigned bit = 0; bit < 8; ++bit) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+
+    return crc;
+}
+
+static void
+encodeRecord(uint8_t tag, const BondTable::BondRecord_t &record, uint8_t *entry)
+{
+    uint8_t *p = entry;
+    *p++ = tag;
+    *p++ = (uint8_t)record.identityAddressType;
+    memcpy(p, record.identityAddress, BLEProtocol::ADDR_LEN);
+    p += BLEProtocol::ADDR_LEN;
+    *p++ = record.flags;
+    *p++ = record.keySize;
+    *p++ = (uint8_t)(record.ediv);
+    *p++ = (uint8_t)(record.ediv >> 8);
+    memcpy(p, record.rand, sizeof(record.rand));
+    p += sizeof(record.rand);
+    memcpy(p, record.ltk, BondTable::KEY_SIZE);
+    p += BondTable::KEY_SIZE;
+    memcpy(p, record.irk, BondTable::KEY_SIZE);
+    p += BondTable::KEY_SIZE;
+    memcpy(p, record.csrk, BondTable::KEY_SIZE);
+    p += BondTable::KEY_SIZE;
+
+    uint16_t crc = crc16(entry, (size_t)(p - entry));
+    *p++ = (uint8_t)(crc);
+    *p++ = (uint8_t)(crc >> 8);
+}
+
+/**
+ * Decode a record and return its tag, TAG_ERASED for erased space, or 0 if
+ * the record is corrupt.
+ */
+static uint8_t
+decodeRecord(const uint8_t *entry, BondTable::BondRecord_t &record)
+{
+    size_t crcOffset = BondTable::RECORD_SIZE - 2;
+    if (entry[0] == TAG_ERASED) {
+        for (size_t i = 1; i < BondTable::RECORD_SIZE; ++i) {
+            if (entry[i] != 0xFF) {
+                return 0;
+            }
+        }
+        return TAG_ERASED;
+    }
+    if (crc16(entry, crcOffset) != (uint16_t)(entry[crcOffset] | (entry[crcOffset + 1] << 8))) {
+        return 0;
+    }
+
+    const uint8_t *p = &entry[1];
+    record.identityAddressType = (BLEProtocol::AddressType_t)*p++;
+    memcpy(record.identityAddress, p, BLEProtocol::ADDR_LEN);
+    p += BLEProtocol::ADDR_LEN;
+    record.flags   = *p++;
+    record.keySize = *p++;
+    record.ediv    = (uint16_t)(p[0] | (p[1] << 8));
+    p += 2;
+    memcpy(record.rand, p, sizeof(record.rand));
+    p += sizeof(record.rand);
+    memcpy(record.ltk, p, BondTable::KEY_SIZE);
+    p += BondTable::KEY_SIZE;
+    memcpy(record.irk, p, BondTable::KEY_SIZE);
+    p += BondTable::KEY_SIZE;
+    memcpy(record.csrk, p, BondTable::KEY_SIZE);
+
+    return entry[0];
+}
+
+static unsigned
+hashAddress(BLEProtocol::AddressType_t type, const BLEProtocol::AddressBytes_t address, unsigned buckets)
+{
+    /* FNV-1a. */
+    uint32_t hash = 2166136261UL;
+    hash = (hash ^ (uint8_t)type) * 16777619UL;
+    for (unsigned i = 0; i < BLEProtocol::ADDR_LEN; ++i) {
+        hash = (hash ^ address[i]) * 16777619UL;
+    }
+
+    return hash % buckets;
+}
+
+/**
+ * Round a size up to the program size of a storage.
+ */
+static size_t
+slotSize(const BondStorage *storage, size_t size)
+{
+    size_t programSize = (storage != NULL) ? storage->getProgramSize() : 1;
+    if ((programSize == 0) || (programSize > BondTable::MAX_PROGRAM_SIZE)) {
+        /* Rejected by load(). */
+        return size;
+    }
+
+    return ((size + programSize - 1) / programSize) * programSize;
+}
+
+BondTable::BondTable(BondStorage *storageIn) :
+    storage(storageIn),
+    activeSector(-1),
+    sequence(0),
+    tail(0),
+    recordSlotSize(slotSize(storageIn, RECORD_SIZE)),
+    headerSlotSize(slotSize(storageIn, HEADER_SIZE)),
+    needsCompaction(false),
+    compactions(0),
+    count(0)
+{
+    resetIndex();
+}
+
+ble_error_t
+BondTable::load(void)
+{
+    ble_error_t err = readStorage();
+    changeCallChain.call(this);
+
+    return err;
+}
+
+ble_error_t
+BondTable::readStorage(void)
+{
+    count = 0;
+    resetIndex();
+    activeSector = -1;
+    sequence     = 0;
+    tail         = 0;
+
+    if (storage == NULL) {
+        return BLE_ERROR_NONE;
+    }
+    if ((storage->getSectorCount() < 2) ||
+        (storage->getProgramSize() == 0) ||
+        (storage->getProgramSize() > MAX_PROGRAM_SIZE) ||
+        (storage->getSectorSize() < (headerSlotSize + ((MAX_BONDS + 1) * recordSlotSize)))) {
+        return BLE_ERROR_INVALID_PARAM;
+    }
+
+    /* The active sector is the valid one with the latest sequence number. */
+    for (unsigned sector = 0; sector < storage->getSectorCount(); ++sector) {
+        uint32_t sectorSequence;
+        ble_error_t err = readHeader(sector, sectorSequence);
+        if (err == BLE_ERROR_NONE) {
+            if ((activeSector < 0) || ((int32_t)(sectorSequence - sequence) > 0)) {
+                activeSector = (int)sector;
+                sequence     = sectorSequence;
+            }
+        } else if (err != BLE_ERROR_INVALID_STATE) {
+            return err;
+        }
+    }
+
+    if (activeSector < 0) {
+        /* Blank or foreign storage: the first write will claim it. */
+        needsCompaction = true;
+        return BLE_ERROR_NONE;
+    }
+
+    return replay();
+}
+
+ble_error_t
+BondTable::store(const BondRecord_t &record)
+{
+    if ((record.identityAddressType != BLEProtocol::AddressType::PUBLIC) &&
+        (record.identityAddressType != BLEProtocol::AddressType::RANDOM_STATIC)) {
+        return BLE_ERROR_INVALID_PARAM;
+    }
+
+    int index = findIndex(record.identityAddressType, record.identityAddress);
+    if (index >= 0) {
+        /* Spare the storage writes which change nothing, unless a failed
+         * write left the storage behind the table. */
+        uint8_t current[RECORD_SIZE];
+        uint8_t updated[RECORD_SIZE];
+        encodeRecord(TAG_STORE, records[index], current);
+        encodeRecord(TAG_STORE, record, updated);
+        if (!needsCompaction && (memcmp(current, updated, RECORD_SIZE) == 0)) {
+            return BLE_ERROR_NONE;
+        }
+        records[index] = record;
+    } else {
+        if (count == MAX_BONDS) {
+            return BLE_ERROR_NO_MEM;
+        }
+        index = count++;
+        records[index] = record;
+        link((uint8_t)index);
+    }
+
+    ble_error_t err = append(TAG_STORE, record);
+    changeCallChain.call(this);
+
+    return err;
+}
+
+ble_error_t
+BondTable::remove(BLEProtocol::AddressType_t type, const BLEProtocol::AddressBytes_t address)
+{
+    int index = findIndex(type, address);
+    if (index < 0) {
+        return BLE_ERROR_INVALID_PARAM;
+    }
+
+    BondRecord_t removed = records[index];
+    removeIndex((uint8_t)index);
+
+    ble_error_t err = append(TAG_REMOVE, removed);
+    changeCallChain.call(this);
+
+    return err;
+}
+
+ble_error_t
+BondTable::clear(void)
+{
+    count = 0;
+    resetIndex();
+
+    /* A compaction leaves a sector without records. */
+    ble_error_t err = (storage != NULL) ? compact() : BLE_ERROR_NONE;
+    changeCallChain.call(this);
+
+    return err;
+}
+
+const BondTable::BondRecord_t *
+BondTable::find(BLEProtocol::AddressType_t type, const BLEProtocol::AddressBytes_t address) const
+{
+    int index = findIndex(type, address);
+    return (index >= 0) ? &records[index] : NULL;
+}
+
+int
+BondTable::findIndex(BLEProtocol::AddressType_t type, const BLEProtocol::AddressBytes_t address) const
+{
+    for (uint8_t i = buckets[hashAddress(type, address, NUM_BUCKETS)]; i != NO_SLOT; i = next[i]) {
+        if ((records[i].identityAddressType == type) &&
+            (memcmp(records[i].identityAddress, address, BLEProtocol::ADDR_LEN) == 0)) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+void
+BondTable::link(uint8_t index)
+{
+    unsigned bucket = hashAddress(records[index].identityAddressType, records[index].identityAddress, NUM_BUCKETS);
+    next[index]     = buckets[bucket];
+    buckets[bucket] = index;
+}
+
+void
+BondTable::unlink(uint8_t index)
+{
+    uint8_t *slot = &buckets[hashAddress(records[index].identityAddressType, records[index].identityAddress, NUM_BUCKETS)];
+    while (*slot != index) {
+        slot = &next[*slot];
+    }
+    *slot = next[index];
+}
+
+void
+BondTable::removeIndex(uint8_t index)
+{
+    unlink(index);
+
+    /* Keep the records packed: the last one takes the free slot. */
+    uint8_t last = (uint8_t)(--count);
+    if (index != last) {
+        unlink(last);
+        records[index] = records[last];
+        link(index);
+    }
+}
+
+void
+BondTable::resetIndex(void)
+{
+    memset(buckets, NO_SLOT, sizeof(buckets));
+}
+
+ble_error_t
+BondTable::append(uint8_t tag, const BondRecord_t &record)
+{
+    if (storage == NULL) {
+        return BLE_ERROR_NONE;
+    }
+    if (needsCompaction || (activeSector < 0) || ((tail + recordSlotSize) > storage->getSectorSize())) {
+        /* The compacted sector holds the change already made in RAM. */
+        return compact();
+    }
+
+    uint8_t entry[RECORD_SIZE + MAX_PROGRAM_SIZE];
+    memset(entry, 0xFF, sizeof(entry));
+    encodeRecord(tag, record, entry);
+    ble_error_t err = storage->program((unsigned)activeSector, tail, entry, recordSlotSize);
+    if (err != BLE_ERROR_NONE) {
+        needsCompaction = true;
+        return err;
+    }
+    tail += recordSlotSize;
+
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t
+BondTable::compact(void)
+{
+    unsigned target = (activeSector < 0) ? 0 : (((unsigned)activeSector + 1) % storage->getSectorCount());
+
+    ble_error_t err = storage->erase(target);
+    if (err != BLE_ERROR_NONE) {
+        needsCompaction = true;
+        return err;
+    }
+
+    size_t offset = headerSlotSize;
+    for (unsigned i = 0; i < count; ++i, offset += recordSlotSize) {
+        uint8_t entry[RECORD_SIZE + MAX_PROGRAM_SIZE];
+        memset(entry, 0xFF, sizeof(entry));
+        encodeRecord(TAG_STORE, records[i], entry);
+        err = storage->program(target, offset, entry, recordSlotSize);
+        if (err != BLE_ERROR_NONE) {
+            needsCompaction = true;
+            return err;
+        }
+    }
+
+    /* The header is written last: until then, the previous sector remains
+     * the active one. */
+    uint32_t targetSequence = sequence + 1;
+    uint8_t  header[HEADER_SIZE + MAX_PROGRAM_SIZE];
+    memset(header, 0xFF, sizeof(header));
+    for (unsigned i = 0; i < 4; ++i) {
+        header[i]     = (uint8_t)(SECTOR_MAGIC >> (8 * i));
+        header[4 + i] = (uint8_t)(targetSequence >> (8 * i));
+    }
+    header[8] = (uint8_t)(FORMAT_VERSION);
+    header[9] = (uint8_t)(FORMAT_VERSION >> 8);
+    uint16_t crc = crc16(header, 10);
+    header[10] = (uint8_t)(crc);
+    header[11] = (uint8_t)(crc >> 8);
+
+    err = storage->program(target, 0, header, headerSlotSize);
+    if (err != BLE_ERROR_NONE) {
+        needsCompaction = true;
+        return err;
+    }
+
+    activeSector    = (int)target;
+    sequence        = targetSequence;
+    tail            = offset;
+    needsCompaction = false;
+    ++compactions;
+
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t
+BondTable::readHeader(unsigned sector, uint32_t &sectorSequence)
+{
+    uint8_t header[HEADER_SIZE];
+    ble_error_t err = storage->read(sector, 0, header, HEADER_SIZE);
+    if (err != BLE_ERROR_NONE) {
+        return err;
+    }
+
+    uint32_t magic = 0;
+    sectorSequence = 0;
+    for (unsigned i = 0; i < 4; ++i) {
+        magic          |= (uint32_t)header[i] << (8 * i);
+        sectorSequence |= (uint32_t)header[4 + i] << (8 * i);
+    }
+    uint16_t version = (uint16_t)(header[8] | (header[9] << 8));
+    uint16_t crc     = (uint16_t)(header[10] | (header[11] << 8));
+
+    if ((magic != SECTOR_MAGIC) || (version != FORMAT_VERSION) || (crc != crc16(header, 10))) {
+        return BLE_ERROR_INVALID_STATE;
+    }
+
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t
+BondTable::replay(void)
+{
+    size_t sectorSize = storage->getSectorSize();
+    for (tail = headerSlotSize; (tail + recordSlotSize) <= sectorSize; tail += recordSlotSize) {
+        uint8_t entry[RECORD_SIZE];
+        ble_error_t err = storage->read((unsigned)activeSector, tail, entry, RECORD_SIZE);
+        if (err != BLE_ERROR_NONE) {
+            return err;
+        }
+
+        BondRecord_t record;
+        uint8_t tag = decodeRecord(entry, record);
+        if (tag == TAG_ERASED) {
+            break;
+        }
+
+        int index = ((tag == TAG_STORE) || (tag == TAG_REMOVE)) ?
+            findIndex(record.identityAddressType, record.identityAddress) : -1;
+        if (tag == TAG_STORE) {
+            if (index >= 0) {
+                records[index] = record;
+            } else if (count < MAX_BONDS) {
+                records[count] = record;
+                link((uint8_t)count++);
+            }
+        } else if (tag == TAG_REMOVE) {
+            if (index >= 0) {
+                removeIndex((uint8_t)index);
+            }
+        } else {
+            /* An interrupted append: the space after the last valid record
+             * can't be programmed again until the sector is erased. */
+            needsCompaction = true;
+            return BLE_ERROR_NONE;
+        }
+    }
+
+    needsCompaction = false;
+    return BLE_ERROR_NONE;
+}
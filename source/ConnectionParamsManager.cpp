@@ -0,0 +1,415 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ble/ConnectionParamsManager.h"
+
+/**
+ * Default parameters of the profiles; each supervision timeout leaves room
+ * for two missed connection events at the longest interval and latency.
+ */
+static const Gap::ConnectionParams_t DEFAULT_PROFILES[ConnectionParamsManager::NUM_PROFILES] = {
+    /* PROFILE_LOW_POWER: 200 to 500 ms, latency 4, 6 s. */
+    { 160, 400, 4, 600 },
+    /* PROFILE_LOW_LATENCY: 30 to 50 ms, 3 s. */
+    { 24,  40,  0, 300 },
+    /* PROFILE_BULK_TRANSFER: 7.5 to 15 ms, 3 s. */
+    { 6,   12,  0, 300 },
+};
+
+ConnectionParamsManager::ConnectionParamsManager(Gap          &gapIn,
+                                                 GattServer   &serverIn,
+                                                 GattClient   &clientIn,
+                                                 TimeSource_t  timeSourceIn) :
+    gap(gapIn),
+    server(serverIn),
+    client(clientIn),
+    timeSource(timeSourceIn),
+    idleTimeout(5000000),
+    bulkPackets(10),
+    bulkBacklog(4),
+    updateCount(0),
+    rejectionCount(0)
+{
+    for (unsigned i = 0; i < NUM_PROFILES; ++i) {
+        profiles[i] = DEFAULT_PROFILES[i];
+    }
+    for (unsigned i = 0; i < MAX_LINKS; ++i) {
+        links[i].used = false;
+    }
+
+    gap.onConnection().add(this, &ConnectionParamsManager::processConnectionEvent);
+    gap.onDisconnection().add(this, &ConnectionParamsManager::processDisconnectionEvent);
+    gap.onConnectionParamsUpdate().add(this, &ConnectionParamsManager::processConnectionParamsUpdateEvent);
+    server.onDataWritten().add(this, &ConnectionParamsManager::processServerDataWritten);
+    server.onDataSent().add(this, &ConnectionParamsManager::processServerDataSent);
+    client.onDataRead().add(this, &ConnectionParamsManager::processClientDataRead);
+    client.onDataWritten().add(this, &ConnectionParamsManager::processClientDataWritten);
+    client.onHVX().add(this, &ConnectionParamsManager::processClientHVX);
+    client.onDataSent().add(this, &ConnectionParamsManager::processClientDataSent);
+}
+
+ConnectionParamsManager::~ConnectionParamsManager()
+{
+    gap.onConnection().detach(Gap::ConnectionEventCallback_t(this, &ConnectionParamsManager::processConnectionEvent));
+    gap.onDisconnection().detach(Gap::DisconnectionEventCallback_t(this, &ConnectionParamsManager::processDisconnectionEvent));
+    gap.onConnectionParamsUpdate().detach(
+        Gap::ConnectionParamsUpdateEventCallback_t(this, &ConnectionParamsManager::processConnectionParamsUpdateEvent));
+    server.onDataWritten().detach(GattServer::DataWrittenCallback_t(this, &ConnectionParamsManager::processServerDataWritten));
+    server.onDataSent().detach(GattServer::DataSentCallback_t(this, &ConnectionParamsManager::processServerDataSent));
+    client.onDataRead().detach(GattClient::ReadCallback_t(this, &ConnectionParamsManager::processClientDataRead));
+    client.onDataWritten().detach(GattClient::WriteCallback_t(this, &ConnectionParamsManager::processClientDataWritten));
+    client.onHVX().detach(GattClient::HVXCallback_t(this, &ConnectionParamsManager::processClientHVX));
+    client.onDataSent().detach(GattClient::DataSentCallback_t(this, &ConnectionParamsManager::processClientDataSent));
+}
+
+ble_error_t
+ConnectionParamsManager::setProfileParams(Profile_t profile, const Gap::ConnectionParams_t &params)
+{
+    if (profile >= NUM_PROFILES) {
+        return BLE_ERROR_INVALID_PARAM;
+    }
+
+    /* Limits of the Core specification, Vol 6, Part B, 4.5.1. */
+    if ((params.minConnectionInterval < 6) ||
+        (params.minConnectionInterval > params.maxConnectionInterval) ||
+        (params.maxConnectionInterval > 3200) ||
+        (params.slaveLatency > 499) ||
+        (params.connectionSupervisionTimeout < 10) ||
+        (params.connectionSupervisionTimeout > 3200)) {
+        return BLE_ERROR_PARAM_OUT_OF_RANGE;
+    }
+    /* The timeout, in 10 ms units, must exceed (1 + latency) * interval * 2,
+     * the interval being in 1.25 ms units. */
+    if ((uint32_t)params.connectionSupervisionTimeout * 4 <=
+        ((uint32_t)params.slaveLatency + 1) * params.maxConnectionInterval) {
+        return BLE_ERROR_PARAM_OUT_OF_RANGE;
+    }
+
+    profiles[profile] = params;
+    return BLE_ERROR_NONE;
+}
+
+void
+ConnectionParamsManager::setPendingNotifications(Gap::Handle_t connHandle, unsigned count)
+{
+    Link_t *link = findLink(connHandle);
+    if (link != NULL) {
+        link->pendingNotifications = (count < 0xFFFF) ? count : 0xFFFF;
+    }
+}
+
+void
+ConnectionParamsManager::setPendingTransactions(Gap::Handle_t connHandle, unsigned count)
+{
+    Link_t *link = findLink(connHandle);
+    if (link != NULL) {
+        link->pendingTransactions = (count < 0xFFFF) ? count : 0xFFFF;
+    }
+}
+
+void
+ConnectionParamsManager::recordActivity(Gap::Handle_t connHandle, unsigned packets)
+{
+    Link_t *link = findLink(connHandle);
+    if (link != NULL) {
+        link->windowPackets += packets;
+        link->lastActivity   = timeSource();
+    }
+}
+
+void
+ConnectionParamsManager::process(void)
+{
+    uint32_t now = timeSource();
+
+    for (unsigned i = 0; i < MAX_LINKS; ++i) {
+        Link_t &link = links[i];
+        if (!link.used) {
+            continue;
+        }
+
+        uint32_t windowAge = getElapsedTime(link.windowStart, now);
+        if (windowAge >= TRAFFIC_WINDOW) {
+            link.previousWindowPackets = (windowAge < 2 * TRAFFIC_WINDOW) ? link.windowPackets : 0;
+            link.windowPackets         = 0;
+            link.windowStart           = now;
+        }
+
+        link.wanted = classify(link, now);
+
+        if (link.pending) {
+            if (getElapsedTime(link.requestTime, now) < REQUEST_TIMEOUT) {
+                continue;
+            }
+            /* The port doesn't report the outcome of updates. */
+            link.pending = false;
+            link.current = link.requested;
+            ++updateCount;
+        }
+
+        Profile_t target = fallback(link, (Profile_t)link.wanted);
+        if (target == link.current) {
+            link.backingOff = false;
+            link.retries    = 0;
+            continue;
+        }
+        if (link.backingOff) {
+            if (target != link.requested) {
+                link.retries = 0;
+            } else if (getElapsedTime(link.requestTime, now) < (RETRY_DELAY << (link.retries - 1))) {
+                continue;
+            }
+            link.backingOff = false;
+        }
+
+        request(link, target, now);
+    }
+}
+
+ConnectionParamsManager::Profile_t
+ConnectionParamsManager::getProfile(Gap::Handle_t connHandle) const
+{
+    const Link_t *link = findLink(connHandle);
+    return (link != NULL) ? (Profile_t)link->current : PROFILE_NONE;
+}
+
+bool
+ConnectionParamsManager::isRejected(Gap::Handle_t connHandle, Profile_t profile) const
+{
+    const Link_t *link = findLink(connHandle);
+    return (link != NULL) && (profile < NUM_PROFILES) && ((link->rejected & (1 << profile)) != 0);
+}
+
+void
+ConnectionParamsManager::processConnectionEvent(const Gap::ConnectionCallbackParams_t *params)
+{
+    Link_t *link = NULL;
+    for (unsigned i = 0; i < MAX_LINKS; ++i) {
+        if (!links[i].used) {
+            link = &links[i];
+            break;
+        }
+    }
+    if (link == NULL) {
+        return;
+    }
+
+    uint32_t now = timeSource();
+
+    /* Connection setup is followed by discovery; the link starts busy. */
+    link->handle                = params->handle;
+    link->used                  = true;
+    link->pending               = false;
+    link->backingOff            = false;
+    link->current               = match(params->connectionParams);
+    link->wanted                = PROFILE_LOW_LATENCY;
+    link->requested             = PROFILE_NONE;
+    link->retries               = 0;
+    link->rejected              = 0;
+    link->pendingNotifications  = 0;
+    link->pendingTransactions   = 0;
+    link->requestTime           = now;
+    link->lastActivity          = now;
+    link->windowStart           = now;
+    link->windowPackets         = 0;
+    link->previousWindowPackets = 0;
+}
+
+void
+ConnectionParamsManager::processDisconnectionEvent(const Gap::DisconnectionCallbackParams_t *params)
+{
+    Link_t *link = findLink(params->handle);
+    if (link != NULL) {
+        link->used = false;
+    }
+}
+
+void
+ConnectionParamsManager::processConnectionParamsUpdateEvent(const Gap::ConnectionParamsUpdateCallbackParams_t *params)
+{
+    Link_t *link = findLink(params->handle);
+    if (link == NULL) {
+        return;
+    }
+
+    if (!link->pending) {
+        /* Started by the peer; it stands for the profile the traffic called
+         * for unless it matches another. */
+        if (params->accepted) {
+            Profile_t profile = match(params->connectionParams);
+            link->current = (profile != PROFILE_NONE) ? profile : (Profile_t)link->wanted;
+        }
+        return;
+    }
+
+    link->pending = false;
+    if (params->accepted) {
+        link->current = link->requested;
+        link->retries = 0;
+        ++updateCount;
+    } else {
+        refuse(*link, timeSource());
+    }
+}
+
+void
+ConnectionParamsManager::processServerDataWritten(const GattWriteCallbackParams *params)
+{
+    recordActivity(params->connHandle, 1);
+}
+
+void
+ConnectionParamsManager::processServerDataSent(unsigned count)
+{
+    /* The event doesn't tell the link; it is only attributed when there is
+     * no doubt. */
+    Link_t *only = NULL;
+    for (unsigned i = 0; i < MAX_LINKS; ++i) {
+        if (links[i].used) {
+            if (only != NULL) {
+                return;
+            }
+            only = &links[i];
+        }
+    }
+    if (only != NULL) {
+        recordActivity(only->handle, count);
+    }
+}
+
+void
+ConnectionParamsManager::processClientDataRead(const GattReadCallbackParams *params)
+{
+    recordActivity(params->connHandle, 1);
+}
+
+void
+ConnectionParamsManager::processClientDataWritten(const GattWriteCallbackParams *params)
+{
+    recordActivity(params->connHandle, 1);
+}
+
+void
+ConnectionParamsManager::processClientHVX(const GattHVXCallbackParams *params)
+{
+    recordActivity(params->connHandle, 1);
+}
+
+void
+ConnectionParamsManager::processClientDataSent(const GattDataSentCallbackParams *params)
+{
+    recordActivity(params->connHandle, params->count);
+}
+
+ConnectionParamsManager::Profile_t
+ConnectionParamsManager::classify(const Link_t &link, uint32_t now) const
+{
+    unsigned packets = (link.windowPackets > link.previousWindowPackets) ? link.windowPackets : link.previousWindowPackets;
+    if ((packets >= bulkPackets) || (link.pendingNotifications >= bulkBacklog)) {
+        return PROFILE_BULK_TRANSFER;
+    }
+    if ((link.pendingNotifications != 0) ||
+        (link.pendingTransactions != 0) ||
+        (getElapsedTime(link.lastActivity, now) < idleTimeout)) {
+        return PROFILE_LOW_LATENCY;
+    }
+    return PROFILE_LOW_POWER;
+}
+
+ConnectionParamsManager::Profile_t
+ConnectionParamsManager::fallback(const Link_t &link, Profile_t profile) const
+{
+    if ((link.rejected & (1 << profile)) == 0) {
+        return profile;
+    }
+    if ((profile == PROFILE_BULK_TRANSFER) && ((link.rejected & (1 << PROFILE_LOW_LATENCY)) == 0)) {
+        return PROFILE_LOW_LATENCY;
+    }
+    return (Profile_t)link.current;
+}
+
+ConnectionParamsManager::Profile_t
+ConnectionParamsManager::match(const Gap::ConnectionParams_t *params) const
+{
+    if (params == NULL) {
+        return PROFILE_NONE;
+    }
+
+    /* The interval granted lies within the range requested. */
+    for (unsigned i = 0; i < NUM_PROFILES; ++i) {
+        if ((params->maxConnectionInterval >= profiles[i].minConnectionInterval) &&
+            (params->minConnectionInterval <= profiles[i].maxConnectionInterval) &&
+            (params->slaveLatency == profiles[i].slaveLatency)) {
+            return (Profile_t)i;
+        }
+    }
+    return PROFILE_NONE;
+}
+
+void
+ConnectionParamsManager::request(Link_t &link, Profile_t profile, uint32_t now)
+{
+    link.requested   = profile;
+    link.requestTime = now;
+
+    ble_error_t error = gap.updateConnectionParams(link.handle, &profiles[profile]);
+    if (error == BLE_ERROR_NONE) {
+        link.pending = true;
+    } else if (error == BLE_ERROR_NOT_IMPLEMENTED) {
+        /* Give up on the link altogether. */
+        link.rejected = (1 << NUM_PROFILES) - 1;
+        ++rejectionCount;
+    } else {
+        refuse(link, now);
+    }
+}
+
+void
+ConnectionParamsManager::refuse(Link_t &link, uint32_t now)
+{
+    link.requestTime = now;
+    if (link.retries < MAX_RETRIES) {
+        ++link.retries;
+        link.backingOff = true;
+    } else {
+        link.rejected  |= (1 << link.requested);
+        link.retries    = 0;
+        link.backingOff = false;
+        ++rejectionCount;
+    }
+}
+
+ConnectionParamsManager::Link_t *
+ConnectionParamsManager::findLink(Gap::Handle_t connHandle)
+{
+    for (unsigned i = 0; i < MAX_LINKS; ++i) {
+        if (links[i].used && (links[i].handle == connHandle)) {
+            return &links[i];
+        }
+    }
+    return NULL;
+}
+
+const ConnectionParamsManager::Link_t *
+ConnectionParamsManager::findLink(Gap::Handle_t connHandle) const
+{
+    for (unsigned i = 0; i < MAX_LINKS; ++i) {
+        if (links[i].used && (links[i].handle == connHandle)) {
+            return &links[i];
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,433 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "ble/ConnectionScheduler.h"
+
+/**
+ * Time, in microseconds, granted to the port beyond the timeout of an attempt
+ * to report it, before the attempt is deemed failed.
+ */
+static const uint32_t ATTEMPT_GRACE = 1000000;
+
+/**
+ * Longest timeout of an attempt, in seconds, whose duration with the grace
+ * can be measured with a TimeSource_t.
+ */
+static const uint32_t MAX_ATTEMPT_TIMEOUT = (0xFFFFFFFF - ATTEMPT_GRACE) / 1000000;
+
+ConnectionScheduler::ConnectionScheduler(Gap &gapIn, TimeSource_t timeSourceIn) :
+    gap(gapIn),
+    timeSource(timeSourceIn),
+    attemptParams(30, 30, 2, false),
+    connectionParams(),
+    hasConnectionParams(false),
+    maxParallelAttempts(1),
+    maxConnections(0xFFFF),
+    scanSlot(500000),
+    scanRequested(false),
+    scanning(false),
+    scanStart(0),
+    scanCallback(),
+    completionCallback(),
+    connectionCount(0),
+    attemptCount(0),
+    requestCount(0)
+{
+    memset(&stats, 0, sizeof(stats));
+    for (unsigned i = 0; i < MAX_REQUESTS; ++i) {
+        requests[i].state = REQUEST_FREE;
+    }
+
+    gap.onConnection().add(this, &ConnectionScheduler::processConnectionEvent);
+    gap.onDisconnection().add(this, &ConnectionScheduler::processDisconnectionEvent);
+    gap.onTimeout().add(this, &ConnectionScheduler::processTimeoutEvent);
+}
+
+ConnectionScheduler::~ConnectionScheduler()
+{
+    if (scanning) {
+        gap.stopScan();
+    }
+
+    gap.onConnection().detach(Gap::ConnectionEventCallback_t(this, &ConnectionScheduler::processConnectionEvent));
+    gap.onDisconnection().detach(Gap::DisconnectionEventCallback_t(this, &ConnectionScheduler::processDisconnectionEvent));
+    gap.onTimeout().detach(Gap::TimeoutEventCallback_t(this, &ConnectionScheduler::processTimeoutEvent));
+}
+
+ble_error_t
+ConnectionScheduler::connect(const BLEProtocol::Address_t &peer, uint8_t priority, uint32_t timeout)
+{
+    Request_t *request = find(peer.address);
+    if (request != NULL) {
+        if (priority > request->priority) {
+            request->priority = priority;
+        }
+        return BLE_ERROR_NONE;
+    }
+
+    for (unsigned i = 0; i < MAX_REQUESTS; ++i) {
+        if (requests[i].state == REQUEST_FREE) {
+            request = &requests[i];
+            break;
+        }
+    }
+    if (request == NULL) {
+        return BLE_ERROR_NO_MEM;
+    }
+
+    uint32_t now = timeSource();
+
+    request->peer        = peer;
+    request->state       = REQUEST_QUEUED;
+    request->priority    = priority;
+    request->attempts    = 0;
+    request->error       = BLE_ERROR_NONE;
+    request->requestTime = now;
+    request->timeout     = (timeout < 0xFFFFFFFF / 1000) ? (timeout * 1000) : 0xFFFFFFFF;
+    request->attemptTime = now;
+    request->backoff     = 0;
+    ++requestCount;
+    ++stats.requests;
+
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t
+ConnectionScheduler::cancel(const BLEProtocol::Address_t &peer)
+{
+    Request_t *request = find(peer.address);
+    if (request == NULL) {
+        return BLE_ERROR_INVALID_PARAM;
+    }
+    if (request->state == REQUEST_INITIATING) {
+        return BLE_ERROR_INVALID_STATE;
+    }
+
+    request->state = REQUEST_FREE;
+    --requestCount;
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t
+ConnectionScheduler::startScan(const Gap::AdvertisementReportCallback_t &callback)
+{
+    scanCallback  = callback;
+    scanRequested = true;
+
+    if (scanning || (attemptCount != 0)) {
+        return BLE_ERROR_NONE;
+    }
+
+    ble_error_t error = gap.startScan(this, &ConnectionScheduler::processAdvertisementReport);
+    if (error != BLE_ERROR_NONE) {
+        scanRequested = false;
+        return error;
+    }
+    scanning  = true;
+    scanStart = timeSource();
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t
+ConnectionScheduler::stopScan(void)
+{
+    scanRequested = false;
+    if (!scanning) {
+        return BLE_ERROR_NONE;
+    }
+
+    scanning = false;
+    return gap.stopScan();
+}
+
+ble_error_t
+ConnectionScheduler::setAttemptParams(uint16_t intervalInMS, uint16_t windowInMS, uint16_t timeoutInSeconds)
+{
+    if ((timeoutInSeconds == 0) || (timeoutInSeconds > MAX_ATTEMPT_TIMEOUT) || (windowInMS > intervalInMS)) {
+        return BLE_ERROR_PARAM_OUT_OF_RANGE;
+    }
+
+    ble_error_t error = attemptParams.setInterval(intervalInMS);
+    if (error == BLE_ERROR_NONE) {
+        error = attemptParams.setWindow(windowInMS);
+    }
+    if (error == BLE_ERROR_NONE) {
+        error = attemptParams.setTimeout(timeoutInSeconds);
+    }
+    return error;
+}
+
+void
+ConnectionScheduler::setConnectionParams(const Gap::ConnectionParams_t *params)
+{
+    hasConnectionParams = (params != NULL);
+    if (params != NULL) {
+        connectionParams = *params;
+    }
+}
+
+void
+ConnectionScheduler::process(void)
+{
+    uint32_t now            = timeSource();
+    uint32_t attemptTimeout = (uint32_t)attemptParams.getTimeout() * 1000000 + ATTEMPT_GRACE;
+
+    for (unsigned i = 0; i < MAX_REQUESTS; ++i) {
+        Request_t &request = requests[i];
+        if (request.state == REQUEST_QUEUED) {
+            if (getElapsedTime(request.requestTime, now) >= request.timeout) {
+                complete(request, OUTCOME_EXPIRED, 0, now);
+            }
+        } else if (request.state == REQUEST_INITIATING) {
+            if (getElapsedTime(request.attemptTime, now) >= attemptTimeout) {
+                /* The port didn't report the timeout. */
+                --attemptCount;
+                failAttempt(request, BLE_ERROR_NONE, now);
+            }
+        }
+    }
+
+    /* Attempts which just ended leave the controller to scanning first. */
+    resumeScan(now);
+
+    while ((attemptCount < maxParallelAttempts) && ((connectionCount + attemptCount) < maxConnections)) {
+        /* Let scanning run for its slot before it is interrupted. */
+        if (scanning && (getElapsedTime(scanStart, now) < scanSlot)) {
+            break;
+        }
+
+        Request_t *request = selectRequest(now);
+        if (request == NULL) {
+            break;
+        }
+
+        if (scanning) {
+            scanning = false;
+            gap.stopScan();
+        }
+        /* Gap is unlikely to take another request right after refusing one. */
+        if (!startAttempt(*request, now)) {
+            break;
+        }
+    }
+
+    resumeScan(now);
+}
+
+void
+ConnectionScheduler::processConnectionEvent(const Gap::ConnectionCallbackParams_t *params)
+{
+    ++connectionCount;
+
+    Request_t *request = find(params->peerAddr);
+    if ((request == NULL) && params->peerAddrResolved) {
+        request = find(params->peerIdentityAddr);
+    }
+    if (request == NULL) {
+        return;
+    }
+
+    uint32_t now = timeSource();
+    if (request->state == REQUEST_INITIATING) {
+        --attemptCount;
+    }
+    complete(*request, OUTCOME_CONNECTED, params->handle, now);
+    resumeScan(now);
+}
+
+void
+ConnectionScheduler::processDisconnectionEvent(const Gap::DisconnectionCallbackParams_t *params)
+{
+    (void)params;
+
+    if (connectionCount != 0) {
+        --connectionCount;
+    }
+}
+
+void
+ConnectionScheduler::processTimeoutEvent(Gap::TimeoutSource_t source)
+{
+    uint32_t now = timeSource();
+
+    if (source == Gap::TIMEOUT_SRC_SCAN) {
+        scanning = false;
+        return;
+    }
+    if (source != Gap::TIMEOUT_SRC_CONN) {
+        return;
+    }
+
+    /* The event doesn't tell the peer; the oldest attempt is the one to time
+     * out when several run. */
+    Request_t *oldest = NULL;
+    for (unsigned i = 0; i < MAX_REQUESTS; ++i) {
+        if ((requests[i].state == REQUEST_INITIATING) &&
+            ((oldest == NULL) || (getElapsedTime(requests[i].attemptTime, now) > getElapsedTime(oldest->attemptTime, now)))) {
+            oldest = &requests[i];
+        }
+    }
+    if (oldest != NULL) {
+        --attemptCount;
+        failAttempt(*oldest, BLE_ERROR_NONE, now);
+        resumeScan(now);
+    }
+}
+
+void
+ConnectionScheduler::processAdvertisementReport(const Gap::AdvertisementCallbackParams_t *params)
+{
+    if (scanCallback) {
+        scanCallback.call(params);
+    }
+}
+
+ConnectionScheduler::Request_t *
+ConnectionScheduler::selectRequest(uint32_t now)
+{
+    Request_t *best          = NULL;
+    uint32_t   bestRemaining = 0;
+
+    for (unsigned i = 0; i < MAX_REQUESTS; ++i) {
+        Request_t &request = requests[i];
+        if ((request.state != REQUEST_QUEUED) || (getElapsedTime(request.attemptTime, now) < request.backoff)) {
+            continue;
+        }
+
+        uint32_t remaining = request.timeout - getElapsedTime(request.requestTime, now);
+        if ((best == NULL) ||
+            (request.priority > best->priority) ||
+            ((request.priority == best->priority) && (remaining < bestRemaining))) {
+            best          = &request;
+            bestRemaining = remaining;
+        }
+    }
+
+    return best;
+}
+
+bool
+ConnectionScheduler::startAttempt(Request_t &request, uint32_t now)
+{
+    if (!gap.acceptsPeer(request.peer.type, request.peer.address)) {
+        /* Gap would terminate the connection without reporting it. */
+        complete(request, OUTCOME_REFUSED, 0, now);
+        return true;
+    }
+
+    ++request.attempts;
+    ++stats.attempts;
+
+    ble_error_t error = gap.connect(request.peer.address,
+                                    request.peer.type,
+                                    hasConnectionParams ? &connectionParams : NULL,
+                                    &attemptParams);
+    if (error != BLE_ERROR_NONE) {
+        failAttempt(request, error, now);
+        return false;
+    }
+
+    request.state       = REQUEST_INITIATING;
+    request.attemptTime = now;
+    ++attemptCount;
+    return true;
+}
+
+void
+ConnectionScheduler::failAttempt(Request_t &request, ble_error_t error, uint32_t now)
+{
+    ++stats.failedAttempts;
+    request.error = error;
+
+    if (request.attempts >= MAX_ATTEMPTS) {
+        complete(request, OUTCOME_FAILED, 0, now);
+        return;
+    }
+    if (getElapsedTime(request.requestTime, now) >= request.timeout) {
+        complete(request, OUTCOME_EXPIRED, 0, now);
+        return;
+    }
+
+    unsigned shift = (request.attempts <= 5) ? (request.attempts - 1) : 4;
+    request.state       = REQUEST_QUEUED;
+    request.attemptTime = now;
+    request.backoff     = BACKOFF_DELAY << shift;
+}
+
+void
+ConnectionScheduler::complete(Request_t &request, Outcome_t outcome, Gap::Handle_t handle, uint32_t now)
+{
+    CompletionCallbackParams_t params;
+    params.peer     = request.peer;
+    params.outcome  = outcome;
+    params.handle   = handle;
+    params.error    = (outcome == OUTCOME_CONNECTED) ? BLE_ERROR_NONE : request.error;
+    params.attempts = request.attempts;
+    params.latency  = getElapsedTime(request.requestTime, now) / 1000;
+
+    switch (outcome) {
+        case OUTCOME_CONNECTED:
+            ++stats.connections;
+            if ((stats.connections == 1) || (params.latency < stats.minLatency)) {
+                stats.minLatency = params.latency;
+            }
+            if (params.latency > stats.maxLatency) {
+                stats.maxLatency = params.latency;
+            }
+            stats.totalLatency += params.latency;
+            break;
+        case OUTCOME_EXPIRED:
+            ++stats.expirations;
+            break;
+        default:
+            ++stats.failures;
+            break;
+    }
+
+    /* Free the request first; the callback may queue another. */
+    request.state = REQUEST_FREE;
+    --requestCount;
+
+    if (completionCallback) {
+        completionCallback.call(&params);
+    }
+}
+
+void
+ConnectionScheduler::resumeScan(uint32_t now)
+{
+    if (!scanRequested || scanning || (attemptCount != 0)) {
+        return;
+    }
+
+    if (gap.startScan(this, &ConnectionScheduler::processAdvertisementReport) == BLE_ERROR_NONE) {
+        scanning  = true;
+        scanStart = now;
+    }
+}
+
+ConnectionScheduler::Request_t *
+ConnectionScheduler::find(const BLEProtocol::AddressBytes_t address)
+{
+    for (unsigned i = 0; i < MAX_REQUESTS; ++i) {
+        if ((requests[i].state != REQUEST_FREE) && (memcmp(requests[i].peer.address, address, BLEProtocol::ADDR_LEN) == 0)) {
+            return &requests[i];
+        }
+    }
+    return NULL;
+}
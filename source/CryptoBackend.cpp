@@ -0,0 +1,369 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "ble/CryptoBackend.h"
+
+/* Largest sizes of the CCM data and additional data supported. */
+static const size_t CCM_MAX_LENGTH     = 0xFFFF;
+static const size_t CCM_MAX_AAD_LENGTH = 0xFEFF;
+
+/**
+ * Copy @p length octets of @p in into @p out in reverse order, converting
+ * between the least significant octet first representation of BLE API and
+ * the most significant octet first one of AES.
+ */
+static void
+reverseCopy(uint8_t *out, const uint8_t *in, size_t length)
+{
+    for (size_t i = 0; i < length; ++i) {
+        out[i] = in[length - 1 - i];
+    }
+}
+
+/**
+ * Compute out = e(k, in), all three least significant octet first.
+ */
+static ble_error_t
+encryptReversed(CryptoBackend &backend, const uint8_t k[16], const uint8_t in[16], uint8_t out[16])
+{
+    uint8_t key[16];
+    uint8_t block[16];
+    reverseCopy(key, k, sizeof(key));
+    reverseCopy(block, in, sizeof(block));
+
+    ble_error_t err = backend.encrypt(key, block, block);
+    if (err == BLE_ERROR_NONE) {
+        reverseCopy(out, block, sizeof(block));
+    }
+
+    return err;
+}
+
+/**
+ * Left shift of a block by one bit, for the CMAC subkeys.
+ */
+static void
+shiftLeft(uint8_t *out, const uint8_t *in)
+{
+    uint8_t overflow = 0;
+    for (int i = 15; i >= 0; --i) {
+        uint8_t value = in[i];
+        out[i]   = (uint8_t)((value << 1) | overflow);
+        overflow = value >> 7;
+    }
+}
+
+/**
+ * CBC-MAC fed octet by octet.
+ */
+struct CbcMac {
+    CbcMac(CryptoBackend &backendIn, const uint8_t *keyIn) :
+        backend(backendIn), key(keyIn), fill(0), err(BLE_ERROR_NONE) {
+        memset(block, 0, sizeof(block));
+    }
+
+    void absorb(const uint8_t *data, size_t length) {
+        for (size_t i = 0; i < length; ++i) {
+            block[fill++] ^= data[i];
+            if (fill == sizeof(block)) {
+                flush();
+            }
+        }
+    }
+
+    /* Zero-pad the current block, if started. */
+    void pad(void) {
+        if (fill != 0) {
+            flush();
+        }
+    }
+
+    void flush(void) {
+        if (err == BLE_ERROR_NONE) {
+            err = backend.encrypt(key, block, block);
+        }
+        fill = 0;
+    }
+
+    CryptoBackend &backend;
+    const uint8_t *key;
+    uint8_t        block[16];
+    size_t         fill;
+    ble_error_t    err;
+};
+
+ble_error_t
+CryptoBackend::ah(const uint8_t irk[BLOCK_SIZE], const uint8_t r[3], uint8_t hash[3])
+{
+    uint8_t block[BLOCK_SIZE] = { 0 };
+    memcpy(block, r, 3);
+
+    ble_error_t err = encryptReversed(*this, irk, block, block);
+    if (err == BLE_ERROR_NONE) {
+        memcpy(hash, block, 3);
+    }
+
+    return err;
+}
+
+ble_error_t
+CryptoBackend::c1(const uint8_t k[BLOCK_SIZE],
+                  const uint8_t r[BLOCK_SIZE],
+                  const uint8_t preq[7],
+                  const uint8_t pres[7],
+                  uint8_t       iat,
+                  const uint8_t ia[6],
+                  uint8_t       rat,
+                  const uint8_t ra[6],
+                  uint8_t       confirm[BLOCK_SIZE])
+{
+    /* p1 = pres || preq || rat' || iat' and p2 = padding || ia || ra, here
+     * least significant octet first. */
+    uint8_t p1[BLOCK_SIZE];
+    p1[0] = iat;
+    p1[1] = rat;
+    memcpy(&p1[2], preq, 7);
+    memcpy(&p1[9], pres, 7);
+
+    uint8_t p2[BLOCK_SIZE] = { 0 };
+    memcpy(&p2[0], ra, 6);
+    memcpy(&p2[6], ia, 6);
+
+    uint8_t block[BLOCK_SIZE];
+    for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+        block[i] = r[i] ^ p1[i];
+    }
+
+    ble_error_t err = encryptReversed(*this, k, block, block);
+    if (err != BLE_ERROR_NONE) {
+        return err;
+    }
+
+    for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+        block[i] ^= p2[i];
+    }
+
+    return encryptReversed(*this, k, block, confirm);
+}
+
+ble_error_t
+CryptoBackend::s1(const uint8_t k[BLOCK_SIZE],
+                  const uint8_t r1[BLOCK_SIZE],
+                  const uint8_t r2[BLOCK_SIZE],
+                  uint8_t       stk[BLOCK_SIZE])
+{
+    /* r' = r1' || r2', the least significant halves of both numbers. */
+    uint8_t block[BLOCK_SIZE];
+    memcpy(&block[0], r2, 8);
+    memcpy(&block[8], r1, 8);
+
+    return encryptReversed(*this, k, block, stk);
+}
+
+ble_error_t
+CryptoBackend::cmac(const uint8_t  key[BLOCK_SIZE],
+                    const uint8_t *message,
+                    size_t         length,
+                    uint8_t        mac[BLOCK_SIZE])
+{
+    /* Subkeys K1 and K2. */
+    uint8_t subkey[BLOCK_SIZE] = { 0 };
+    ble_error_t err = encrypt(key, subkey, subkey);
+    if (err != BLE_ERROR_NONE) {
+        return err;
+    }
+
+    bool complete = (length != 0) && ((length % BLOCK_SIZE) == 0);
+    for (unsigned i = 0; i < (complete ? 1U : 2U); ++i) {
+        uint8_t msb = subkey[0] & 0x80;
+        shiftLeft(subkey, subkey);
+        if (msb) {
+            subkey[BLOCK_SIZE - 1] ^= 0x87;
+        }
+    }
+
+    /* All blocks but the last one are chained as is. */
+    size_t lastOffset = complete ? (length - BLOCK_SIZE) : (length - (length % BLOCK_SIZE));
+    CbcMac chain(*this, key);
+    chain.absorb(message, lastOffset);
+
+    /* The last block is padded if incomplete and masked with a subkey. */
+    uint8_t last[BLOCK_SIZE] = { 0 };
+    size_t  lastLength = length - lastOffset;
+    if (lastLength != 0) {
+        memcpy(last, &message[lastOffset], lastLength);
+    }
+    if (!complete) {
+        last[lastLength] = 0x80;
+    }
+    for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+        last[i] ^= subkey[i];
+    }
+    chain.absorb(last, BLOCK_SIZE);
+
+    if (chain.err == BLE_ERROR_NONE) {
+        memcpy(mac, chain.block, BLOCK_SIZE);
+    }
+
+    return chain.err;
+}
+
+ble_error_t
+CryptoBackend::ccmEncrypt(const uint8_t  key[BLOCK_SIZE],
+                          const uint8_t  nonce[CCM_NONCE_SIZE],
+                          const uint8_t *aad,
+                          size_t         aadLength,
+                          uint8_t       *data,
+                          size_t         length,
+                          uint8_t       *mic,
+                          size_t         micLength)
+{
+    uint8_t tag[BLOCK_SIZE];
+    ble_error_t err = ccmMac(key, nonce, aad, aadLength, data, length, micLength, tag);
+    if (err != BLE_ERROR_NONE) {
+        return err;
+    }
+
+    err = ccmCtr(key, nonce, data, length, tag);
+    if (err == BLE_ERROR_NONE) {
+        memcpy(mic, tag, micLength);
+    }
+
+    return err;
+}
+
+ble_error_t
+CryptoBackend::ccmDecrypt(const uint8_t  key[BLOCK_SIZE],
+                          const uint8_t  nonce[CCM_NONCE_SIZE],
+                          const uint8_t *aad,
+                          size_t         aadLength,
+                          uint8_t       *data,
+                          size_t         length,
+                          const uint8_t *mic,
+                          size_t         micLength)
+{
+    if ((micLength < 4) || (micLength > BLOCK_SIZE) || ((micLength % 2) != 0) ||
+        (length > CCM_MAX_LENGTH) || (aadLength > CCM_MAX_AAD_LENGTH)) {
+        return BLE_ERROR_INVALID_PARAM;
+    }
+
+    /* Recover the tag along with the plaintext. */
+    uint8_t received[BLOCK_SIZE] = { 0 };
+    memcpy(received, mic, micLength);
+    ble_error_t err = ccmCtr(key, nonce, data, length, received);
+    if (err != BLE_ERROR_NONE) {
+        return err;
+    }
+
+    uint8_t expected[BLOCK_SIZE];
+    err = ccmMac(key, nonce, aad, aadLength, data, length, micLength, expected);
+    if (err != BLE_ERROR_NONE) {
+        return err;
+    }
+
+    /* Compare in constant time. */
+    uint8_t difference = 0;
+    for (size_t i = 0; i < micLength; ++i) {
+        difference |= received[i] ^ expected[i];
+    }
+    if (difference != 0) {
+        memset(data, 0, length);
+        return BLE_ERROR_OPERATION_NOT_PERMITTED;
+    }
+
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t
+CryptoBackend::ccmMac(const uint8_t  key[BLOCK_SIZE],
+                      const uint8_t  nonce[CCM_NONCE_SIZE],
+                      const uint8_t *aad,
+                      size_t         aadLength,
+                      const uint8_t *data,
+                      size_t         length,
+                      size_t         micLength,
+                      uint8_t        tag[BLOCK_SIZE])
+{
+    if ((micLength < 4) || (micLength > BLOCK_SIZE) || ((micLength % 2) != 0) ||
+        (length > CCM_MAX_LENGTH) || (aadLength > CCM_MAX_AAD_LENGTH)) {
+        return BLE_ERROR_INVALID_PARAM;
+    }
+
+    /* B0: flags (Adata, M' and L' = 1), nonce and length of the data. */
+    uint8_t b0[BLOCK_SIZE];
+    b0[0] = (uint8_t)(((aadLength != 0) ? 0x40 : 0x00) | (((micLength - 2) / 2) << 3) | 0x01);
+    memcpy(&b0[1], nonce, CCM_NONCE_SIZE);
+    b0[14] = (uint8_t)(length >> 8);
+    b0[15] = (uint8_t)(length);
+
+    CbcMac mac(*this, key);
+    mac.absorb(b0, sizeof(b0));
+
+    if (aadLength != 0) {
+        uint8_t encodedLength[2] = { (uint8_t)(aadLength >> 8), (uint8_t)(aadLength) };
+        mac.absorb(encodedLength, sizeof(encodedLength));
+        mac.absorb(aad, aadLength);
+        mac.pad();
+    }
+
+    mac.absorb(data, length);
+    mac.pad();
+
+    if (mac.err == BLE_ERROR_NONE) {
+        memcpy(tag, mac.block, BLOCK_SIZE);
+    }
+
+    return mac.err;
+}
+
+ble_error_t
+CryptoBackend::ccmCtr(const uint8_t  key[BLOCK_SIZE],
+                      const uint8_t  nonce[CCM_NONCE_SIZE],
+                      uint8_t       *data,
+                      size_t         length,
+                      uint8_t        tag[BLOCK_SIZE])
+{
+    /* A_i: flags (L' = 1), nonce and counter. A_0 masks the tag, the
+     * following ones the data. */
+    uint8_t counter[BLOCK_SIZE];
+    uint8_t stream[BLOCK_SIZE];
+    counter[0] = 0x01;
+    memcpy(&counter[1], nonce, CCM_NONCE_SIZE);
+
+    for (size_t block = 0, offset = 0; (block == 0) || (offset < length); ++block) {
+        counter[14] = (uint8_t)(block >> 8);
+        counter[15] = (uint8_t)(block);
+
+        ble_error_t err = encrypt(key, counter, stream);
+        if (err != BLE_ERROR_NONE) {
+            return err;
+        }
+
+        if (block == 0) {
+            for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+                tag[i] ^= stream[i];
+            }
+        } else {
+            for (size_t i = 0; (i < BLOCK_SIZE) && (offset < length); ++i) {
+                data[offset++] ^= stream[i];
+            }
+        }
+    }
+
+    return BLE_ERROR_NONE;
+}
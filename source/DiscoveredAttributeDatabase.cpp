@@ -0,0 +1,399 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "ble/DiscoveredAttributeDatabase.h"
+#include "ble/DiscoveredCharacteristicDescriptor.h"
+#include "ble/GattClient.h"
+
+DiscoveredAttributeDatabase::DiscoveredAttributeDatabase(Attribute_t *attributeStorage,
+                                                         uint16_t    *handleIndexStorage,
+                                                         uint16_t    *uuidIndexStorage,
+                                                         uint16_t     capacityIn) :
+    attributes(attributeStorage),
+    handleIndex(handleIndexStorage),
+    uuidIndex(uuidIndexStorage),
+    capacity((capacityIn < MAX_CAPACITY) ? capacityIn : MAX_CAPACITY),
+    count(0),
+    overflowed(false),
+    connHandle(0),
+    gattc(NULL),
+    serviceDiscoveryActive(false),
+    descriptorDiscoveryActive(false),
+    serviceCallback(),
+    characteristicCallback(),
+    terminationCallback(),
+    descriptorCallback(),
+    descriptorTerminationCallback()
+{
+    memset(uuidIndex, 0, getTableSize() * sizeof(uint16_t));
+}
+
+ble_error_t
+DiscoveredAttributeDatabase::launchServiceDiscovery(GattClient                                 &client,
+                                                    Gap::Handle_t                               connectionHandle,
+                                                    ServiceDiscovery::ServiceCallback_t         sc,
+                                                    ServiceDiscovery::CharacteristicCallback_t  cc,
+                                                    ServiceDiscovery::TerminationCallback_t     tc,
+                                                    const UUID                                 &matchingServiceUUID,
+                                                    const UUID                                 &matchingCharacteristicUUIDIn)
+{
+    ble_error_t err = prepareServiceDiscovery(client, connectionHandle, sc, cc, tc);
+    if (err != BLE_ERROR_NONE) {
+        return err;
+    }
+
+    err = client.launchServiceDiscovery(connectionHandle,
+                                        makeFunctionPointer(this, &DiscoveredAttributeDatabase::onServiceDiscovered),
+                                        makeFunctionPointer(this, &DiscoveredAttributeDatabase::onCharacteristicDiscovered),
+                                        matchingServiceUUID,
+                                        matchingCharacteristicUUIDIn);
+    completeServiceDiscoveryLaunch(err);
+
+    return err;
+}
+
+ble_error_t
+DiscoveredAttributeDatabase::launchServiceDiscovery(GattClient                                 &client,
+                                                    Gap::Handle_t                               connectionHandle,
+                                                    ServiceDiscovery::ServiceCallback_t         sc,
+                                                    ServiceDiscovery::CharacteristicCallback_t  cc,
+                                                    ServiceDiscovery::TerminationCallback_t     tc,
+                                                    const UUIDSet                              &matchingServiceUUIDs,
+                                                    const UUIDSet                              &matchingCharacteristicUUIDs)
+{
+    ble_error_t err = prepareServiceDiscovery(client, connectionHandle, sc, cc, tc);
+    if (err != BLE_ERROR_NONE) {
+        return err;
+    }
+
+    err = client.launchServiceDiscovery(connectionHandle,
+                                        makeFunctionPointer(this, &DiscoveredAttributeDatabase::onServiceDiscovered),
+                                        makeFunctionPointer(this, &DiscoveredAttributeDatabase::onCharacteristicDiscovered),
+                                        matchingServiceUUIDs,
+                                        matchingCharacteristicUUIDs);
+    completeServiceDiscoveryLaunch(err);
+
+    return err;
+}
+
+ble_error_t
+DiscoveredAttributeDatabase::discoverDescriptors(const DiscoveredCharacteristic                                &characteristic,
+                                                 const CharacteristicDescriptorDiscovery::DiscoveryCallback_t   &discoveryCallback,
+                                                 const CharacteristicDescriptorDiscovery::TerminationCallback_t &terminationCallback)
+{
+    if (descriptorDiscoveryActive) {
+        return BLE_STACK_BUSY;
+    }
+    if ((gattc == NULL) || (characteristic.getConnectionHandle() != connHandle)) {
+        return BLE_ERROR_INVALID_PARAM;
+    }
+
+    descriptorCallback            = discoveryCallback;
+    descriptorTerminationCallback = terminationCallback;
+
+    ble_error_t err = gattc->discoverCharacteristicDescriptors(
+        characteristic,
+        makeFunctionPointer(this, &DiscoveredAttributeDatabase::onDescriptorDiscovered),
+        makeFunctionPointer(this, &DiscoveredAttributeDatabase::onDescriptorDiscoveryTermination)
+    );
+    descriptorDiscoveryActive = (err == BLE_ERROR_NONE);
+
+    return err;
+}
+
+ble_error_t
+DiscoveredAttributeDatabase::addService(const UUID &uuid, GattAttribute::Handle_t startHandle, GattAttribute::Handle_t endHandle)
+{
+    return add(SERVICE, uuid, startHandle, endHandle, startHandle, NULL);
+}
+
+ble_error_t
+DiscoveredAttributeDatabase::addCharacteristic(const UUID                                   &uuid,
+                                               GattAttribute::Handle_t                       declHandle,
+                                               GattAttribute::Handle_t                       valueHandle,
+                                               GattAttribute::Handle_t                       lastHandle,
+                                               const DiscoveredCharacteristic::Properties_t &properties)
+{
+    return add(CHARACTERISTIC, uuid, declHandle, lastHandle, valueHandle, &properties);
+}
+
+ble_error_t
+DiscoveredAttributeDatabase::addDescriptor(const UUID &uuid, GattAttribute::Handle_t handle)
+{
+    return add(DESCRIPTOR, uuid, handle, handle, handle, NULL);
+}
+
+void
+DiscoveredAttributeDatabase::clear(void)
+{
+    count      = 0;
+    overflowed = false;
+    connHandle = 0;
+    gattc      = NULL;
+    memset(uuidIndex, 0, getTableSize() * sizeof(uint16_t));
+}
+
+const DiscoveredAttributeDatabase::Attribute_t *
+DiscoveredAttributeDatabase::findByHandle(GattAttribute::Handle_t handle) const
+{
+    uint16_t position = lowerBound(handle);
+    if ((position < count) && (attributes[handleIndex[position]].handle == handle)) {
+        return &attributes[handleIndex[position]];
+    }
+
+    return NULL;
+}
+
+const DiscoveredAttributeDatabase::Attribute_t *
+DiscoveredAttributeDatabase::findEnclosing(GattAttribute::Handle_t handle, AttributeType_t type) const
+{
+    /* Start from the last attribute whose handle is not greater than the one
+     * looked for. Attributes of a given type don't overlap so the first one of
+     * that type met while walking backward is the only candidate. */
+    uint16_t position = lowerBound(handle);
+    if ((position < count) && (attributes[handleIndex[position]].handle == handle)) {
+        ++position;
+    }
+
+    while (position-- > 0) {
+        const Attribute_t &attribute = attributes[handleIndex[position]];
+        if (attribute.type == type) {
+            return (attribute.endHandle >= handle) ? &attribute : NULL;
+        }
+    }
+
+    return NULL;
+}
+
+const DiscoveredAttributeDatabase::Attribute_t *
+DiscoveredAttributeDatabase::findByUUID(const UUID &uuid, AttributeType_t type, const Attribute_t *previous) const
+{
+    if (capacity == 0) {
+        return NULL;
+    }
+
+    bool skipping = (previous != NULL);
+
+    for (uint16_t slot = hashSlot(uuid); uuidIndex[slot] != 0; slot = nextSlot(slot)) {
+        const Attribute_t &attribute = attributes[uuidIndex[slot] - 1];
+        if (skipping) {
+            skipping = (&attribute != previous);
+            continue;
+        }
+        if ((attribute.type == type) && (attribute.uuid == uuid)) {
+            return &attribute;
+        }
+    }
+
+    return NULL;
+}
+
+const DiscoveredAttributeDatabase::Attribute_t *
+DiscoveredAttributeDatabase::findCharacteristic(const UUID &serviceUUID, const UUID &characteristicUUID) const
+{
+    for (const Attribute_t *service = findByUUID(serviceUUID, SERVICE);
+         service != NULL;
+         service = findByUUID(serviceUUID, SERVICE, service)) {
+        for (const Attribute_t *characteristic = findByUUID(characteristicUUID, CHARACTERISTIC);
+             characteristic != NULL;
+             characteristic = findByUUID(characteristicUUID, CHARACTERISTIC, characteristic)) {
+            if ((characteristic->handle >= service->handle) && (characteristic->handle <= service->endHandle)) {
+                return characteristic;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+ble_error_t
+DiscoveredAttributeDatabase::add(uint8_t type, const UUID &uuid, GattAttribute::Handle_t handle,
+                                 GattAttribute::Handle_t endHandle, GattAttribute::Handle_t valueHandle,
+                                 const DiscoveredCharacteristic::Properties_t *properties)
+{
+    uint16_t position = lowerBound(handle);
+    if ((position < count) && (attributes[handleIndex[position]].handle == handle)) {
+        /* Already recorded by a previous discovery. */
+        return BLE_ERROR_NONE;
+    }
+
+    if (count == capacity) {
+        overflowed = true;
+        return BLE_ERROR_NO_MEM;
+    }
+
+    Attribute_t &attribute = attributes[count];
+    attribute.uuid        = uuid;
+    attribute.handle      = handle;
+    attribute.endHandle   = endHandle;
+    attribute.valueHandle = valueHandle;
+    attribute.properties  = (properties != NULL) ? *properties : DiscoveredCharacteristic::Properties_t();
+    attribute.type        = type;
+
+    /* Keep the handle index sorted. */
+    memmove(&handleIndex[position + 1], &handleIndex[position], (count - position) * sizeof(uint16_t));
+    handleIndex[position] = count;
+
+    /* Insert in the first free slot of the probe sequence. */
+    uint16_t slot = hashSlot(uuid);
+    while (uuidIndex[slot] != 0) {
+        slot = nextSlot(slot);
+    }
+    uuidIndex[slot] = ++count;
+
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t
+DiscoveredAttributeDatabase::prepareServiceDiscovery(GattClient &client, Gap::Handle_t connectionHandle,
+                                                     ServiceDiscovery::ServiceCallback_t sc,
+                                                     ServiceDiscovery::CharacteristicCallback_t cc,
+                                                     ServiceDiscovery::TerminationCallback_t tc)
+{
+    if (serviceDiscoveryActive || descriptorDiscoveryActive) {
+        return BLE_STACK_BUSY;
+    }
+
+    clear();
+    gattc                  = &client;
+    connHandle             = connectionHandle;
+    serviceCallback        = sc;
+    characteristicCallback = cc;
+    terminationCallback    = tc;
+
+    /* Set before the launch, for the terminations reported during it. */
+    serviceDiscoveryActive = true;
+
+    return BLE_ERROR_NONE;
+}
+
+void
+DiscoveredAttributeDatabase::completeServiceDiscoveryLaunch(ble_error_t status)
+{
+    if (status != BLE_ERROR_NONE) {
+        serviceDiscoveryActive = false;
+        return;
+    }
+    if (!serviceDiscoveryActive) {
+        /* Terminated during the launch. */
+        return;
+    }
+
+    /* Ports which don't report terminations per connection report them to
+     * the callback common to all connections. */
+    ServiceDiscovery::TerminationCallback_t callback =
+        makeFunctionPointer(this, &DiscoveredAttributeDatabase::onServiceDiscoveryTermination);
+    ble_error_t err = gattc->onServiceDiscoveryTerminationOn(connHandle, callback);
+    if (err == BLE_ERROR_NOT_IMPLEMENTED) {
+        gattc->onServiceDiscoveryTermination(callback);
+        err = BLE_ERROR_NONE;
+    }
+
+    /* The discovery may have terminated before the callback was set. */
+    if ((err != BLE_ERROR_NONE) || !gattc->isServiceDiscoveryActiveOn(connHandle)) {
+        onServiceDiscoveryTermination(connHandle);
+    }
+}
+
+uint16_t
+DiscoveredAttributeDatabase::lowerBound(GattAttribute::Handle_t handle) const
+{
+    uint16_t low  = 0;
+    uint16_t high = count;
+
+    while (low < high) {
+        uint16_t middle = low + (high - low) / 2;
+        if (attributes[handleIndex[middle]].handle < handle) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+uint16_t
+DiscoveredAttributeDatabase::hashSlot(const UUID &uuid) const
+{
+    return (uint16_t)(uuid.hash() % getTableSize());
+}
+
+uint16_t
+DiscoveredAttributeDatabase::nextSlot(uint16_t slot) const
+{
+    return (uint16_t)((slot + 1) % getTableSize());
+}
+
+void
+DiscoveredAttributeDatabase::onServiceDiscovered(const DiscoveredService *service)
+{
+    addService(service->getUUID(), service->getStartHandle(), service->getEndHandle());
+
+    if (serviceCallback) {
+        serviceCallback(service);
+    }
+}
+
+void
+DiscoveredAttributeDatabase::onCharacteristicDiscovered(const DiscoveredCharacteristic *characteristic)
+{
+    addCharacteristic(characteristic->getUUID(),
+                      characteristic->getDeclHandle(),
+                      characteristic->getValueHandle(),
+                      characteristic->getLastHandle(),
+                      characteristic->getProperties());
+
+    if (characteristicCallback) {
+        characteristicCallback(characteristic);
+    }
+}
+
+void
+DiscoveredAttributeDatabase::onServiceDiscoveryTermination(Gap::Handle_t connectionHandle)
+{
+    /* The callback common to all connections reports the others too. */
+    if (!serviceDiscoveryActive || (connectionHandle != connHandle)) {
+        return;
+    }
+    serviceDiscoveryActive = false;
+
+    if (terminationCallback) {
+        terminationCallback(connectionHandle);
+    }
+}
+
+void
+DiscoveredAttributeDatabase::onDescriptorDiscovered(const CharacteristicDescriptorDiscovery::DiscoveryCallbackParams_t *params)
+{
+    addDescriptor(params->descriptor.getUUID(), params->descriptor.getAttributeHandle());
+
+    if (descriptorCallback) {
+        descriptorCallback(params);
+    }
+}
+
+void
+DiscoveredAttributeDatabase::onDescriptorDiscoveryTermination(const CharacteristicDescriptorDiscovery::TerminationCallbackParams_t *params)
+{
+    descriptorDiscoveryActive = false;
+
+    if (descriptorTerminationCallback) {
+        descriptorTerminationCallback(params);
+    }
+}
@@ -105,6 +105,20 @@ DiscoveredCharacteristic::writeWoResponse(uint16_t length, const uint8_t *value)
     return gattc->write(GattClient::GATT_OP_WRITE_CMD, connHandle, valueHandle, length, value);
 }
 
+ble_error_t
+DiscoveredCharacteristic::writeBurst(size_t length, const uint8_t *value, const GattClient::BurstWriteCallback_t &onComplete) const
+{
+    if (!props.writeWoResp()) {
+        return BLE_ERROR_OPERATION_NOT_PERMITTED;
+    }
+
+    if (!gattc) {
+        return BLE_ERROR_INVALID_STATE;
+    }
+
+    return gattc->writeBurst(connHandle, valueHandle, length, value, onComplete);
+}
+
 struct OneShotWriteCallback {
     static void launch(GattClient* client, Gap::Handle_t connHandle,
                        GattAttribute::Handle_t handle, const GattClient::WriteCallback_t& cb) {
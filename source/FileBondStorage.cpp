@@ -0,0 +1,144 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "ble/FileBondStorage.h"
+
+/* Size of the buffer through which sectors are erased and programmed. */
+static const size_t CHUNK_SIZE = 64;
+
+FileBondStorage::FileBondStorage(const char *pathIn, size_t sectorSizeIn, unsigned sectorCountIn) :
+    path(pathIn),
+    sectorSize(sectorSizeIn),
+    sectorCount(sectorCountIn),
+    file(NULL)
+{
+    /* empty */
+}
+
+FileBondStorage::~FileBondStorage()
+{
+    close();
+}
+
+ble_error_t
+FileBondStorage::open(void)
+{
+    close();
+
+    long expectedSize = (long)(sectorSize * sectorCount);
+    file = fopen(path, "r+b");
+    if (file != NULL) {
+        if ((fseek(file, 0, SEEK_END) == 0) && (ftell(file) == expectedSize)) {
+            return BLE_ERROR_NONE;
+        }
+        fclose(file);
+    }
+
+    /* Missing or of another geometry: start over with erased sectors. */
+    file = fopen(path, "w+b");
+    if (file == NULL) {
+        return BLE_ERROR_UNSPECIFIED;
+    }
+    for (unsigned i = 0; i < sectorCount; ++i) {
+        if (erase(i) != BLE_ERROR_NONE) {
+            close();
+            return BLE_ERROR_UNSPECIFIED;
+        }
+    }
+
+    return BLE_ERROR_NONE;
+}
+
+void
+FileBondStorage::close(void)
+{
+    if (file != NULL) {
+        fclose(file);
+        file = NULL;
+    }
+}
+
+ble_error_t
+FileBondStorage::read(unsigned sector, size_t offset, void *buffer, size_t length)
+{
+    if (!seek(sector, offset, length)) {
+        return BLE_ERROR_INVALID_PARAM;
+    }
+
+    return (fread(buffer, 1, length, file) == length) ? BLE_ERROR_NONE : BLE_ERROR_UNSPECIFIED;
+}
+
+ble_error_t
+FileBondStorage::program(unsigned sector, size_t offset, const void *data, size_t length)
+{
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    uint8_t        chunk[CHUNK_SIZE];
+
+    while (length != 0) {
+        size_t chunkLength = (length < CHUNK_SIZE) ? length : CHUNK_SIZE;
+
+        /* Programming only clears bits. */
+        ble_error_t err = read(sector, offset, chunk, chunkLength);
+        if (err != BLE_ERROR_NONE) {
+            return err;
+        }
+        for (size_t i = 0; i < chunkLength; ++i) {
+            chunk[i] &= bytes[i];
+        }
+
+        if (!seek(sector, offset, chunkLength) || (fwrite(chunk, 1, chunkLength, file) != chunkLength)) {
+            return BLE_ERROR_UNSPECIFIED;
+        }
+
+        bytes  += chunkLength;
+        offset += chunkLength;
+        length -= chunkLength;
+    }
+
+    return (fflush(file) == 0) ? BLE_ERROR_NONE : BLE_ERROR_UNSPECIFIED;
+}
+
+ble_error_t
+FileBondStorage::erase(unsigned sector)
+{
+    if (!seek(sector, 0, sectorSize)) {
+        return BLE_ERROR_INVALID_PARAM;
+    }
+
+    uint8_t chunk[CHUNK_SIZE];
+    memset(chunk, 0xFF, sizeof(chunk));
+    for (size_t offset = 0; offset < sectorSize; offset += CHUNK_SIZE) {
+        size_t chunkLength = ((sectorSize - offset) < CHUNK_SIZE) ? (sectorSize - offset) : CHUNK_SIZE;
+        if (fwrite(chunk, 1, chunkLength, file) != chunkLength) {
+            return BLE_ERROR_UNSPECIFIED;
+        }
+    }
+
+    return (fflush(file) == 0) ? BLE_ERROR_NONE : BLE_ERROR_UNSPECIFIED;
+}
+
+bool
+FileBondStorage::seek(unsigned sector, size_t offset, size_t length)
+{
+    if ((file == NULL) || (sector >= sectorCount) || (offset > sectorSize) || (length > (sectorSize - offset))) {
+        return false;
+    }
+
+    return fseek(file, (long)((sector * sectorSize) + offset), SEEK_SET) == 0;
+}
@@ -0,0 +1,312 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ble/GattClient.h"
+#include "ble/GattClientFuture.h"
+
+/* Size of the header of an ATT Write Command: opcode and attribute handle. */
+static const uint16_t ATT_WRITE_CMD_HEADER_SIZE = 3;
+
+ble_error_t
+GattClient::writeBurst(Gap::Handle_t               connHandle,
+                       GattAttribute::Handle_t     attributeHandle,
+                       size_t                      length,
+                       const uint8_t              *value,
+                       const BurstWriteCallback_t &onComplete)
+{
+    if ((length == 0) || (value == NULL)) {
+        return BLE_ERROR_INVALID_PARAM;
+    }
+
+    if (findBurstWrite(connHandle) != NULL) {
+        return BLE_STACK_BUSY;
+    }
+
+    BurstWrite_t *burst = NULL;
+    for (unsigned i = 0; i < MAX_BURST_WRITES; ++i) {
+        if (!burstWrites[i].active) {
+            burst = &burstWrites[i];
+            break;
+        }
+    }
+    if (burst == NULL) {
+        return BLE_ERROR_NO_MEM;
+    }
+
+    burst->active          = true;
+    burst->connHandle      = connHandle;
+    burst->attributeHandle = attributeHandle;
+    burst->value           = value;
+    burst->length          = length;
+    burst->offset          = 0;
+    burst->inFlight        = 0;
+    burst->onComplete      = onComplete;
+
+    ble_error_t err = pumpBurstWrite(*burst);
+    if (err != BLE_ERROR_NONE) {
+        burst->active = false;
+    }
+
+    return err;
+}
+
+bool
+GattClient::isBurstWriteActive(Gap::Handle_t connHandle) const
+{
+    for (unsigned i = 0; i < MAX_BURST_WRITES; ++i) {
+        if (burstWrites[i].active && (burstWrites[i].connHandle == connHandle)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void
+GattClient::cancelBurstWrite(Gap::Handle_t connHandle)
+{
+    BurstWrite_t *burst = findBurstWrite(connHandle);
+    if (burst != NULL) {
+        completeBurstWrite(*burst, BLE_ERROR_INVALID_STATE);
+    }
+}
+
+void
+GattClient::processDataSentEvent(Gap::Handle_t connHandle, unsigned count)
+{
+    BLE_STATS_START(stats);
+    BLE_TRACE_RECORD(trace, recordClientDataSentEvent(connHandle, count));
+
+    BurstWrite_t *burst = findBurstWrite(connHandle);
+    if (burst != NULL) {
+        /* Packets sent may include write commands issued outside of the burst. */
+        burst->inFlight -= (count < burst->inFlight) ? count : burst->inFlight;
+
+        ble_error_t err = pumpBurstWrite(*burst);
+        if (err != BLE_ERROR_NONE) {
+            completeBurstWrite(*burst, err);
+        } else if ((burst->offset == burst->length) && (burst->inFlight == 0)) {
+            completeBurstWrite(*burst, BLE_ERROR_NONE);
+        }
+    }
+
+    if (dataSentCallChain) {
+        GattDataSentCallbackParams params = {
+            connHandle,
+            count
+        };
+        dataSentCallChain(&params);
+    }
+
+    BLE_STATS_RECORD(stats, BLEStats::GATT_CLIENT_DATA_SENT);
+}
+
+GattClient::BurstWrite_t *
+GattClient::findBurstWrite(Gap::Handle_t connHandle)
+{
+    for (unsigned i = 0; i < MAX_BURST_WRITES; ++i) {
+        if (burstWrites[i].active && (burstWrites[i].connHandle == connHandle)) {
+            return &burstWrites[i];
+        }
+    }
+
+    return NULL;
+}
+
+ble_error_t
+GattClient::pumpBurstWrite(BurstWrite_t &burst)
+{
+    uint16_t mtu = getAttMtu(burst.connHandle);
+    if (mtu < BLE_GATT_MTU_SIZE_DEFAULT) {
+        mtu = BLE_GATT_MTU_SIZE_DEFAULT;
+    }
+    const size_t segmentSize = mtu - ATT_WRITE_CMD_HEADER_SIZE;
+
+    uint16_t credits      = 0;
+    bool     creditsKnown = (getWriteWithoutResponseCredits(burst.connHandle, credits) == BLE_ERROR_NONE);
+
+    while (burst.offset < burst.length) {
+        if (creditsKnown && (credits == 0)) {
+            break;
+        }
+
+        size_t segmentLength = burst.length - burst.offset;
+        if (segmentLength > segmentSize) {
+            segmentLength = segmentSize;
+        }
+
+        ble_error_t err = write(GATT_OP_WRITE_CMD, burst.connHandle, burst.attributeHandle, segmentLength, burst.value + burst.offset);
+        if ((err == BLE_ERROR_NO_MEM) || (err == BLE_STACK_BUSY)) {
+            /* Out of buffers; resume on the next data sent event, unless no
+             * packet of the burst is left to trigger one. */
+            if (burst.inFlight == 0) {
+                return err;
+            }
+            break;
+        } else if (err != BLE_ERROR_NONE) {
+            return err;
+        }
+
+        burst.offset += segmentLength;
+        ++burst.inFlight;
+        if (creditsKnown) {
+            --credits;
+        }
+    }
+
+    return BLE_ERROR_NONE;
+}
+
+void
+GattClient::completeBurstWrite(BurstWrite_t &burst, ble_error_t status)
+{
+    /* Release the slot first: the callback may start a new burst. */
+    burst.active = false;
+
+    GattBurstWriteCallbackParams params = {
+        burst.connHandle,
+        burst.attributeHandle,
+        status,
+        burst.offset
+    };
+    if (burst.onComplete) {
+        BurstWriteCallback_t onComplete = burst.onComplete;
+        onComplete(&params);
+    }
+}
+
+void
+GattClient::attachFuture(GattClientFuture *future)
+{
+    /* Keep the oldest futures first: the server answers requests in order. */
+    future->next = NULL;
+
+    GattClientFuture **link = &pendingFutures;
+    while (*link != NULL) {
+        link = &(*link)->next;
+    }
+    *link = future;
+}
+
+void
+GattClient::detachFuture(GattClientFuture *future)
+{
+    for (GattClientFuture **link = &pendingFutures; *link != NULL; link = &(*link)->next) {
+        if (*link == future) {
+            *link = future->next;
+            future->next = NULL;
+            return;
+        }
+    }
+}
+
+void
+GattClient::completeReadFuture(const GattReadCallbackParams *params)
+{
+    for (GattClientFuture *future = pendingFutures; future != NULL; future = future->next) {
+        if (future->matches(GattClientFuture::OPERATION_READ, params->connHandle, params->handle)) {
+            detachFuture(future);
+            future->store(GattClientFuture::STATE_COMPLETED, params->data, params->len);
+            future->notify();
+            return;
+        }
+    }
+}
+
+void
+GattClient::completeWriteFuture(const GattWriteCallbackParams *params)
+{
+    if (params->writeOp != GattWriteCallbackParams::OP_WRITE_REQ) {
+        return;
+    }
+
+    for (GattClientFuture *future = pendingFutures; future != NULL; future = future->next) {
+        if (future->matches(GattClientFuture::OPERATION_WRITE, params->connHandle, params->handle)) {
+            detachFuture(future);
+            future->store(GattClientFuture::STATE_COMPLETED, NULL, 0);
+            future->notify();
+            return;
+        }
+    }
+}
+
+void
+GattClient::completeUpdateFutures(const GattHVXCallbackParams *params)
+{
+    /* Every future waiting for the attribute completes. Futures re-armed by
+     * their callback are linked after the ones already waiting and must wait
+     * for the next update, hence the count taken upfront. */
+    unsigned count = 0;
+    for (GattClientFuture *future = pendingFutures; future != NULL; future = future->next) {
+        if (future->matches(GattClientFuture::OPERATION_UPDATE, params->connHandle, params->handle)) {
+            ++count;
+        }
+    }
+
+    while (count-- != 0) {
+        GattClientFuture *future = pendingFutures;
+        while ((future != NULL) &&
+               !future->matches(GattClientFuture::OPERATION_UPDATE, params->connHandle, params->handle)) {
+            future = future->next;
+        }
+        if (future == NULL) {
+            return;
+        }
+
+        detachFuture(future);
+        future->store(GattClientFuture::STATE_COMPLETED, params->data, params->len);
+        future->notify();
+    }
+}
+
+void
+GattClient::cancelFutures(void)
+{
+    while (pendingFutures != NULL) {
+        GattClientFuture *future = pendingFutures;
+        pendingFutures = future->next;
+        future->next   = NULL;
+        future->store(GattClientFuture::STATE_CANCELLED, NULL, 0);
+        future->notify();
+    }
+}
+
+void
+GattClient::cancelFutures(Gap::Handle_t connHandle)
+{
+    /* As in completeUpdateFutures(), the futures started again by their
+     * callback are linked after the ones to cancel and are left pending. */
+    unsigned count = 0;
+    for (GattClientFuture *future = pendingFutures; future != NULL; future = future->next) {
+        if (future->connHandle == connHandle) {
+            ++count;
+        }
+    }
+
+    while (count-- != 0) {
+        GattClientFuture *future = pendingFutures;
+        while ((future != NULL) && (future->connHandle != connHandle)) {
+            future = future->next;
+        }
+        if (future == NULL) {
+            return;
+        }
+
+        detachFuture(future);
+        future->store(GattClientFuture::STATE_CANCELLED, NULL, 0);
+        future->notify();
+    }
+}
@@ -0,0 +1,218 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "ble/GattClientFuture.h"
+
+/* Values of the Client Characteristic Configuration descriptor. */
+static const uint16_t CCCD_DISABLED = 0x0000;
+
+GattClientFuture::GattClientFuture() :
+    client(NULL),
+    next(NULL),
+    operation(OPERATION_NONE),
+    state(STATE_IDLE),
+    connHandle(0),
+    attributeHandle(0),
+    length(0),
+    truncated(false),
+    buffer(),
+    completionCallback()
+{
+    /* empty */
+}
+
+GattClientFuture::~GattClientFuture()
+{
+    if (state == STATE_PENDING) {
+        client->detachFuture(this);
+        state = STATE_CANCELLED;
+    }
+}
+
+ble_error_t
+GattClientFuture::read(GattClient              &clientIn,
+                       Gap::Handle_t            connHandleIn,
+                       GattAttribute::Handle_t  attributeHandleIn,
+                       uint16_t                 offset)
+{
+    ble_error_t err = start(clientIn, OPERATION_READ, connHandleIn, attributeHandleIn);
+    if (err != BLE_ERROR_NONE) {
+        return err;
+    }
+
+    err = clientIn.read(connHandleIn, attributeHandleIn, offset);
+    if (err != BLE_ERROR_NONE) {
+        clientIn.detachFuture(this);
+        state = STATE_IDLE;
+    }
+
+    return err;
+}
+
+ble_error_t
+GattClientFuture::write(GattClient              &clientIn,
+                        Gap::Handle_t            connHandleIn,
+                        GattAttribute::Handle_t  attributeHandleIn,
+                        uint16_t                 lengthIn,
+                        const uint8_t           *value)
+{
+    ble_error_t err = start(clientIn, OPERATION_WRITE, connHandleIn, attributeHandleIn);
+    if (err != BLE_ERROR_NONE) {
+        return err;
+    }
+
+    err = clientIn.write(GattClient::GATT_OP_WRITE_REQ, connHandleIn, attributeHandleIn, lengthIn, value);
+    if (err != BLE_ERROR_NONE) {
+        clientIn.detachFuture(this);
+        state = STATE_IDLE;
+    }
+
+    return err;
+}
+
+ble_error_t
+GattClientFuture::subscribe(GattClient              &clientIn,
+                            Gap::Handle_t            connHandleIn,
+                            GattAttribute::Handle_t  cccdHandle,
+                            HVXType_t                type)
+{
+    if ((type != BLE_HVX_NOTIFICATION) && (type != BLE_HVX_INDICATION)) {
+        return BLE_ERROR_INVALID_PARAM;
+    }
+
+    /* The CCCD bits match the values of HVXType_t. */
+    return writeCCCD(clientIn, connHandleIn, cccdHandle, type);
+}
+
+ble_error_t
+GattClientFuture::unsubscribe(GattClient              &clientIn,
+                              Gap::Handle_t            connHandleIn,
+                              GattAttribute::Handle_t  cccdHandle)
+{
+    return writeCCCD(clientIn, connHandleIn, cccdHandle, CCCD_DISABLED);
+}
+
+ble_error_t
+GattClientFuture::waitForUpdate(GattClient              &clientIn,
+                                Gap::Handle_t            connHandleIn,
+                                GattAttribute::Handle_t  valueHandle)
+{
+    return start(clientIn, OPERATION_UPDATE, connHandleIn, valueHandle);
+}
+
+void
+GattClientFuture::cancel(void)
+{
+    if (state != STATE_PENDING) {
+        return;
+    }
+
+    client->detachFuture(this);
+    store(STATE_CANCELLED, NULL, 0);
+    notify();
+}
+
+ble_error_t
+GattClientFuture::start(GattClient              &clientIn,
+                        Operation_t              operationIn,
+                        Gap::Handle_t            connHandleIn,
+                        GattAttribute::Handle_t  attributeHandleIn)
+{
+    if (state == STATE_PENDING) {
+        return BLE_ERROR_INVALID_STATE;
+    }
+
+    client          = &clientIn;
+    operation       = operationIn;
+    state           = STATE_PENDING;
+    connHandle      = connHandleIn;
+    attributeHandle = attributeHandleIn;
+    length          = 0;
+    truncated       = false;
+
+    /* Link the future before starting the operation, in case the stack
+     * reports the response synchronously. */
+    clientIn.attachFuture(this);
+
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t
+GattClientFuture::writeCCCD(GattClient              &clientIn,
+                            Gap::Handle_t            connHandleIn,
+                            GattAttribute::Handle_t  cccdHandle,
+                            uint16_t                 cccdValue)
+{
+    /* The value is sent in little endian; the stack may not copy it before
+     * the write completes, so it is staged in the buffer of the future. */
+    ble_error_t err = start(clientIn, OPERATION_WRITE, connHandleIn, cccdHandle);
+    if (err != BLE_ERROR_NONE) {
+        return err;
+    }
+
+    buffer[0] = (uint8_t)(cccdValue);
+    buffer[1] = (uint8_t)(cccdValue >> 8);
+
+    err = clientIn.write(GattClient::GATT_OP_WRITE_REQ, connHandleIn, cccdHandle, sizeof(cccdValue), buffer);
+    if (err != BLE_ERROR_NONE) {
+        clientIn.detachFuture(this);
+        state = STATE_IDLE;
+    }
+
+    return err;
+}
+
+bool
+GattClientFuture::matches(Operation_t              operationIn,
+                          Gap::Handle_t            connHandleIn,
+                          GattAttribute::Handle_t  attributeHandleIn) const
+{
+    return (operation == operationIn) && (connHandle == connHandleIn) && (attributeHandle == attributeHandleIn);
+}
+
+void
+GattClientFuture::store(State_t stateIn, const uint8_t *data, uint16_t lengthIn)
+{
+    truncated = (lengthIn > BUFFER_SIZE);
+    length    = truncated ? BUFFER_SIZE : lengthIn;
+    if (length != 0) {
+        memcpy(buffer, data, length);
+    }
+    state = stateIn;
+}
+
+void
+GattClientFuture::notify(void)
+{
+    /* The callback may start the next operation, which replaces the
+     * continuation; resume the coroutine waiting for this one. */
+#if defined(__cpp_impl_coroutine)
+    std::coroutine_handle<> waiter = continuation;
+    continuation = std::coroutine_handle<>();
+#endif
+
+    if (completionCallback) {
+        completionCallback.call(this);
+    }
+
+#if defined(__cpp_impl_coroutine)
+    if (waiter) {
+        waiter.resume();
+    }
+#endif
+}
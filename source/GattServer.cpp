@@ -0,0 +1,117 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ble/GattServer.h"
+
+ble_error_t
+GattServer::notifyConnections(GattAttribute::Handle_t  valueHandle,
+                              const uint8_t           *value,
+                              uint16_t                 size,
+                              const Gap::Handle_t     *connectionHandles,
+                              uint8_t                  count,
+                              NotificationResult_t    *results)
+{
+    /* Update the attribute value once for all the connections. */
+    ble_error_t err = write(valueHandle, value, size, true);
+    if (err != BLE_ERROR_NONE) {
+        return err;
+    }
+
+    for (uint8_t i = 0; i < count; ++i) {
+        ble_error_t          linkError = BLE_ERROR_NONE;
+        NotificationStatus_t status    = NOTIFICATION_NOT_SUBSCRIBED;
+
+        if (isSubscribed(connectionHandles[i], valueHandle)) {
+            status = notifyConnection(connectionHandles[i], valueHandle, value, size, linkError);
+        }
+
+        if (results != NULL) {
+            results[i].connectionHandle = connectionHandles[i];
+            results[i].status           = status;
+            results[i].error            = linkError;
+        }
+    }
+
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t
+GattServer::notifySubscribers(GattAttribute::Handle_t  valueHandle,
+                              const uint8_t           *value,
+                              uint16_t                 size,
+                              NotificationResult_t    *results,
+                              uint8_t                  maxResults,
+                              uint8_t                 *resultCount)
+{
+    if (resultCount != NULL) {
+        *resultCount = 0;
+    }
+
+    if (!isSubscriptionCacheAvailable() || subscriptions.hasUntrackedSubscribers(valueHandle)) {
+        /* Subscribers are unknown, or not all of them; let the stack notify
+         * them. */
+        return write(valueHandle, value, size);
+    }
+
+    Gap::Handle_t subscribers[GattSubscriptionTable::MAX_CONNECTIONS];
+    uint8_t       count = subscriptions.getSubscribers(valueHandle, subscribers, GattSubscriptionTable::MAX_CONNECTIONS);
+
+    ble_error_t err = write(valueHandle, value, size, true);
+    if (err != BLE_ERROR_NONE) {
+        return err;
+    }
+
+    for (uint8_t i = 0; i < count; ++i) {
+        ble_error_t          linkError = BLE_ERROR_NONE;
+        NotificationStatus_t status    = notifyConnection(subscribers[i], valueHandle, value, size, linkError);
+
+        if ((results != NULL) && (i < maxResults)) {
+            results[i].connectionHandle = subscribers[i];
+            results[i].status           = status;
+            results[i].error            = linkError;
+        }
+    }
+
+    if (resultCount != NULL) {
+        *resultCount = (count < maxResults) ? count : maxResults;
+    }
+
+    return BLE_ERROR_NONE;
+}
+
+GattServer::NotificationStatus_t
+GattServer::notifyConnection(Gap::Handle_t           connectionHandle,
+                             GattAttribute::Handle_t valueHandle,
+                             const uint8_t          *value,
+                             uint16_t                size,
+                             ble_error_t            &error)
+{
+    error = sendUpdate(connectionHandle, valueHandle);
+    if (error == BLE_ERROR_NOT_IMPLEMENTED) {
+        /* Legacy ports: the value is copied again for this connection. */
+        error = write(connectionHandle, valueHandle, value, size);
+    }
+
+    switch (error) {
+        case BLE_ERROR_NONE:
+            return NOTIFICATION_QUEUED;
+        case BLE_ERROR_NO_MEM:
+        case BLE_STACK_BUSY:
+            return NOTIFICATION_DROPPED;
+        default:
+            return NOTIFICATION_FAILED;
+    }
+}
@@ -0,0 +1,247 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "ble/GattUpdateCoalescer.h"
+
+ble_error_t
+GattUpdateCoalescer::attach(Gap &gap)
+{
+    ble_error_t err = gap.initRadioNotification();
+    if (err != BLE_ERROR_NONE) {
+        return err;
+    }
+
+    gap.onRadioNotification(this, &GattUpdateCoalescer::processRadioNotification);
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t
+GattUpdateCoalescer::setDeadband(GattAttribute::Handle_t valueHandle, ValueFormat_t format, uint32_t threshold)
+{
+    Slot_t *slot = acquire(valueHandle);
+    if (slot == NULL) {
+        return BLE_ERROR_NO_MEM;
+    }
+
+    slot->format    = format;
+    slot->threshold = threshold;
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t
+GattUpdateCoalescer::update(GattAttribute::Handle_t valueHandle, const uint8_t *value, uint16_t size)
+{
+    Slot_t *slot = (size <= MAX_VALUE_SIZE) ? acquire(valueHandle) : find(valueHandle);
+
+    if ((slot == NULL) || (size > MAX_VALUE_SIZE)) {
+        if (slot != NULL) {
+            /* The value written through supersedes the pending one. */
+            slot->pending    = false;
+            slot->hasWritten = false;
+        }
+        return gattServer.notifySubscribers(valueHandle, value, size);
+    }
+
+    if (isSuppressed(*slot, value, size)) {
+        /* The latest value is close enough to what the peers already have. */
+        slot->pending = false;
+        return BLE_ERROR_NONE;
+    }
+
+    memcpy(slot->latestValue, value, size);
+    slot->latestLength = size;
+    slot->pending      = true;
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t
+GattUpdateCoalescer::flush(void)
+{
+    ble_error_t status = BLE_ERROR_NONE;
+
+    for (uint8_t i = 0; i < MAX_CHARACTERISTICS; ++i) {
+        if (!slots[i].inUse || !slots[i].pending) {
+            continue;
+        }
+
+        ble_error_t err = flushSlot(slots[i]);
+        if ((err != BLE_ERROR_NONE) && (status == BLE_ERROR_NONE)) {
+            status = err;
+        }
+    }
+
+    return status;
+}
+
+ble_error_t
+GattUpdateCoalescer::flush(GattAttribute::Handle_t valueHandle)
+{
+    Slot_t *slot = find(valueHandle);
+    if ((slot == NULL) || !slot->pending) {
+        return BLE_ERROR_NONE;
+    }
+
+    return flushSlot(*slot);
+}
+
+bool
+GattUpdateCoalescer::hasPendingUpdates(void) const
+{
+    for (uint8_t i = 0; i < MAX_CHARACTERISTICS; ++i) {
+        if (slots[i].inUse && slots[i].pending) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void
+GattUpdateCoalescer::remove(GattAttribute::Handle_t valueHandle)
+{
+    Slot_t *slot = find(valueHandle);
+    if (slot != NULL) {
+        slot->inUse = false;
+    }
+}
+
+void
+GattUpdateCoalescer::clear(void)
+{
+    for (uint8_t i = 0; i < MAX_CHARACTERISTICS; ++i) {
+        slots[i].inUse = false;
+    }
+}
+
+GattUpdateCoalescer::Slot_t *
+GattUpdateCoalescer::find(GattAttribute::Handle_t valueHandle)
+{
+    for (uint8_t i = 0; i < MAX_CHARACTERISTICS; ++i) {
+        if (slots[i].inUse && (slots[i].valueHandle == valueHandle)) {
+            return &slots[i];
+        }
+    }
+
+    return NULL;
+}
+
+GattUpdateCoalescer::Slot_t *
+GattUpdateCoalescer::acquire(GattAttribute::Handle_t valueHandle)
+{
+    Slot_t *slot = find(valueHandle);
+    if (slot != NULL) {
+        return slot;
+    }
+
+    for (uint8_t i = 0; i < MAX_CHARACTERISTICS; ++i) {
+        if (!slots[i].inUse) {
+            slot = &slots[i];
+            slot->inUse       = true;
+            slot->hasWritten  = false;
+            slot->pending     = false;
+            slot->valueHandle = valueHandle;
+            slot->format      = FORMAT_NONE;
+            slot->threshold   = 0;
+            return slot;
+        }
+    }
+
+    return NULL;
+}
+
+bool
+GattUpdateCoalescer::isSuppressed(const Slot_t &slot, const uint8_t *value, uint16_t size) const
+{
+    if (!slot.hasWritten || (size != slot.writtenLength)) {
+        return false;
+    }
+
+    if (memcmp(slot.writtenValue, value, size) == 0) {
+        return true;
+    }
+
+    if ((slot.format == FORMAT_NONE) || (size != getFormatSize(slot.format))) {
+        return false;
+    }
+
+    int64_t difference = decode(slot.format, value) - decode(slot.format, slot.writtenValue);
+    if (difference < 0) {
+        difference = -difference;
+    }
+
+    return difference < (int64_t)slot.threshold;
+}
+
+ble_error_t
+GattUpdateCoalescer::flushSlot(Slot_t &slot)
+{
+    ble_error_t err = gattServer.notifySubscribers(slot.valueHandle, slot.latestValue, slot.latestLength);
+
+    if ((err == BLE_ERROR_NO_MEM) || (err == BLE_STACK_BUSY)) {
+        /* Out of buffers; keep the update for the next flush. */
+        return err;
+    }
+
+    slot.pending = false;
+    if (err == BLE_ERROR_NONE) {
+        memcpy(slot.writtenValue, slot.latestValue, slot.latestLength);
+        slot.writtenLength = slot.latestLength;
+        slot.hasWritten    = true;
+    }
+
+    return err;
+}
+
+int64_t
+GattUpdateCoalescer::decode(ValueFormat_t format, const uint8_t *value)
+{
+    switch (format) {
+        case FORMAT_UINT8:
+            return value[0];
+        case FORMAT_SINT8:
+            return (int8_t)value[0];
+        case FORMAT_UINT16:
+            return (uint16_t)(value[0] | (value[1] << 8));
+        case FORMAT_SINT16:
+            return (int16_t)(value[0] | (value[1] << 8));
+        case FORMAT_UINT32:
+            return (uint32_t)(value[0] | (value[1] << 8) | (value[2] << 16) | ((uint32_t)value[3] << 24));
+        case FORMAT_SINT32:
+            return (int32_t)(value[0] | (value[1] << 8) | (value[2] << 16) | ((uint32_t)value[3] << 24));
+        default:
+            return 0;
+    }
+}
+
+uint8_t
+GattUpdateCoalescer::getFormatSize(ValueFormat_t format)
+{
+    switch (format) {
+        case FORMAT_UINT8:
+        case FORMAT_SINT8:
+            return 1;
+        case FORMAT_UINT16:
+        case FORMAT_SINT16:
+            return 2;
+        case FORMAT_UINT32:
+        case FORMAT_SINT32:
+            return 4;
+        default:
+            return 0;
+    }
+}
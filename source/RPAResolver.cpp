@@ -0,0 +1,214 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "ble/RPAResolver.h"
+
+/* Longest rotation period, in seconds, whose expiry fits the 32-bit
+ * microsecond clock. */
+static const uint32_t MAX_ROTATION_PERIOD = 4294;
+
+RPAResolver::RPAResolver(CryptoBackend &cryptoIn, TimeSource_t timeSourceIn, uint32_t rotationPeriod) :
+    crypto(cryptoIn),
+    timeSource(timeSourceIn),
+    expiry(((rotationPeriod < MAX_ROTATION_PERIOD) ? rotationPeriod : MAX_ROTATION_PERIOD) * 1000000UL),
+    useCounter(0),
+    cacheHits(0),
+    cacheMisses(0),
+    identityCount(0)
+{
+    flushCache();
+}
+
+ble_error_t
+RPAResolver::addIdentity(const IRK_t irk, BLEProtocol::AddressType_t type, const BLEProtocol::AddressBytes_t address)
+{
+    if ((type != BLEProtocol::AddressType::PUBLIC) && (type != BLEProtocol::AddressType::RANDOM_STATIC)) {
+        return BLE_ERROR_INVALID_PARAM;
+    }
+
+    int index = findIdentity(type, address);
+    if (index >= 0) {
+        /* A new IRK invalidates what the previous one resolved. */
+        dropEntries((uint8_t)index);
+    } else {
+        if (identityCount == MAX_IDENTITIES) {
+            return BLE_ERROR_NO_MEM;
+        }
+        index = identityCount++;
+        identities[index].type = type;
+        memcpy(identities[index].address, address, BLEProtocol::ADDR_LEN);
+    }
+    memcpy(identities[index].irk, irk, IRK_SIZE);
+
+    /* Addresses which matched no identity so far may match this one. */
+    dropEntries(NO_IDENTITY);
+
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t
+RPAResolver::removeIdentity(BLEProtocol::AddressType_t type, const BLEProtocol::AddressBytes_t address)
+{
+    int index = findIdentity(type, address);
+    if (index < 0) {
+        return BLE_ERROR_INVALID_PARAM;
+    }
+
+    dropEntries((uint8_t)index);
+
+    /* Keep the identities packed: the last one takes the free slot. */
+    uint8_t last = (uint8_t)(--identityCount);
+    if (index != last) {
+        identities[index] = identities[last];
+        for (unsigned i = 0; i < CACHE_SIZE; ++i) {
+            if (cache[i].identity == last) {
+                cache[i].identity = (uint8_t)index;
+            }
+        }
+    }
+
+    return BLE_ERROR_NONE;
+}
+
+void
+RPAResolver::clear(void)
+{
+    identityCount = 0;
+    flushCache();
+}
+
+void
+RPAResolver::flushCache(void)
+{
+    for (unsigned i = 0; i < CACHE_SIZE; ++i) {
+        cache[i].identity = ENTRY_UNUSED;
+    }
+}
+
+bool
+RPAResolver::resolve(const BLEProtocol::AddressBytes_t  address,
+                     BLEProtocol::AddressType_t        &identityType,
+                     BLEProtocol::AddressBytes_t        identityAddress)
+{
+    if (!isResolvable(address)) {
+        return false;
+    }
+
+    uint32_t now = (timeSource != NULL) ? timeSource() : 0;
+    ++useCounter;
+
+    CacheEntry_t *entry = NULL;
+    for (unsigned i = 0; i < CACHE_SIZE; ++i) {
+        if ((cache[i].identity != ENTRY_UNUSED) &&
+            (memcmp(cache[i].address, address, BLEProtocol::ADDR_LEN) == 0)) {
+            if (!isExpired(cache[i], now)) {
+                entry = &cache[i];
+            }
+            break;
+        }
+    }
+
+    if (entry != NULL) {
+        ++cacheHits;
+    } else {
+        ++cacheMisses;
+
+        uint8_t identity = NO_IDENTITY;
+        for (unsigned i = 0; i < identityCount; ++i) {
+            if (matches(crypto, identities[i].irk, address)) {
+                identity = (uint8_t)i;
+                break;
+            }
+        }
+
+        entry = &allocateEntry(now);
+        memcpy(entry->address, address, BLEProtocol::ADDR_LEN);
+        entry->identity = identity;
+    }
+
+    entry->lastSeen = now;
+    entry->lastUse  = useCounter;
+
+    if (entry->identity == NO_IDENTITY) {
+        return false;
+    }
+
+    identityType = identities[entry->identity].type;
+    memcpy(identityAddress, identities[entry->identity].address, BLEProtocol::ADDR_LEN);
+    return true;
+}
+
+bool
+RPAResolver::matches(CryptoBackend &crypto, const IRK_t irk, const BLEProtocol::AddressBytes_t address)
+{
+    /* The hash is the three least significant octets of the address, prand
+     * the three most significant ones. */
+    uint8_t hash[3];
+    if (crypto.ah(irk, &address[3], hash) != BLE_ERROR_NONE) {
+        return false;
+    }
+
+    return memcmp(hash, address, sizeof(hash)) == 0;
+}
+
+int
+RPAResolver::findIdentity(BLEProtocol::AddressType_t type, const BLEProtocol::AddressBytes_t address) const
+{
+    for (unsigned i = 0; i < identityCount; ++i) {
+        if ((identities[i].type == type) &&
+            (memcmp(identities[i].address, address, BLEProtocol::ADDR_LEN) == 0)) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+bool
+RPAResolver::isExpired(const CacheEntry_t &entry, uint32_t now) const
+{
+    return (timeSource != NULL) && (getElapsedTime(entry.lastSeen, now) >= expiry);
+}
+
+RPAResolver::CacheEntry_t &
+RPAResolver::allocateEntry(uint32_t now)
+{
+    /* Prefer a free or expired entry; otherwise replace the least recently
+     * used one. */
+    CacheEntry_t *victim = &cache[0];
+    for (unsigned i = 0; i < CACHE_SIZE; ++i) {
+        if ((cache[i].identity == ENTRY_UNUSED) || isExpired(cache[i], now)) {
+            return cache[i];
+        }
+        if ((uint32_t)(useCounter - cache[i].lastUse) > (uint32_t)(useCounter - victim->lastUse)) {
+            victim = &cache[i];
+        }
+    }
+
+    return *victim;
+}
+
+void
+RPAResolver::dropEntries(uint8_t identity)
+{
+    for (unsigned i = 0; i < CACHE_SIZE; ++i) {
+        if (cache[i].identity == identity) {
+            cache[i].identity = ENTRY_UNUSED;
+        }
+    }
+}
@@ -0,0 +1,249 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <math.h>
+
+#include "ble/RSSITracker.h"
+
+/**
+ * RSSI value reporting that the RSSI is unavailable.
+ */
+static const int8_t   RSSI_UNAVAILABLE = 127;
+/**
+ * Free space path loss at 1 meter on 2.4 GHz, in dB.
+ */
+static const int8_t   LOSS_AT_1_METER  = 41;
+/**
+ * Number of advertisers compared to pick the one making room.
+ */
+static const unsigned EVICTION_PROBES  = 8;
+/**
+ * AD type of the TX power level; see GapAdvertisingData::TX_POWER_LEVEL.
+ */
+static const uint8_t  TX_POWER_LEVEL   = 0x0A;
+
+RSSITracker::RSSITracker(Slot_t *slotsIn, unsigned slotCount, TimeSource_t timeSourceIn) :
+    table(slotsIn, slotCount),
+    cursor(0),
+    timeSource(timeSourceIn),
+    smoothing(3),
+    defaultReferencePower(-59),
+    enterLoss(0),
+    leaveLoss(0),
+    pathLossExponent(2.0f),
+    absenceTimeout(10000000),
+    evictions(0),
+    regionCallback()
+{
+    setRegion(2.0f, 3.0f);
+}
+
+ble_error_t
+RSSITracker::setSmoothing(uint8_t shift)
+{
+    if (shift > 7) {
+        return BLE_ERROR_PARAM_OUT_OF_RANGE;
+    }
+
+    smoothing = shift;
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t
+RSSITracker::setRegion(float enterDistance, float leaveDistance, float exponent)
+{
+    if ((enterDistance <= 0.0f) || (leaveDistance <= enterDistance) ||
+        (leaveDistance > 1000.0f) || (exponent < 1.0f) || (exponent > 6.0f)) {
+        return BLE_ERROR_PARAM_OUT_OF_RANGE;
+    }
+
+    /* Path loss beyond 1 meter: 10 * n * log10(d) dB. */
+    pathLossExponent = exponent;
+    enterLoss        = (int16_t)(160.0f * exponent * log10f(enterDistance));
+    leaveLoss        = (int16_t)(160.0f * exponent * log10f(leaveDistance));
+    return BLE_ERROR_NONE;
+}
+
+void
+RSSITracker::processReport(const BLEProtocol::AddressBytes_t address,
+                           int8_t                            rssi,
+                           uint8_t                           advertisingDataLen,
+                           const uint8_t                    *advertisingData)
+{
+    if ((table.getCapacity() == 0) || (rssi == RSSI_UNAVAILABLE)) {
+        return;
+    }
+
+    uint32_t now   = timeSource();
+    int      found = table.find(address);
+    Slot_t  *slot;
+
+    if (found < 0) {
+        if (table.getSize() == table.getCapacity()) {
+            evict(table.getHomeSlot(address), now);
+        }
+        slot                 = &table[table.insert(address)];
+        slot->referencePower = defaultReferencePower;
+        slot->rssi           = (int16_t)(rssi * 16);
+    } else {
+        slot = &table[found];
+        if (getElapsedTime(slot->lastSeen, now) >= absenceTimeout) {
+            /* Back after an absence process() hasn't noticed yet. */
+            if (slot->flags & SLOT_INSIDE) {
+                leave(*slot, true);
+            }
+            slot->rssi = (int16_t)(rssi * 16);
+        } else {
+            slot->rssi = (int16_t)(slot->rssi + ((rssi * 16) - slot->rssi) / (1 << smoothing));
+        }
+    }
+    slot->lastSeen = now;
+
+    bool   hasTxPower = false;
+    int8_t txPower    = findTxPower(advertisingDataLen, advertisingData, hasTxPower);
+    if (hasTxPower) {
+        slot->referencePower = (int8_t)((txPower > -128 + LOSS_AT_1_METER) ? (txPower - LOSS_AT_1_METER) : -128);
+    }
+
+    int16_t loss = (int16_t)((slot->referencePower * 16) - slot->rssi);
+    if (!(slot->flags & SLOT_INSIDE)) {
+        if (loss <= enterLoss) {
+            slot->flags |= SLOT_INSIDE;
+            notify(*slot, true, false);
+        }
+    } else if (loss >= leaveLoss) {
+        leave(*slot, false);
+    }
+}
+
+void
+RSSITracker::process(unsigned slotCount)
+{
+    uint32_t now = timeSource();
+    for (unsigned n = 0; (n < slotCount) && (n < table.getSlotCount()); ) {
+        Slot_t &slot = table[cursor];
+        if (table.isUsed(cursor) && (getElapsedTime(slot.lastSeen, now) >= absenceTimeout)) {
+            if (slot.flags & SLOT_INSIDE) {
+                leave(slot, true);
+            }
+            /* The following entries may shift into the cursor; check it
+             * again. */
+            table.erase(cursor);
+        } else {
+            cursor = table.getNextSlot(cursor);
+            ++n;
+        }
+    }
+}
+
+bool
+RSSITracker::getRSSI(const BLEProtocol::AddressBytes_t address, int8_t &rssi) const
+{
+    int found = table.find(address);
+    if (found < 0) {
+        return false;
+    }
+
+    rssi = (int8_t)(table[found].rssi / 16);
+    return true;
+}
+
+float
+RSSITracker::getDistance(const BLEProtocol::AddressBytes_t address) const
+{
+    int found = table.find(address);
+    return (found >= 0) ? estimateDistance(table[found]) : -1.0f;
+}
+
+bool
+RSSITracker::isInside(const BLEProtocol::AddressBytes_t address) const
+{
+    int found = table.find(address);
+    return (found >= 0) && ((table[found].flags & SLOT_INSIDE) != 0);
+}
+
+void
+RSSITracker::evict(unsigned home, uint32_t now)
+{
+    /* Compare the first advertisers from the home slot of the newcomer. */
+    int      oldest = -1;
+    unsigned probes = 0;
+    for (unsigned index = home; (probes < EVICTION_PROBES) || (oldest < 0); index = table.getNextSlot(index)) {
+        if (!table.isUsed(index)) {
+            continue;
+        }
+        if ((oldest < 0) ||
+            (getElapsedTime(table[index].lastSeen, now) > getElapsedTime(table[oldest].lastSeen, now))) {
+            oldest = (int)index;
+        }
+        ++probes;
+    }
+
+    if (table[oldest].flags & SLOT_INSIDE) {
+        leave(table[oldest], true);
+    }
+    table.erase((unsigned)oldest);
+    ++evictions;
+}
+
+void
+RSSITracker::leave(Slot_t &slot, bool absent)
+{
+    slot.flags &= ~SLOT_INSIDE;
+    notify(slot, false, absent);
+}
+
+void
+RSSITracker::notify(const Slot_t &slot, bool entered, bool absent)
+{
+    if (!regionCallback) {
+        return;
+    }
+
+    RegionEventCallbackParams_t params;
+    memcpy(params.address, slot.address, BLEProtocol::ADDR_LEN);
+    params.entered  = entered;
+    params.absent   = absent;
+    params.rssi     = (int8_t)(slot.rssi / 16);
+    params.distance = estimateDistance(slot);
+    regionCallback.call(&params);
+}
+
+float
+RSSITracker::estimateDistance(const Slot_t &slot) const
+{
+    float loss = ((slot.referencePower * 16) - slot.rssi) / 16.0f;
+    return powf(10.0f, loss / (10.0f * pathLossExponent));
+}
+
+int8_t
+RSSITracker::findTxPower(uint8_t advertisingDataLen, const uint8_t *advertisingData, bool &found)
+{
+    /* Each AD structure is a length, covering the type, a type and data. */
+    for (unsigned index = 0; (index + 2) < advertisingDataLen; index += advertisingData[index] + 1) {
+        uint8_t length = advertisingData[index];
+        if (length == 0) {
+            break;
+        }
+        if ((advertisingData[index + 1] == TX_POWER_LEVEL) && (length >= 2)) {
+            found = true;
+            return (int8_t)advertisingData[index + 2];
+        }
+    }
+
+    return 0;
+}
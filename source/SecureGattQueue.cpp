@@ -0,0 +1,429 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "ble/SecureGattQueue.h"
+
+/**
+ * Rank a security mode by the protection it gives; signing stands for
+ * encryption with the same MITM protection.
+ */
+static unsigned
+rankMode(SecurityManager::SecurityMode_t mode)
+{
+    switch (mode) {
+        case SecurityManager::SECURITY_MODE_ENCRYPTION_OPEN_LINK:
+            return 1;
+        case SecurityManager::SECURITY_MODE_ENCRYPTION_NO_MITM:
+        case SecurityManager::SECURITY_MODE_SIGNED_NO_MITM:
+            return 2;
+        case SecurityManager::SECURITY_MODE_ENCRYPTION_WITH_MITM:
+        case SecurityManager::SECURITY_MODE_SIGNED_WITH_MITM:
+            return 3;
+        default:
+            return 0;
+    }
+}
+
+SecureGattQueue::SecureGattQueue(Gap &gapIn, GattClient &clientIn, SecurityManager &securityManagerIn, TimeSource_t timeSourceIn) :
+    gap(gapIn),
+    client(clientIn),
+    securityManager(securityManagerIn),
+    timeSource(timeSourceIn),
+    failureCallback(),
+    operationCount(0)
+{
+    for (unsigned i = 0; i < MAX_LINKS; ++i) {
+        links[i].used = false;
+    }
+
+    securityManager.onLinkSecurityEvent().add(this, &SecureGattQueue::processLinkSecurityEvent);
+    gap.onDisconnection().add(this, &SecureGattQueue::processDisconnectionEvent);
+    client.onDataRead().add(this, &SecureGattQueue::processReadResponse);
+    client.onDataWritten().add(this, &SecureGattQueue::processWriteResponse);
+}
+
+SecureGattQueue::~SecureGattQueue()
+{
+    securityManager.onLinkSecurityEvent().detach(
+        SecurityManager::LinkSecurityEventCallback_t(this, &SecureGattQueue::processLinkSecurityEvent));
+    gap.onDisconnection().detach(Gap::DisconnectionEventCallback_t(this, &SecureGattQueue::processDisconnectionEvent));
+    client.onDataRead().detach(GattClient::ReadCallback_t(this, &SecureGattQueue::processReadResponse));
+    client.onDataWritten().detach(GattClient::WriteCallback_t(this, &SecureGattQueue::processWriteResponse));
+}
+
+ble_error_t
+SecureGattQueue::read(Gap::Handle_t                   connHandle,
+                      GattAttribute::Handle_t         attributeHandle,
+                      uint16_t                        offset,
+                      SecurityManager::SecurityMode_t requiredMode)
+{
+    Link_t *link = acquireLink(connHandle);
+    if (link == NULL) {
+        return BLE_ERROR_NO_MEM;
+    }
+    if (isReady(*link, requiredMode)) {
+        return client.read(connHandle, attributeHandle, offset);
+    }
+
+    Operation_t operation;
+    operation.connHandle      = connHandle;
+    operation.attributeHandle = attributeHandle;
+    operation.isWrite         = false;
+    operation.cmd             = GattClient::GATT_OP_WRITE_REQ;
+    operation.offset          = offset;
+    operation.length          = 0;
+    operation.requiredMode    = requiredMode;
+
+    return submit(*link, operation);
+}
+
+ble_error_t
+SecureGattQueue::write(GattClient::WriteOp_t           cmd,
+                       Gap::Handle_t                   connHandle,
+                       GattAttribute::Handle_t         attributeHandle,
+                       size_t                          length,
+                       const uint8_t                  *value,
+                       SecurityManager::SecurityMode_t requiredMode)
+{
+    Link_t *link = acquireLink(connHandle);
+    if (link == NULL) {
+        return BLE_ERROR_NO_MEM;
+    }
+    if (isReady(*link, requiredMode)) {
+        return client.write(cmd, connHandle, attributeHandle, length, value);
+    }
+    if (length > MAX_VALUE_SIZE) {
+        return BLE_ERROR_INVALID_PARAM;
+    }
+
+    Operation_t operation;
+    operation.connHandle      = connHandle;
+    operation.attributeHandle = attributeHandle;
+    operation.isWrite         = true;
+    operation.cmd             = cmd;
+    operation.offset          = 0;
+    operation.length          = (uint8_t)length;
+    operation.requiredMode    = requiredMode;
+    if (length != 0) {
+        memcpy(operation.value, value, length);
+    }
+
+    return submit(*link, operation);
+}
+
+void
+SecureGattQueue::process(void)
+{
+    if (timeSource == NULL) {
+        return;
+    }
+
+    uint32_t now = timeSource();
+    for (unsigned i = 0; i < MAX_LINKS; ++i) {
+        Link_t &link = links[i];
+        if (!link.used || !link.awaitingResponse || (getElapsedTime(link.requestTime, now) < RESPONSE_TIMEOUT)) {
+            continue;
+        }
+
+        /* Most likely an error response, which GattClient doesn't report. */
+        Operation_t operation;
+        operation.connHandle      = link.handle;
+        operation.attributeHandle = link.outstandingHandle;
+        operation.isWrite         = link.outstandingIsWrite;
+        link.awaitingResponse = false;
+        fail(operation, BLE_ERROR_UNSPECIFIED, SecurityManager::SEC_STATUS_SUCCESS);
+        replay(link);
+    }
+}
+
+SecureGattQueue::LinkState_t
+SecureGattQueue::getLinkState(Gap::Handle_t connHandle) const
+{
+    const Link_t *link = findLink(connHandle);
+    return (link != NULL) ? link->state : LINK_NOT_ENCRYPTED;
+}
+
+unsigned
+SecureGattQueue::getPendingCount(Gap::Handle_t connHandle) const
+{
+    unsigned count = 0;
+    for (unsigned i = 0; i < operationCount; ++i) {
+        if (operations[i].connHandle == connHandle) {
+            ++count;
+        }
+    }
+
+    return count;
+}
+
+void
+SecureGattQueue::processLinkSecurityEvent(const SecurityManager::LinkSecurityEventParams_t *params)
+{
+    if (params->secured) {
+        /* Track the links secured on the application's initiative too, so
+         * that their operations are issued immediately. */
+        Link_t *link = acquireLink(params->handle);
+        if (link != NULL) {
+            link->state = LINK_ENCRYPTED;
+            link->mode  = params->securityMode;
+
+            /* The peer may have paired at a weaker mode than requested:
+             * requesting it again would only repeat the pairing. */
+            failInsufficient(*link, params->status);
+            replay(*link);
+        }
+    } else {
+        Link_t *link = findLink(params->handle);
+        if (link != NULL) {
+            link->state = LINK_NOT_ENCRYPTED;
+            link->mode  = SecurityManager::SECURITY_MODE_ENCRYPTION_OPEN_LINK;
+            failAll(params->handle, BLE_ERROR_INVALID_STATE, params->status);
+        }
+    }
+}
+
+void
+SecureGattQueue::processDisconnectionEvent(const Gap::DisconnectionCallbackParams_t *params)
+{
+    Link_t *link = findLink(params->handle);
+    if (link != NULL) {
+        link->used = false;
+        failAll(params->handle, BLE_ERROR_INVALID_STATE, SecurityManager::SEC_STATUS_UNSPECIFIED);
+    }
+}
+
+void
+SecureGattQueue::processReadResponse(const GattReadCallbackParams *params)
+{
+    Link_t *link = findLink(params->connHandle);
+    if ((link != NULL) && link->awaitingResponse && (link->outstandingHandle == params->handle)) {
+        link->awaitingResponse = false;
+        replay(*link);
+    }
+}
+
+void
+SecureGattQueue::processWriteResponse(const GattWriteCallbackParams *params)
+{
+    Link_t *link = findLink(params->connHandle);
+    if ((link != NULL) && link->awaitingResponse && (link->outstandingHandle == params->handle)) {
+        link->awaitingResponse = false;
+        replay(*link);
+    }
+}
+
+bool
+SecureGattQueue::isReady(const Link_t &link, SecurityManager::SecurityMode_t requiredMode) const
+{
+    /* Operations are issued in order: not before those already held. */
+    return (link.state == LINK_ENCRYPTED) && satisfies(link.mode, requiredMode) &&
+           !link.awaitingResponse && (getPendingCount(link.handle) == 0);
+}
+
+ble_error_t
+SecureGattQueue::submit(Link_t &link, const Operation_t &operation)
+{
+    if (operationCount == MAX_OPERATIONS) {
+        return BLE_ERROR_NO_MEM;
+    }
+    operations[operationCount++] = operation;
+
+    /* Queued behind other operations, or waiting for a procedure which
+     * will reach the mode required. */
+    if (((link.state == LINK_ENCRYPTED) || (link.state == LINK_ENCRYPTING)) &&
+        satisfies(link.mode, operation.requiredMode)) {
+        return BLE_ERROR_NONE;
+    }
+
+    ble_error_t err = securityManager.setLinkSecurity(link.handle, operation.requiredMode);
+    if (err != BLE_ERROR_NONE) {
+        --operationCount;
+        return err;
+    }
+    link.state = LINK_ENCRYPTING;
+    link.mode  = operation.requiredMode;
+
+    return BLE_ERROR_NONE;
+}
+
+void
+SecureGattQueue::replay(Link_t &link)
+{
+    while (!link.awaitingResponse) {
+        unsigned index = 0;
+        while ((index < operationCount) && (operations[index].connHandle != link.handle)) {
+            ++index;
+        }
+        if (index == operationCount) {
+            return;
+        }
+
+        if ((link.state != LINK_ENCRYPTED) || !satisfies(link.mode, operations[index].requiredMode)) {
+            /* The next operation needs more security than the link has; the
+             * following ones wait behind it. */
+            if (link.state != LINK_ENCRYPTING) {
+                ble_error_t err = securityManager.setLinkSecurity(link.handle, operations[index].requiredMode);
+                if (err != BLE_ERROR_NONE) {
+                    failAll(link.handle, err, SecurityManager::SEC_STATUS_UNSPECIFIED);
+                    return;
+                }
+                link.state = LINK_ENCRYPTING;
+                link.mode  = operations[index].requiredMode;
+            }
+            return;
+        }
+
+        Operation_t operation = operations[index];
+        erase(index);
+
+        ble_error_t err = operation.isWrite ?
+            client.write(operation.cmd, operation.connHandle, operation.attributeHandle, operation.length, operation.value) :
+            client.read(operation.connHandle, operation.attributeHandle, operation.offset);
+        if (err != BLE_ERROR_NONE) {
+            fail(operation, err, SecurityManager::SEC_STATUS_SUCCESS);
+        } else if (!operation.isWrite || (operation.cmd == GattClient::GATT_OP_WRITE_REQ)) {
+            /* Commands have no response; requests are issued one at a time. */
+            link.awaitingResponse   = true;
+            link.outstandingHandle  = operation.attributeHandle;
+            link.outstandingIsWrite = operation.isWrite;
+            link.requestTime        = (timeSource != NULL) ? timeSource() : 0;
+        }
+    }
+}
+
+void
+SecureGattQueue::failAll(Gap::Handle_t connHandle, ble_error_t error, SecurityManager::SecurityCompletionStatus_t status)
+{
+    /* The failure callback may submit operations: look up the next one from
+     * the start each time. */
+    for (;;) {
+        unsigned index = 0;
+        while ((index < operationCount) && (operations[index].connHandle != connHandle)) {
+            ++index;
+        }
+        if (index == operationCount) {
+            return;
+        }
+
+        Operation_t operation = operations[index];
+        erase(index);
+        fail(operation, error, status);
+    }
+}
+
+void
+SecureGattQueue::failInsufficient(Link_t &link, SecurityManager::SecurityCompletionStatus_t status)
+{
+    /* As in failAll(); an operation submitted again by the failure callback
+     * requests its mode again and waits for it, as the following ones. */
+    while (link.state == LINK_ENCRYPTED) {
+        unsigned index = 0;
+        while ((index < operationCount) &&
+               ((operations[index].connHandle != link.handle) || satisfies(link.mode, operations[index].requiredMode))) {
+            ++index;
+        }
+        if (index == operationCount) {
+            return;
+        }
+
+        Operation_t operation = operations[index];
+        erase(index);
+        fail(operation, BLE_ERROR_INVALID_STATE, status);
+    }
+}
+
+void
+SecureGattQueue::fail(const Operation_t &operation, ble_error_t error, SecurityManager::SecurityCompletionStatus_t status)
+{
+    if (failureCallback) {
+        FailureCallbackParams_t params = {
+            operation.connHandle,
+            operation.attributeHandle,
+            operation.isWrite,
+            error,
+            status
+        };
+        failureCallback.call(&params);
+    }
+}
+
+void
+SecureGattQueue::erase(unsigned index)
+{
+    for (unsigned i = index + 1; i < operationCount; ++i) {
+        operations[i - 1] = operations[i];
+    }
+    --operationCount;
+}
+
+SecureGattQueue::Link_t *
+SecureGattQueue::findLink(Gap::Handle_t connHandle)
+{
+    for (unsigned i = 0; i < MAX_LINKS; ++i) {
+        if (links[i].used && (links[i].handle == connHandle)) {
+            return &links[i];
+        }
+    }
+
+    return NULL;
+}
+
+const SecureGattQueue::Link_t *
+SecureGattQueue::findLink(Gap::Handle_t connHandle) const
+{
+    return const_cast<SecureGattQueue *>(this)->findLink(connHandle);
+}
+
+SecureGattQueue::Link_t *
+SecureGattQueue::acquireLink(Gap::Handle_t connHandle)
+{
+    Link_t *link = findLink(connHandle);
+    if (link != NULL) {
+        return link;
+    }
+
+    for (unsigned i = 0; i < MAX_LINKS; ++i) {
+        if (!links[i].used) {
+            link = &links[i];
+            link->handle           = connHandle;
+            link->used             = true;
+            link->awaitingResponse = false;
+
+            /* The link may have been secured before it was first seen; the
+             * mode reached isn't known then, the weakest one is assumed. */
+            SecurityManager::LinkSecurityStatus_t status;
+            if (securityManager.getLinkSecurity(connHandle, &status) != BLE_ERROR_NONE) {
+                status = SecurityManager::NOT_ENCRYPTED;
+            }
+            link->state = (status == SecurityManager::ENCRYPTED)              ? LINK_ENCRYPTED :
+                          (status == SecurityManager::ENCRYPTION_IN_PROGRESS) ? LINK_ENCRYPTING :
+                                                                                LINK_NOT_ENCRYPTED;
+            link->mode  = (link->state == LINK_NOT_ENCRYPTED) ? SecurityManager::SECURITY_MODE_ENCRYPTION_OPEN_LINK :
+                                                                SecurityManager::SECURITY_MODE_ENCRYPTION_NO_MITM;
+            return link;
+        }
+    }
+
+    return NULL;
+}
+
+bool
+SecureGattQueue::satisfies(SecurityManager::SecurityMode_t mode, SecurityManager::SecurityMode_t requiredMode)
+{
+    return rankMode(mode) >= rankMode(requiredMode);
+}
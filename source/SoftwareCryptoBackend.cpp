@@ -0,0 +1,224 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "ble/SoftwareCryptoBackend.h"
+
+/**
+ * Multiplication by x in GF(2^8), without branch.
+ */
+static uint8_t
+xtime(uint8_t x)
+{
+    return (uint8_t)((x << 1) ^ (0x1B & (uint8_t)(-(x >> 7))));
+}
+
+/**
+ * Multiplication in GF(2^8), in constant time.
+ */
+static uint8_t
+multiply(uint8_t a, uint8_t b)
+{
+    uint8_t product = 0;
+    for (unsigned i = 0; i < 8; ++i) {
+        product ^= a & (uint8_t)(-(b & 1));
+        a = xtime(a);
+        b >>= 1;
+    }
+
+    return product;
+}
+
+static uint8_t
+rotateLeft(uint8_t x, unsigned shift)
+{
+    return (uint8_t)((x << shift) | (x >> (8 - shift)));
+}
+
+/**
+ * The AES S-box: inversion in GF(2^8), 0 being its own inverse, followed by
+ * the affine transform.
+ */
+static uint8_t
+substitute(uint8_t x)
+{
+    /* x^-1 = x^254; 254 = 0b11111110. */
+    uint8_t inverse = x;
+    for (unsigned i = 0; i < 6; ++i) {
+        inverse = multiply(multiply(inverse, inverse), x);
+    }
+    inverse = multiply(inverse, inverse);
+
+    return (uint8_t)(inverse ^ rotateLeft(inverse, 1) ^ rotateLeft(inverse, 2) ^
+                     rotateLeft(inverse, 3) ^ rotateLeft(inverse, 4) ^ 0x63);
+}
+
+ble_error_t
+SoftwareCryptoBackend::encrypt(const uint8_t key[BLOCK_SIZE],
+                               const uint8_t plaintext[BLOCK_SIZE],
+                               uint8_t       ciphertext[BLOCK_SIZE])
+{
+    /* The state is column-major, as the input; the round key is expanded
+     * along with the rounds. */
+    uint8_t state[BLOCK_SIZE];
+    uint8_t roundKey[BLOCK_SIZE];
+    memcpy(roundKey, key, BLOCK_SIZE);
+    for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+        state[i] = plaintext[i] ^ roundKey[i];
+    }
+
+    uint8_t rcon = 0x01;
+    for (unsigned round = 1; round <= 10; ++round) {
+        /* SubBytes and ShiftRows: row r is rotated left by r columns. */
+        uint8_t shifted[BLOCK_SIZE];
+        for (unsigned column = 0; column < 4; ++column) {
+            for (unsigned row = 0; row < 4; ++row) {
+                shifted[(column * 4) + row] = substitute(state[(((column + row) % 4) * 4) + row]);
+            }
+        }
+
+        /* MixColumns, skipped by the last round. */
+        if (round != 10) {
+            for (unsigned column = 0; column < 4; ++column) {
+                uint8_t *c  = &shifted[column * 4];
+                uint8_t all = c[0] ^ c[1] ^ c[2] ^ c[3];
+                uint8_t first = c[0];
+                c[0] ^= all ^ xtime(c[0] ^ c[1]);
+                c[1] ^= all ^ xtime(c[1] ^ c[2]);
+                c[2] ^= all ^ xtime(c[2] ^ c[3]);
+                c[3] ^= all ^ xtime(c[3] ^ first);
+            }
+        }
+
+        /* Next round key. */
+        uint8_t temp[4] = {
+            (uint8_t)(substitute(roundKey[13]) ^ rcon),
+            substitute(roundKey[14]),
+            substitute(roundKey[15]),
+            substitute(roundKey[12])
+        };
+        for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+            roundKey[i] ^= (i < 4) ? temp[i] : roundKey[i - 4];
+        }
+        rcon = xtime(rcon);
+
+        for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+            state[i] = shifted[i] ^ roundKey[i];
+        }
+    }
+
+    memcpy(ciphertext, state, BLOCK_SIZE);
+    return BLE_ERROR_NONE;
+}
+
+static uint32_t
+rotateRight(uint32_t x, unsigned shift)
+{
+    return (x >> shift) | (x << (32 - shift));
+}
+
+static uint32_t
+loadWord(const uint8_t *bytes)
+{
+    return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | bytes[3];
+}
+
+static void
+storeWord(uint8_t *bytes, uint32_t word)
+{
+    bytes[0] = (uint8_t)(word >> 24);
+    bytes[1] = (uint8_t)(word >> 16);
+    bytes[2] = (uint8_t)(word >> 8);
+    bytes[3] = (uint8_t)(word);
+}
+
+TableCryptoBackend::TableCryptoBackend() : keyCached(false)
+{
+    /* Columns are words, first row in the most significant octet. An input
+     * octet s = S(x) in the first row contributes (2s, s, s, 3s) to the mixed
+     * column; in the following rows, the same rotated right by one octet per
+     * row. */
+    for (unsigned x = 0; x < 256; ++x) {
+        uint8_t s = substitute((uint8_t)x);
+        sbox[x]  = s;
+        table[x] = ((uint32_t)xtime(s) << 24) | ((uint32_t)s << 16) | ((uint32_t)s << 8) | (uint8_t)(xtime(s) ^ s);
+    }
+}
+
+ble_error_t
+TableCryptoBackend::encrypt(const uint8_t key[BLOCK_SIZE],
+                            const uint8_t plaintext[BLOCK_SIZE],
+                            uint8_t       ciphertext[BLOCK_SIZE])
+{
+    if (!keyCached || (memcmp(cachedKey, key, BLOCK_SIZE) != 0)) {
+        expandKey(key);
+    }
+
+    uint32_t state[4];
+    for (unsigned column = 0; column < 4; ++column) {
+        state[column] = loadWord(&plaintext[column * 4]) ^ roundKeys[column];
+    }
+
+    const uint32_t *roundKey = &roundKeys[4];
+    for (unsigned round = 1; round < NUM_ROUNDS; ++round, roundKey += 4) {
+        uint32_t next[4];
+        for (unsigned column = 0; column < 4; ++column) {
+            next[column] = table[state[column] >> 24] ^
+                           rotateRight(table[(state[(column + 1) % 4] >> 16) & 0xFF], 8) ^
+                           rotateRight(table[(state[(column + 2) % 4] >> 8) & 0xFF], 16) ^
+                           rotateRight(table[state[(column + 3) % 4] & 0xFF], 24) ^
+                           roundKey[column];
+        }
+        memcpy(state, next, sizeof(state));
+    }
+
+    /* The last round has no MixColumns. */
+    for (unsigned column = 0; column < 4; ++column) {
+        uint32_t word = ((uint32_t)sbox[state[column] >> 24] << 24) |
+                        ((uint32_t)sbox[(state[(column + 1) % 4] >> 16) & 0xFF] << 16) |
+                        ((uint32_t)sbox[(state[(column + 2) % 4] >> 8) & 0xFF] << 8) |
+                        sbox[state[(column + 3) % 4] & 0xFF];
+        storeWord(&ciphertext[column * 4], word ^ roundKey[column]);
+    }
+
+    return BLE_ERROR_NONE;
+}
+
+void
+TableCryptoBackend::expandKey(const uint8_t key[BLOCK_SIZE])
+{
+    for (unsigned i = 0; i < 4; ++i) {
+        roundKeys[i] = loadWord(&key[i * 4]);
+    }
+
+    uint8_t rcon = 0x01;
+    for (unsigned i = 4; i < (4 * (NUM_ROUNDS + 1)); ++i) {
+        uint32_t word = roundKeys[i - 1];
+        if ((i % 4) == 0) {
+            /* SubWord(RotWord(word)) ^ Rcon. */
+            word = (((uint32_t)sbox[(word >> 16) & 0xFF] << 24) |
+                    ((uint32_t)sbox[(word >> 8) & 0xFF] << 16) |
+                    ((uint32_t)sbox[word & 0xFF] << 8) |
+                    sbox[word >> 24]) ^ ((uint32_t)rcon << 24);
+            rcon = xtime(rcon);
+        }
+        roundKeys[i] = roundKeys[i - 4] ^ word;
+    }
+
+    memcpy(cachedKey, key, BLOCK_SIZE);
+    keyCached = true;
+}
@@ -0,0 +1,326 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "ble/WhitelistManager.h"
+
+/**
+ * Order addresses by type, then by address.
+ */
+static int
+compareAddress(const BLEProtocol::Address_t     &entry,
+               BLEProtocol::AddressType_t         type,
+               const BLEProtocol::AddressBytes_t  address)
+{
+    if (entry.type != type) {
+        return (entry.type < type) ? -1 : 1;
+    }
+
+    return memcmp(entry.address, address, BLEProtocol::ADDR_LEN);
+}
+
+WhitelistManager::WhitelistManager(Gap &gapIn) :
+    gap(gapIn),
+    bondTable(NULL),
+    size(0),
+    overflowCount(0),
+    controllerUpdates(0)
+{
+    /* empty */
+}
+
+WhitelistManager::~WhitelistManager()
+{
+    detach();
+}
+
+ble_error_t
+WhitelistManager::add(const BLEProtocol::Address_t &address)
+{
+    if (address.type == BLEProtocol::AddressType::RANDOM_PRIVATE_NON_RESOLVABLE) {
+        return BLE_ERROR_INVALID_PARAM;
+    }
+
+    ble_error_t err = insert(address, SOURCE_USER);
+    updateOverflowCount();
+    return err;
+}
+
+ble_error_t
+WhitelistManager::remove(const BLEProtocol::Address_t &address)
+{
+    unsigned index = lowerBound(address.type, address.address);
+    if ((index == size) ||
+        (compareAddress(entries[index].address, address.type, address.address) != 0) ||
+        !(entries[index].sources & SOURCE_USER)) {
+        return BLE_ERROR_INVALID_PARAM;
+    }
+
+    entries[index].sources &= ~SOURCE_USER;
+    purge();
+    updateOverflowCount();
+    return BLE_ERROR_NONE;
+}
+
+void
+WhitelistManager::clear(void)
+{
+    for (unsigned i = 0; i < size; ++i) {
+        entries[i].sources = 0;
+    }
+    purge();
+    updateOverflowCount();
+}
+
+ble_error_t
+WhitelistManager::syncFromBondTable(const BondTable &table)
+{
+    for (unsigned i = 0; i < size; ++i) {
+        entries[i].sources &= ~SOURCE_BOND;
+    }
+    purge();
+
+    ble_error_t err = BLE_ERROR_NONE;
+    for (unsigned i = 0; i < table.getCount(); ++i) {
+        const BondTable::BondRecord_t *record = table.getRecord(i);
+        BLEProtocol::Address_t address(record->identityAddressType, record->identityAddress);
+        if (insert(address, SOURCE_BOND) != BLE_ERROR_NONE) {
+            err = BLE_ERROR_NO_MEM;
+        }
+    }
+
+    /* Bonded identities which disappeared and were never pushed. */
+    purge();
+    updateOverflowCount();
+    return err;
+}
+
+ble_error_t
+WhitelistManager::attach(BondTable &table)
+{
+    detach();
+
+    bondTable = &table;
+    bondTable->onChange(makeFunctionPointer(this, &WhitelistManager::onBondTableChange));
+
+    return syncFromBondTable(table);
+}
+
+void
+WhitelistManager::detach(void)
+{
+    if (bondTable != NULL) {
+        bondTable->onChange().detach(makeFunctionPointer(this, &WhitelistManager::onBondTableChange));
+        bondTable = NULL;
+    }
+}
+
+ble_error_t
+WhitelistManager::commit(void)
+{
+    ble_error_t err = commitIncrementally();
+    if (err == BLE_ERROR_NOT_IMPLEMENTED) {
+        err = commitWholesale();
+    }
+
+    updateOverflowCount();
+    return err;
+}
+
+bool
+WhitelistManager::contains(BLEProtocol::AddressType_t type, const BLEProtocol::AddressBytes_t address) const
+{
+    const Entry_t *entry = find(type, address);
+    return (entry != NULL) && (entry->sources != 0);
+}
+
+bool
+WhitelistManager::isInController(BLEProtocol::AddressType_t type, const BLEProtocol::AddressBytes_t address) const
+{
+    const Entry_t *entry = find(type, address);
+    return (entry != NULL) && entry->inController;
+}
+
+unsigned
+WhitelistManager::lowerBound(BLEProtocol::AddressType_t type, const BLEProtocol::AddressBytes_t address) const
+{
+    unsigned low  = 0;
+    unsigned high = size;
+    while (low < high) {
+        unsigned middle = low + ((high - low) / 2);
+        if (compareAddress(entries[middle].address, type, address) < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+const WhitelistManager::Entry_t *
+WhitelistManager::find(BLEProtocol::AddressType_t type, const BLEProtocol::AddressBytes_t address) const
+{
+    unsigned index = lowerBound(type, address);
+    if ((index == size) || (compareAddress(entries[index].address, type, address) != 0)) {
+        return NULL;
+    }
+
+    return &entries[index];
+}
+
+ble_error_t
+WhitelistManager::insert(const BLEProtocol::Address_t &address, uint8_t source)
+{
+    unsigned index = lowerBound(address.type, address.address);
+    if ((index < size) && (compareAddress(entries[index].address, address.type, address.address) == 0)) {
+        entries[index].sources |= source;
+        return BLE_ERROR_NONE;
+    }
+    if (size == CAPACITY) {
+        return BLE_ERROR_NO_MEM;
+    }
+
+    memmove(&entries[index + 1], &entries[index], (size - index) * sizeof(Entry_t));
+    entries[index].address      = address;
+    entries[index].sources      = source;
+    entries[index].inController = false;
+    ++size;
+
+    return BLE_ERROR_NONE;
+}
+
+void
+WhitelistManager::erase(unsigned index)
+{
+    memmove(&entries[index], &entries[index + 1], (size - index - 1) * sizeof(Entry_t));
+    --size;
+}
+
+void
+WhitelistManager::purge(void)
+{
+    /* Entries without source are only kept until removed from the
+     * controller. */
+    for (unsigned i = size; i-- > 0; ) {
+        if ((entries[i].sources == 0) && !entries[i].inController) {
+            erase(i);
+        }
+    }
+}
+
+void
+WhitelistManager::updateOverflowCount(void)
+{
+    overflowCount = 0;
+    for (unsigned i = 0; i < size; ++i) {
+        if ((entries[i].sources != 0) && !entries[i].inController) {
+            ++overflowCount;
+        }
+    }
+}
+
+void
+WhitelistManager::selectControllerEntries(bool wanted[CAPACITY]) const
+{
+    /* The bonded identities first, then the others; in each group, those
+     * already in the controller first, so as to limit the updates. */
+    unsigned maxSize = gap.getMaxWhitelistSize();
+    unsigned count   = 0;
+
+    memset(wanted, 0, CAPACITY * sizeof(bool));
+    for (unsigned pass = 0; pass < 4; ++pass) {
+        uint8_t source       = (pass < 2) ? (uint8_t)SOURCE_BOND : (uint8_t)SOURCE_USER;
+        bool    inController = ((pass % 2) == 0);
+        for (unsigned i = 0; (i < size) && (count < maxSize); ++i) {
+            if (!wanted[i] && (entries[i].sources & source) && (entries[i].inController == inController)) {
+                wanted[i] = true;
+                ++count;
+            }
+        }
+    }
+}
+
+void
+WhitelistManager::onBondTableChange(const BondTable *table)
+{
+    /* Identities which don't fit are left out, as on attach(). */
+    syncFromBondTable(*table);
+}
+
+ble_error_t
+WhitelistManager::commitIncrementally(void)
+{
+    bool wanted[CAPACITY];
+    selectControllerEntries(wanted);
+
+    /* Removals first, to make room for the additions. */
+    for (unsigned i = 0; i < size; ++i) {
+        if (entries[i].inController && !wanted[i]) {
+            ble_error_t err = gap.removeFromWhitelist(entries[i].address);
+            if (err != BLE_ERROR_NONE) {
+                purge();
+                return err;
+            }
+            entries[i].inController = false;
+            ++controllerUpdates;
+        }
+    }
+
+    for (unsigned i = 0; i < size; ++i) {
+        if (wanted[i] && !entries[i].inController) {
+            ble_error_t err = gap.addToWhitelist(entries[i].address);
+            if (err != BLE_ERROR_NONE) {
+                purge();
+                return err;
+            }
+            entries[i].inController = true;
+            ++controllerUpdates;
+        }
+    }
+
+    purge();
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t
+WhitelistManager::commitWholesale(void)
+{
+    bool                   wanted[CAPACITY];
+    BLEProtocol::Address_t addresses[CAPACITY];
+    Gap::Whitelist_t       whitelist = { addresses, 0, CAPACITY };
+
+    selectControllerEntries(wanted);
+    for (unsigned i = 0; i < size; ++i) {
+        if (wanted[i]) {
+            addresses[whitelist.size++] = entries[i].address;
+        }
+    }
+
+    ble_error_t err = gap.setWhitelist(whitelist);
+    if (err != BLE_ERROR_NONE) {
+        return err;
+    }
+
+    for (unsigned i = 0; i < size; ++i) {
+        entries[i].inController = wanted[i];
+    }
+    controllerUpdates += whitelist.size;
+    purge();
+
+    return BLE_ERROR_NONE;
+}